@@ -3,6 +3,13 @@
  *
  * CAN bus driver for STM32 HAL. Provides initialization, transmit (standard
  * and extended IDs), and interrupt-driven receive with an internal ring buffer.
+ *
+ * Received traffic is limited in hardware by a subscription table: each
+ * entry is programmed into a bxCAN filter bank, so frames nobody subscribed
+ * to (e.g. AK70-9 motor traffic) never raise an interrupt. Each entry picks
+ * the RX FIFO it lands in (FIFO0 for high priority, FIFO1 for low priority)
+ * and either a handler that is called from the RX interrupt or, with a NULL
+ * handler, the ring buffer read by can_bus_recv().
  */
 
 #ifndef CAN_BUS_H
@@ -12,16 +19,53 @@
 #include "can_frame.h"
 #include <stdint.h>
 
+#define CAN_BUS_MAX_SUBSCRIPTIONS 28        /* Up to 4 per filter bank, 14 banks on CAN1 */
+#define CAN_BUS_EXACT_STD         0x7FFU    /* Mask for a single standard ID */
+#define CAN_BUS_EXACT_EXT         0x1FFFFFFFU /* Mask for a single extended ID */
+
+/* Called from the RX interrupt, keep it short */
+typedef void (*CanRxHandler)(const CanFrame* frame);
+
+typedef struct {
+    uint32_t     id;          /* Identifier to accept */
+    uint32_t     mask;        /* Identifier bits that must match; CAN_BUS_EXACT_* for one ID */
+    uint8_t      is_extended; /* 1 = 29-bit ID, 0 = 11-bit ID */
+    uint32_t     fifo;        /* CAN_RX_FIFO0 (high priority) or CAN_RX_FIFO1 (low priority) */
+    CanRxHandler handler;     /* NULL = queue for can_bus_recv() */
+} CanSubscription;
+
+typedef struct {
+    uint32_t rx_frames[2];    /* Frames received, per FIFO */
+    uint32_t rx_dropped;      /* Ring buffer full */
+    uint32_t rx_high_water;   /* Deepest ring buffer fill level */
+    uint32_t fifo_overruns;   /* Hardware FIFO overrun (ISR too slow) */
+    uint8_t  filter_banks;    /* Banks in use */
+} CanBusStats;
+
 /*
- * Initialize the CAN peripheral: configure an accept-all filter, start the
- * peripheral, enable the CAN1 RX FIFO 0 interrupt in the NVIC, and activate
- * RX/error notifications.
+ * Initialize the CAN peripheral: program the filter banks from the
+ * subscription table, start the peripheral, enable the CAN1 RX FIFO 0/1
+ * interrupts in the NVIC, and activate RX/error notifications.
+ *
+ * A NULL table (or count 0) installs an accept-all filter that queues every
+ * frame, the behaviour before subscriptions existed. The table is referenced,
+ * not copied, so it must stay valid (normally a static const array).
  *
  * Must be called after HAL_CAN_Init() (i.e. after MX_CAN1_Init()).
  *
  * Returns 1 on success, 0 on failure.
  */
-int can_bus_init(CAN_HandleTypeDef* hcan);
+int can_bus_init(CAN_HandleTypeDef* hcan, const CanSubscription* subs, uint8_t count);
+
+/*
+ * Replace the subscription table while running. Standard exact IDs share a
+ * bank four at a time (16-bit list mode), standard masks and extended exact
+ * IDs two at a time, extended masks take a bank each.
+ *
+ * Returns 1 on success, 0 if the table needs more than 14 banks or the HAL
+ * rejects a bank.
+ */
+int can_bus_subscribe(const CanSubscription* subs, uint8_t count);
 
 /*
  * Transmit a CAN frame using a 29-bit extended identifier.
@@ -45,4 +89,14 @@ int can_bus_send_std(uint16_t std_id, const uint8_t* data, uint8_t dlc);
  */
 int can_bus_recv(CanFrame* out);
 
+/*
+ * Pop up to max received frames at once.
+ *
+ * Returns the number of frames copied to out.
+ */
+int can_bus_recv_batch(CanFrame* out, int max);
+
+/* Copy the RX counters */
+void can_bus_get_stats(CanBusStats* out);
+
 #endif /* CAN_BUS_H */
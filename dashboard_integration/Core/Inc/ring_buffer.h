@@ -1,52 +1,106 @@
 /*
  * ring_buffer.h
  *
- * Circular buffer for CAN RX frames. Header-only with static inline functions.
- * Used by the CAN bus driver to queue received messages from the ISR.
+ * Lock-free single-producer/single-consumer ring buffers. Header-only with
+ * static inline functions generated per element type by SPSC_RING_DEFINE.
+ * Used by the CAN bus driver to queue received messages from the ISR, and
+ * meant for any ISR -> main loop queue (UART RX, sample queues).
+ *
+ * head is written only by the producer and tail only by the consumer, so
+ * neither side needs to mask interrupts. Both are free-running counters;
+ * the slot is the counter masked by (capacity - 1), which is why the
+ * capacity must be a power of two, and head - tail is the fill level even
+ * across wrap-around. A data memory barrier orders the element copy against
+ * the index update on each side.
+ *
+ * Only one context may push and only one may pop. The counters are updated
+ * by the producer: high_water is the deepest fill seen, dropped counts
+ * pushes rejected because the buffer was full.
  */
 
 #ifndef RING_BUFFER_H
 #define RING_BUFFER_H
 
+#include "stm32f4xx_hal.h"
 #include "can_frame.h"
 #include <stdint.h>
 #include <string.h>
 
-#define CAN_RX_BUFFER_CAPACITY 32
-
-typedef struct {
-    CanFrame buf[CAN_RX_BUFFER_CAPACITY];
-    volatile uint16_t head;
-    volatile uint16_t tail;
-    volatile uint16_t count;
-} CanRxRingBuffer;
-
-static inline void can_rx_rb_init(CanRxRingBuffer* rb) {
-    rb->head  = 0;
-    rb->tail  = 0;
-    rb->count = 0;
-}
-
-/* Returns 1 on success, 0 if buffer is full (frame dropped) */
-static inline int can_rx_rb_push(CanRxRingBuffer* rb, const CanFrame* f) {
-    if (rb->count >= CAN_RX_BUFFER_CAPACITY) return 0;
-    rb->buf[rb->head] = *f;
-    rb->head = (rb->head + 1) % CAN_RX_BUFFER_CAPACITY;
-    rb->count++;
-    return 1;
+/*
+ * Define ring buffer type TYPE holding ELEM, with functions PREFIX_init,
+ * PREFIX_push, PREFIX_pop, PREFIX_pop_batch and PREFIX_size.
+ * CAPACITY must be a power of two.
+ */
+#define SPSC_RING_DEFINE(TYPE, PREFIX, ELEM, CAPACITY)                              \
+                                                                                    \
+_Static_assert((CAPACITY) > 0 && ((CAPACITY) & ((CAPACITY) - 1)) == 0,              \
+               #TYPE " capacity must be a power of two");                          \
+                                                                                    \
+typedef struct {                                                                    \
+    ELEM buf[CAPACITY];                                                             \
+    volatile uint32_t head;       /* Next slot to write, producer only */          \
+    volatile uint32_t tail;       /* Next slot to read, consumer only */           \
+    volatile uint32_t high_water; /* Deepest fill level seen */                    \
+    volatile uint32_t dropped;    /* Pushes rejected, buffer full */               \
+} TYPE;                                                                             \
+                                                                                    \
+/* Not safe while either side is running */                                        \
+static inline void PREFIX##_init(TYPE* rb) {                                        \
+    rb->head       = 0;                                                             \
+    rb->tail       = 0;                                                             \
+    rb->high_water = 0;                                                             \
+    rb->dropped    = 0;                                                             \
+}                                                                                   \
+                                                                                    \
+/* Producer. Returns 1 on success, 0 if buffer is full (element dropped) */         \
+static inline int PREFIX##_push(TYPE* rb, const ELEM* e) {                          \
+    uint32_t head = rb->head;                                                       \
+    uint32_t used = head - rb->tail;                                                \
+    if (used >= (CAPACITY)) {                                                       \
+        rb->dropped++;                                                              \
+        return 0;                                                                   \
+    }                                                                               \
+    rb->buf[head & ((CAPACITY) - 1)] = *e;                                          \
+    __DMB();                      /* Element visible before the new head */        \
+    rb->head = head + 1;                                                            \
+    if (used + 1 > rb->high_water) rb->high_water = used + 1;                       \
+    return 1;                                                                       \
+}                                                                                   \
+                                                                                    \
+/* Consumer. Returns 1 on success, 0 if buffer is empty */                          \
+static inline int PREFIX##_pop(TYPE* rb, ELEM* out) {                               \
+    uint32_t tail = rb->tail;                                                       \
+    if (rb->head == tail) return 0;                                                 \
+    __DMB();                      /* Read the element after seeing the head */     \
+    *out = rb->buf[tail & ((CAPACITY) - 1)];                                        \
+    __DMB();                      /* Copy done before the slot is released */      \
+    rb->tail = tail + 1;                                                            \
+    return 1;                                                                       \
+}                                                                                   \
+                                                                                    \
+/* Consumer. Pops up to max elements with one index update, returns the count */   \
+static inline uint32_t PREFIX##_pop_batch(TYPE* rb, ELEM* out, uint32_t max) {      \
+    uint32_t tail = rb->tail;                                                       \
+    uint32_t n = rb->head - tail;                                                   \
+    if (n > max) n = max;                                                           \
+    if (n == 0) return 0;                                                           \
+    __DMB();                                                                        \
+    for (uint32_t i = 0; i < n; i++) {                                              \
+        out[i] = rb->buf[(tail + i) & ((CAPACITY) - 1)];                            \
+    }                                                                               \
+    __DMB();                                                                        \
+    rb->tail = tail + n;                                                            \
+    return n;                                                                       \
+}                                                                                   \
+                                                                                    \
+/* Either side. A snapshot: the other side may change it right after */            \
+static inline uint32_t PREFIX##_size(const TYPE* rb) {                              \
+    return rb->head - rb->tail;                                                     \
 }
 
-/* Returns 1 on success, 0 if buffer is empty */
-static inline int can_rx_rb_pop(CanRxRingBuffer* rb, CanFrame* out) {
-    if (rb->count == 0) return 0;
-    *out = rb->buf[rb->tail];
-    rb->tail = (rb->tail + 1) % CAN_RX_BUFFER_CAPACITY;
-    rb->count--;
-    return 1;
-}
+/* CAN RX frames, pushed by the RX FIFO ISRs (same priority, so one producer at a time) */
+#define CAN_RX_BUFFER_CAPACITY 32
 
-static inline uint16_t can_rx_rb_size(const CanRxRingBuffer* rb) {
-    return rb->count;
-}
+SPSC_RING_DEFINE(CanRxRingBuffer, can_rx_rb, CanFrame, CAN_RX_BUFFER_CAPACITY)
 
 #endif /* RING_BUFFER_H */
@@ -2,44 +2,65 @@
  * can_bus.c
  *
  * CAN bus driver implementation for STM32 HAL.
- * Handles initialization, transmit, and interrupt-driven receive.
+ * Handles initialization, filter programming, transmit, and interrupt-driven
+ * receive with per-ID dispatch.
  */
 
 #include "can_bus.h"
 #include "ring_buffer.h"
 #include <string.h>
 
+#define CAN_BUS_NUM_BANKS    14     /* CAN1 banks; CAN2 starts at SlaveStartFilterBank */
+#define CAN_BUS_MAX_FMI      (CAN_BUS_NUM_BANKS * 4)
+#define CAN_BUS_NO_SUB       0xFF
+
+/* IDE/RTR bits of the filter register formats */
+#define FILTER32_IDE         0x4U
+#define FILTER32_RTR         0x2U
+#define FILTER16_RTR_IDE     0x18U
+
+/* Filter bank layouts, in the order they are allocated */
+enum {
+    LAYOUT_STD_LIST,    /* 16-bit list: 4 exact standard IDs */
+    LAYOUT_STD_MASK,    /* 16-bit mask: 2 masked standard IDs */
+    LAYOUT_EXT_LIST,    /* 32-bit list: 2 exact extended IDs */
+    LAYOUT_EXT_MASK,    /* 32-bit mask: 1 masked extended ID */
+    NUM_LAYOUTS
+};
+
+static const uint8_t layout_entries[NUM_LAYOUTS] = { 4, 2, 2, 1 };
+
 /* Internal state */
 static CAN_HandleTypeDef* g_hcan = NULL;
 static CanRxRingBuffer g_rxq;
+static const CanSubscription* g_subs = NULL;
+static uint8_t g_banks_used = 0;
+static uint8_t g_fmi_sub[2][CAN_BUS_MAX_FMI];  /* Filter match index -> subscription, per FIFO */
+static volatile CanBusStats g_stats;
 
-int can_bus_init(CAN_HandleTypeDef* hcan) {
+static int subscription_layout(const CanSubscription* sub);
+static int program_bank(uint8_t bank, int layout, uint32_t fifo, const CanSubscription* subs, const uint8_t* idx, uint8_t n);
+static void receive_fifo(CAN_HandleTypeDef* hcan, uint32_t fifo);
+
+int can_bus_init(CAN_HandleTypeDef* hcan, const CanSubscription* subs, uint8_t count) {
     g_hcan = hcan;
     can_rx_rb_init(&g_rxq);
+    memset((void*)&g_stats, 0, sizeof(g_stats));
 
-    /* Accept-all filter: mask = 0 means all bits are don't-care */
-    CAN_FilterTypeDef filter;
-    memset(&filter, 0, sizeof(filter));
-    filter.FilterBank           = 0;
-    filter.FilterMode           = CAN_FILTERMODE_IDMASK;
-    filter.FilterScale          = CAN_FILTERSCALE_32BIT;
-    filter.FilterIdHigh         = 0x0000;
-    filter.FilterIdLow          = 0x0000;
-    filter.FilterMaskIdHigh     = 0x0000;
-    filter.FilterMaskIdLow      = 0x0000;
-    filter.FilterFIFOAssignment = CAN_FILTER_FIFO0;
-    filter.FilterActivation     = ENABLE;
-    filter.SlaveStartFilterBank = 14;
-
-    if (HAL_CAN_ConfigFilter(g_hcan, &filter) != HAL_OK) return 0;
+    if (!can_bus_subscribe(subs, count)) return 0;
     if (HAL_CAN_Start(g_hcan) != HAL_OK) return 0;
 
-    /* Enable NVIC for CAN1 RX FIFO 0 */
+    /* Enable NVIC for CAN1 RX FIFO 0 and 1 (same priority, so the ISRs never nest) */
     HAL_NVIC_SetPriority(CAN1_RX0_IRQn, 1, 0);
     HAL_NVIC_EnableIRQ(CAN1_RX0_IRQn);
+    HAL_NVIC_SetPriority(CAN1_RX1_IRQn, 1, 0);
+    HAL_NVIC_EnableIRQ(CAN1_RX1_IRQn);
 
     /* Activate RX and error notifications */
     uint32_t notif = CAN_IT_RX_FIFO0_MSG_PENDING |
+                     CAN_IT_RX_FIFO1_MSG_PENDING |
+                     CAN_IT_RX_FIFO0_OVERRUN |
+                     CAN_IT_RX_FIFO1_OVERRUN |
                      CAN_IT_ERROR |
                      CAN_IT_BUSOFF |
                      CAN_IT_LAST_ERROR_CODE;
@@ -49,6 +70,79 @@ int can_bus_init(CAN_HandleTypeDef* hcan) {
     return 1;
 }
 
+int can_bus_subscribe(const CanSubscription* subs, uint8_t count) {
+    if (!g_hcan) return 0;
+    if (count > CAN_BUS_MAX_SUBSCRIPTIONS) return 0;
+    if (subs == NULL) count = 0;
+
+    /* Banks needed: entries of each layout and FIFO are packed together */
+    uint8_t per_group[2][NUM_LAYOUTS] = {{0}};
+    for (uint8_t i = 0; i < count; i++) {
+        if (subs[i].fifo > CAN_RX_FIFO1) return 0;
+        per_group[subs[i].fifo][subscription_layout(&subs[i])]++;
+    }
+
+    uint8_t banks = (count == 0) ? 1 : 0;
+    for (int f = 0; f < 2; f++) {
+        for (int l = 0; l < NUM_LAYOUTS; l++) {
+            banks += (per_group[f][l] + layout_entries[l] - 1) / layout_entries[l];
+        }
+    }
+    if (banks > CAN_BUS_NUM_BANKS) return 0;
+
+    /* The RX interrupts read the dispatch table */
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    int ok = 1;
+    uint8_t bank = 0;
+    uint8_t next_fmi[2] = { 0, 0 };
+    memset(g_fmi_sub, CAN_BUS_NO_SUB, sizeof(g_fmi_sub));
+
+    if (count == 0) {
+        /* Accept-all filter: mask = 0 means all bits are don't-care */
+        ok = program_bank(bank++, LAYOUT_EXT_MASK, CAN_RX_FIFO0, NULL, NULL, 0);
+    }
+
+    for (uint32_t f = 0; f < 2 && ok; f++) {
+        for (int l = 0; l < NUM_LAYOUTS && ok; l++) {
+            uint8_t idx[4];
+            uint8_t n = 0;
+
+            for (uint8_t i = 0; i <= count && ok; i++) {
+                /* Flush a full bank, or the partial last one */
+                if (n == layout_entries[l] || (i == count && n > 0)) {
+                    ok = program_bank(bank++, l, f, subs, idx, n);
+
+                    /* Padding repeats the last entry, so every index of the bank maps */
+                    for (uint8_t k = 0; k < layout_entries[l]; k++) {
+                        g_fmi_sub[f][next_fmi[f]++] = idx[(k < n) ? k : n - 1];
+                    }
+                    n = 0;
+                }
+                if (i < count && subs[i].fifo == f && subscription_layout(&subs[i]) == l) idx[n++] = i;
+            }
+        }
+    }
+
+    /* Switch off banks left over from a larger table */
+    for (uint8_t b = bank; b < g_banks_used && ok; b++) {
+        CAN_FilterTypeDef filter;
+        memset(&filter, 0, sizeof(filter));
+        filter.FilterBank           = b;
+        filter.FilterActivation     = DISABLE;
+        filter.SlaveStartFilterBank = CAN_BUS_NUM_BANKS;
+        ok = (HAL_CAN_ConfigFilter(g_hcan, &filter) == HAL_OK);
+    }
+
+    g_subs = subs;
+    g_banks_used = bank;
+    g_stats.filter_banks = bank;
+
+    __set_PRIMASK(primask);
+    return ok;
+}
+
 int can_bus_send_ext(uint32_t ext_id, const uint8_t* data, uint8_t dlc) {
     if (!g_hcan) return 0;
     if (ext_id > 0x1FFFFFFFU) return 0;
@@ -87,35 +181,147 @@ int can_bus_recv(CanFrame* out) {
     return can_rx_rb_pop(&g_rxq, out);
 }
 
+int can_bus_recv_batch(CanFrame* out, int max) {
+    if (max <= 0) return 0;
+    return (int)can_rx_rb_pop_batch(&g_rxq, out, (uint32_t)max);
+}
+
+void can_bus_get_stats(CanBusStats* out) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    *out = g_stats;
+    out->rx_dropped = g_rxq.dropped;
+    out->rx_high_water = g_rxq.high_water;
+    __set_PRIMASK(primask);
+}
+
+static int subscription_layout(const CanSubscription* sub) {
+    if (sub->is_extended) {
+        return ((sub->mask & CAN_BUS_EXACT_EXT) == CAN_BUS_EXACT_EXT) ? LAYOUT_EXT_LIST : LAYOUT_EXT_MASK;
+    }
+    return ((sub->mask & CAN_BUS_EXACT_STD) == CAN_BUS_EXACT_STD) ? LAYOUT_STD_LIST : LAYOUT_STD_MASK;
+}
+
 /*
- * HAL callback: called from HAL_CAN_IRQHandler when a message arrives
- * in RX FIFO 0. Reads the message and pushes it into the ring buffer.
+ * Program one filter bank with n (1..layout_entries) subscriptions of the
+ * same layout. Register images follow the bxCAN formats:
+ *   32-bit: STID[10:0] EXID[17:0] IDE RTR 0
+ *   16-bit: STID[10:0] RTR IDE EXID[17:15]
+ * Masks always include IDE and RTR, so only data frames of the subscribed
+ * ID type match. With subs == NULL the bank accepts everything.
  */
-void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef *hcan) {
-    CAN_RxHeaderTypeDef hdr;
-    uint8_t data[8];
+static int program_bank(uint8_t bank, int layout, uint32_t fifo, const CanSubscription* subs, const uint8_t* idx, uint8_t n) {
+    uint32_t reg[4];    /* Filter words in index order */
 
-    memset(&hdr, 0, sizeof(hdr));
-    memset(data, 0, sizeof(data));
+    for (uint8_t k = 0; k < layout_entries[layout]; k++) {
+        const CanSubscription* sub = (subs != NULL) ? &subs[idx[(k < n) ? k : n - 1]] : NULL;
 
-    if (HAL_CAN_GetRxMessage(hcan, CAN_RX_FIFO0, &hdr, data) != HAL_OK) {
-        return;
+        switch (layout) {
+        case LAYOUT_STD_LIST:
+            reg[k] = (sub->id & 0x7FFU) << 5;
+            break;
+        case LAYOUT_STD_MASK:
+            reg[2 * k]     = (sub->id & 0x7FFU) << 5;
+            reg[2 * k + 1] = ((sub->mask & 0x7FFU) << 5) | FILTER16_RTR_IDE;
+            break;
+        case LAYOUT_EXT_LIST:
+            reg[k] = ((sub->id & 0x1FFFFFFFU) << 3) | FILTER32_IDE;
+            break;
+        case LAYOUT_EXT_MASK:
+        default:
+            if (sub == NULL) {
+                reg[0] = reg[1] = 0;
+            } else {
+                reg[0] = ((sub->id & 0x1FFFFFFFU) << 3) | FILTER32_IDE;
+                reg[1] = ((sub->mask & 0x1FFFFFFFU) << 3) | FILTER32_IDE | FILTER32_RTR;
+            }
+            break;
+        }
     }
 
-    CanFrame f;
-    memset(&f, 0, sizeof(f));
+    CAN_FilterTypeDef filter;
+    memset(&filter, 0, sizeof(filter));
+    filter.FilterBank           = bank;
+    filter.FilterFIFOAssignment = (fifo == CAN_RX_FIFO0) ? CAN_FILTER_FIFO0 : CAN_FILTER_FIFO1;
+    filter.FilterActivation     = ENABLE;
+    filter.SlaveStartFilterBank = CAN_BUS_NUM_BANKS;
 
-    if (hdr.IDE == CAN_ID_EXT) {
-        f.id = hdr.ExtId;
-        f.is_extended = 1;
+    if (layout == LAYOUT_STD_LIST || layout == LAYOUT_STD_MASK) {
+        /* 16-bit scale: FR1 = MaskIdLow:IdLow, FR2 = MaskIdHigh:IdHigh */
+        filter.FilterScale      = CAN_FILTERSCALE_16BIT;
+        filter.FilterMode       = (layout == LAYOUT_STD_LIST) ? CAN_FILTERMODE_IDLIST : CAN_FILTERMODE_IDMASK;
+        filter.FilterIdLow      = reg[0];
+        filter.FilterMaskIdLow  = reg[1];
+        filter.FilterIdHigh     = reg[2];
+        filter.FilterMaskIdHigh = reg[3];
     } else {
-        f.id = hdr.StdId;
-        f.is_extended = 0;
+        /* 32-bit scale: FR1 = IdHigh:IdLow, FR2 = MaskIdHigh:MaskIdLow */
+        filter.FilterScale      = CAN_FILTERSCALE_32BIT;
+        filter.FilterMode       = (layout == LAYOUT_EXT_LIST) ? CAN_FILTERMODE_IDLIST : CAN_FILTERMODE_IDMASK;
+        filter.FilterIdHigh     = reg[0] >> 16;
+        filter.FilterIdLow      = reg[0] & 0xFFFFU;
+        filter.FilterMaskIdHigh = reg[1] >> 16;
+        filter.FilterMaskIdLow  = reg[1] & 0xFFFFU;
+    }
+
+    return (HAL_CAN_ConfigFilter(g_hcan, &filter) == HAL_OK);
+}
+
+/*
+ * Drain one RX FIFO. Each frame goes to the handler of the subscription
+ * whose filter matched (looked up by the hardware filter match index) or,
+ * without a handler, into the ring buffer.
+ */
+static void receive_fifo(CAN_HandleTypeDef* hcan, uint32_t fifo) {
+    CAN_RxHeaderTypeDef hdr;
+    uint8_t data[8];
+
+    /* Empty the FIFO in one interrupt instead of one interrupt per frame */
+    while (HAL_CAN_GetRxFifoFillLevel(hcan, fifo) > 0) {
+        memset(&hdr, 0, sizeof(hdr));
+        memset(data, 0, sizeof(data));
+
+        if (HAL_CAN_GetRxMessage(hcan, fifo, &hdr, data) != HAL_OK) {
+            return;
+        }
+
+        CanFrame f;
+        memset(&f, 0, sizeof(f));
+
+        if (hdr.IDE == CAN_ID_EXT) {
+            f.id = hdr.ExtId;
+            f.is_extended = 1;
+        } else {
+            f.id = hdr.StdId;
+            f.is_extended = 0;
+        }
+
+        f.dlc = hdr.DLC;
+        memcpy(f.data, data, 8);
+        g_stats.rx_frames[fifo]++;
+
+        uint8_t sub = (hdr.FilterMatchIndex < CAN_BUS_MAX_FMI) ? g_fmi_sub[fifo][hdr.FilterMatchIndex] : CAN_BUS_NO_SUB;
+        if (sub != CAN_BUS_NO_SUB && g_subs[sub].handler != NULL) {
+            g_subs[sub].handler(&f);
+        } else {
+            can_rx_rb_push(&g_rxq, &f);     /* Counts a drop when full */
+        }
     }
+}
 
-    f.dlc = hdr.DLC;
-    memcpy(f.data, data, 8);
+/* HAL callbacks: called from HAL_CAN_IRQHandler when a message arrives in RX FIFO 0 / 1 */
+void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef *hcan) {
+    receive_fifo(hcan, CAN_RX_FIFO0);
+}
+
+void HAL_CAN_RxFifo1MsgPendingCallback(CAN_HandleTypeDef *hcan) {
+    receive_fifo(hcan, CAN_RX_FIFO1);
+}
 
-    /* If buffer is full the frame is silently dropped */
-    can_rx_rb_push(&g_rxq, &f);
+/* HAL callback: a FIFO overrun means a frame was lost in hardware before the ISR could read it */
+void HAL_CAN_ErrorCallback(CAN_HandleTypeDef *hcan) {
+    uint32_t fov = hcan->ErrorCode & (HAL_CAN_ERROR_RX_FOV0 | HAL_CAN_ERROR_RX_FOV1);
+    if (fov & HAL_CAN_ERROR_RX_FOV0) g_stats.fifo_overruns++;
+    if (fov & HAL_CAN_ERROR_RX_FOV1) g_stats.fifo_overruns++;
+    hcan->ErrorCode &= ~fov;
 }
@@ -37,6 +37,11 @@
 static int sampling_rate = 10;   // Hz
 #define DASHBOARD_COMMAND   1000	//Arbitrary message to send data
 
+/* CAN IDs received; everything else (e.g. AK70-9 motor traffic) is rejected by the filter banks */
+static const CanSubscription can_subscriptions[] = {
+  { DASHBOARD_COMMAND, CAN_BUS_EXACT_STD, 0, CAN_RX_FIFO0, NULL },  // Queued for Dashboard_Receive_CAN
+};
+
 
 #define RX_BUF_SIZE    64
 static char rxBuf[RX_BUF_SIZE];
@@ -99,7 +104,7 @@ int main(void)
   //MX_CAN1_Init();
   //MX_CAN2_Init();
   MX_USART1_UART_Init();
-  can_bus_init(&hcan1);
+  can_bus_init(&hcan1, can_subscriptions, sizeof(can_subscriptions) / sizeof(can_subscriptions[0]));
 
   HAL_GPIO_WritePin(GPIOB,
                     GPIO_PIN_0 | GPIO_PIN_1 | GPIO_PIN_2,
@@ -503,6 +508,16 @@ static void Dashboard_Transmit_CAN(void)
 
 int Dashboard_Receive_CAN(void)
 {
+  CanFrame frame;
 
+  // Only subscribed IDs reach the queue
+  while (can_bus_recv(&frame))
+  {
+    if (!frame.is_extended && frame.id == DASHBOARD_COMMAND)
+    {
+      return 1;
+    }
+  }
+  return 0;
 }
 
@@ -35,6 +35,8 @@ extern "C" {
 extern CAN_HandleTypeDef hcan1;
 
 /* USER CODE BEGIN Private defines */
+#define CAN1_BITRATE            1000000U    // Bit timing is recomputed from PCLK1 for every clock profile
+#define CAN1_SAMPLE_POINT_PCT   87          // Target sample point (CANopen recommends 87.5%)
 
 /* USER CODE END Private defines */
 
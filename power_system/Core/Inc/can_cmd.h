@@ -0,0 +1,65 @@
+/*
+ * can_cmd.h
+ *
+ * CAN command channel: lets the dashboard reset a latched fault and tune
+ * the telemetry at runtime.
+ *
+ * One filter bank passes only CAN_ID_CMD into RX FIFO 0. The FIFO interrupt
+ * copies each command frame into a small queue and releases the command
+ * task, which executes the commands in main context and answers each one
+ * with an acknowledgement frame. Frames arriving while the queue is full
+ * are dropped unanswered and counted, so the dashboard retries on a missing
+ * acknowledgement.
+ *
+ * Command frame (ID CAN_ID_CMD, DLC 2-8):
+ *   Byte 0   : opcode (CAN_CMD_*)
+ *   Byte 1   : tag, any value, echoed in the acknowledgement
+ *   Byte 2-7 : arguments, little-endian
+ *
+ * Acknowledgement frame (ID CAN_ID_CMD_ACK, DLC 3):
+ *   Byte 0 : opcode
+ *   Byte 1 : tag
+ *   Byte 2 : result (CAN_CMD_OK or CAN_CMD_ERR_*)
+ */
+
+#ifndef INC_CAN_CMD_H_
+#define INC_CAN_CMD_H_
+
+#include "main.h"
+#include <stdint.h>
+
+// CAN IDs, both ahead of the telemetry frames in arbitration
+#define CAN_ID_CMD              0x080   // Dashboard -> board
+#define CAN_ID_CMD_ACK          0x081   // Board -> dashboard
+
+// Opcodes
+#define CAN_CMD_FAULT_RESET     0x01    // No arguments: leave FAULT, start over from PRECHARGE
+#define CAN_CMD_TELEMETRY_RATE  0x02    // Byte 2-3: telemetry tick in ms (uint16)
+#define CAN_CMD_SENSOR_MASK     0x03    // Byte 2: sensors sent on CAN, bit n = sensor n
+#define CAN_CMD_ADC_PROFILE     0x04    // Byte 2: INA228_AdcProfile_t, byte 3: sensor mask (0 = all sensors)
+#define CAN_CMD_SNAPSHOT        0x05    // No arguments: status frame and both pages of every enabled sensor
+
+// Acknowledgement results
+#define CAN_CMD_OK              0
+#define CAN_CMD_ERR_UNKNOWN     1       // Unknown opcode
+#define CAN_CMD_ERR_ARG         2       // Frame too short or argument out of range
+#define CAN_CMD_ERR_BUSY        3       // Refused in the current state (fault reset while ALERT is asserted)
+
+#define CAN_CMD_FILTER_BANK     0       // Filter bank used for CAN_ID_CMD
+#define CAN_CMD_QUEUE_SIZE      4       // Commands received but not yet executed
+
+// TELEMETRY_RATE range
+#define TELEMETRY_RATE_MIN_MS   10
+#define TELEMETRY_RATE_MAX_MS   10000
+
+typedef struct {
+    uint32_t received;          // Command frames taken from the FIFO
+    uint32_t dropped;           // Queue full, not executed or acknowledged
+} CanCmdStats_t;
+
+/* Function Prototypes */
+HAL_StatusTypeDef can_cmd_init(void);       // After HAL_CAN_Start() and can_tx_init()
+void can_cmd_task(void);                    // Scheduler task released by SCHED_EV_CAN_CMD
+void can_cmd_get_stats(CanCmdStats_t* stats);
+
+#endif /* INC_CAN_CMD_H_ */
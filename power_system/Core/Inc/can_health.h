@@ -0,0 +1,60 @@
+/*
+ * can_health.h
+ *
+ * CAN1 error monitoring and bus-off recovery.
+ *
+ * The status change/error interrupt (CAN1_SCE) reports the error warning,
+ * error passive and bus-off transitions and the error code of every bus
+ * error. CAN1 runs with AutoBusOff disabled, so after a bus-off the
+ * controller stays off the bus until software restarts it. The health task
+ * restarts it after a backoff that doubles with every restart, up to
+ * CAN_BUSOFF_BACKOFF_MAX_MS, so a node on a broken bus does not keep
+ * disturbing it; the backoff starts over once the bus has stayed up for
+ * CAN_BUSOFF_STABLE_MS.
+ *
+ * Once per CAN_HEALTH_FRAME_MS the task sends a health frame with the error
+ * counters, the bus-off count, the TX results since the previous health
+ * frame and the bus load of this node's own frames.
+ */
+
+#ifndef INC_CAN_HEALTH_H_
+#define INC_CAN_HEALTH_H_
+
+#include "main.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#define CAN_ID_CAN_HEALTH           0x0F0   // Ahead of the telemetry, so it survives a full TX queue
+
+#define CAN_HEALTH_INTERVAL_MS      100     // Error state poll and bus-off restart period
+#define CAN_HEALTH_FRAME_MS         1000    // Health frame period (a multiple of CAN_HEALTH_INTERVAL_MS)
+#define CAN_BUSOFF_BACKOFF_MIN_MS   100     // Bus-off to the first restart
+#define CAN_BUSOFF_BACKOFF_MAX_MS   6400
+#define CAN_BUSOFF_STABLE_MS        10000   // Up this long after a recovery, the backoff starts over
+
+typedef enum {
+    CAN_ERROR_ACTIVE = 0,
+    CAN_ERROR_WARNING,          // TEC or REC >= 96
+    CAN_ERROR_PASSIVE,          // TEC or REC >= 128
+    CAN_BUS_OFF                 // TEC > 255, off the bus until restarted
+} CanErrorState_t;
+
+typedef struct {
+    CanErrorState_t state;
+    uint8_t  tec;               // Transmit error counter (255 while bus-off)
+    uint8_t  rec;               // Receive error counter
+    uint8_t  last_error;        // ESR.LEC code of the last bus error: 1 stuff, 2 form, 3 ACK, 4 bit recessive, 5 bit dominant, 6 CRC
+    uint32_t bus_errors;        // Bus errors reported by the error interrupt
+    uint32_t bus_offs;          // Entries into bus-off
+    uint32_t restarts;          // Controller restarts after a bus-off
+    uint32_t backoff_ms;        // Wait from the next bus-off to its restart
+    uint16_t load_centi_pct;    // Bus load of this node's frames over the last health frame period, 0.01 %
+} CanHealth_t;
+
+/* Function Prototypes */
+void can_health_init(void);                                 // After can_tx_init()
+void can_health_task(void);
+void can_health_get(CanHealth_t* health);
+void can_health_error_callback(CAN_HandleTypeDef* hcan);    // From HAL_CAN_ErrorCallback
+
+#endif /* INC_CAN_HEALTH_H_ */
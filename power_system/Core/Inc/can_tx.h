@@ -0,0 +1,49 @@
+/*
+ * can_tx.h
+ *
+ * Interrupt-driven CAN1 transmit queue.
+ *
+ * can_tx_send() copies a frame into a software queue kept in CAN ID order
+ * (lowest ID = highest bus priority first) and returns immediately. The
+ * queue is drained into the three bxCAN TX mailboxes right away when they
+ * are free, and from then on by the mailbox-complete interrupts, so callers
+ * never wait for the bus.
+ *
+ * AutoRetransmission is disabled on CAN1, so a frame that loses arbitration
+ * is not retried by the hardware. It is put back into the queue at its
+ * priority and counted. A frame that fails with a transmit error is dropped
+ * and counted. When the queue is full, a new frame evicts the lowest
+ * priority queued frame if it outranks it, otherwise the new frame is
+ * dropped.
+ */
+
+#ifndef INC_CAN_TX_H_
+#define INC_CAN_TX_H_
+
+#include "main.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#define CAN_TX_QUEUE_SIZE       24      // Frames waiting for a mailbox (a periodic tick is 6, a snapshot 11)
+
+typedef struct {
+    uint8_t  depth;             // Frames queued now
+    uint8_t  max_depth;         // High-water mark
+    uint32_t sent;              // Frames acknowledged on the bus
+    uint32_t dropped;           // Queue full, or transmit error
+    uint32_t arb_lost;          // Arbitration lost, requeued
+    uint32_t tx_errors;         // Transmit error (no ACK, bit error), dropped
+    uint32_t tx_bits;           // Bits of the frames sent, without stuffing (wraps)
+} CanTxStats_t;
+
+// Standard data frame with interframe space, without stuff bits
+#define CAN_FRAME_BITS(dlc)     (47U + 8U * (dlc))
+
+/* Function Prototypes */
+void can_tx_init(void);                                             // After HAL_CAN_Start()
+bool can_tx_send(uint32_t std_id, const uint8_t* data, uint8_t dlc); // false if the frame was dropped
+void can_tx_get_stats(CanTxStats_t* stats);
+void can_tx_flush(void);                                            // Drop every queued frame (not those in the mailboxes)
+void can_tx_irq_handler(void);                                      // Called from the CAN1 TX, RX0 and SCE vectors
+
+#endif /* INC_CAN_TX_H_ */
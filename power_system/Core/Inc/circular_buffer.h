@@ -1,35 +1,83 @@
 /*
- * circular_buffer.h
+ *  circular_buffer.h
  *
- *  Generic circular buffer for float values.
- *  Maintains a rolling average over the last CIRC_BUF_SIZE samples.
+ *  Generic circular buffer with selectable filter output. Samples are floats,
+ *  or int32 raw codes (64-bit sums, Q16 EMA) when SENSOR_FIXED_POINT is set.
+ *  Every instance keeps its own window length (up to CIRC_BUF_MAX_SIZE) and
+ *  one of the filter kinds below. Pushing a sample is O(1) for the mean and
+ *  EMA, and O(N) over a short window for the median. Min/max over the window
+ *  are tracked for every kind.
  *
  */
 
 #ifndef INC_CIRCULAR_BUFFER_H_
 #define INC_CIRCULAR_BUFFER_H_
 
+#include "main.h"
 #include <stdint.h>
 
-// Number of samples in each rolling window.
-// At a 100ms poll rate, 10 samples = latest 1s of data
-#define CIRC_BUF_SIZE   10
+// Largest window any instance can use.
+// At a 10ms poll rate, 128 samples = latest 1.28s of data
+#define CIRC_BUF_MAX_SIZE           128
+
+// Median windows are kept sorted on every push, so they are capped much lower
+#define CIRC_BUF_MEDIAN_MAX_SIZE    15
+
+// The running sum is recomputed from the stored samples every N pushes to bound float drift
+#define CIRC_BUF_RENORM_INTERVAL    1024
+
+#if SENSOR_FIXED_POINT
+typedef int32_t circ_sample_t;
+typedef int64_t circ_sum_t;			// Exact, never needs renormalising
+#else
+typedef float circ_sample_t;
+typedef float circ_sum_t;
+#endif
+
+typedef enum {
+	FILTER_MEAN,		// Rolling mean over the window (running sum)
+	FILTER_EMA,			// Exponential moving average, alpha = 2 / (window + 1)
+	FILTER_MEDIAN		// Median of the window, rejects single-sample spikes
+} FilterKind_t;
 
 typedef struct {
-	float buf[CIRC_BUF_SIZE];	// Array for storing samples
-	uint8_t index;				// Next write position (wraps around)
-	uint8_t count;				// Number of samples in circular buffer
-	float average; 				// Most recently computed rolling average
+	circ_sample_t buf[CIRC_BUF_MAX_SIZE];	// Array for storing samples
+	uint16_t size;						// Window length of this instance
+	uint16_t index;						// Next write position (wraps around)
+	uint16_t count;						// Number of samples in circular buffer
+	FilterKind_t kind;					// Filter applied to produce average
+
+	circ_sum_t sum;						// Running sum of the samples in the window (FILTER_MEAN)
+	uint16_t pushes_since_renorm;		// Pushes since sum was last recomputed
+#if SENSOR_FIXED_POINT
+	int32_t alpha;						// Smoothing factor, Q16 (FILTER_EMA)
+	int64_t ema;						// Filter state, Q16, so small steps are not rounded away
+#else
+	float alpha;						// Smoothing factor (FILTER_EMA)
+#endif
+	circ_sample_t sorted[CIRC_BUF_MEDIAN_MAX_SIZE];	// Window kept in ascending order (FILTER_MEDIAN)
+
+	// Monotonic deques of buffer slots for O(1) amortised min/max
+	uint8_t min_dq[CIRC_BUF_MAX_SIZE];
+	uint8_t max_dq[CIRC_BUF_MAX_SIZE];
+	uint16_t min_head, min_len;
+	uint16_t max_head, max_len;
+
+	circ_sample_t average; 				// Most recently computed filter output
 } CircularBuffer_t;
 
 
-/* Clear all samples and reset state */
-void circ_buf_init(CircularBuffer_t *cb);
+/* Clear all samples and select the filter kind and window length (clamped to the kind's maximum) */
+void circ_buf_init(CircularBuffer_t *cb, FilterKind_t kind, uint16_t size);
+
+/* Push a new sample in and update the filter output */
+void circ_buf_push(CircularBuffer_t *cb, circ_sample_t value);
 
-/* Push a new sample in and recompute the average */
-void circ_buf_push(CircularBuffer_t *cb, float value);
+/* Return the current filter output (0 if no samples yet) */
+circ_sample_t circ_buf_average(const CircularBuffer_t *cb);
 
-/* Return the current rolling average (0.0f if no samples yet) */
-float circ_buf_average(const CircularBuffer_t *cb);
+/* Return the smallest / largest sample in the window (0 if no samples yet) */
+circ_sample_t circ_buf_min(const CircularBuffer_t *cb);
+circ_sample_t circ_buf_max(const CircularBuffer_t *cb);
 
 #endif /* INC_CIRCULAR_BUFFER_H_ */
@@ -0,0 +1,47 @@
+/*
+ * energy.h
+ *
+ * Public interface for the energy and charge (coulomb counting) module.
+ *
+ * Every INA228 integrates power and current at the ADC rate into its 40-bit
+ * ENERGY and CHARGE registers. Once per ENERGY_INTERVAL_MS the acquisition
+ * engine reads them in the next sweep; this module turns the change since
+ * the previous read into running totals, so register wrap-around (ENERGYOF /
+ * CHARGEOF) and a sensor that was reset in between do not corrupt them, and
+ * broadcasts the totals per sensor over CAN.
+ */
+
+#ifndef INC_ENERGY_H_
+#define INC_ENERGY_H_
+
+#include "main.h"
+#include "ina228_driver.h"
+#include <stdint.h>
+
+// CAN IDs, one frame per sensor (order of INA228_Location_t)
+#define CAN_ID_ENERGY_BUS       0x110
+#define CAN_ID_ENERGY_MOTOR1    0x111
+#define CAN_ID_ENERGY_MOTOR2    0x112
+#define CAN_ID_ENERGY_MOTOR3    0x113
+#define CAN_ID_ENERGY_MOTOR4    0x114
+
+#define ENERGY_INTERVAL_MS      1000    // Accumulator read and CAN frame period
+
+/* Running totals for one sensor, in INA228 register codes */
+typedef struct {
+    int64_t  energy;        // ENERGY codes since energy_reset() (J = code x 16 x POWER LSB)
+    int64_t  charge;        // CHARGE codes since energy_reset() (C = code x CURRENT LSB)
+    uint64_t last_energy;   // Register values at the previous read
+    int64_t  last_charge;
+    uint8_t  valid;         // 1 = last accumulator read succeeded
+} EnergyTotals_t;
+
+// Public API Functions
+void energy_init(void);     // Clears the sensor accumulators (RSTACC), bus must be idle
+void energy_tick(void);
+void energy_reset(void);    // Zero the running totals, the sensors keep integrating
+void energy_get_totals(uint8_t sensor, EnergyTotals_t* totals);
+uint32_t energy_milli_wh(uint8_t sensor);    // Saturated
+int32_t energy_milli_ah(uint8_t sensor);     // Saturated, negative when charge flowed back
+
+#endif /* INC_ENERGY_H_ */
@@ -0,0 +1,46 @@
+/*
+ * fmpi2c.h
+ *
+ * Master driver for FMPI2C1, the F446's Fast-mode Plus I2C peripheral
+ * (PC6 = SCL, PC7 = SDA, AF4). The HAL FMPI2C driver is not part of this
+ * project, so the peripheral is programmed at register level, like TIM2 in
+ * sampler.c.
+ *
+ * Only what the INA228 driver needs is covered: a blocking write, a
+ * blocking register read and an interrupt-driven register read (register
+ * pointer write, repeated START, read, automatic STOP). The peripheral is
+ * clocked from SYSCLK and SCL timing is computed from it for the requested
+ * speed, up to 1 MHz with the Fm+ pad drive enabled above 400 kHz. When the
+ * spec minimums for SCL low/high do not fit in the requested period the bus
+ * runs slower; fmpi2c_speed() returns the rate actually programmed.
+ *
+ * Use it through i2c_bus.h, which also handles I2C1.
+ */
+
+#ifndef INC_FMPI2C_H_
+#define INC_FMPI2C_H_
+
+#include "main.h"
+#include <stdint.h>
+
+// Board dependent bus edges, used for the SCL timing (measure with a scope after a pull-up change)
+#define FMPI2C_RISE_TIME_NS     50
+#define FMPI2C_FALL_TIME_NS     10
+
+/* Function Prototypes */
+HAL_StatusTypeDef fmpi2c_init(uint32_t speed_hz);          // Pins, clock, timing and interrupts; also reprograms a running bus
+void fmpi2c_deinit(void);                                   // Cancels a transfer in flight without a callback
+uint32_t fmpi2c_speed(void);                                // Programmed SCL rate in Hz
+uint8_t fmpi2c_busy(void);
+
+HAL_StatusTypeDef fmpi2c_transmit(uint8_t dev_addr, const uint8_t* data, uint16_t len, uint32_t timeout_ms);
+HAL_StatusTypeDef fmpi2c_mem_read(uint8_t dev_addr, uint8_t reg, uint8_t* data, uint16_t len, uint32_t timeout_ms);
+HAL_StatusTypeDef fmpi2c_mem_read_it(uint8_t dev_addr, uint8_t reg, uint8_t* data, uint16_t len);
+
+void fmpi2c_ev_irq_handler(void);
+void fmpi2c_er_irq_handler(void);
+
+void fmpi2c_mem_read_cplt_callback(void);                   // Weak, from the EV interrupt
+void fmpi2c_error_callback(void);                           // Weak, NACK, bus error or arbitration loss
+
+#endif /* INC_FMPI2C_H_ */
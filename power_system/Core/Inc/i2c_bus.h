@@ -0,0 +1,40 @@
+/*
+ * i2c_bus.h
+ *
+ * I2C transport under the INA228 driver. The sensor bus runs on either
+ * I2C1 (HAL driver, up to 400 kHz) or FMPI2C1 (fmpi2c.h, up to 1 MHz),
+ * chosen with i2c_bus_init(); callers only see 8-bit device addresses and
+ * register reads/writes. The speed can be changed at runtime while no
+ * transfer is in flight.
+ *
+ * Interrupt-driven reads on either port finish in i2c_bus_read_callback(),
+ * called from the port's I2C interrupt.
+ */
+
+#ifndef INC_I2C_BUS_H_
+#define INC_I2C_BUS_H_
+
+#include "main.h"
+#include "i2c.h"
+#include <stdint.h>
+
+#define I2C_BUS_I2C1_MAX_HZ     400000U
+#define I2C_BUS_FMPI2C1_MAX_HZ  1000000U
+
+/* Function Prototypes */
+HAL_StatusTypeDef i2c_bus_init(uint8_t port, uint32_t speed_hz);       // port = I2C_BUS_I2C1 or I2C_BUS_FMPI2C1 (main.h)
+HAL_StatusTypeDef i2c_bus_set_speed(uint32_t speed_hz);                // HAL_BUSY while a transfer is in flight
+uint32_t i2c_bus_speed(void);                                           // SCL rate in Hz as programmed
+uint8_t i2c_bus_port(void);
+uint8_t i2c_bus_busy(void);
+
+HAL_StatusTypeDef i2c_bus_write(uint8_t dev_addr, const uint8_t* data, uint16_t len, uint32_t timeout_ms);
+HAL_StatusTypeDef i2c_bus_mem_read(uint8_t dev_addr, uint8_t reg, uint8_t* data, uint16_t len, uint32_t timeout_ms);
+HAL_StatusTypeDef i2c_bus_mem_read_it(uint8_t dev_addr, uint8_t reg, uint8_t* data, uint16_t len);
+
+void i2c_bus_suspend(void);     // Stop the port and its interrupts, a transfer in flight is dropped without callback
+void i2c_bus_resume(void);      // Bring the port back at the current speed
+
+void i2c_bus_read_callback(HAL_StatusTypeDef status);                  // Weak, HAL_OK or HAL_ERROR
+
+#endif /* INC_I2C_BUS_H_ */
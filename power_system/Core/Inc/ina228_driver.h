@@ -5,14 +5,15 @@
  * Defines I2C device addresses, register map, configuration bit masks,
  * calibration constants for the bus and motor sensor locations, and LSB
  * scaling values used for voltage, current, power, and alert registers.
- * Declares all driver API functions (init, read, health check, alerts).
+ * Declares all driver API functions (init, read, health check, alerts) and the
+ * raw register decoders shared with the non-blocking acquisition engine.
  */
 
 #ifndef INC_INA228_DRIVER_H_
 #define INC_INA228_DRIVER_H_
 
 #include "main.h"
-#include "i2c.h"
+#include "i2c_bus.h"
 
 /* INA228 I2C Addresses */
 // NOTE: must shift device address left 1 bit because STM32 HAL expects 8-bit address format (7-bit address frame + 1 R/W bit)
@@ -46,14 +47,40 @@
 
 /* Configuration Bits */
 #define INA228_CONFIG_RST       (1 << 15) 	// software reset bit
+#define INA228_CONFIG_RSTACC    (1 << 14) 	// reset the ENERGY and CHARGE accumulators (self-clearing)
 #define INA228_CONFIG_CONVDLY_0 (0 << 6)  	// conversion delay time = 0ms
 #define INA228_CONFIG_ADCRANGE  (0 << 4)  	// ±163.84 mV shunt measurement range
 
+/* Diagnostic Flags and Alert Bits (DIAG_ALRT) */
+#define INA228_DIAG_ALATCH      (1 << 15)   // ALERT pin stays asserted until DIAG_ALRT is read
+#define INA228_DIAG_CNVR        (1 << 14)   // assert ALERT pin on conversion ready
+#define INA228_DIAG_SLOWALERT   (1 << 13)   // compare limits on averaged value instead of every conversion
+#define INA228_DIAG_APOL        (1 << 12)   // ALERT pin active high (default active low)
+#define INA228_DIAG_ENERGYOF    (1 << 11)   // ENERGY wrapped past 2^40 (cleared by reading ENERGY)
+#define INA228_DIAG_CHARGEOF    (1 << 10)   // CHARGE wrapped past +/-2^39 (cleared by reading CHARGE)
+#define INA228_DIAG_TMPOL       (1 << 7)    // temperature over limit
+#define INA228_DIAG_SHNTOL      (1 << 6)    // shunt voltage over limit (overcurrent)
+#define INA228_DIAG_SHNTUL      (1 << 5)    // shunt voltage under limit
+#define INA228_DIAG_BUSOL       (1 << 4)    // bus voltage over limit
+#define INA228_DIAG_BUSUL       (1 << 3)    // bus voltage under limit
+#define INA228_DIAG_POL         (1 << 2)    // power over limit
+#define INA228_DIAG_CNVRF       (1 << 1)    // conversion complete
+#define INA228_DIAG_MEMSTAT     (1 << 0)    // checksum of trim memory OK (always 1 in normal operation)
+#define INA228_DIAG_LIMIT_FLAGS (INA228_DIAG_TMPOL | INA228_DIAG_SHNTOL | INA228_DIAG_SHNTUL | INA228_DIAG_BUSOL | INA228_DIAG_BUSUL | INA228_DIAG_POL)
+
 /* ADC Configuration */
 #define INA228_ADC_MODE_CONT_ALL 	(0x0F << 12) 	// mode = continuous for all measurements
+#define INA228_ADC_VBUSCT_150us		(0x02 << 9) 	// bus voltage conversion time = 150us
+#define INA228_ADC_VBUSCT_540us		(0x04 << 9) 	// bus voltage conversion time = 540us
 #define INA228_ADC_VBUSCT_1052us	(0x05 << 9) 	// bus voltage conversion time = 1.052ms
+#define INA228_ADC_VSHCT_150us 		(0x02 << 6)		// shunt voltage conversion time = 150us
+#define INA228_ADC_VSHCT_540us 		(0x04 << 6)		// shunt voltage conversion time = 540us
 #define INA228_ADC_VSHCT_1052us 	(0x05 << 6)		// shunt voltage conversion time = 1.052ms
+#define INA228_ADC_VTCT_50us 		(0x00 << 3)		// temperature conversion time = 50us
+#define INA228_ADC_VTCT_150us 		(0x02 << 3)		// temperature conversion time = 150us
 #define INA228_ADC_VTCT_1052us 		(0x05 << 3)		// temperature conversion time = 1.052ms
+#define INA228_ADC_AVG_4   			(0x01 << 0)		// average = 4 individual measurements
+#define INA228_ADC_AVG_16   		(0x02 << 0)		// average = 16 individual measurements
 #define INA228_ADC_AVG_64   		(0x03 << 0)		// average = 64 individual measurements
 
 /* Bus Calibration Constants */
@@ -73,6 +100,46 @@
 #define INA228_BOVL_LSB			0.003125f 		// 3.125 mV per LSB (datasheet Section 7.6.1.15)
 #define INA228_BUVL_LSB			0.003125f 		// 3.125 mV per LSB (datasheet Section 7.6.1.16)
 #define INA228_SOVL_LSB			0.000005f	    // 5uV per LSB when ADCRANGE = 0 (datasheet Section 7.6.1.13)
+#define INA228_VSHUNT_LSB		0.0000003125f	// 312.5 nV per LSB when ADCRANGE = 0 (datasheet Table 8-1)
+#define INA228_DIETEMP_LSB		0.0078125f		// 7.8125 m°C per LSB (datasheet Table 8-1)
+#define INA228_ENERGY_LSB_FACTOR	16.0f			// J per ENERGY LSB = 16 x POWER LSB, C per CHARGE LSB = CURRENT LSB (datasheet Section 8.1.2)
+#define INA228_ACCUM_BITS		40				// ENERGY unsigned, CHARGE two's complement
+
+/* Engineering units -> nearest register code (non-negative limits), folded into integer constants at compile time */
+#define INA228_VBUS_CODE(volts)			((int32_t)((volts) / INA228_VBUS_LSB + 0.5f))
+#define INA228_CURRENT_CODE(amps, lsb)	((int32_t)((amps) / (lsb) + 0.5f))
+
+/* Measurement register block (VSHUNT..POWER), raw codes */
+typedef struct {
+    int32_t  vshunt;        // 20-bit, sign extended
+    int32_t  vbus;          // 20-bit, sign extended
+    int16_t  dietemp;       // 16-bit two's complement
+    int32_t  current;       // 20-bit, sign extended
+    uint32_t power;         // 24-bit unsigned
+} INA228_RawMeasurement_t;
+
+/* ADC conversion time / averaging profiles (ADC_CONFIG CT and AVG fields) */
+typedef enum {
+    INA228_PROFILE_FAST,        // 150/150/50us x4:    a result every 1.4ms, for fast transients
+    INA228_PROFILE_BALANCED,    // 540/540/150us x16:  every 19.7ms
+    INA228_PROFILE_LOW_NOISE,   // 1052us x3 x64:      every 202ms, lowest noise
+    INA228_NUM_PROFILES
+} INA228_AdcProfile_t;
+
+/* ENERGY and CHARGE accumulators, raw codes */
+typedef struct {
+    uint64_t energy;        // 40-bit unsigned
+    int64_t  charge;        // 40-bit, sign extended
+} INA228_RawAccum_t;
+
+/* Measurement register block, scaled to engineering units */
+typedef struct {
+    float shunt_voltage;    // V
+    float voltage;          // V
+    float temperature;      // °C
+    float current;          // A
+    float power;            // W
+} INA228_Measurement_t;
 
 /* Function Prototypes */
 HAL_StatusTypeDef INA228_Init(uint8_t device_addr, float current_LSB, float shunt_resistor);
@@ -80,8 +147,27 @@ HAL_StatusTypeDef INA228_ReadManufacturerID(uint8_t device_addr, uint16_t *id);
 HAL_StatusTypeDef INA228_ReadVoltage(uint8_t device_addr, float* voltage);
 HAL_StatusTypeDef INA228_ReadCurrent(uint8_t device_addr, float* current, float current_LSB);
 HAL_StatusTypeDef INA228_ReadPower(uint8_t device_addr, float* power, float power_LSB);
+HAL_StatusTypeDef INA228_ReadAll(uint8_t device_addr, float current_LSB, float power_LSB, INA228_Measurement_t* meas);	// Whole VSHUNT..POWER block, back to back
 HAL_StatusTypeDef INA228_CheckHealth(uint8_t device_addr, uint8_t* healthy);
 HAL_StatusTypeDef INA228_ConfigureAlerts(uint8_t device_addr, float shunt_resistor, float overvoltage_limit, float undervoltage_limit, float overcurrent_limit);
+HAL_StatusTypeDef INA228_ConfigureAlertPin(uint8_t device_addr, uint16_t alert_config);	// Write ALATCH/CNVR/SLOWALERT/APOL bits of DIAG_ALRT
+HAL_StatusTypeDef INA228_ReadAccumulators(uint8_t device_addr, INA228_RawAccum_t* accum);	// ENERGY and CHARGE (reading clears ENERGYOF/CHARGEOF)
+HAL_StatusTypeDef INA228_ResetAccumulators(uint8_t device_addr);							// CONFIG RSTACC, other CONFIG bits kept
+HAL_StatusTypeDef INA228_SetAdcProfile(uint8_t device_addr, INA228_AdcProfile_t profile);	// Rewrites ADC_CONFIG, the running average restarts
+uint16_t INA228_ProfileAdcConfig(INA228_AdcProfile_t profile);							// ADC_CONFIG value, continuous mode
+uint32_t INA228_ProfileResultUs(INA228_AdcProfile_t profile);								// Time between averaged results
+const char* INA228_ProfileName(INA228_AdcProfile_t profile);
+
+/* Non-blocking access (used by the sensor_acq engine) */
+HAL_StatusTypeDef INA228_ReadRegister_IT(uint8_t device_addr, uint8_t reg, uint8_t* data, uint16_t len);
+uint16_t INA228_Decode16bit(const uint8_t* data);
+int32_t  INA228_Decode20bit(const uint8_t* data);
+uint32_t INA228_Decode24bit(const uint8_t* data);
+uint64_t INA228_Decode40bit(const uint8_t* data);
+int64_t  INA228_Decode40bitSigned(const uint8_t* data);
+uint8_t  INA228_DecodeAccumulator(uint8_t reg, const uint8_t* data, INA228_RawAccum_t* accum);
+uint8_t  INA228_DecodeMeasurement(uint8_t reg, const uint8_t* data, INA228_RawMeasurement_t* raw);
+void     INA228_ScaleMeasurement(const INA228_RawMeasurement_t* raw, float current_LSB, float power_LSB, INA228_Measurement_t* meas);
 
 #endif /* INC_INA228_DRIVER_H_ */
 
@@ -0,0 +1,67 @@
+/*
+ * log_frame.h
+ *
+ * Binary framing for the UART data link.
+ *
+ * Every frame is a little-endian payload followed by a CRC-16/CCITT-FALSE
+ * (poly 0x1021, init 0xFFFF) of the payload, COBS-encoded so it contains no
+ * zero bytes, and terminated by a single 0x00 delimiter. A receiver resyncs
+ * on the next 0x00 after any corrupted byte.
+ *
+ * Payload layouts (byte 0 is always the frame type, bytes 1-2 the frame
+ * sequence number, which increments for every frame built so the host can
+ * count lost frames):
+ *
+ *   LOG_FRAME_INFO     type, seq u16, rate_hz u32, fields u8, n u8,
+ *                      n x { sensor_id u8, current_lsb f32, power_lsb f32 }
+ *   LOG_FRAME_SAMPLES  type, seq u16, count u8,
+ *                      count x { timestamp_us u32, valid u8, n x packed raw sample }
+ *   LOG_FRAME_END      type, seq u16, dropped u32, overruns u32, max_latency_us u32
+ *
+ * INFO lists the captured sensors in ascending ID order, and every SAMPLES
+ * record holds one sweep: a single timestamp and one packed sample per
+ * listed sensor, in the same order. Bit k of valid is set if the k-th
+ * listed sensor read cleanly in that sweep; a sample whose bit is clear is
+ * all zeros.
+ *
+ * A packed raw sample holds the INA228 codes selected by the LOG_FIELD_*
+ * bits in fields, in bit order, as one little-endian bit string padded to a
+ * whole byte: VBUS (20 bits), CURRENT (20 bits, two's complement), POWER
+ * (24 bits), DIETEMP (16 bits, two's complement) and VSHUNT (20 bits, two's
+ * complement). The default V/I/P selection packs into 8 bytes. Timestamps
+ * come from the 1 MHz sampler counter and wrap every ~71.6 minutes.
+ */
+
+#ifndef INC_LOG_FRAME_H_
+#define INC_LOG_FRAME_H_
+
+#include "ina228_driver.h"
+#include <stdint.h>
+
+#define LOG_FRAME_SAMPLES       0x01
+#define LOG_FRAME_INFO          0x02
+#define LOG_FRAME_END           0x03
+
+// Raw codes a sample can carry, packed in this order
+#define LOG_FIELD_VBUS          0x01
+#define LOG_FIELD_CURRENT       0x02
+#define LOG_FIELD_POWER         0x04
+#define LOG_FIELD_DIETEMP       0x08
+#define LOG_FIELD_VSHUNT        0x10
+#define LOG_FIELDS_ALL          0x1F
+#define LOG_FIELDS_DEFAULT      (LOG_FIELD_VBUS | LOG_FIELD_CURRENT | LOG_FIELD_POWER)
+
+#define LOG_SAMPLE_MAX_SIZE     13      // Bytes per packed raw sample with every field (100 bits)
+#define LOG_RECORD_HEADER_SIZE  5       // Timestamp + valid bits
+#define LOG_FRAME_MAX_PAYLOAD   212     // Largest payload the logger builds (16 single-sensor V/I/P records)
+
+// Payload + CRC, plus one COBS code byte per 254 bytes and the delimiter
+#define LOG_FRAME_MAX_ENCODED   (LOG_FRAME_MAX_PAYLOAD + 2 + (LOG_FRAME_MAX_PAYLOAD + 2) / 254 + 2)
+
+/* Function Prototypes */
+uint16_t log_crc16(const uint8_t* data, uint16_t len);
+uint16_t log_frame_encode(const uint8_t* payload, uint16_t len, uint8_t* out);  // Returns encoded length including the 0x00 delimiter
+uint8_t log_sample_size(uint8_t fields);                                         // Bytes per packed sample
+uint8_t log_pack_sample(const INA228_RawMeasurement_t* raw, uint8_t fields, uint8_t* out);   // Returns log_sample_size(fields)
+
+#endif /* INC_LOG_FRAME_H_ */
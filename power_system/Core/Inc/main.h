@@ -41,6 +41,53 @@ extern "C" {
 
 /* Exported constants --------------------------------------------------------*/
 /* USER CODE BEGIN EC */
+// Measurement pipeline: 1 keeps INA228 readings as raw integer codes through filtering and CAN
+// packing and converts to engineering units only on request; 0 scales every sample to float.
+#ifndef SENSOR_FIXED_POINT
+#define SENSOR_FIXED_POINT  0
+#endif
+
+// Cycle-count profiling probes (profile.h): on in Debug builds, compiled out of Release builds.
+#ifndef PROFILE_ENABLE
+#ifdef DEBUG
+#define PROFILE_ENABLE      1
+#else
+#define PROFILE_ENABLE      0
+#endif
+#endif
+
+// System clock profile applied by SystemClock_Config(). I2C, UART, CAN and TIM2 timings are
+// derived from the resulting bus clocks at init, so any profile keeps the same bus speeds.
+#define CLOCK_PROFILE_FULL      0   // 180 MHz, scale 1 + over-drive, APB1 45 MHz, APB2 90 MHz
+#define CLOCK_PROFILE_BALANCED  1   // 84 MHz, scale 3, APB1 42 MHz, APB2 84 MHz (original CubeMX setup)
+#define CLOCK_PROFILE_LOW_POWER 2   // 16 MHz straight from the oscillator, PLL off, scale 3
+#ifndef CLOCK_PROFILE
+#define CLOCK_PROFILE       CLOCK_PROFILE_FULL
+#endif
+
+// 1 runs the profiles from the HSE_VALUE crystal on PH0/PH1 instead of the 16 MHz HSI
+// (better frequency accuracy for CAN; the low power profile then runs at HSE_VALUE).
+#ifndef CLOCK_USE_HSE
+#define CLOCK_USE_HSE       0
+#endif
+
+// Sensor bus (i2c_bus.h). FMPI2C1 on PC6/PC7 reaches 1 MHz, I2C1 on PB6/PB7 tops out at 400 kHz.
+// The speed can also be changed at runtime with the "I2C,<hz>" command.
+#define I2C_BUS_I2C1        0
+#define I2C_BUS_FMPI2C1     1
+#ifndef I2C_BUS_PORT
+#define I2C_BUS_PORT        I2C_BUS_I2C1
+#endif
+#ifndef I2C_BUS_SPEED_HZ
+#define I2C_BUS_SPEED_HZ    400000U
+#endif
+
+// Sampling trigger: 1 sets CNVR on every INA228, so its ALERT EXTI line reports each new averaged
+// result and only that sensor is read (limit trips then open the outputs from the DIAG_ALRT read);
+// 0 polls all sensors every SENSOR_POLL_INTERVAL_MS and ALERT is a pure hardware trip.
+#ifndef SENSOR_CNVR_SAMPLING
+#define SENSOR_CNVR_SAMPLING 0
+#endif
 
 /* USER CODE END EC */
 
@@ -69,18 +116,33 @@ void Error_Handler(void);
 #define MOTOR4_GPIO_Port GPIOC
 #define CONTACTOR_Pin GPIO_PIN_0
 #define CONTACTOR_GPIO_Port GPIOA
+#define ALERT_M1_Pin GPIO_PIN_1
+#define ALERT_M1_GPIO_Port GPIOA
+#define ALERT_M1_EXTI_IRQn EXTI1_IRQn
 #define USART_TX_Pin GPIO_PIN_2
 #define USART_TX_GPIO_Port GPIOA
 #define USART_RX_Pin GPIO_PIN_3
 #define USART_RX_GPIO_Port GPIOA
 #define LD2_Pin GPIO_PIN_5
 #define LD2_GPIO_Port GPIOA
+#define ALERT_M3_Pin GPIO_PIN_4
+#define ALERT_M3_GPIO_Port GPIOC
+#define ALERT_M3_EXTI_IRQn EXTI4_IRQn
+#define ALERT_M4_Pin GPIO_PIN_5
+#define ALERT_M4_GPIO_Port GPIOC
+#define ALERT_M4_EXTI_IRQn EXTI9_5_IRQn
+#define ALERT_BUS_Pin GPIO_PIN_0
+#define ALERT_BUS_GPIO_Port GPIOB
+#define ALERT_BUS_EXTI_IRQn EXTI0_IRQn
 #define TMS_Pin GPIO_PIN_13
 #define TMS_GPIO_Port GPIOA
 #define TCK_Pin GPIO_PIN_14
 #define TCK_GPIO_Port GPIOA
 #define SWO_Pin GPIO_PIN_3
 #define SWO_GPIO_Port GPIOB
+#define ALERT_M2_Pin GPIO_PIN_2
+#define ALERT_M2_GPIO_Port GPIOD
+#define ALERT_M2_EXTI_IRQn EXTI2_IRQn
 
 /* USER CODE BEGIN Private defines */
 
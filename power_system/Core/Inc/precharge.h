@@ -3,9 +3,14 @@
  *
  * Public interface for the precharge FSM and system status module.
  * Defines FSM state and fault codes, the INA228 sensor location enum,
- * per-sensor and system-wide status structures, threshold constants for
+ * the per-sensor descriptor table (address, calibration, limits,
+ * ALERT pin), per-sensor and system-wide status structures, threshold constants for
  * voltage and current protection, and the public API functions used by
  * main.c and telemetry.c to query system state and sensor readings.
+ * Also exposes the ALERT pin trip path used by the EXTI interrupts, and
+ * the per-sensor INA228 ADC profile selection: the bus sensor runs
+ * ADC_PRECHARGE_PROFILE while the bus ramps, every sensor runs its selected
+ * run profile otherwise.
  */
 
 #ifndef INC_PRECHARGE_H_
@@ -30,7 +35,8 @@ typedef enum {
     FAULT_BUS_OVERCURRENT,
     FAULT_BUS_OVERVOLTAGE,
     FAULT_BUS_UNDERVOLTAGE,
-	FAULT_MOTOR_OVERCURRENT
+	FAULT_MOTOR_OVERCURRENT,
+	FAULT_SENSOR_ALERT          // ALERT pin tripped, cause not read back from DIAG_ALRT yet
 } FaultType_t;
 
 /* INA228 Measurement Locations */
@@ -39,14 +45,19 @@ typedef enum {
     INA228_MOTOR1,
 	INA228_MOTOR2,
 	INA228_MOTOR3,
-	INA228_MOTOR4
+	INA228_MOTOR4,
+	INA228_NUM_SENSORS
 } INA228_Location_t;
 
-/* Sensor Data Structure */
+/* Sensor Data Structure. With SENSOR_FIXED_POINT only raw is kept up to date; get_sensor_data() fills in the floats */
 typedef struct {
+    INA228_RawMeasurement_t raw;    // Register codes of the last good sweep
     float voltage;           // Voltage in V
     float current;           // Current in A
     float power;             // Power in W
+    float shunt_voltage;     // Shunt voltage in V
+    float temperature;       // Die temperature in °C
+    uint16_t diag_alrt;      // DIAG_ALRT of the last good sweep
     uint8_t healthy;         // Sensor health flag (1 = healthy, 0 = fault/comm error)
 } SensorData_t;
 
@@ -54,19 +65,32 @@ typedef struct {
 typedef struct {
     PrechargeState_t state;
     FaultType_t fault;
-    SensorData_t bus_sensor;
-    SensorData_t motor1_sensor;
-    SensorData_t motor2_sensor;
-    SensorData_t motor3_sensor;
-    SensorData_t motor4_sensor;
+    SensorData_t sensor[INA228_NUM_SENSORS];    // Indexed by INA228_Location_t
 } SystemStatus_t;
 
+// Per-sensor hardware and protection settings, indexed by INA228_Location_t
+typedef struct {
+    uint8_t       address;              // 8-bit I2C address (INA228_ADDRx)
+    float         shunt_resistor;       // Ohms
+    float         current_lsb;          // A per CURRENT LSB, programmed through SHUNT_CAL
+    float         power_lsb;            // W per POWER LSB
+    float         overcurrent_limit;    // A, SOVL (ALERT) and software check
+    int32_t       overcurrent_code;     // overcurrent_limit in CURRENT codes, for the software check
+    float         overvoltage_limit;    // V, BOVL (ALERT only; the bus is also checked in software)
+    FaultType_t   overcurrent_fault;    // Fault latched when overcurrent_limit is exceeded
+    GPIO_TypeDef* alert_port;           // ALERT line (EXTI, active low)
+    uint16_t      alert_pin;
+} SensorDesc_t;
+
+extern const SensorDesc_t g_sensor_table[INA228_NUM_SENSORS];
+
 /* Expose global system status so main.c can read sensor data directly */
 extern SystemStatus_t g_system_status;
 
 /* Configuration Parameters */
 #define PRECHARGE_THRESHOLD_PERCENT 90      // Bus voltage must reach (Threshold)% of battery nominal
 #define SENSOR_POLL_INTERVAL_MS     50      // Poll sensors every 50ms
+#define SENSOR_CNVR_FALLBACK_MS     500     // SENSOR_CNVR_SAMPLING: poll all sensors if none were read together this long (ALERT line unwired)
 
 #define BUS_OVERVOLTAGE_THRESHOLD   48.0f   // Overvoltage threshold for bus
 #define BUS_UNDERVOLTAGE_THRESHOLD  30.0f    // Undervoltage threshold for bus
@@ -75,11 +99,30 @@ extern SystemStatus_t g_system_status;
 #define BUS_OVERCURRENT_THRESHOLD	50.0f   // Overcurrent threshold for bus
 #define MOTOR_OVERCURRENT_THRESHOLD	25.0f   // Overcurrent threshold for motors
 
+#define ADC_PRECHARGE_PROFILE       INA228_PROFILE_FAST         // Bus sensor while in STATE_PRECHARGE
+#define ADC_RUN_PROFILE             INA228_PROFILE_LOW_NOISE    // Every sensor otherwise, until changed at runtime
+
+// Limits in register codes, so the software checks are integer compares on the raw readings
+#define BUS_OVERCURRENT_CODE        INA228_CURRENT_CODE(BUS_OVERCURRENT_THRESHOLD, BUS_CURRENT_LSB)
+#define MOTOR_OVERCURRENT_CODE      INA228_CURRENT_CODE(MOTOR_OVERCURRENT_THRESHOLD, MOTOR_CURRENT_LSB)
+#define BUS_OVERVOLTAGE_CODE        INA228_VBUS_CODE(BUS_OVERVOLTAGE_THRESHOLD)
+#define BUS_UNDERVOLTAGE_CODE       INA228_VBUS_CODE(BUS_UNDERVOLTAGE_THRESHOLD)
+#define PRECHARGE_COMPLETE_CODE     INA228_VBUS_CODE(BATTERY_NOMINAL * PRECHARGE_THRESHOLD_PERCENT / 100.0f)
+
 /* Function Prototypes */
 void precharge_control_init(void);
 void precharge_fsm_tick(void);
 PrechargeState_t get_current_state(void);
 FaultType_t get_current_fault(void);
+uint8_t get_fault_sensors(void);        // Bit n = sensor n tripped a limit, latched with the fault
+uint8_t get_relay_status(void);         // Bit 0 = contactor closed, bit n = motor n relay closed
 void get_sensor_data(INA228_Location_t location, SensorData_t* data);
+HAL_StatusTypeDef precharge_reset_fault(void);     // Leave FAULT for PRECHARGE; HAL_BUSY while a limit is still exceeded
+HAL_StatusTypeDef precharge_set_adc_profile(uint8_t sensor_mask, INA228_AdcProfile_t profile);    // Run profile, applied on the next FSM tick
+INA228_AdcProfile_t precharge_get_adc_profile(INA228_Location_t location);                        // Profile the sensor is running now
+
+/* ALERT pin fast path (called from HAL_GPIO_EXTI_Callback) */
+void precharge_alert_trip(INA228_Location_t location);
+uint32_t precharge_alert_latency_cycles(void);     // Worst case trip path -> contactor/relays open, in CPU cycles
 
 #endif /* INC_PRECHARGE_H_ */
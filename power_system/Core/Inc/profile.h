@@ -0,0 +1,66 @@
+/*
+ * profile.h
+ *
+ * Cycle-count profiling probes on the DWT cycle counter.
+ *
+ * A probe brackets a block of code with PROFILE_BEGIN(probe) and
+ * PROFILE_END(probe) in the same scope. Every pass through the block adds
+ * its CYCCNT delta to the probe's count, min, max, total and a log2
+ * histogram: bin 0 holds runs under 32 cycles, bin k runs of 16 * 2^k up to
+ * 32 * 2^k - 1 cycles, and the last bin everything longer. Recording masks
+ * interrupts for a few cycles, so a probe may sit in code that runs in both
+ * the main context and an ISR. The probes' own overhead (a few tens of
+ * cycles) is included in what they measure.
+ *
+ * profile_report() prints one CSV line per probe, in cycles at
+ * SystemCoreClock (see the STATS command in main.c).
+ *
+ * With PROFILE_ENABLE = 0 (main.h, release builds) the macros expand to
+ * nothing and profile.c compiles to an empty unit.
+ */
+
+#ifndef INC_PROFILE_H_
+#define INC_PROFILE_H_
+
+#include "main.h"
+#include <stdint.h>
+
+#define PROFILE_HIST_BINS       16
+
+typedef enum {
+    PROF_UPDATE_SENSORS = 0,    // precharge.c UpdateSensorReadings(), when a new snapshot is applied
+    PROF_TELEMETRY_TICK,        // telemetry_tick(), all five frames filtered and queued
+    PROF_CIRC_BUF_PUSH,         // circ_buf_push(), one sample into one filter
+    PROF_CAN_TX_SEND,           // can_tx_send(), queue insert and mailbox refill
+    PROF_NUM_PROBES
+} ProfileProbe_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t min_cycles;
+    uint32_t max_cycles;
+    uint64_t total_cycles;
+    uint32_t hist[PROFILE_HIST_BINS];
+} ProfileStats_t;
+
+#if PROFILE_ENABLE
+
+#define PROFILE_BEGIN(probe)    uint32_t prof_start_##probe = DWT->CYCCNT
+#define PROFILE_END(probe)      profile_record((probe), DWT->CYCCNT - prof_start_##probe)
+
+/* Function Prototypes */
+void profile_init(void);                                    // Enable the cycle counter, clear all probes
+void profile_reset(void);
+void profile_record(ProfileProbe_t probe, uint32_t cycles);
+void profile_get_stats(ProfileProbe_t probe, ProfileStats_t* stats);
+const char* profile_name(ProfileProbe_t probe);
+void profile_report(void (*send)(const char* line));        // Header line, then one line per probe
+
+#else
+
+#define PROFILE_BEGIN(probe)
+#define PROFILE_END(probe)
+
+#endif /* PROFILE_ENABLE */
+
+#endif /* INC_PROFILE_H_ */
@@ -0,0 +1,43 @@
+/*
+ * sampler.h
+ *
+ * Timer-triggered sampling and the microsecond timebase.
+ *
+ * TIM2 (32-bit) free-runs at 1 MHz and is the microsecond counter used to
+ * stamp every acquisition sweep. While sampling is enabled, capture/compare
+ * channel 1 fires at exact periods and each interrupt starts a sensor_acq
+ * sweep. The compare value is advanced from the previous scheduled time, not
+ * from the time the interrupt ran, so ISR latency never accumulates into the
+ * rate. A tick that finds the previous sweep still running is counted as an
+ * overrun.
+ *
+ * The HAL TIM driver is not part of this project, so TIM2 is programmed at
+ * register level.
+ */
+
+#ifndef INC_SAMPLER_H_
+#define INC_SAMPLER_H_
+
+#include "main.h"
+#include <stdint.h>
+
+#define SAMPLER_TIMER_HZ        1000000U    // TIM2 counts microseconds
+#define SAMPLER_MAX_RATE_HZ     5000        // A full five-sensor sweep takes ~4ms, so high rates are overrun-bound
+
+/* Measured behaviour of the running (or last) sampling session */
+typedef struct {
+    uint32_t ticks;             // Compare interrupts serviced
+    uint32_t overruns;          // Ticks whose sweep could not start (previous still running, or slot missed)
+    uint32_t max_latency_us;    // Worst scheduled-compare -> ISR delay
+} SamplerStats_t;
+
+/* Function Prototypes */
+void sampler_init(void);                                    // Start the microsecond counter
+uint32_t sampler_micros(void);
+uint8_t sampler_start(uint32_t rate_hz, uint32_t count);    // count = 0 samples until sampler_stop()
+void sampler_stop(void);
+uint8_t sampler_running(void);
+void sampler_get_stats(SamplerStats_t* stats);
+void sampler_irq_handler(void);                             // Called from TIM2_IRQHandler
+
+#endif /* INC_SAMPLER_H_ */
@@ -0,0 +1,66 @@
+/*
+ * scheduler.h
+ *
+ * Run-to-completion cooperative scheduler for the main context.
+ *
+ * Tasks are given as a table, in priority order (first = highest). A task
+ * becomes ready when its period elapses, when one of its event flags is
+ * signalled (usually from an ISR with sched_signal()), or both. Each pass
+ * of the dispatcher runs the highest priority ready task to completion;
+ * when nothing is ready the core sleeps in WFI until the next interrupt
+ * (SysTick wakes it at least every millisecond).
+ *
+ * Periodic releases are kept on a fixed grid (release += period), so the
+ * period does not drift with the time a task takes. A task that finishes
+ * after its next release is late; a release that could not even start
+ * before the one after it is skipped. Both count as deadline misses.
+ *
+ * Execution times are measured with the TIM2 microsecond counter, so
+ * sampler_init() must run first. Time spent in WFI is accounted as idle,
+ * which gives the CPU headroom.
+ */
+
+#ifndef INC_SCHEDULER_H_
+#define INC_SCHEDULER_H_
+
+#include "main.h"
+#include <stdint.h>
+
+#define SCHED_MAX_TASKS         8
+
+// Event flags, set from interrupt context
+#define SCHED_EV_SWEEP_DONE     (1U << 0)   // sensor_acq published a snapshot (I2C ISR)
+#define SCHED_EV_UART_LINE      (1U << 1)   // A full command line was received on USART2
+#define SCHED_EV_STATUS         (1U << 2)   // FSM state, fault or relays changed (precharge, also from the ALERT ISR)
+#define SCHED_EV_CAN_CMD        (1U << 3)   // A command frame was received on CAN1 (RX FIFO 0 ISR)
+
+typedef struct {
+    const char* name;
+    void (*run)(void);
+    uint32_t period_ms;         // 0 = event driven only; sched_set_period() can change it at runtime
+    uint32_t events;            // Event flags that release the task, 0 = periodic only
+} SchedTask_t;
+
+typedef struct {
+    uint32_t runs;
+    uint32_t deadline_misses;   // Periodic jobs finished after the next release, or skipped
+    uint32_t max_us;            // Longest run
+    uint64_t total_us;          // Sum of all runs
+} SchedTaskStats_t;
+
+typedef struct {
+    uint64_t elapsed_us;        // Since sched_init() or sched_reset_stats()
+    uint64_t idle_us;           // Of which asleep in WFI
+} SchedStats_t;
+
+/* Function Prototypes */
+void sched_init(const SchedTask_t* tasks, uint8_t count);     // tasks must stay valid (static const table)
+void sched_signal(uint32_t events);                             // Safe from any interrupt priority
+void sched_run(void);                                           // Dispatch forever
+void sched_run_once(void);                                      // One dispatcher pass: run one task, or sleep
+HAL_StatusTypeDef sched_set_period(void (*run)(void), uint32_t period_ms);  // Task found by its run function, periodic tasks only
+void sched_get_task_stats(uint8_t task, SchedTaskStats_t* stats);
+void sched_get_stats(SchedStats_t* stats);
+void sched_reset_stats(void);
+
+#endif /* INC_SCHEDULER_H_ */
@@ -0,0 +1,97 @@
+/*
+ * sensor_acq.h
+ *
+ * Public interface for the non-blocking INA228 acquisition engine.
+ *
+ * A sweep walks a fixed transaction list (DIAG_ALRT followed by the
+ * VSHUNT..POWER measurement block) for every registered sensor using
+ * interrupt-driven reads on the sensor bus (i2c_bus.h).
+ * Each completion callback launches the next read, so the main loop only
+ * starts a sweep and later picks up the finished snapshot. Snapshots are
+ * double buffered: the ISR fills one copy while the other stays stable for
+ * the reader, and a snapshot is only published once every sensor is done.
+ *
+ * Values are left as raw register codes; scaling to V/A/W is done by the
+ * caller, which knows the per-sensor LSBs.
+ *
+ * Sweeps are started by the precharge FSM poll or by the sampler timer
+ * (tagged in the snapshot). Every published snapshot is also passed to
+ * sensor_acq_sweep_callback(), so a consumer that needs every sweep (the UART
+ * logger) does not compete with the FSM for sensor_acq_get_snapshot().
+ *
+ * After sensor_acq_request_accum() the next sweep also reads the 40-bit
+ * ENERGY and CHARGE accumulators. They are kept aside for
+ * sensor_acq_get_accum(), so the slower energy task gets them no matter who
+ * reads the snapshot.
+ *
+ * With SENSOR_CNVR_SAMPLING every sensor's ALERT line reports conversion
+ * ready; sensor_acq_conversion_ready() (EXTI) queues that sensor and a
+ * conversion sweep reads only the queued ones. Such a sweep skips the
+ * measurement block of a sensor whose CNVRF is already clear, so every
+ * result is read exactly once, and publishes a snapshot in which the other
+ * sensors keep their previous values (read_mask tells them apart).
+ *
+ * Blocking register access from main context (e.g. an ADC_CONFIG change)
+ * goes between sweeps: sensor_acq_claim() keeps every trigger off the bus
+ * until sensor_acq_release(); a sampler tick in between counts as an overrun.
+ */
+
+#ifndef INC_SENSOR_ACQ_H_
+#define INC_SENSOR_ACQ_H_
+
+#include "main.h"
+#include "ina228_driver.h"
+#include <stdint.h>
+
+#define ACQ_MAX_SENSORS         5
+#define ACQ_SWEEP_TIMEOUT_MS    30      // Abort a sweep stuck on the bus after this long (nominal sweep ~4ms at 400kHz, ~25ms with the accumulators at 100kHz)
+
+/* What started a sweep */
+typedef enum {
+    ACQ_TRIGGER_POLL,       // Precharge FSM interval poll
+    ACQ_TRIGGER_SAMPLER,    // Sampler timer tick
+    ACQ_TRIGGER_CNVR        // Conversion ready on one or more ALERT lines (SENSOR_CNVR_SAMPLING)
+} AcqTrigger_t;
+
+/* Raw register codes for one sensor */
+typedef struct {
+    uint8_t  healthy;               // 1 = MEMSTAT set and every read completed
+    uint16_t diag_alrt;             // DIAG_ALRT register
+    INA228_RawMeasurement_t meas;   // VSHUNT..POWER block
+    INA228_RawAccum_t accum;        // ENERGY and CHARGE, only in an accumulator sweep
+} AcqSensorRaw_t;
+
+/* One complete sweep over all sensors */
+typedef struct {
+    AcqSensorRaw_t sensor[ACQ_MAX_SENSORS];
+    uint32_t timestamp_us;  // sampler_micros() when the sweep started
+    uint32_t sequence;      // Incremented for every published sweep
+    AcqTrigger_t trigger;
+    uint8_t accum;          // 1 = this sweep also read the accumulators
+    uint8_t read_mask;      // Bit n = sensor n read by this sweep, the others are carried over
+} AcqSnapshot_t;
+
+/* Accumulators from the latest accumulator sweep */
+typedef struct {
+    INA228_RawAccum_t sensor[ACQ_MAX_SENSORS];
+    uint16_t diag_alrt[ACQ_MAX_SENSORS];    // Read before the accumulators, so ENERGYOF/CHARGEOF are still set
+    uint8_t  valid_mask;                    // Bit n = sensor n read completely
+    uint32_t timestamp_us;
+} AcqAccum_t;
+
+/* Function Prototypes */
+void sensor_acq_init(const uint8_t* device_addrs, uint8_t num_sensors);
+HAL_StatusTypeDef sensor_acq_start_sweep(AcqTrigger_t trigger);   // Safe from main loop and ISRs
+void sensor_acq_conversion_ready(uint8_t sensor);                   // ALERT EXTI with CNVR, read as soon as the bus is free
+uint8_t sensor_acq_busy(void);
+HAL_StatusTypeDef sensor_acq_claim(void);                   // HAL_BUSY while a sweep runs
+void sensor_acq_release(void);
+void sensor_acq_poll(void);                                 // Call from the main loop, recovers a stalled bus
+void sensor_acq_wait(void);                                 // Block until the running sweep finishes (init only)
+uint8_t sensor_acq_get_snapshot(AcqSnapshot_t* snapshot);   // Returns 1 if a new snapshot was copied out
+void sensor_acq_request_accum(void);                        // Read ENERGY/CHARGE in the next sweep
+uint8_t sensor_acq_get_accum(AcqAccum_t* accum);            // Returns 1 if new accumulators were copied out
+void sensor_acq_sweep_callback(const AcqSnapshot_t* snapshot);  // Weak, called on every publish (usually from the I2C ISR)
+void sensor_acq_limit_callback(uint8_t sensor, uint16_t diag_alrt);  // Weak, SENSOR_CNVR_SAMPLING: limit flag read (I2C ISR)
+
+#endif /* INC_SENSOR_ACQ_H_ */
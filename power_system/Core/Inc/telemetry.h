@@ -3,11 +3,19 @@
  *
  * Public interface for the CAN telemetry module.
  * 
- * Reads all five INA228 sensors, applies a rolling average to voltage and
- * current via circular_buffer, then packs the results into CAN frames.
+ * Reads all five INA228 sensors, applies a rolling filter to voltage,
+ * current and power via circular_buffer, then packs the results into one
+ * status frame and one multiplexed measurement frame per sensor.
+ *
+ * In TELEMETRY_TX_PERIODIC mode every frame goes out on every tick. In
+ * TELEMETRY_TX_ON_CHANGE mode a frame is only sent when one of its values
+ * moved past its deadband since it was last sent, or when it has been
+ * silent for its heartbeat interval; a state, fault or relay change sends
+ * the status frame at once through telemetry_notify_status().
  * 
- * To disable a sensor during testing:
- * Set its entry in SENSOR_ENABLED to 0. Order: { BUS, M1, M2, M3, M4 }
+ * Which sensors are sent is a bitmask: SENSOR_ENABLED_MASK at boot, then
+ * telemetry_set_sensor_mask() (the CAN SENSOR_MASK command) at runtime.
+ * telemetry_send_snapshot() sends every frame at once on request.
  */
 
 #ifndef INC_TELEMETRY_H_
@@ -21,19 +29,55 @@
 #include <stdbool.h>
 
 // CAN IDs
-#define CAN_ID_BUS      0x100
-#define CAN_ID_MOTOR1   0x101
-#define CAN_ID_MOTOR2   0x102
-#define CAN_ID_MOTOR3   0x103
-#define CAN_ID_MOTOR4   0x104
+#define CAN_ID_STATUS   0x100   // State, fault, health and relay bitmaps (DLC 6)
+#define CAN_ID_MEAS     0x101   // Measurement frames, byte 0 selects sensor and page (DLC 8)
+
+// Measurement frame multiplexer: byte 0 = (page << 4) | sensor
+#define MEAS_PAGE_ELECTRICAL    0   // V, I, P, every tick
+#define MEAS_PAGE_DIAG          1   // Die temperature, shunt voltage, DIAG_ALRT
+#define MEAS_MUX(page, sensor)  ((uint8_t)(((page) << 4) | (sensor)))
+
+// One sensor's diagnostic page per tick, in the first NUM_SENSORS of every TELEMETRY_DIAG_DIVIDER ticks
+#define TELEMETRY_DIAG_DIVIDER  10      // 100ms tick -> diagnostic page of each sensor at 1 Hz
+
+// Transmission policy
+#define TELEMETRY_TX_PERIODIC   0       // Every frame on every tick
+#define TELEMETRY_TX_ON_CHANGE  1       // Deadbands, heartbeat and immediate status on transitions
+#define TELEMETRY_TX_MODE       TELEMETRY_TX_ON_CHANGE     // Mode at boot, telemetry_set_tx_mode() changes it
+
+// On-change deadbands in frame units, compared with the value last sent (0 = any change)
+#define VOLTAGE_DEADBAND_MV     100     // 0.1 V
+#define CURRENT_DEADBAND_MA     50      // 0.05 A
+#define POWER_DEADBAND_DW       10      // 1 W
+#define TEMP_DEADBAND_CENTI     50      // 0.5 °C, diagnostic page also sent when a DIAG_ALRT limit or overflow flag changes
+
+// On-change heartbeats: longest silence before a frame is sent unchanged
+#define TELEMETRY_HEARTBEAT_MS       1000   // Status frame and each sensor's electrical page
+#define TELEMETRY_DIAG_HEARTBEAT_MS  5000   // Each sensor's diagnostic page
+
+// Sensors sent on CAN, bit n = INA228_Location_t n (bit 0 = BUS, bits 1-4 = M1-M4)
+#define NUM_SENSORS         INA228_NUM_SENSORS
+#define SENSOR_ENABLED_MASK 0x1F            // Mask at boot, telemetry_set_sensor_mask() changes it
 
-// Sensors for testing
-#define NUM_SENSORS     5
-#define SENSOR_ENABLED  { 1, 1, 1, 1, 1 }   // Order: BUS, M1, M2, M3, M4
+// Filters applied to each sensor before CAN transmission (see circular_buffer.h)
+// At a 100ms tick, a window of 10 samples = latest 1s of data
+#define VOLTAGE_FILTER_KIND     FILTER_MEAN
+#define VOLTAGE_FILTER_WINDOW   10
+#define CURRENT_FILTER_KIND     FILTER_MEAN
+#define CURRENT_FILTER_WINDOW   10
+#define POWER_FILTER_KIND       FILTER_MEAN
+#define POWER_FILTER_WINDOW     10
 
 
 // Public API Functions
 void telemetry_init(void);
 void telemetry_tick(void);
+void telemetry_status_task(void);                   // Scheduler task released by SCHED_EV_STATUS
+void telemetry_notify_status(void);                 // State/fault/relays changed, safe from any ISR
+HAL_StatusTypeDef telemetry_set_tx_mode(uint8_t mode);
+uint8_t telemetry_tx_mode(void);
+HAL_StatusTypeDef telemetry_set_sensor_mask(uint8_t mask);     // HAL_ERROR for bits past the last sensor
+uint8_t telemetry_sensor_mask(void);
+void telemetry_send_snapshot(void);                 // Status frame and both pages of every enabled sensor, now
 
 #endif /* INC_TELEMETRY_H_ */
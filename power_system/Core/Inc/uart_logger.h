@@ -0,0 +1,47 @@
+/*
+ * uart_logger.h
+ *
+ * Streaming UART data logger.
+ *
+ * Sampling is paced by the sampler timer: every tick starts an acquisition
+ * sweep, and each finished sweep is handed from the I2C ISR to the logger
+ * through a small queue together with its microsecond timestamp. A capture
+ * selects any subset of the sensors and any of the raw codes
+ * (LOG_FIELD_*); each sweep becomes one record holding a single timestamp
+ * and the selected codes of every selected sensor, so the sensors stay
+ * aligned sample for sample. The main loop batches records into binary
+ * frames (log_frame.h), as many per frame as fit up to LOG_BATCH_SAMPLES,
+ * and writes them into one half of a TX double buffer while DMA drains the
+ * other half on USART2, so a capture uses the same small amount of RAM
+ * however long it runs. Command replies (OK/ERR, fault messages) stay ASCII
+ * lines and are sent before the first frame.
+ */
+
+#ifndef INC_UART_LOGGER_H_
+#define INC_UART_LOGGER_H_
+
+#include "main.h"
+#include "sampler.h"
+#include "log_frame.h"
+#include <stdint.h>
+
+#define LOG_TX_BUF_SIZE     512     // Bytes per half of the TX double buffer
+#define LOG_MAX_RATE_HZ     SAMPLER_MAX_RATE_HZ
+#define LOG_DEFAULT_SENSOR_MASK (1U << INA228_BUS)  // Sensors captured when START gives no mask, one bit per INA228_Location_t
+#define LOG_QUEUE_DEPTH     16      // Sweeps buffered between the I2C ISR and the main loop with every sensor and field; narrower records fit more
+#define LOG_BATCH_SAMPLES   16      // Most sweep records per LOG_FRAME_SAMPLES frame
+#define LOG_BATCH_MAX_AGE_MS 100    // Send a partial batch once its first sample is this old
+
+// One sweep record with every sensor and field selected
+#define LOG_RECORD_MAX_SIZE (LOG_RECORD_HEADER_SIZE + INA228_NUM_SENSORS * LOG_SAMPLE_MAX_SIZE)
+
+/* Function Prototypes */
+void uart_logger_init(void);
+uint8_t uart_logger_start(uint32_t rate_hz, uint32_t duration_s,   // Replies OK/ERR/fault; duration_s = 0 streams until uart_logger_stop()
+                          uint8_t mask, uint8_t field_bits);        // Bit per INA228_Location_t, LOG_FIELD_* bits
+void uart_logger_stop(void);                                        // Stop sampling; the END frame follows the last sweep
+uint8_t uart_logger_active(void);
+void uart_logger_send(const char* msg);                             // Queue a text reply (only outside a capture)
+void uart_logger_tick(void);                                        // Call from the main loop
+
+#endif /* INC_UART_LOGGER_H_ */
@@ -22,6 +22,34 @@
 
 /* USER CODE BEGIN 0 */
 
+/*
+ * Fill Prescaler/TimeSeg1/TimeSeg2 for `bitrate` from the current PCLK1.
+ * Prefers the most time quanta per bit (8..25) that divide PCLK1 exactly
+ * and whose segments fit, with the sample point nearest CAN1_SAMPLE_POINT_PCT.
+ * Returns 0 if no exact setting exists.
+ */
+static uint8_t CAN_Bit_Timing(uint32_t bitrate, CAN_InitTypeDef* init)
+{
+  uint32_t pclk1 = HAL_RCC_GetPCLK1Freq();
+
+  for (uint32_t tq = 25; tq >= 8; tq--) {
+    if (pclk1 % (bitrate * tq) != 0) continue;
+    uint32_t prescaler = pclk1 / (bitrate * tq);
+    if (prescaler == 0 || prescaler > 1024) continue;
+
+    // Sync segment + BS1 end at the sample point
+    uint32_t bs1 = (tq * CAN1_SAMPLE_POINT_PCT + 50) / 100 - 1;
+    uint32_t bs2 = tq - 1 - bs1;
+    if (bs1 < 1 || bs1 > 16 || bs2 < 1 || bs2 > 8) continue;
+
+    init->Prescaler = prescaler;
+    init->TimeSeg1  = (bs1 - 1) << CAN_BTR_TS1_Pos;
+    init->TimeSeg2  = (bs2 - 1) << CAN_BTR_TS2_Pos;
+    return 1;
+  }
+  return 0;
+}
+
 /* USER CODE END 0 */
 
 CAN_HandleTypeDef hcan1;
@@ -54,6 +82,21 @@ void MX_CAN1_Init(void)
     Error_Handler();
   }
   /* USER CODE BEGIN CAN1_Init 2 */
+  // The generated values assume the 84 MHz clock tree: derive them from the active one
+  CAN_InitTypeDef timing = hcan1.Init;
+  if (!CAN_Bit_Timing(CAN1_BITRATE, &timing))
+  {
+    Error_Handler();
+  }
+  if (timing.Prescaler != hcan1.Init.Prescaler || timing.TimeSeg1 != hcan1.Init.TimeSeg1
+      || timing.TimeSeg2 != hcan1.Init.TimeSeg2)
+  {
+    hcan1.Init = timing;
+    if (HAL_CAN_Init(&hcan1) != HAL_OK)
+    {
+      Error_Handler();
+    }
+  }
 
   /* USER CODE END CAN1_Init 2 */
 
@@ -83,6 +126,13 @@ void HAL_CAN_MspInit(CAN_HandleTypeDef* canHandle)
     GPIO_InitStruct.Alternate = GPIO_AF9_CAN1;
     HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
 
+    /* CAN1 interrupt Init */
+    HAL_NVIC_SetPriority(CAN1_TX_IRQn, 2, 0);
+    HAL_NVIC_EnableIRQ(CAN1_TX_IRQn);
+    HAL_NVIC_SetPriority(CAN1_RX0_IRQn, 2, 0);
+    HAL_NVIC_EnableIRQ(CAN1_RX0_IRQn);
+    HAL_NVIC_SetPriority(CAN1_SCE_IRQn, 2, 0);
+    HAL_NVIC_EnableIRQ(CAN1_SCE_IRQn);
   /* USER CODE BEGIN CAN1_MspInit 1 */
 
   /* USER CODE END CAN1_MspInit 1 */
@@ -106,6 +156,10 @@ void HAL_CAN_MspDeInit(CAN_HandleTypeDef* canHandle)
     */
     HAL_GPIO_DeInit(GPIOA, GPIO_PIN_11|GPIO_PIN_12);
 
+    /* CAN1 interrupt Deinit */
+    HAL_NVIC_DisableIRQ(CAN1_TX_IRQn);
+    HAL_NVIC_DisableIRQ(CAN1_RX0_IRQn);
+    HAL_NVIC_DisableIRQ(CAN1_SCE_IRQn);
   /* USER CODE BEGIN CAN1_MspDeInit 1 */
 
   /* USER CODE END CAN1_MspDeInit 1 */
@@ -0,0 +1,170 @@
+/*
+ * can_cmd.c
+ *
+ * CAN command channel: command frames from RX FIFO 0, executed by the
+ * command task and acknowledged on CAN_ID_CMD_ACK.
+ */
+
+#include "can_cmd.h"
+#include "can.h"
+#include "can_tx.h"
+#include "precharge.h"
+#include "telemetry.h"
+#include "scheduler.h"
+#include <string.h>
+
+typedef struct {
+    uint8_t dlc;
+    uint8_t data[8];
+} CanCmd_t;
+
+// Filled by the RX FIFO 0 interrupt, emptied by the command task
+static CanCmd_t queue[CAN_CMD_QUEUE_SIZE];
+static uint8_t head, count;
+
+static volatile CanCmdStats_t stats;
+
+/* Local Prototypes */
+static bool Queue_Pop(CanCmd_t* cmd);
+static uint8_t Execute(const CanCmd_t* cmd);
+static void Send_Ack(uint8_t opcode, uint8_t tag, uint8_t result);
+
+/*
+ * @brief Accept CAN_ID_CMD into RX FIFO 0 and enable its interrupt
+ *
+ * The bank is a 32-bit identifier list with the same ID in both entries,
+ * so only standard data frames with exactly that ID pass.
+ */
+HAL_StatusTypeDef can_cmd_init(void)
+{
+    CAN_FilterTypeDef filter;
+
+    head = count = 0;
+    memset((void*)&stats, 0, sizeof(stats));
+
+    filter.FilterBank           = CAN_CMD_FILTER_BANK;
+    filter.FilterMode           = CAN_FILTERMODE_IDLIST;
+    filter.FilterScale          = CAN_FILTERSCALE_32BIT;
+    filter.FilterIdHigh         = CAN_ID_CMD << 5;     // STID[10:0] in bits 31:21, IDE = RTR = 0
+    filter.FilterIdLow          = 0;
+    filter.FilterMaskIdHigh     = CAN_ID_CMD << 5;     // Second list entry
+    filter.FilterMaskIdLow      = 0;
+    filter.FilterFIFOAssignment = CAN_FILTER_FIFO0;
+    filter.FilterActivation     = CAN_FILTER_ENABLE;
+    filter.SlaveStartFilterBank = 14;                  // CAN2 is unused, reset split
+
+    if (HAL_CAN_ConfigFilter(&hcan1, &filter) != HAL_OK) return HAL_ERROR;
+    return HAL_CAN_ActivateNotification(&hcan1, CAN_IT_RX_FIFO0_MSG_PENDING);
+}
+
+/* Execute every queued command in arrival order, each answered with an acknowledgement */
+void can_cmd_task(void)
+{
+    CanCmd_t cmd;
+
+    while (Queue_Pop(&cmd)) {
+        Send_Ack(cmd.data[0], cmd.data[1], Execute(&cmd));
+    }
+}
+
+void can_cmd_get_stats(CanCmdStats_t* out)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    *out = stats;
+    __set_PRIMASK(primask);
+}
+
+/* Oldest queued command; the RX interrupt also touches the queue */
+static bool Queue_Pop(CanCmd_t* cmd)
+{
+    bool popped = false;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (count > 0) {
+        *cmd = queue[head];
+        head = (uint8_t)((head + 1) % CAN_CMD_QUEUE_SIZE);
+        count--;
+        popped = true;
+    }
+    __set_PRIMASK(primask);
+    return popped;
+}
+
+/* Run one command, returns its CAN_CMD_* result */
+static uint8_t Execute(const CanCmd_t* cmd)
+{
+    const uint8_t* arg = &cmd->data[2];
+
+    if (cmd->dlc < 2) return CAN_CMD_ERR_ARG;
+
+    switch (cmd->data[0]) {
+        case CAN_CMD_FAULT_RESET:
+            return (precharge_reset_fault() == HAL_OK) ? CAN_CMD_OK : CAN_CMD_ERR_BUSY;
+
+        case CAN_CMD_TELEMETRY_RATE: {
+            uint16_t period_ms = (uint16_t)(arg[0] | (arg[1] << 8));
+            if (cmd->dlc < 4 || period_ms < TELEMETRY_RATE_MIN_MS || period_ms > TELEMETRY_RATE_MAX_MS) return CAN_CMD_ERR_ARG;
+            return (sched_set_period(telemetry_tick, period_ms) == HAL_OK) ? CAN_CMD_OK : CAN_CMD_ERR_ARG;
+        }
+
+        case CAN_CMD_SENSOR_MASK:
+            if (cmd->dlc < 3) return CAN_CMD_ERR_ARG;
+            return (telemetry_set_sensor_mask(arg[0]) == HAL_OK) ? CAN_CMD_OK : CAN_CMD_ERR_ARG;
+
+        case CAN_CMD_ADC_PROFILE: {
+            if (cmd->dlc < 4) return CAN_CMD_ERR_ARG;
+            uint8_t sensor_mask = arg[1] ? arg[1] : (uint8_t)((1 << INA228_NUM_SENSORS) - 1);
+            return (precharge_set_adc_profile(sensor_mask, (INA228_AdcProfile_t)arg[0]) == HAL_OK) ? CAN_CMD_OK : CAN_CMD_ERR_ARG;
+        }
+
+        case CAN_CMD_SNAPSHOT:
+            telemetry_send_snapshot();
+            return CAN_CMD_OK;
+
+        default:
+            return CAN_CMD_ERR_UNKNOWN;
+    }
+}
+
+/**
+ * @brief CAN: Send an acknowledgement
+ *
+ * Frame layout (DLC = 3):
+ *   Byte 0 : opcode of the command
+ *   Byte 1 : tag of the command
+ *   Byte 2 : result (CAN_CMD_OK or CAN_CMD_ERR_*)
+ */
+static void Send_Ack(uint8_t opcode, uint8_t tag, uint8_t result)
+{
+    uint8_t TxData[3] = { opcode, tag, result };
+
+    can_tx_send(CAN_ID_CMD_ACK, TxData, 3);
+}
+
+/* HAL callback, from HAL_CAN_IRQHandler in CAN1_RX0_IRQHandler: drain the FIFO into the queue */
+void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef* hcan)
+{
+    CAN_RxHeaderTypeDef header;
+    uint8_t data[8];
+
+    while (HAL_CAN_GetRxFifoFillLevel(hcan, CAN_RX_FIFO0) > 0) {
+        if (HAL_CAN_GetRxMessage(hcan, CAN_RX_FIFO0, &header, data) != HAL_OK) break;
+        if (header.IDE != CAN_ID_STD || header.RTR != CAN_RTR_DATA || header.StdId != CAN_ID_CMD) continue;
+
+        stats.received++;
+        if (count == CAN_CMD_QUEUE_SIZE) {
+            stats.dropped++;
+            continue;
+        }
+
+        CanCmd_t* cmd = &queue[(head + count) % CAN_CMD_QUEUE_SIZE];
+        cmd->dlc = (header.DLC > 8) ? 8 : (uint8_t)header.DLC;
+        memset(cmd->data, 0, sizeof(cmd->data));
+        memcpy(cmd->data, data, cmd->dlc);
+        count++;
+    }
+
+    sched_signal(SCHED_EV_CAN_CMD);
+}
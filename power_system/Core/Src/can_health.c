@@ -0,0 +1,179 @@
+/*
+ * can_health.c
+ *
+ * CAN1 error state, bus-off restarts with backoff, and the CAN health frame.
+ */
+
+#include "can_health.h"
+#include "can.h"
+#include "can_tx.h"
+#include <string.h>
+
+#define CAN_HEALTH_FRAME_TICKS  (CAN_HEALTH_FRAME_MS / CAN_HEALTH_INTERVAL_MS)
+
+// Bus errors as reported by the HAL, in ESR.LEC order (codes 1-6)
+static const uint32_t lec_errors[6] = {
+    HAL_CAN_ERROR_STF, HAL_CAN_ERROR_FOR, HAL_CAN_ERROR_ACK, HAL_CAN_ERROR_BR, HAL_CAN_ERROR_BD, HAL_CAN_ERROR_CRC
+};
+
+// bus_errors, bus_offs and last_error are also written by the error interrupt
+static volatile CanHealth_t health;
+static volatile bool bus_off;           // Bus-off seen and the controller not restarted yet
+static volatile uint32_t bus_off_ms;    // Bus-off entry, or the last restart attempt
+
+static uint32_t restart_ms;             // Last successful restart
+static uint8_t frame_ticks;
+static uint32_t frame_ms;               // Start of the current health frame period
+static CanTxStats_t tx_prev;            // can_tx counters at frame_ms
+
+/* Local Prototypes */
+static void Bus_Off_Entered(void);
+static bool Restart(void);
+static void CAN_Send_Health_Frame(const CanHealth_t* h, uint32_t sent, uint32_t lost);
+
+/* Enable the error interrupts on top of the TX and RX ones */
+void can_health_init(void)
+{
+    memset((void*)&health, 0, sizeof(health));
+    health.backoff_ms = CAN_BUSOFF_BACKOFF_MIN_MS;
+    bus_off = false;
+    frame_ticks = 0;
+    frame_ms = restart_ms = HAL_GetTick();
+    can_tx_get_stats(&tx_prev);
+
+    HAL_CAN_ActivateNotification(&hcan1, CAN_IT_ERROR_WARNING | CAN_IT_ERROR_PASSIVE | CAN_IT_BUSOFF
+                                         | CAN_IT_LAST_ERROR_CODE | CAN_IT_ERROR);
+}
+
+/*
+ * @brief Track the error state, restart the controller after a bus-off and send the health frame
+ *
+ * Runs every CAN_HEALTH_INTERVAL_MS. A restart is due once the current
+ * backoff has passed since the bus-off (or the previous attempt); each
+ * restart doubles the backoff for the next one.
+ */
+void can_health_task(void)
+{
+    uint32_t now = HAL_GetTick();
+    uint32_t esr = hcan1.Instance->ESR;
+
+    // Also caught here, should the interrupt have been missed
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if ((esr & CAN_ESR_BOFF) && !bus_off) Bus_Off_Entered();
+    __set_PRIMASK(primask);
+
+    if (bus_off && now - bus_off_ms >= health.backoff_ms) {
+        health.restarts++;
+        bus_off_ms = now;
+        if (Restart()) {
+            bus_off = false;
+            restart_ms = now;
+        }
+        health.backoff_ms = (health.backoff_ms * 2 > CAN_BUSOFF_BACKOFF_MAX_MS) ? CAN_BUSOFF_BACKOFF_MAX_MS
+                                                                                : health.backoff_ms * 2;
+    } else if (!bus_off && health.backoff_ms > CAN_BUSOFF_BACKOFF_MIN_MS && now - restart_ms >= CAN_BUSOFF_STABLE_MS) {
+        health.backoff_ms = CAN_BUSOFF_BACKOFF_MIN_MS;
+    }
+
+    health.state = (esr & CAN_ESR_BOFF) ? CAN_BUS_OFF :
+                   (esr & CAN_ESR_EPVF) ? CAN_ERROR_PASSIVE :
+                   (esr & CAN_ESR_EWGF) ? CAN_ERROR_WARNING : CAN_ERROR_ACTIVE;
+    health.tec = (esr & CAN_ESR_BOFF) ? 255 : (uint8_t)((esr & CAN_ESR_TEC) >> CAN_ESR_TEC_Pos);
+    health.rec = (uint8_t)((esr & CAN_ESR_REC) >> CAN_ESR_REC_Pos);
+
+    if (++frame_ticks < CAN_HEALTH_FRAME_TICKS) return;
+    frame_ticks = 0;
+
+    // TX results and this node's bus load since the previous health frame
+    CanTxStats_t tx;
+    CanHealth_t h;
+    can_tx_get_stats(&tx);
+    uint32_t elapsed_ms = now - frame_ms;
+    if (elapsed_ms > 0) {
+        uint64_t centi_pct = (uint64_t)(tx.tx_bits - tx_prev.tx_bits) * 10000U * 1000U / ((uint64_t)CAN1_BITRATE * elapsed_ms);
+        health.load_centi_pct = (centi_pct > 10000U) ? 10000U : (uint16_t)centi_pct;
+    }
+    can_health_get(&h);
+    CAN_Send_Health_Frame(&h, tx.sent - tx_prev.sent, tx.dropped - tx_prev.dropped);
+    tx_prev = tx;
+    frame_ms = now;
+}
+
+void can_health_get(CanHealth_t* out)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    *out = health;
+    __set_PRIMASK(primask);
+}
+
+/* From HAL_CAN_ErrorCallback: count bus errors and a new bus-off, then clear what was handled */
+void can_health_error_callback(CAN_HandleTypeDef* hcan)
+{
+    uint32_t code = hcan->ErrorCode;
+
+    for (uint8_t i = 0; i < 6; i++) {
+        if (code & lec_errors[i]) {
+            health.bus_errors++;
+            health.last_error = i + 1;
+        }
+    }
+    if ((code & HAL_CAN_ERROR_BOF) && !bus_off) Bus_Off_Entered();
+
+    hcan->ErrorCode &= ~(HAL_CAN_ERROR_EWG | HAL_CAN_ERROR_EPV | HAL_CAN_ERROR_BOF | HAL_CAN_ERROR_STF | HAL_CAN_ERROR_FOR
+                         | HAL_CAN_ERROR_ACK | HAL_CAN_ERROR_BR | HAL_CAN_ERROR_BD | HAL_CAN_ERROR_CRC);
+}
+
+/* Called from the error interrupt or with it masked */
+static void Bus_Off_Entered(void)
+{
+    bus_off = true;
+    bus_off_ms = HAL_GetTick();
+    health.bus_offs++;
+}
+
+/*
+ * Leave and re-enter normal mode. With AutoBusOff disabled this is what
+ * starts the recovery: the controller is back on the bus once it has seen
+ * 128 x 11 recessive bits. Frames queued while off the bus are dropped so
+ * fresh telemetry goes out first; the three in the mailboxes still go.
+ */
+static bool Restart(void)
+{
+    can_tx_flush();
+
+    // A previous attempt that timed out (bus held dominant) left the handle in the error state
+    if (HAL_CAN_GetState(&hcan1) == HAL_CAN_STATE_ERROR && HAL_CAN_Init(&hcan1) != HAL_OK) return false;
+    if (HAL_CAN_GetState(&hcan1) == HAL_CAN_STATE_LISTENING && HAL_CAN_Stop(&hcan1) != HAL_OK) return false;
+    return HAL_CAN_Start(&hcan1) == HAL_OK;
+}
+
+/**
+ * @brief CAN: Send the health frame
+ *
+ * Frame layout (DLC = 8):
+ *   Byte 0   : TEC (255 while bus-off)
+ *   Byte 1   : REC
+ *   Byte 2   : bits 0-1 CanErrorState_t, bits 4-6 last bus error (ESR.LEC code, 0 = none yet)
+ *   Byte 3   : bus-off count since boot (saturates at 255)
+ *   Byte 4-5 : frames sent since the previous health frame (uint16, little-endian, saturated)
+ *   Byte 6   : frames lost since the previous health frame, transmit errors and TX queue overflow (saturated)
+ *   Byte 7   : bus load of this node's frames in 0.5 % steps (no stuff bits)
+ */
+static void CAN_Send_Health_Frame(const CanHealth_t* h, uint32_t sent, uint32_t lost)
+{
+    uint8_t TxData[8];
+
+    if (sent > 0xFFFF) sent = 0xFFFF;
+    TxData[0] = h->tec;
+    TxData[1] = h->rec;
+    TxData[2] = (uint8_t)((h->state & 0x03) | ((h->last_error & 0x07) << 4));
+    TxData[3] = (h->bus_offs > 255) ? 255 : (uint8_t)h->bus_offs;
+    TxData[4] = sent & 0xFF;
+    TxData[5] = (sent >> 8) & 0xFF;
+    TxData[6] = (lost > 255) ? 255 : (uint8_t)lost;
+    TxData[7] = (uint8_t)((h->load_centi_pct + 25) / 50);
+
+    can_tx_send(CAN_ID_CAN_HEALTH, TxData, 8);
+}
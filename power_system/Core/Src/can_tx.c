@@ -0,0 +1,199 @@
+/*
+ * can_tx.c
+ *
+ * CAN1 software TX queue drained by the TX mailbox interrupts.
+ */
+
+#include "can_tx.h"
+#include "can_health.h"
+#include "can.h"
+#include "profile.h"
+#include <string.h>
+
+#define CAN_NUM_MAILBOXES   3
+
+typedef struct {
+    uint32_t id;
+    uint8_t  dlc;
+    uint8_t  data[8];
+} CanTxFrame_t;
+
+// Sorted by ID, frames with the same ID in send order
+static CanTxFrame_t queue[CAN_TX_QUEUE_SIZE];
+static uint8_t count;
+
+// Copy of the frame in each mailbox, needed to requeue it after a lost arbitration
+static CanTxFrame_t in_flight[CAN_NUM_MAILBOXES];
+
+static volatile CanTxStats_t stats;
+
+/* Local Prototypes */
+static bool Queue_Insert(const CanTxFrame_t* frame, bool ahead);
+static void Fill_Mailboxes(void);
+static void Mailbox_Done(uint32_t n);
+
+/* Enable the TX mailbox empty interrupt that drives the queue */
+void can_tx_init(void)
+{
+    count = 0;
+    memset((void*)&stats, 0, sizeof(stats));
+    HAL_CAN_ActivateNotification(&hcan1, CAN_IT_TX_MAILBOX_EMPTY);
+}
+
+/**
+  * @brief Queue a standard data frame for transmission
+  * @retval false if the frame was dropped (queue full of higher priority frames)
+  */
+bool can_tx_send(uint32_t std_id, const uint8_t* data, uint8_t dlc)
+{
+    CanTxFrame_t frame;
+    PROFILE_BEGIN(PROF_CAN_TX_SEND);
+
+    frame.id = std_id & 0x7FFU;
+    frame.dlc = (dlc > 8) ? 8 : dlc;
+    memset(frame.data, 0, sizeof(frame.data));
+    memcpy(frame.data, data, frame.dlc);
+
+    // The TX interrupt also pops the queue
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    bool queued = Queue_Insert(&frame, false);
+    Fill_Mailboxes();
+    __set_PRIMASK(primask);
+
+    PROFILE_END(PROF_CAN_TX_SEND);
+    return queued;
+}
+
+void can_tx_get_stats(CanTxStats_t* out)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    *out = stats;
+    __set_PRIMASK(primask);
+}
+
+/* Frames queued while the controller was off the bus are stale: count them as dropped */
+void can_tx_flush(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    stats.dropped += count;
+    count = 0;
+    stats.depth = 0;
+    __set_PRIMASK(primask);
+}
+
+/*
+ * Refill the mailboxes once HAL_CAN_IRQHandler has reported every mailbox.
+ * Refilling from the callbacks would let a new request clear a mailbox
+ * whose lost arbitration the HAL has not reported yet (writing TXRQ clears
+ * RQCP and ALST), and its frame would vanish.
+ */
+void can_tx_irq_handler(void)
+{
+    Fill_Mailboxes();
+}
+
+/* Insert in ID order, after frames of equal ID (or before them when ahead, for a requeued frame) */
+static bool Queue_Insert(const CanTxFrame_t* frame, bool ahead)
+{
+    if (count == CAN_TX_QUEUE_SIZE) {
+        // Full: the lowest priority frame (the tail) makes room only for a higher priority one
+        if (queue[count - 1].id <= frame->id) {
+            stats.dropped++;
+            return false;
+        }
+        count--;
+        stats.dropped++;
+    }
+
+    uint8_t pos = count;
+    while (pos > 0 && (ahead ? queue[pos - 1].id >= frame->id : queue[pos - 1].id > frame->id)) pos--;
+
+    memmove(&queue[pos + 1], &queue[pos], sizeof(CanTxFrame_t) * (count - pos));
+    queue[pos] = *frame;
+    count++;
+
+    stats.depth = count;
+    if (count > stats.max_depth) stats.max_depth = count;
+    return true;
+}
+
+/* Move the head of the queue into every free mailbox. Called with the TX interrupt masked or from it */
+static void Fill_Mailboxes(void)
+{
+    while (count > 0 && HAL_CAN_GetTxMailboxesFreeLevel(&hcan1) > 0) {
+        CAN_TxHeaderTypeDef TxHeader;
+        uint32_t TxMailbox;
+
+        TxHeader.StdId = queue[0].id;
+        TxHeader.ExtId = 0;
+        TxHeader.IDE   = CAN_ID_STD;
+        TxHeader.RTR   = CAN_RTR_DATA;
+        TxHeader.DLC   = queue[0].dlc;
+        TxHeader.TransmitGlobalTime = DISABLE;
+
+        if (HAL_CAN_AddTxMessage(&hcan1, &TxHeader, queue[0].data, &TxMailbox) != HAL_OK) {
+            HAL_GPIO_TogglePin(LD2_GPIO_Port, LD2_Pin); // Blink if not sending data (CAN not started)
+            break;
+        }
+
+        uint32_t n = (TxMailbox == CAN_TX_MAILBOX0) ? 0 : (TxMailbox == CAN_TX_MAILBOX1) ? 1 : 2;
+        in_flight[n] = queue[0];
+
+        count--;
+        memmove(&queue[0], &queue[1], sizeof(CanTxFrame_t) * count);
+        stats.depth = count;
+    }
+}
+
+/* Mailbox n is free again: account for how its frame ended */
+static void Mailbox_Done(uint32_t n)
+{
+    static const uint32_t alst[CAN_NUM_MAILBOXES] = { HAL_CAN_ERROR_TX_ALST0, HAL_CAN_ERROR_TX_ALST1, HAL_CAN_ERROR_TX_ALST2 };
+    static const uint32_t terr[CAN_NUM_MAILBOXES] = { HAL_CAN_ERROR_TX_TERR0, HAL_CAN_ERROR_TX_TERR1, HAL_CAN_ERROR_TX_TERR2 };
+
+    if (hcan1.ErrorCode & alst[n]) {
+        hcan1.ErrorCode &= ~alst[n];
+        stats.arb_lost++;
+        Queue_Insert(&in_flight[n], true);  // No hardware retransmission: retry at the same priority
+    } else if (hcan1.ErrorCode & terr[n]) {
+        hcan1.ErrorCode &= ~terr[n];
+        stats.tx_errors++;
+        stats.dropped++;
+    } else {
+        stats.sent++;
+        stats.tx_bits += CAN_FRAME_BITS(in_flight[n].dlc);
+    }
+}
+
+// HAL callbacks, from HAL_CAN_IRQHandler in the CAN1 TX, RX0 and SCE vectors
+
+void HAL_CAN_TxMailbox0CompleteCallback(CAN_HandleTypeDef* hcan)
+{
+    Mailbox_Done(0);
+}
+
+void HAL_CAN_TxMailbox1CompleteCallback(CAN_HandleTypeDef* hcan)
+{
+    Mailbox_Done(1);
+}
+
+void HAL_CAN_TxMailbox2CompleteCallback(CAN_HandleTypeDef* hcan)
+{
+    Mailbox_Done(2);
+}
+
+/*
+ * Arbitration lost or transmit error: the HAL flags the mailbox in ErrorCode instead of a complete callback.
+ * Error states and bus errors from the CAN1_SCE vector are passed on to can_health.
+ */
+void HAL_CAN_ErrorCallback(CAN_HandleTypeDef* hcan)
+{
+    for (uint32_t n = 0; n < CAN_NUM_MAILBOXES; n++) {
+        uint32_t failed = (HAL_CAN_ERROR_TX_ALST0 | HAL_CAN_ERROR_TX_TERR0) << (2 * n);
+        if (hcan->ErrorCode & failed) Mailbox_Done(n);
+    }
+    can_health_error_callback(hcan);
+}
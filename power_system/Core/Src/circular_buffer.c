@@ -1,35 +1,159 @@
 /*
  * circular_buffer.c
  *
- * Generic circular buffer implementation for float values.
- * Stores the last CIRC_BUF_SIZE samples and maintains a running average
- * that is recomputed on every push. Used by the telemetry module to
+ * Generic circular buffer implementation for float values, or int32 raw
+ * codes when SENSOR_FIXED_POINT is set.
+ * Stores the last `size` samples of each instance and produces a filtered
+ * output on every push: a rolling mean kept as a running sum (periodically
+ * recomputed to bound float drift), an exponential moving average, or a
+ * median over a short window. Window min/max are tracked with monotonic
+ * deques so they never need a full rescan. Used by the telemetry module to
  * smooth INA228 voltage and current readings before CAN transmission.
+ *
+ * In fixed point the mean divides an exact 64-bit sum with rounding, the EMA
+ * keeps 16 fractional bits of state, and the median of an even window is the
+ * rounded-down midpoint.
  */
 
 #include "circular_buffer.h"
+#include "profile.h"
 #include <string.h>
 
-void circ_buf_init(CircularBuffer_t *cb)
+#define EMA_FRAC_BITS   16
+
+/* Local Prototypes */
+static void Deque_PopFront(uint8_t *dq, uint16_t *head, uint16_t *len, uint16_t slot);
+static void Median_Update(CircularBuffer_t *cb, uint8_t full, circ_sample_t evicted, circ_sample_t value);
+
+void circ_buf_init(CircularBuffer_t *cb, FilterKind_t kind, uint16_t size)
 {
     memset(cb, 0, sizeof(CircularBuffer_t)); // Reset buffer by zeroing memory block
+
+    uint16_t max_size = (kind == FILTER_MEDIAN) ? CIRC_BUF_MEDIAN_MAX_SIZE : CIRC_BUF_MAX_SIZE;
+    if (size == 0) size = 1;
+    if (size > max_size) size = max_size;
+
+    cb->kind  = kind;
+    cb->size  = size;
+#if SENSOR_FIXED_POINT
+    cb->alpha = (int32_t)((2 << EMA_FRAC_BITS) / (size + 1));
+#else
+    cb->alpha = 2.0f / ((float)size + 1.0f);
+#endif
 }
 
-void circ_buf_push(CircularBuffer_t *cb, float value)
+void circ_buf_push(CircularBuffer_t *cb, circ_sample_t value)
 {
+	PROFILE_BEGIN(PROF_CIRC_BUF_PUSH);
+	uint8_t full  = (cb->count == cb->size);
+	circ_sample_t evicted = cb->buf[cb->index];		// Oldest sample, only valid when the window is full
+
+	// The slot about to be overwritten leaves the window
+	if (full) {
+		Deque_PopFront(cb->min_dq, &cb->min_head, &cb->min_len, cb->index);
+		Deque_PopFront(cb->max_dq, &cb->max_head, &cb->max_len, cb->index);
+	}
+
 	cb->buf[cb->index] = value; 					// Write into the current slot
-	cb->index = (cb->index + 1) % CIRC_BUF_SIZE; 	// Advance write pointer and wrap around
 
-	if(cb->count < CIRC_BUF_SIZE) cb->count++; 		// Increase sample count until buffer is full
+	// Drop slots the new sample dominates, so the front of each deque is always the window min/max
+	while (cb->min_len && cb->buf[cb->min_dq[(cb->min_head + cb->min_len - 1) % CIRC_BUF_MAX_SIZE]] >= value) cb->min_len--;
+	cb->min_dq[(cb->min_head + cb->min_len++) % CIRC_BUF_MAX_SIZE] = (uint8_t)cb->index;
+
+	while (cb->max_len && cb->buf[cb->max_dq[(cb->max_head + cb->max_len - 1) % CIRC_BUF_MAX_SIZE]] <= value) cb->max_len--;
+	cb->max_dq[(cb->max_head + cb->max_len++) % CIRC_BUF_MAX_SIZE] = (uint8_t)cb->index;
 
-    /* Recompute average over all valid slots */
-    float sum = 0.0f;
-    for (int i = 0; i < cb->count; i++)
-    	sum += cb->buf[i];
-    cb->average = sum / (float)cb->count;
+	cb->index = (cb->index + 1) % cb->size; 		// Advance write pointer and wrap around
+	if (!full) cb->count++; 						// Increase sample count until buffer is full
+
+	switch (cb->kind) {
+		case FILTER_MEAN:
+#if SENSOR_FIXED_POINT
+			cb->sum += (circ_sum_t)value - (full ? evicted : 0);
+			cb->average = (circ_sample_t)((cb->sum + (cb->sum >= 0 ? cb->count / 2 : -(cb->count / 2))) / cb->count);
+#else
+			cb->sum += value - (full ? evicted : 0.0f);
+
+			// Recompute from the stored samples once in a while so rounding error cannot accumulate
+			if (++cb->pushes_since_renorm >= CIRC_BUF_RENORM_INTERVAL) {
+				float sum = 0.0f;
+				for (uint16_t i = 0; i < cb->count; i++)
+					sum += cb->buf[i];
+				cb->sum = sum;
+				cb->pushes_since_renorm = 0;
+			}
+			cb->average = cb->sum / (float)cb->count;
+#endif
+			break;
+
+		case FILTER_EMA:
+#if SENSOR_FIXED_POINT
+			if (cb->count == 1) cb->ema = (int64_t)value * (1 << EMA_FRAC_BITS);
+			else cb->ema += (cb->alpha * ((int64_t)value * (1 << EMA_FRAC_BITS) - cb->ema)) / (1 << EMA_FRAC_BITS);
+			cb->average = (circ_sample_t)((cb->ema + (1 << (EMA_FRAC_BITS - 1))) >> EMA_FRAC_BITS);
+#else
+			if (cb->count == 1) cb->average = value; 	// Seed with the first sample
+			else cb->average += cb->alpha * (value - cb->average);
+#endif
+			break;
+
+		case FILTER_MEDIAN:
+			Median_Update(cb, full, evicted, value);
+			break;
+
+		default:
+			break;
+	}
+
+	PROFILE_END(PROF_CIRC_BUF_PUSH);
 }
 
-float circ_buf_average(const CircularBuffer_t *cb)
+circ_sample_t circ_buf_average(const CircularBuffer_t *cb)
 {
     return cb->average;
 }
+
+circ_sample_t circ_buf_min(const CircularBuffer_t *cb)
+{
+    return cb->min_len ? cb->buf[cb->min_dq[cb->min_head]] : 0;
+}
+
+circ_sample_t circ_buf_max(const CircularBuffer_t *cb)
+{
+    return cb->max_len ? cb->buf[cb->max_dq[cb->max_head]] : 0;
+}
+
+/* Remove the front of a deque if it refers to the slot being evicted */
+static void Deque_PopFront(uint8_t *dq, uint16_t *head, uint16_t *len, uint16_t slot)
+{
+	if (*len && dq[*head] == slot) {
+		*head = (*head + 1) % CIRC_BUF_MAX_SIZE;
+		(*len)--;
+	}
+}
+
+/* Keep the median window sorted: remove the evicted sample, insert the new one */
+static void Median_Update(CircularBuffer_t *cb, uint8_t full, circ_sample_t evicted, circ_sample_t value)
+{
+	uint16_t n = full ? cb->count : cb->count - 1; 	// Samples in sorted[] before this push
+	uint16_t i;
+
+	if (full) {
+		for (i = 0; i < n && cb->sorted[i] != evicted; i++);
+		for (; i + 1 < n; i++)
+			cb->sorted[i] = cb->sorted[i + 1];
+		n--;
+	}
+
+	for (i = n; i > 0 && cb->sorted[i - 1] > value; i--)
+		cb->sorted[i] = cb->sorted[i - 1];
+	cb->sorted[i] = value;
+	n++;
+
+	if (n & 1) cb->average = cb->sorted[n / 2];
+#if SENSOR_FIXED_POINT
+	else       cb->average = (circ_sample_t)(((int64_t)cb->sorted[n / 2 - 1] + cb->sorted[n / 2]) >> 1);
+#else
+	else       cb->average = 0.5f * (cb->sorted[n / 2 - 1] + cb->sorted[n / 2]);
+#endif
+}
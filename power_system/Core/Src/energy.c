@@ -0,0 +1,173 @@
+/*
+ * energy.c
+ *
+ * Energy and charge totals from the INA228 hardware accumulators.
+ * Each tick takes the ENERGY/CHARGE values read by the last accumulator
+ * sweep, adds the change since the previous read to 64-bit running totals,
+ * sends one CAN frame per sensor (IDs 0x110–0x114) and asks the acquisition
+ * engine to read the accumulators again in its next sweep.
+ *
+ * The totals stay in register codes; mWh and mAh are only computed for the
+ * frames, with Q32 multipliers precomputed from each sensor's LSBs.
+ */
+
+#include "energy.h"
+#include "precharge.h"
+#include "sensor_acq.h"
+#include "can_tx.h"
+#include <string.h>
+
+#define ACCUM_Q             32      // Fractional bits of the code -> mWh / mAh multipliers
+#define ACCUM_RANGE         ((int64_t)1 << INA228_ACCUM_BITS)
+
+static const uint16_t can_ids[INA228_NUM_SENSORS] = {
+    CAN_ID_ENERGY_BUS, CAN_ID_ENERGY_MOTOR1, CAN_ID_ENERGY_MOTOR2, CAN_ID_ENERGY_MOTOR3, CAN_ID_ENERGY_MOTOR4
+};
+
+static EnergyTotals_t totals[INA228_NUM_SENSORS];
+
+// mWh per ENERGY code and mAh per CHARGE code in Q32, from each sensor's calibration
+static int64_t milli_wh_q[INA228_NUM_SENSORS];
+static int64_t milli_ah_q[INA228_NUM_SENSORS];
+
+/* Local Prototypes */
+static void Accumulate(EnergyTotals_t* t, const INA228_RawAccum_t* raw, uint16_t diag_alrt);
+static int64_t Codes_To_Milli(int64_t codes, int64_t milli_q);
+static void CAN_Send_Energy_Frame(uint16_t can_id, uint32_t milli_wh, int32_t milli_ah);
+
+/*
+ * @brief Clear the hardware accumulators and the running totals
+ *
+ * Called once the sensors are configured and before the scheduler starts,
+ * while no sweep is using the bus.
+ */
+void energy_init(void)
+{
+	memset(totals, 0, sizeof(totals));
+
+	for (uint8_t i = 0; i < INA228_NUM_SENSORS; i++) {
+		const SensorDesc_t* desc = &g_sensor_table[i];
+
+		milli_wh_q[i] = (int64_t)(INA228_ENERGY_LSB_FACTOR * desc->power_lsb / 3.6f * (float)(1ULL << ACCUM_Q) + 0.5f);
+		milli_ah_q[i] = (int64_t)(desc->current_lsb / 3.6f * (float)(1ULL << ACCUM_Q) + 0.5f);
+
+		// An unhealthy sensor is picked up later through the reset check in Accumulate()
+		INA228_ResetAccumulators(desc->address);
+	}
+
+	sensor_acq_request_accum();
+}
+
+void energy_tick(void)
+{
+	AcqAccum_t accum;
+
+	if (sensor_acq_get_accum(&accum)) {
+		for (uint8_t i = 0; i < INA228_NUM_SENSORS; i++) {
+			totals[i].valid = (accum.valid_mask >> i) & 1U;
+			if (totals[i].valid) Accumulate(&totals[i], &accum.sensor[i], accum.diag_alrt[i]);
+		}
+	}
+
+	for (uint8_t i = 0; i < INA228_NUM_SENSORS; i++) {
+		CAN_Send_Energy_Frame(can_ids[i], energy_milli_wh(i), energy_milli_ah(i));
+	}
+
+	// Read the accumulators again in the next sweep, whichever task starts it
+	sensor_acq_request_accum();
+}
+
+/* Restart the totals from zero; the next read is measured against the last register values as before */
+void energy_reset(void)
+{
+	for (uint8_t i = 0; i < INA228_NUM_SENSORS; i++) {
+		totals[i].energy = 0;
+		totals[i].charge = 0;
+	}
+}
+
+void energy_get_totals(uint8_t sensor, EnergyTotals_t* out)
+{
+	if (sensor < INA228_NUM_SENSORS) *out = totals[sensor];
+}
+
+uint32_t energy_milli_wh(uint8_t sensor)
+{
+	if (sensor >= INA228_NUM_SENSORS) return 0;
+
+	int64_t mwh = Codes_To_Milli(totals[sensor].energy, milli_wh_q[sensor]);
+	if (mwh > (int64_t)UINT32_MAX) return UINT32_MAX;
+	return (mwh < 0) ? 0 : (uint32_t)mwh;
+}
+
+int32_t energy_milli_ah(uint8_t sensor)
+{
+	if (sensor >= INA228_NUM_SENSORS) return 0;
+
+	int64_t mah = Codes_To_Milli(totals[sensor].charge, milli_ah_q[sensor]);
+	if (mah > INT32_MAX) return INT32_MAX;
+	if (mah < INT32_MIN) return INT32_MIN;
+	return (int32_t)mah;
+}
+
+/*
+ * Add the change since the previous read. ENERGYOF/CHARGEOF (still set in
+ * the DIAG_ALRT read that precedes the accumulators) mean the register
+ * wrapped once; ENERGY going backwards without ENERGYOF means the sensor was
+ * reset, so everything it holds is new.
+ */
+static void Accumulate(EnergyTotals_t* t, const INA228_RawAccum_t* raw, uint16_t diag_alrt)
+{
+	int64_t d_energy;
+	int64_t d_charge = raw->charge - t->last_charge;
+
+	if (diag_alrt & INA228_DIAG_ENERGYOF) {
+		d_energy = (int64_t)(raw->energy + (uint64_t)ACCUM_RANGE - t->last_energy);
+	} else if (raw->energy >= t->last_energy) {
+		d_energy = (int64_t)(raw->energy - t->last_energy);
+	} else {
+		d_energy = (int64_t)raw->energy;
+		d_charge = raw->charge;
+	}
+
+	// CHARGE is signed: a wrap past +2^39 reads as a large drop, past -2^39 as a large rise
+	if (diag_alrt & INA228_DIAG_CHARGEOF) {
+		d_charge += (d_charge < 0) ? ACCUM_RANGE : -ACCUM_RANGE;
+	}
+
+	t->energy += d_energy;
+	t->charge += d_charge;
+	t->last_energy = raw->energy;
+	t->last_charge = raw->charge;
+}
+
+/* codes x (milli-units per code), rounded to nearest; saturates instead of overflowing int64 */
+static int64_t Codes_To_Milli(int64_t codes, int64_t milli_q)
+{
+	if (milli_q == 0) return 0;
+	if (codes > INT64_MAX / milli_q) return INT64_MAX >> ACCUM_Q;
+	if (codes < INT64_MIN / milli_q) return INT64_MIN >> ACCUM_Q;
+
+	int64_t scaled = codes * milli_q;
+	return (scaled + ((int64_t)1 << (ACCUM_Q - 1))) >> ACCUM_Q;
+}
+
+/**
+ * @brief CAN: Send one energy frame
+ *
+ * Frame layout (DLC = 8):
+ *   Byte 0-3 : energy in mWh since reset (uint32, little-endian, saturated)
+ *   Byte 4-7 : charge in mAh since reset (int32, little-endian, saturated)
+ */
+static void CAN_Send_Energy_Frame(uint16_t can_id, uint32_t milli_wh, int32_t milli_ah)
+{
+	uint8_t TxData[8];
+	uint32_t mah = (uint32_t)milli_ah;
+
+	for (uint8_t b = 0; b < 4; b++) {
+		TxData[b]     = (milli_wh >> (8 * b)) & 0xFF;
+		TxData[4 + b] = (mah >> (8 * b)) & 0xFF;
+	}
+
+	can_tx_send(can_id, TxData, 8);
+}
@@ -0,0 +1,366 @@
+/*
+ * fmpi2c.c
+ *
+ * Register-level master driver for FMPI2C1: SCL timing, blocking transfers
+ * and the interrupt-driven register read used by the acquisition engine.
+ */
+
+#include "fmpi2c.h"
+
+#define FMP_MAX_SPEED_HZ    1000000U
+#define FMP_MAX_NBYTES      255U            // One CR2 transfer, no reload
+#define FMP_FILTER_NS       50              // Analog noise filter delay, minimum
+#define FMP_SYNC_CLKS       3               // SCL edge resynchronisation, kernel clocks per edge
+#define FMP_FMPLUS_HZ       400000U         // Above this the pads need the Fm+ drive
+
+#define FMP_IT_MASK         (FMPI2C_CR1_TXIE | FMPI2C_CR1_RXIE | FMPI2C_CR1_NACKIE | FMPI2C_CR1_STOPIE | FMPI2C_CR1_TCIE | FMPI2C_CR1_ERRIE)
+
+/* I2C-bus specification minimums for each speed class */
+typedef struct {
+    uint32_t max_hz;
+    uint16_t low_ns;        // tLOW
+    uint16_t high_ns;       // tHIGH
+    uint16_t su_dat_ns;     // tSU;DAT
+} FmpMode_t;
+
+static const FmpMode_t fmp_modes[] = {
+    { 100000U,  4700, 4000, 250 },  // Standard mode
+    { 400000U,  1300,  600, 100 },  // Fast mode
+    { 1000000U,  500,  260,  50 },  // Fast mode plus
+};
+
+#define FMP_NUM_MODES   (sizeof(fmp_modes) / sizeof(fmp_modes[0]))
+
+typedef enum {
+    FMP_IDLE = 0,
+    FMP_BLOCKING,
+    FMP_IT
+} FmpState_t;
+
+static volatile uint8_t fmp_state = FMP_IDLE;
+static uint32_t fmp_speed = 0;
+
+/* Interrupt-driven read in flight */
+static uint8_t it_addr;
+static uint8_t it_reg;
+static uint8_t* it_buf;
+static uint16_t it_len;
+static uint16_t it_count;
+static uint8_t it_failed;
+
+/* Local Prototypes */
+static uint8_t Fmp_Timing(uint32_t clk_hz, uint32_t speed_hz, uint32_t* timingr, uint32_t* scl_hz);
+static uint32_t Ns_To_Clk(uint32_t clk_hz, uint32_t ns);
+static uint8_t Fmp_Claim(FmpState_t state);
+static HAL_StatusTypeDef Fmp_Wait(uint32_t flag, uint32_t tickstart, uint32_t timeout_ms);
+static HAL_StatusTypeDef Fmp_Finish(HAL_StatusTypeDef status, uint32_t tickstart, uint32_t timeout_ms);
+static void Fmp_Reset(void);
+static void Fmp_EndIt(uint8_t ok);
+
+/**
+  * @brief Bring up FMPI2C1 at speed_hz (at most 1 MHz)
+  *
+  * May be called again with the bus idle to change the speed. Returns
+  * HAL_ERROR if the speed is out of range or SYSCLK is too fast to reach it
+  * with the 4-bit prescaler.
+  */
+HAL_StatusTypeDef fmpi2c_init(uint32_t speed_hz)
+{
+    uint32_t timingr, scl_hz;
+    GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+    if (speed_hz == 0 || speed_hz > FMP_MAX_SPEED_HZ) return HAL_ERROR;
+    if (!Fmp_Timing(HAL_RCC_GetSysClockFreq(), speed_hz, &timingr, &scl_hz)) return HAL_ERROR;
+
+    // Kernel clock from SYSCLK rather than PCLK1: finer SCL steps, so 1 MHz fits the spec minimums
+    __HAL_RCC_FMPI2C1_CLK_ENABLE();
+    RCC->DCKCFGR2 = (RCC->DCKCFGR2 & ~RCC_DCKCFGR2_FMPI2C1SEL) | RCC_DCKCFGR2_FMPI2C1SEL_0;
+
+    __HAL_RCC_GPIOC_CLK_ENABLE();
+    GPIO_InitStruct.Pin = GPIO_PIN_6|GPIO_PIN_7;      // PC6 = SCL, PC7 = SDA
+    GPIO_InitStruct.Mode = GPIO_MODE_AF_OD;
+    GPIO_InitStruct.Pull = GPIO_NOPULL;
+    GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
+    GPIO_InitStruct.Alternate = GPIO_AF4_FMPI2C1;
+    HAL_GPIO_Init(GPIOC, &GPIO_InitStruct);
+
+    __HAL_RCC_SYSCFG_CLK_ENABLE();
+    if (speed_hz > FMP_FMPLUS_HZ) SYSCFG->CFGR |= SYSCFG_CFGR_FMPI2C1_SCL | SYSCFG_CFGR_FMPI2C1_SDA;
+    else SYSCFG->CFGR &= ~(SYSCFG_CFGR_FMPI2C1_SCL | SYSCFG_CFGR_FMPI2C1_SDA);
+
+    // TIMINGR is only writable with the peripheral disabled; analog filter on, digital filter off
+    FMPI2C1->CR1 = 0;
+    FMPI2C1->TIMINGR = timingr;
+    FMPI2C1->CR1 = FMPI2C_CR1_PE;
+
+    HAL_NVIC_SetPriority(FMPI2C1_EV_IRQn, 1, 0);
+    HAL_NVIC_EnableIRQ(FMPI2C1_EV_IRQn);
+    HAL_NVIC_SetPriority(FMPI2C1_ER_IRQn, 1, 0);
+    HAL_NVIC_EnableIRQ(FMPI2C1_ER_IRQn);
+
+    fmp_speed = scl_hz;
+    fmp_state = FMP_IDLE;
+    return HAL_OK;
+}
+
+void fmpi2c_deinit(void)
+{
+    HAL_NVIC_DisableIRQ(FMPI2C1_EV_IRQn);
+    HAL_NVIC_DisableIRQ(FMPI2C1_ER_IRQn);
+
+    FMPI2C1->CR1 = 0;
+    SYSCFG->CFGR &= ~(SYSCFG_CFGR_FMPI2C1_SCL | SYSCFG_CFGR_FMPI2C1_SDA);
+    HAL_GPIO_DeInit(GPIOC, GPIO_PIN_6|GPIO_PIN_7);
+    __HAL_RCC_FMPI2C1_CLK_DISABLE();
+
+    fmp_state = FMP_IDLE;
+}
+
+uint32_t fmpi2c_speed(void)
+{
+    return fmp_speed;
+}
+
+uint8_t fmpi2c_busy(void)
+{
+    return fmp_state != FMP_IDLE;
+}
+
+/* Blocking write of len bytes (register pointer first), STOP at the end */
+HAL_StatusTypeDef fmpi2c_transmit(uint8_t dev_addr, const uint8_t* data, uint16_t len, uint32_t timeout_ms)
+{
+    if (data == NULL || len == 0 || len > FMP_MAX_NBYTES) return HAL_ERROR;
+    if (!Fmp_Claim(FMP_BLOCKING)) return HAL_BUSY;
+
+    uint32_t tickstart = HAL_GetTick();
+    HAL_StatusTypeDef status = HAL_OK;
+
+    FMPI2C1->CR2 = dev_addr | ((uint32_t)len << FMPI2C_CR2_NBYTES_Pos) | FMPI2C_CR2_AUTOEND | FMPI2C_CR2_START;
+    for (uint16_t i = 0; i < len && status == HAL_OK; i++) {
+        status = Fmp_Wait(FMPI2C_ISR_TXIS, tickstart, timeout_ms);
+        if (status == HAL_OK) FMPI2C1->TXDR = data[i];
+    }
+    return Fmp_Finish(status, tickstart, timeout_ms);
+}
+
+/* Blocking register read: pointer write, repeated START, len bytes, STOP */
+HAL_StatusTypeDef fmpi2c_mem_read(uint8_t dev_addr, uint8_t reg, uint8_t* data, uint16_t len, uint32_t timeout_ms)
+{
+    if (data == NULL || len == 0 || len > FMP_MAX_NBYTES) return HAL_ERROR;
+    if (!Fmp_Claim(FMP_BLOCKING)) return HAL_BUSY;
+
+    uint32_t tickstart = HAL_GetTick();
+    HAL_StatusTypeDef status;
+
+    FMPI2C1->CR2 = dev_addr | (1U << FMPI2C_CR2_NBYTES_Pos) | FMPI2C_CR2_START;
+    status = Fmp_Wait(FMPI2C_ISR_TXIS, tickstart, timeout_ms);
+    if (status == HAL_OK) {
+        FMPI2C1->TXDR = reg;
+        status = Fmp_Wait(FMPI2C_ISR_TC, tickstart, timeout_ms);
+    }
+    if (status == HAL_OK) {
+        FMPI2C1->CR2 = dev_addr | FMPI2C_CR2_RD_WRN | ((uint32_t)len << FMPI2C_CR2_NBYTES_Pos) | FMPI2C_CR2_AUTOEND | FMPI2C_CR2_START;
+        for (uint16_t i = 0; i < len && status == HAL_OK; i++) {
+            status = Fmp_Wait(FMPI2C_ISR_RXNE, tickstart, timeout_ms);
+            if (status == HAL_OK) data[i] = (uint8_t)FMPI2C1->RXDR;
+        }
+    }
+    return Fmp_Finish(status, tickstart, timeout_ms);
+}
+
+/* Start an interrupt-driven register read, the outcome is reported by one of the callbacks */
+HAL_StatusTypeDef fmpi2c_mem_read_it(uint8_t dev_addr, uint8_t reg, uint8_t* data, uint16_t len)
+{
+    if (data == NULL || len == 0 || len > FMP_MAX_NBYTES) return HAL_ERROR;
+    if (!Fmp_Claim(FMP_IT)) return HAL_BUSY;
+
+    it_addr = dev_addr;
+    it_reg = reg;
+    it_buf = data;
+    it_len = len;
+    it_count = 0;
+    it_failed = 0;
+
+    FMPI2C1->CR1 |= FMP_IT_MASK;
+    FMPI2C1->CR2 = dev_addr | (1U << FMPI2C_CR2_NBYTES_Pos) | FMPI2C_CR2_START;
+    return HAL_OK;
+}
+
+/*
+ * Event interrupt: TXIS sends the register pointer, TC turns the transfer
+ * around with a repeated START, RXNE stores the data and STOPF ends it.
+ */
+void fmpi2c_ev_irq_handler(void)
+{
+    uint32_t isr = FMPI2C1->ISR;
+    if (fmp_state != FMP_IT) return;
+
+    if (isr & FMPI2C_ISR_NACKF) {
+        // Address or pointer not acknowledged: finish with a STOP, reported at STOPF
+        FMPI2C1->ICR = FMPI2C_ICR_NACKCF;
+        it_failed = 1;
+        if (!(FMPI2C1->CR2 & FMPI2C_CR2_AUTOEND)) FMPI2C1->CR2 |= FMPI2C_CR2_STOP;
+        FMPI2C1->ISR |= FMPI2C_ISR_TXE;     // Flush TXDR
+    } else {
+        if (isr & FMPI2C_ISR_TXIS) FMPI2C1->TXDR = it_reg;
+        if (isr & FMPI2C_ISR_TC) {
+            FMPI2C1->CR2 = it_addr | FMPI2C_CR2_RD_WRN | ((uint32_t)it_len << FMPI2C_CR2_NBYTES_Pos) | FMPI2C_CR2_AUTOEND | FMPI2C_CR2_START;
+        }
+        if (isr & FMPI2C_ISR_RXNE) {
+            uint8_t byte = (uint8_t)FMPI2C1->RXDR;
+            if (it_count < it_len) it_buf[it_count++] = byte;
+        }
+    }
+
+    if (isr & FMPI2C_ISR_STOPF) {
+        FMPI2C1->ICR = FMPI2C_ICR_STOPCF;
+        Fmp_EndIt(!it_failed && it_count == it_len);
+    }
+}
+
+/* Error interrupt: bus error, arbitration loss or overrun ends the transfer right away */
+void fmpi2c_er_irq_handler(void)
+{
+    uint32_t isr = FMPI2C1->ISR;
+    FMPI2C1->ICR = FMPI2C_ICR_BERRCF | FMPI2C_ICR_ARLOCF | FMPI2C_ICR_OVRCF;
+
+    if (fmp_state != FMP_IT || !(isr & (FMPI2C_ISR_BERR | FMPI2C_ISR_ARLO | FMPI2C_ISR_OVR))) return;
+
+    Fmp_Reset();
+    Fmp_EndIt(0);
+}
+
+__weak void fmpi2c_mem_read_cplt_callback(void)
+{
+}
+
+__weak void fmpi2c_error_callback(void)
+{
+}
+
+/*
+ * Compute TIMINGR for speed_hz from a kernel clock of clk_hz.
+ *
+ * An SCL period is tSCLL + tSCLH plus the edge synchronisation (rise and
+ * fall times, analog filter delay and a few kernel clocks per edge). The
+ * spec minimums for tLOW and tHIGH are taken first; time left over in the
+ * requested period is shared between them in the same ratio. If the
+ * minimums do not fit the period is stretched, never shortened below them.
+ */
+static uint8_t Fmp_Timing(uint32_t clk_hz, uint32_t speed_hz, uint32_t* timingr, uint32_t* scl_hz)
+{
+    const FmpMode_t* mode = &fmp_modes[FMP_NUM_MODES - 1];
+    for (uint8_t i = 0; i < FMP_NUM_MODES; i++) {
+        if (speed_hz <= fmp_modes[i].max_hz) {
+            mode = &fmp_modes[i];
+            break;
+        }
+    }
+
+    // All in kernel clock cycles
+    uint32_t period = clk_hz / speed_hz;
+    uint32_t sync = Ns_To_Clk(clk_hz, FMPI2C_RISE_TIME_NS + FMPI2C_FALL_TIME_NS + 2 * FMP_FILTER_NS) + 2 * FMP_SYNC_CLKS;
+    uint32_t low = Ns_To_Clk(clk_hz, mode->low_ns);
+    uint32_t high = Ns_To_Clk(clk_hz, mode->high_ns);
+    uint32_t scldel = Ns_To_Clk(clk_hz, FMPI2C_RISE_TIME_NS + mode->su_dat_ns);
+    uint32_t sdadel = (FMPI2C_FALL_TIME_NS > FMP_FILTER_NS) ? Ns_To_Clk(clk_hz, FMPI2C_FALL_TIME_NS - FMP_FILTER_NS) : 0;
+
+    if (period > low + high + sync) {
+        uint32_t avail = period - sync;
+        uint32_t min_sum = low + high;
+        low = (uint32_t)((uint64_t)avail * low / min_sum);
+        high = avail - low;
+    }
+    if (scldel == 0) scldel = 1;
+
+    // Smallest prescaler where every field fits: SCLL/SCLH 8 bits, SCLDEL/SDADEL 4 bits
+    for (uint32_t presc = 0; presc < 16; presc++) {
+        uint32_t div = presc + 1;
+        uint32_t scll = (low + div - 1) / div;
+        uint32_t sclh = (high + div - 1) / div;
+        uint32_t del = (scldel + div - 1) / div;
+        uint32_t sda = (sdadel + div - 1) / div;
+
+        if (scll <= 256 && sclh <= 256 && del <= 16 && sda <= 15) {
+            *timingr = (presc << FMPI2C_TIMINGR_PRESC_Pos) | ((del - 1) << FMPI2C_TIMINGR_SCLDEL_Pos) |
+                       (sda << FMPI2C_TIMINGR_SDADEL_Pos) | ((sclh - 1) << FMPI2C_TIMINGR_SCLH_Pos) |
+                       ((scll - 1) << FMPI2C_TIMINGR_SCLL_Pos);
+            *scl_hz = clk_hz / ((scll + sclh) * div + sync);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Nanoseconds to kernel clock cycles, rounded up */
+static uint32_t Ns_To_Clk(uint32_t clk_hz, uint32_t ns)
+{
+    return (uint32_t)(((uint64_t)ns * clk_hz + 999999999U) / 1000000000U);
+}
+
+/* Take the peripheral for one transfer; a sweep may start from an ISR, so the test-and-set is masked */
+static uint8_t Fmp_Claim(FmpState_t state)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (fmp_state != FMP_IDLE) {
+        __set_PRIMASK(primask);
+        return 0;
+    }
+    fmp_state = state;
+    __set_PRIMASK(primask);
+    return 1;
+}
+
+/* Poll for flag, HAL_ERROR on NACK */
+static HAL_StatusTypeDef Fmp_Wait(uint32_t flag, uint32_t tickstart, uint32_t timeout_ms)
+{
+    while (!(FMPI2C1->ISR & flag)) {
+        if (FMPI2C1->ISR & FMPI2C_ISR_NACKF) return HAL_ERROR;
+        if (HAL_GetTick() - tickstart > timeout_ms) return HAL_TIMEOUT;
+    }
+    return HAL_OK;
+}
+
+/* End a blocking transfer: wait for its STOP (sending one after a NACK if needed) and release the peripheral */
+static HAL_StatusTypeDef Fmp_Finish(HAL_StatusTypeDef status, uint32_t tickstart, uint32_t timeout_ms)
+{
+    if (status == HAL_ERROR && !(FMPI2C1->CR2 & FMPI2C_CR2_AUTOEND)) FMPI2C1->CR2 |= FMPI2C_CR2_STOP;
+
+    if (status != HAL_TIMEOUT) {
+        while (!(FMPI2C1->ISR & FMPI2C_ISR_STOPF)) {
+            if (HAL_GetTick() - tickstart > timeout_ms) {
+                status = HAL_TIMEOUT;
+                break;
+            }
+        }
+    }
+    if (status == HAL_TIMEOUT) Fmp_Reset();    // A stuck transfer is cut off by the peripheral reset
+
+    FMPI2C1->ICR = FMPI2C_ICR_STOPCF | FMPI2C_ICR_NACKCF;
+    FMPI2C1->ISR |= FMPI2C_ISR_TXE;
+    FMPI2C1->CR2 = 0;
+    fmp_state = FMP_IDLE;
+    return status;
+}
+
+/* Software reset: clearing PE releases SCL/SDA and clears the state machine and flags */
+static void Fmp_Reset(void)
+{
+    FMPI2C1->CR1 &= ~FMPI2C_CR1_PE;
+    (void)FMPI2C1->CR1;                         // PE must stay low for 3 APB clocks
+    (void)FMPI2C1->CR1;
+    (void)FMPI2C1->CR1;
+    FMPI2C1->CR1 |= FMPI2C_CR1_PE;
+}
+
+/* Release the peripheral after an interrupt-driven read and report it */
+static void Fmp_EndIt(uint8_t ok)
+{
+    FMPI2C1->CR1 &= ~FMP_IT_MASK;
+    FMPI2C1->CR2 = 0;
+    fmp_state = FMP_IDLE;
+
+    if (ok) fmpi2c_mem_read_cplt_callback();
+    else fmpi2c_error_callback();
+}
@@ -0,0 +1,113 @@
+/*
+ * i2c_bus.c
+ *
+ * Sensor bus transport: routes the INA228 transfers to I2C1 or FMPI2C1 and
+ * funnels both ports' completion interrupts into i2c_bus_read_callback().
+ */
+
+#include "i2c_bus.h"
+#include "fmpi2c.h"
+
+static uint8_t bus_port = I2C_BUS_I2C1;     // MX_I2C1_Init() has already brought up I2C1
+static uint32_t bus_speed_hz = 0;           // Requested FMPI2C1 speed, I2C1 keeps its own in hi2c1.Init
+
+/* Local Prototypes */
+static HAL_StatusTypeDef Bus_Start(uint8_t port, uint32_t speed_hz);
+
+/* Select the port and speed; the other port is shut down */
+HAL_StatusTypeDef i2c_bus_init(uint8_t port, uint32_t speed_hz) {
+    if (port != I2C_BUS_I2C1 && port != I2C_BUS_FMPI2C1) return HAL_ERROR;
+
+    uint32_t max_hz = (port == I2C_BUS_FMPI2C1) ? I2C_BUS_FMPI2C1_MAX_HZ : I2C_BUS_I2C1_MAX_HZ;
+    if (speed_hz == 0 || speed_hz > max_hz) return HAL_ERROR;
+
+    if (port != bus_port) i2c_bus_suspend();
+    return Bus_Start(port, speed_hz);
+}
+
+/* Change the speed of the current port. Masked, so a sweep started from an ISR cannot slip in. */
+HAL_StatusTypeDef i2c_bus_set_speed(uint32_t speed_hz) {
+    uint32_t max_hz = (bus_port == I2C_BUS_FMPI2C1) ? I2C_BUS_FMPI2C1_MAX_HZ : I2C_BUS_I2C1_MAX_HZ;
+    if (speed_hz == 0 || speed_hz > max_hz) return HAL_ERROR;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    HAL_StatusTypeDef status = i2c_bus_busy() ? HAL_BUSY : Bus_Start(bus_port, speed_hz);
+    __set_PRIMASK(primask);
+    return status;
+}
+
+uint32_t i2c_bus_speed(void) {
+    return (bus_port == I2C_BUS_FMPI2C1) ? fmpi2c_speed() : hi2c1.Init.ClockSpeed;
+}
+
+uint8_t i2c_bus_port(void) {
+    return bus_port;
+}
+
+uint8_t i2c_bus_busy(void) {
+    if (bus_port == I2C_BUS_FMPI2C1) return fmpi2c_busy();
+    return HAL_I2C_GetState(&hi2c1) != HAL_I2C_STATE_READY;
+}
+
+/* Blocking write, data[0] is the register pointer */
+HAL_StatusTypeDef i2c_bus_write(uint8_t dev_addr, const uint8_t* data, uint16_t len, uint32_t timeout_ms) {
+    if (bus_port == I2C_BUS_FMPI2C1) return fmpi2c_transmit(dev_addr, data, len, timeout_ms);
+    return HAL_I2C_Master_Transmit(&hi2c1, dev_addr, (uint8_t*)data, len, timeout_ms);
+}
+
+/* Blocking register read */
+HAL_StatusTypeDef i2c_bus_mem_read(uint8_t dev_addr, uint8_t reg, uint8_t* data, uint16_t len, uint32_t timeout_ms) {
+    if (bus_port == I2C_BUS_FMPI2C1) return fmpi2c_mem_read(dev_addr, reg, data, len, timeout_ms);
+    return HAL_I2C_Mem_Read(&hi2c1, dev_addr, reg, I2C_MEMADD_SIZE_8BIT, data, len, timeout_ms);
+}
+
+/* Start a non-blocking register read, finished in i2c_bus_read_callback() */
+HAL_StatusTypeDef i2c_bus_mem_read_it(uint8_t dev_addr, uint8_t reg, uint8_t* data, uint16_t len) {
+    if (bus_port == I2C_BUS_FMPI2C1) return fmpi2c_mem_read_it(dev_addr, reg, data, len);
+    return HAL_I2C_Mem_Read_IT(&hi2c1, dev_addr, reg, I2C_MEMADD_SIZE_8BIT, data, len);
+}
+
+/* De-init also disables the port's interrupts, so no callback can race with the caller's cleanup */
+void i2c_bus_suspend(void) {
+    if (bus_port == I2C_BUS_FMPI2C1) fmpi2c_deinit();
+    else HAL_I2C_DeInit(&hi2c1);
+}
+
+void i2c_bus_resume(void) {
+    if (bus_port == I2C_BUS_FMPI2C1) fmpi2c_init(bus_speed_hz);
+    else HAL_I2C_Init(&hi2c1);
+}
+
+static HAL_StatusTypeDef Bus_Start(uint8_t port, uint32_t speed_hz) {
+    bus_port = port;
+    if (port == I2C_BUS_FMPI2C1) {
+        bus_speed_hz = speed_hz;
+        return fmpi2c_init(speed_hz);
+    }
+    hi2c1.Init.ClockSpeed = speed_hz;
+    return HAL_I2C_Init(&hi2c1);
+}
+
+/* Default completion hook, overridden by the acquisition engine */
+__weak void i2c_bus_read_callback(HAL_StatusTypeDef status) {
+    UNUSED(status);
+}
+
+/* HAL callback: I2C1 register read finished */
+void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef *hi2c) {
+    if (hi2c->Instance == I2C1) i2c_bus_read_callback(HAL_OK);
+}
+
+/* HAL callback: I2C1 NACK, bus error or arbitration loss */
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c) {
+    if (hi2c->Instance == I2C1) i2c_bus_read_callback(HAL_ERROR);
+}
+
+void fmpi2c_mem_read_cplt_callback(void) {
+    i2c_bus_read_callback(HAL_OK);
+}
+
+void fmpi2c_error_callback(void) {
+    i2c_bus_read_callback(HAL_ERROR);
+}
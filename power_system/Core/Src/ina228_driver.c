@@ -13,13 +13,113 @@
 // NOTE: INA228 sends data in big-endian (MSB = lowest mem address), but STM32 stores data in little-endian (LSB = lowest mem address)
 // Must manually shift/ control byte order to account for different platform endianness
 
+/* Reconstruct a 16-bit register (CONFIG, DIAG_ALRT, ...) from its raw bytes */
+uint16_t INA228_Decode16bit(const uint8_t* data) {
+    return ((uint16_t)data[0] << 8) | data[1];
+}
+
+/* Reconstruct a signed 20-bit register (VSHUNT, VBUS, CURRENT) from its raw bytes */
+int32_t INA228_Decode20bit(const uint8_t* data) {
+    // Reconstruct 24-bit value
+    int32_t value = ((int32_t)data[0] << 16) | ((int32_t)data[1] << 8) | data[2];
+
+    // INA228 voltage/current registers use bits [23:4] for 20-bit data, bits [3:0] are reserved (always read 0)
+    // Shift right by 4 to get the actual 20-bit data
+    value >>= 4;
+
+    // Current and shunt registers are signed using 2's complement
+    if (value & 0x00080000) {  // Check bit 19 (sign bit of 20-bit value where 1=negative, 0=positive)
+        value |= 0xFFF00000;   // Extend from 20-bit to 32-bit by filling upper bits with 1s (indicate negative number)
+    }
+    return value;
+}
+
+/* Reconstruct an unsigned 24-bit register (POWER) from its raw bytes */
+uint32_t INA228_Decode24bit(const uint8_t* data) {
+    // POWER register uses all 24 bits/ has no reserved bits
+    return ((uint32_t)data[0] << 16) | ((uint32_t)data[1] << 8) | data[2];
+}
+
+/* Reconstruct the unsigned 40-bit ENERGY register from its raw bytes */
+uint64_t INA228_Decode40bit(const uint8_t* data) {
+    return ((uint64_t)data[0] << 32) | ((uint64_t)data[1] << 24) | ((uint64_t)data[2] << 16) | ((uint64_t)data[3] << 8) | data[4];
+}
+
+/* Reconstruct the signed 40-bit CHARGE register from its raw bytes */
+int64_t INA228_Decode40bitSigned(const uint8_t* data) {
+    uint64_t value = INA228_Decode40bit(data);
+
+    // Bit 39 is the sign bit, extend it through the upper 24 bits
+    if (value & (1ULL << 39)) {
+        value |= 0xFFFFFF0000000000ULL;
+    }
+    return (int64_t)value;
+}
+
+/* Decode ENERGY or CHARGE into accum, returns 0 for any other register */
+uint8_t INA228_DecodeAccumulator(uint8_t reg, const uint8_t* data, INA228_RawAccum_t* accum) {
+    switch (reg) {
+        case INA228_REG_ENERGY: accum->energy = INA228_Decode40bit(data); break;
+        case INA228_REG_CHARGE: accum->charge = INA228_Decode40bitSigned(data); break;
+        default: return 0;
+    }
+    return 1;
+}
+
+/* Measurement block read by INA228_ReadAll, in transfer order.
+ * The INA228 register pointer does not auto-increment, so each register is its own
+ * transfer. VBUS and CURRENT go back to back so both come from the same conversion. */
+static const struct {
+    uint8_t reg;
+    uint8_t len;
+} INA228_MeasBlock[] = {
+    { INA228_REG_VBUS,    3 },
+    { INA228_REG_CURRENT, 3 },
+    { INA228_REG_POWER,   3 },
+    { INA228_REG_VSHUNT,  3 },
+    { INA228_REG_DIETEMP, 2 },
+};
+
+/* Decode one register of the measurement block into raw, returns 0 if reg is not part of the block */
+uint8_t INA228_DecodeMeasurement(uint8_t reg, const uint8_t* data, INA228_RawMeasurement_t* raw) {
+    switch (reg) {
+        case INA228_REG_VSHUNT:  raw->vshunt  = INA228_Decode20bit(data); break;
+        case INA228_REG_VBUS:    raw->vbus    = INA228_Decode20bit(data); break;
+        case INA228_REG_DIETEMP: raw->dietemp = (int16_t)INA228_Decode16bit(data); break;
+        case INA228_REG_CURRENT: raw->current = INA228_Decode20bit(data); break;
+        case INA228_REG_POWER:   raw->power   = INA228_Decode24bit(data); break;
+        default: return 0;
+    }
+    return 1;
+}
+
+/* Convert raw codes to engineering units */
+void INA228_ScaleMeasurement(const INA228_RawMeasurement_t* raw, float current_LSB, float power_LSB, INA228_Measurement_t* meas) {
+    meas->shunt_voltage = (float)raw->vshunt * INA228_VSHUNT_LSB;   	// Convert to volts
+    meas->voltage       = (float)raw->vbus * INA228_VBUS_LSB;       	// Convert to volts
+    meas->temperature   = (float)raw->dietemp * INA228_DIETEMP_LSB; 	// Convert to °C
+    meas->current       = (float)raw->current * current_LSB;        	// Convert to amps
+    meas->power         = (float)raw->power * power_LSB;            	// Convert to watts
+}
+
+/* ADC_CONFIG CT/AVG fields and averaged result period of each profile (conversion times summed x averages) */
+static const struct {
+    uint16_t adc_config;
+    uint32_t result_us;
+    const char* name;
+} adc_profiles[INA228_NUM_PROFILES] = {
+    [INA228_PROFILE_FAST]      = { INA228_ADC_VBUSCT_150us  | INA228_ADC_VSHCT_150us  | INA228_ADC_VTCT_50us   | INA228_ADC_AVG_4,  (150 + 150 + 50) * 4,      "FAST" },
+    [INA228_PROFILE_BALANCED]  = { INA228_ADC_VBUSCT_540us  | INA228_ADC_VSHCT_540us  | INA228_ADC_VTCT_150us  | INA228_ADC_AVG_16, (540 + 540 + 150) * 16,    "BALANCED" },
+    [INA228_PROFILE_LOW_NOISE] = { INA228_ADC_VBUSCT_1052us | INA228_ADC_VSHCT_1052us | INA228_ADC_VTCT_1052us | INA228_ADC_AVG_64, (1052 + 1052 + 1052) * 64, "LOW_NOISE" },
+};
+
 /* Helper function to write 16-bit register */
 static HAL_StatusTypeDef INA228_WriteRegister16(uint8_t device_addr, uint8_t reg, uint16_t value) {
     uint8_t data[3];
     data[0] = reg;					// INA228 register address
     data[1] = (value >> 8) & 0xFF;  // MSB first
     data[2] = value & 0xFF;			// LSB
-    return HAL_I2C_Master_Transmit(&hi2c1, device_addr, data, 3, INA228_I2C_TIMEOUT);
+    return i2c_bus_write(device_addr, data, 3, INA228_I2C_TIMEOUT);
 }
 
 /* Helper function to read 16-bit register */
@@ -29,10 +129,9 @@ static HAL_StatusTypeDef INA228_ReadRegister16(uint8_t device_addr, uint8_t reg,
     uint8_t data[2];
     HAL_StatusTypeDef status;
 
-    status = HAL_I2C_Mem_Read(&hi2c1, device_addr, reg, I2C_MEMADD_SIZE_8BIT, data, 2, INA228_I2C_TIMEOUT);
+    status = i2c_bus_mem_read(device_addr, reg, data, 2, INA228_I2C_TIMEOUT);
     if (status == HAL_OK) {
-    	// Reconstruct 16-bit value
-        *value = ((uint16_t)data[0] << 8) | data[1];
+        *value = INA228_Decode16bit(data);
     }
     return status;
 }
@@ -44,19 +143,9 @@ static HAL_StatusTypeDef INA228_ReadRegister24_20bit(uint8_t device_addr, uint8_
     uint8_t data[3];
     HAL_StatusTypeDef status;
 
-    status = HAL_I2C_Mem_Read(&hi2c1, device_addr, reg, I2C_MEMADD_SIZE_8BIT, data, 3, INA228_I2C_TIMEOUT);
+    status = i2c_bus_mem_read(device_addr, reg, data, 3, INA228_I2C_TIMEOUT);
     if (status == HAL_OK) {
-        // Reconstruct 24-bit value
-        *value = ((int32_t)data[0] << 16) | ((int32_t)data[1] << 8) | data[2];
-
-        // INA228 voltage/current registers use bits [23:4] for 20-bit data, bits [3:0] are reserved (always read 0)
-        // Shift right by 4 to get the actual 20-bit data
-        *value >>= 4;
-
-        // Current and shunt registers are signed using 2's complement
-        if (*value & 0x00080000) {  // Check bit 19 (sign bit of 20-bit value where 1=negative, 0=positive)
-            *value |= 0xFFF00000;   // Extend from 20-bit to 32-bit by filling upper bits with 1s (indicate negative number)
-        }
+        *value = INA228_Decode20bit(data);
     }
     return status;
 }
@@ -68,10 +157,9 @@ static HAL_StatusTypeDef INA228_ReadRegister24_Full(uint8_t device_addr, uint8_t
     uint8_t data[3];
     HAL_StatusTypeDef status;
 
-    status = HAL_I2C_Mem_Read(&hi2c1, device_addr, reg, I2C_MEMADD_SIZE_8BIT, data, 3, INA228_I2C_TIMEOUT);
+    status = i2c_bus_mem_read(device_addr, reg, data, 3, INA228_I2C_TIMEOUT);
     if (status == HAL_OK) {
-        // Reconstruct full 24-bit value (POWER register uses all 24 bits/ has no reserved bits)
-        *value = ((uint32_t)data[0] << 16) | ((uint32_t)data[1] << 8) | data[2];
+        *value = INA228_Decode24bit(data);
     }
     return status;
 }
@@ -102,7 +190,7 @@ HAL_StatusTypeDef INA228_Init(uint8_t device_addr, float current_LSB, float shun
     if (status != HAL_OK) return status;
 
     // Configure ADC
-    adc_config_value = INA228_ADC_MODE_CONT_ALL | INA228_ADC_VBUSCT_1052us | INA228_ADC_VSHCT_1052us | INA228_ADC_VTCT_1052us | INA228_ADC_AVG_64;
+    adc_config_value = INA228_ProfileAdcConfig(INA228_PROFILE_LOW_NOISE);
     status = INA228_WriteRegister16(device_addr, INA228_REG_ADC_CONFIG, adc_config_value);
     if (status != HAL_OK) return status;
 
@@ -162,6 +250,24 @@ HAL_StatusTypeDef INA228_ReadPower(uint8_t device_addr, float* power, float powe
     return status;
 }
 
+/* Read the whole measurement block (VSHUNT, VBUS, DIETEMP, CURRENT, POWER) back to back */
+HAL_StatusTypeDef INA228_ReadAll(uint8_t device_addr, float current_LSB, float power_LSB, INA228_Measurement_t* meas) {
+    if (meas == NULL) return HAL_ERROR;
+
+    INA228_RawMeasurement_t raw = {0};
+    uint8_t data[3];
+    HAL_StatusTypeDef status;
+
+    for (uint8_t i = 0; i < sizeof(INA228_MeasBlock) / sizeof(INA228_MeasBlock[0]); i++) {
+        status = i2c_bus_mem_read(device_addr, INA228_MeasBlock[i].reg, data, INA228_MeasBlock[i].len, INA228_I2C_TIMEOUT);
+        if (status != HAL_OK) return status;
+        INA228_DecodeMeasurement(INA228_MeasBlock[i].reg, data, &raw);
+    }
+
+    INA228_ScaleMeasurement(&raw, current_LSB, power_LSB, meas);
+    return HAL_OK;
+}
+
 /* Check sensor health */
 HAL_StatusTypeDef INA228_CheckHealth(uint8_t device_addr, uint8_t* healthy) {
 	if (healthy == NULL) return HAL_ERROR;
@@ -172,7 +278,7 @@ HAL_StatusTypeDef INA228_CheckHealth(uint8_t device_addr, uint8_t* healthy) {
     status = INA228_ReadRegister16(device_addr, INA228_REG_DIAG_ALRT, &diag_alert);
 
     // Check MEMSTAT bit (bit 0) - should always be 1 for normal operation
-	if (status == HAL_OK && (diag_alert & 0x0001)) {
+	if (status == HAL_OK && (diag_alert & INA228_DIAG_MEMSTAT)) {
 		*healthy = 1;
 	} else {
 		*healthy = 0;
@@ -205,4 +311,63 @@ HAL_StatusTypeDef INA228_ConfigureAlerts(uint8_t device_addr, float shunt_resist
     return status;
 }
 
+/* Configure ALERT pin behaviour (latching, polarity, conversion ready, averaged compare) */
+HAL_StatusTypeDef INA228_ConfigureAlertPin(uint8_t device_addr, uint16_t alert_config) {
+    // Only bits [15:12] are writable, the remaining DIAG_ALRT bits are read-only status flags
+    return INA228_WriteRegister16(device_addr, INA228_REG_DIAG_ALRT, alert_config & 0xF000);
+}
+
+/* Read the ENERGY and CHARGE accumulators */
+HAL_StatusTypeDef INA228_ReadAccumulators(uint8_t device_addr, INA228_RawAccum_t* accum) {
+    if (accum == NULL) return HAL_ERROR;
+
+    uint8_t data[5];
+    HAL_StatusTypeDef status;
+
+    status = i2c_bus_mem_read(device_addr, INA228_REG_ENERGY, data, 5, INA228_I2C_TIMEOUT);
+    if (status != HAL_OK) return status;
+    INA228_DecodeAccumulator(INA228_REG_ENERGY, data, accum);
+
+    status = i2c_bus_mem_read(device_addr, INA228_REG_CHARGE, data, 5, INA228_I2C_TIMEOUT);
+    if (status != HAL_OK) return status;
+    INA228_DecodeAccumulator(INA228_REG_CHARGE, data, accum);
+
+    return HAL_OK;
+}
+
+/* Clear ENERGY and CHARGE; RSTACC self-clears, the rest of CONFIG is written back unchanged */
+HAL_StatusTypeDef INA228_ResetAccumulators(uint8_t device_addr) {
+    uint16_t config;
+    HAL_StatusTypeDef status;
+
+    status = INA228_ReadRegister16(device_addr, INA228_REG_CONFIG, &config);
+    if (status != HAL_OK) return status;
+
+    return INA228_WriteRegister16(device_addr, INA228_REG_CONFIG, (config & ~INA228_CONFIG_RST) | INA228_CONFIG_RSTACC);
+}
+
+/* Switch the ADC conversion times and averaging, the sensor restarts its averaging window */
+HAL_StatusTypeDef INA228_SetAdcProfile(uint8_t device_addr, INA228_AdcProfile_t profile) {
+    if (profile >= INA228_NUM_PROFILES) return HAL_ERROR;
+    return INA228_WriteRegister16(device_addr, INA228_REG_ADC_CONFIG, INA228_ProfileAdcConfig(profile));
+}
 
+uint16_t INA228_ProfileAdcConfig(INA228_AdcProfile_t profile) {
+    if (profile >= INA228_NUM_PROFILES) profile = INA228_PROFILE_LOW_NOISE;
+    return INA228_ADC_MODE_CONT_ALL | adc_profiles[profile].adc_config;
+}
+
+uint32_t INA228_ProfileResultUs(INA228_AdcProfile_t profile) {
+    return (profile < INA228_NUM_PROFILES) ? adc_profiles[profile].result_us : 0;
+}
+
+const char* INA228_ProfileName(INA228_AdcProfile_t profile) {
+    return (profile < INA228_NUM_PROFILES) ? adc_profiles[profile].name : "?";
+}
+
+/* Start a non-blocking register read, completion is reported through i2c_bus_read_callback */
+HAL_StatusTypeDef INA228_ReadRegister_IT(uint8_t device_addr, uint8_t reg, uint8_t* data, uint16_t len) {
+    if (data == NULL) return HAL_ERROR;
+
+    return i2c_bus_mem_read_it(device_addr, reg, data, len);
+}
@@ -0,0 +1,93 @@
+/*
+ * log_frame.c
+ *
+ * CRC-16 and COBS framing for the binary UART data link (see log_frame.h
+ * for the frame layouts).
+ */
+
+#include "log_frame.h"
+
+/* CRC-16/CCITT-FALSE, bitwise (frames are short, so no table is kept in flash) */
+uint16_t log_crc16(const uint8_t* data, uint16_t len)
+{
+    uint16_t crc = 0xFFFF;
+
+    for (uint16_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (uint8_t bit = 0; bit < 8; bit++)
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+    }
+    return crc;
+}
+
+/**
+  * @brief Append the CRC to a payload, COBS-encode both and terminate with 0x00
+  * @param out: Must hold LOG_FRAME_MAX_ENCODED bytes
+  * @retval Number of bytes written to out
+  */
+uint16_t log_frame_encode(const uint8_t* payload, uint16_t len, uint8_t* out)
+{
+    uint16_t crc = log_crc16(payload, len);
+    uint8_t crc_bytes[2] = { (uint8_t)(crc & 0xFF), (uint8_t)(crc >> 8) };
+
+    uint16_t code_idx = 0;      // Where the current block's code byte goes
+    uint16_t o = 1;
+    uint8_t code = 1;
+
+    for (uint16_t i = 0; i < len + 2; i++) {
+        uint8_t b = (i < len) ? payload[i] : crc_bytes[i - len];
+
+        if (b == 0) {
+            out[code_idx] = code;
+            code_idx = o++;
+            code = 1;
+        } else {
+            out[o++] = b;
+            if (++code == 0xFF) {   // Block full: 254 data bytes without a zero
+                out[code_idx] = code;
+                code_idx = o++;
+                code = 1;
+            }
+        }
+    }
+
+    out[code_idx] = code;
+    out[o++] = 0x00;
+    return o;
+}
+
+// Code widths in LOG_FIELD_* bit order
+static const uint8_t field_bits[] = { 20, 20, 24, 16, 20 };
+
+uint8_t log_sample_size(uint8_t fields)
+{
+    uint8_t bits = 0;
+
+    for (uint8_t f = 0; f < sizeof(field_bits); f++)
+        if (fields & (1U << f)) bits += field_bits[f];
+    return (uint8_t)((bits + 7) / 8);
+}
+
+/* Pack the selected raw codes into a little-endian bit string (VBUS, CURRENT and POWER alone make 8 bytes) */
+uint8_t log_pack_sample(const INA228_RawMeasurement_t* raw, uint8_t fields, uint8_t* out)
+{
+    const uint32_t codes[] = {
+        (uint32_t)raw->vbus, (uint32_t)raw->current, raw->power, (uint32_t)(uint16_t)raw->dietemp, (uint32_t)raw->vshunt
+    };
+    uint32_t acc = 0;       // Bits not written yet, never more than 7 + 24
+    uint8_t acc_bits = 0;
+    uint8_t n = 0;
+
+    for (uint8_t f = 0; f < sizeof(field_bits); f++) {
+        if (!(fields & (1U << f))) continue;
+        acc |= (codes[f] & ((1UL << field_bits[f]) - 1)) << acc_bits;
+        acc_bits += field_bits[f];
+        while (acc_bits >= 8) {
+            out[n++] = (uint8_t)acc;
+            acc >>= 8;
+            acc_bits -= 8;
+        }
+    }
+    if (acc_bits) out[n++] = (uint8_t)acc;
+    return n;
+}
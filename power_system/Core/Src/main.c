@@ -6,56 +6,94 @@
   *
   * Application entry point for the exoskeleton power architecture firmware.
   * 
-  * Initializes all STM32 peripherals (GPIO, USART2, I2C1, CAN1), then runs
-  * three concurrent tasks in the main loop:
+  * Initializes all STM32 peripherals (GPIO, USART2, I2C1 or FMPI2C1, CAN1), then hands
+  * the main context to the cooperative scheduler, which runs these tasks and
+  * sleeps in WFI whenever none of them is ready:
   * 
   *   1. Precharge FSM — manages contactor/relay sequencing and fault detection.
-  *   2. CAN telemetry — broadcasts INA228 sensor data to the dashboard every 100 ms.
-  *   3. UART data logger — on receiving a "START,<rate>,<time>" command from the
-  *      host PC, acquires bus sensor samples and streams them back as CSV for plotting by data_log.py.
+  *      Runs every 10 ms and as soon as a sensor sweep completes.
+  *   2. UART data logger — on receiving a "START,<rate>,<time>[,<sensors>[,<fields>]]"
+  *      command from the host PC, streams sweep-aligned samples of the selected sensors
+  *      back as binary frames over DMA while the other tasks keep running. A time of 0
+  *      streams until a "STOP" command.
+  *   3. CAN telemetry — broadcasts INA228 sensor data to the dashboard every 100 ms,
+  *      or only what moved past its deadband (on-change mode, the default). A state,
+  *      fault or relay change releases a status task that sends the status frame at once.
+  *   4. Energy — reads the INA228 ENERGY/CHARGE accumulators once a second and
+  *      broadcasts per-sensor Wh/Ah totals over CAN.
+  *   5. UART commands — runs when the RX interrupt completes a line. "I2C,<hz>"
+  *      changes the sensor bus speed, "ENERGY,RESET" zeroes the energy totals and
+  *      "ADC,<FAST|BALANCED|LOW_NOISE>[,<sensor>]" selects the INA228 ADC profile
+  *      and "CANTX,<PERIODIC|ONCHANGE>" the CAN telemetry transmission policy.
+  *      In builds with PROFILE_ENABLE, "STATS" reports the cycle-count probes
+  *      and "STATS,RESET" clears them.
+  *   6. CAN commands — runs when a frame on the command ID arrives in RX FIFO 0:
+  *      fault reset, telemetry rate, telemetry sensor mask, ADC profile and
+  *      snapshot request from the dashboard, each acknowledged on CAN.
+  *   7. CAN health — every 100 ms tracks the CAN1 error state and restarts the
+  *      controller after a bus-off, with backoff; once a second broadcasts the
+  *      error counters, TX results and bus load.
   * 
   ********************************************************************************************************
   */
 
 #include "main.h"
 #include "can.h"
+#include "dma.h"
 #include "i2c.h"
+#include "i2c_bus.h"
 #include "usart.h"
 #include "gpio.h"
 #include "precharge.h"
 #include "ina228_driver.h"
 #include "telemetry.h"
+#include "energy.h"
+#include "can_tx.h"
+#include "can_cmd.h"
+#include "can_health.h"
+#include "uart_logger.h"
+#include "sampler.h"
+#include "scheduler.h"
+#include "profile.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 
-#define CAN_TX_INTERVAL_MS = 100
+#define CAN_TX_INTERVAL_MS 100  // At boot, the CAN TELEMETRY_RATE command changes it
+#define FSM_INTERVAL_MS    10   // Sweeps still start every SENSOR_POLL_INTERVAL_MS, this bounds timeout recovery
+#define LOGGER_INTERVAL_MS 1
 #define RX_BUF_SIZE  64
-#define MAX_SAMPLES  2000
-
-/* Global variables (telemetry)*/
-uint32_t last_can_tx_time = 0;
 
 uint8_t uart_rx_byte;
-volatile uint8_t uart_line_ready = 0;
 
 char rx_buf[RX_BUF_SIZE];
 int  rx_index;
 
 int sampling_rate = 0;   // Hz
-int total_time = 0;      // seconds
-int num_samples = 0;
-
-float voltage_buf[MAX_SAMPLES];
-float current_buf[MAX_SAMPLES];
-float power_buf[MAX_SAMPLES];
+int total_time = 0;      // seconds, 0 = until STOP
+uint8_t log_sensor_mask = LOG_DEFAULT_SENSOR_MASK;
+uint8_t log_fields = LOG_FIELDS_DEFAULT;
 
 /* Private function prototypes */
 void SystemClock_Config(void);
 
 static int  Parse_Command(void);
-static void Acquire_Data(void);
-static void Transmit_Data(void);
+static int  Parse_I2C_Command(void);
+static int  Parse_ADC_Command(void);
+static int  Parse_CANTX_Command(void);
+static void Command_Task(void);
+
+/* Scheduler tasks, highest priority first */
+static const SchedTask_t tasks[] = {
+  { "fsm",       precharge_fsm_tick,    FSM_INTERVAL_MS,    SCHED_EV_SWEEP_DONE },
+  { "logger",    uart_logger_tick,      LOGGER_INTERVAL_MS, SCHED_EV_SWEEP_DONE },
+  { "status",    telemetry_status_task, 0,                  SCHED_EV_STATUS },
+  { "cancmd",    can_cmd_task,          0,                  SCHED_EV_CAN_CMD },
+  { "telemetry", telemetry_tick,        CAN_TX_INTERVAL_MS, 0 },
+  { "energy",    energy_tick,           ENERGY_INTERVAL_MS, 0 },
+  { "canhealth", can_health_task,       CAN_HEALTH_INTERVAL_MS, 0 },
+  { "command",   Command_Task,          0,                  SCHED_EV_UART_LINE },
+};
 
 /**
   * @brief  The application entry point.
@@ -72,50 +110,49 @@ int main(void)
 
   /* Initialize all configured peripherals */
   MX_GPIO_Init();
+  MX_DMA_Init();
   MX_USART2_UART_Init();
   MX_I2C1_Init();
   MX_CAN1_Init();
 
+  // Sensor bus port and speed (I2C1 was brought up at 400 kHz by MX_I2C1_Init)
+  if (i2c_bus_init(I2C_BUS_PORT, I2C_BUS_SPEED_HZ) != HAL_OK)
+  {
+    Error_Handler();
+  }
+
+  // Microsecond timebase (TIM2), used to stamp every sensor sweep
+  sampler_init();
+#if PROFILE_ENABLE
+  profile_init();   // DWT cycle counter for the profiling probes
+#endif
 
   // Initialize precharge FSM (also initializes all 5 INA228 sensors internally)
   precharge_control_init();
 
   // Initialize CAN telemetry
   HAL_CAN_Start(&hcan1);
+  can_tx_init();
+  can_health_init();
+  if (can_cmd_init() != HAL_OK)
+  {
+    Error_Handler();
+  }
   telemetry_init();
+  energy_init();    // Sensors are configured and idle, clear their accumulators
+
+  // UART logger: TX through the DMA pipeline, commands received one byte at a time
+  uart_logger_init();
+  HAL_UART_Receive_IT(&huart2, &uart_rx_byte, 1);
 
   // Uncomment to verify I2C communication
   //uint16_t id;
   //INA228_ReadManufacturerID(INA228_ADDR1, &id); // Should be 0x5449
   //HAL_UART_Transmit(&huart2, (uint16_t *)&id, 1, 100);
 
-  /* Main Loop */
-  while (1) {
-    // Precharge FSM tick (sensors internally polled on SENSOR_POLL_INTERVAL_MS)
-    precharge_fsm_tick();
-
-    // CAN telemetry
-    uint32_t now = HAL_GetTick();
-    if (now - last_can_tx_time >= can_tx_interval_ms) {
-        telemetry_tick();
-        last_can_tx_time = now;
-    }
-
-    // Check for UART interrupt
-    if (uart_line_ready) {
-      uart_line_ready = 0; // Clear interrupt
-
-      if (Parse_Command()) {
-        const char ok[] = "OK\n"; // Response for Python script to check
-        HAL_UART_Transmit(&huart2, (uint8_t *)ok, sizeof(ok) - 1, HAL_MAX_DELAY);
-        Acquire_Data();
-        Transmit_Data();
-      } else {
-        const char err[] = "ERR\n"; // Response for Python script to check
-        HAL_UART_Transmit(&huart2, (uint8_t *)err, sizeof(err) - 1, HAL_MAX_DELAY);
-      }
-    }
-  }
+  /* Main Loop: dispatch tasks, sleep in between */
+  sched_init(tasks, sizeof(tasks) / sizeof(tasks[0]));
+  sched_run();
 }
 
 /**
@@ -130,19 +167,38 @@ void SystemClock_Config(void)
   /** Configure the main internal regulator output voltage
   */
   __HAL_RCC_PWR_CLK_ENABLE();
+#if CLOCK_PROFILE == CLOCK_PROFILE_FULL
+  __HAL_PWR_VOLTAGESCALING_CONFIG(PWR_REGULATOR_VOLTAGE_SCALE1);   // 180 MHz needs scale 1 and over-drive
+#else
   __HAL_PWR_VOLTAGESCALING_CONFIG(PWR_REGULATOR_VOLTAGE_SCALE3);
+#endif
 
   /** Initializes the RCC Oscillators according to the specified parameters
   * in the RCC_OscInitTypeDef structure.
   */
+#if CLOCK_USE_HSE
+  RCC_OscInitStruct.OscillatorType = RCC_OSCILLATORTYPE_HSE;
+  RCC_OscInitStruct.HSEState = RCC_HSE_ON;
+  RCC_OscInitStruct.PLL.PLLSource = RCC_PLLSOURCE_HSE;
+  RCC_OscInitStruct.PLL.PLLM = HSE_VALUE / 2000000U;   // 2 MHz PLL input
+#else
   RCC_OscInitStruct.OscillatorType = RCC_OSCILLATORTYPE_HSI;
   RCC_OscInitStruct.HSIState = RCC_HSI_ON;
   RCC_OscInitStruct.HSICalibrationValue = RCC_HSICALIBRATION_DEFAULT;
-  RCC_OscInitStruct.PLL.PLLState = RCC_PLL_ON;
   RCC_OscInitStruct.PLL.PLLSource = RCC_PLLSOURCE_HSI;
-  RCC_OscInitStruct.PLL.PLLM = 16;
-  RCC_OscInitStruct.PLL.PLLN = 336;
-  RCC_OscInitStruct.PLL.PLLP = RCC_PLLP_DIV4;
+  RCC_OscInitStruct.PLL.PLLM = HSI_VALUE / 2000000U;
+#endif
+#if CLOCK_PROFILE == CLOCK_PROFILE_FULL
+  RCC_OscInitStruct.PLL.PLLState = RCC_PLL_ON;
+  RCC_OscInitStruct.PLL.PLLN = 180;                     // VCO 360 MHz
+  RCC_OscInitStruct.PLL.PLLP = RCC_PLLP_DIV2;           // 180 MHz
+#elif CLOCK_PROFILE == CLOCK_PROFILE_BALANCED
+  RCC_OscInitStruct.PLL.PLLState = RCC_PLL_ON;
+  RCC_OscInitStruct.PLL.PLLN = 168;                     // VCO 336 MHz
+  RCC_OscInitStruct.PLL.PLLP = RCC_PLLP_DIV4;           // 84 MHz
+#else
+  RCC_OscInitStruct.PLL.PLLState = RCC_PLL_OFF;
+#endif
   RCC_OscInitStruct.PLL.PLLQ = 2;
   RCC_OscInitStruct.PLL.PLLR = 2;
   if (HAL_RCC_OscConfig(&RCC_OscInitStruct) != HAL_OK)
@@ -150,16 +206,38 @@ void SystemClock_Config(void)
     Error_Handler();
   }
 
+#if CLOCK_PROFILE == CLOCK_PROFILE_FULL
+  /** Activate the Over-Drive mode
+  */
+  if (HAL_PWREx_EnableOverDrive() != HAL_OK)
+  {
+    Error_Handler();
+  }
+#endif
+
   /** Initializes the CPU, AHB and APB buses clocks
   */
   RCC_ClkInitStruct.ClockType = RCC_CLOCKTYPE_HCLK|RCC_CLOCKTYPE_SYSCLK
                               |RCC_CLOCKTYPE_PCLK1|RCC_CLOCKTYPE_PCLK2;
-  RCC_ClkInitStruct.SYSCLKSource = RCC_SYSCLKSOURCE_PLLCLK;
   RCC_ClkInitStruct.AHBCLKDivider = RCC_SYSCLK_DIV1;
+#if CLOCK_PROFILE == CLOCK_PROFILE_FULL
+  RCC_ClkInitStruct.SYSCLKSource = RCC_SYSCLKSOURCE_PLLCLK;
+  RCC_ClkInitStruct.APB1CLKDivider = RCC_HCLK_DIV4;     // APB1 max 45 MHz
+  RCC_ClkInitStruct.APB2CLKDivider = RCC_HCLK_DIV2;     // APB2 max 90 MHz
+  const uint32_t flash_latency = FLASH_LATENCY_5;
+#elif CLOCK_PROFILE == CLOCK_PROFILE_BALANCED
+  RCC_ClkInitStruct.SYSCLKSource = RCC_SYSCLKSOURCE_PLLCLK;
   RCC_ClkInitStruct.APB1CLKDivider = RCC_HCLK_DIV2;
   RCC_ClkInitStruct.APB2CLKDivider = RCC_HCLK_DIV1;
+  const uint32_t flash_latency = FLASH_LATENCY_2;
+#else
+  RCC_ClkInitStruct.SYSCLKSource = CLOCK_USE_HSE ? RCC_SYSCLKSOURCE_HSE : RCC_SYSCLKSOURCE_HSI;
+  RCC_ClkInitStruct.APB1CLKDivider = RCC_HCLK_DIV1;
+  RCC_ClkInitStruct.APB2CLKDivider = RCC_HCLK_DIV1;
+  const uint32_t flash_latency = FLASH_LATENCY_0;
+#endif
 
-  if (HAL_RCC_ClockConfig(&RCC_ClkInitStruct, FLASH_LATENCY_2) != HAL_OK)
+  if (HAL_RCC_ClockConfig(&RCC_ClkInitStruct, flash_latency) != HAL_OK)
   {
     Error_Handler();
   }
@@ -172,7 +250,7 @@ void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart) {
     if (huart->Instance == USART2) {
         if (uart_rx_byte == '\n') { 	// Detect line completion
             rx_buf[rx_index] = '\0';	// Null-terminate the string
-            uart_line_ready = 1;   		// Signal to main loop
+            sched_signal(SCHED_EV_UART_LINE); // Release the command task
             rx_index = 0;				// Reset for next line
         } else if (rx_index < RX_BUF_SIZE - 1) {
             rx_buf[rx_index++] = (char)uart_rx_byte; // Add char to buffer
@@ -181,12 +259,48 @@ void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart) {
     }
 }
 
+/* UART: handle the command line completed by the RX interrupt */
+static void Command_Task(void)
+{
+    if (strcmp(rx_buf, "STOP") == 0) {
+        uart_logger_stop(); // Ends a running capture with the END frame
+#if PROFILE_ENABLE
+    } else if (!uart_logger_active() && strcmp(rx_buf, "STATS") == 0) {
+        profile_report(uart_logger_send); // Text lines, so not while frames are streaming
+    } else if (!uart_logger_active() && strcmp(rx_buf, "STATS,RESET") == 0) {
+        profile_reset();
+        uart_logger_send("OK\n");
+#endif
+    } else if (!uart_logger_active() && strcmp(rx_buf, "ENERGY,RESET") == 0) {
+        energy_reset();
+        uart_logger_send("OK\n");
+    } else if (!uart_logger_active() && strncmp(rx_buf, "I2C,", 4) == 0) {
+        uart_logger_send(Parse_I2C_Command() ? "OK\n" : "ERR\n");
+    } else if (!uart_logger_active() && strncmp(rx_buf, "ADC,", 4) == 0) {
+        uart_logger_send(Parse_ADC_Command() ? "OK\n" : "ERR\n");
+    } else if (!uart_logger_active() && strncmp(rx_buf, "CANTX,", 6) == 0) {
+        uart_logger_send(Parse_CANTX_Command() ? "OK\n" : "ERR\n");
+    } else if (!uart_logger_active() && Parse_Command()) {
+        uart_logger_start(sampling_rate, total_time, log_sensor_mask, log_fields); // Replies OK, or the latched fault
+    } else {
+        uart_logger_send("ERR\n"); // Response for Python script to check
+    }
+}
+
 /**
-  * @brief UART: Parse command "START,<rate_hz>,<time_s>"
+  * @brief UART: Parse command "START,<rate_hz>,<time_s>[,<sensor_mask>[,<fields>]]"
+  *
+  * A time of 0 streams until a "STOP" command is received. The sensor mask
+  * has a bit per INA228_Location_t (decimal or 0x hex, bus only when
+  * omitted); fields is any of V (bus voltage), I (current), P (power),
+  * T (die temperature) and S (shunt voltage), VIP when omitted.
   * @retval 1 on valid command, 0 on error
   */
 static int Parse_Command(void)
 {
+    static const char field_names[] = "VIPTS";     // LOG_FIELD_* bit order
+    char *end;
+
     if (strncmp(rx_buf, "START", 5) != 0) return 0;
 
     char *tok = strtok(rx_buf, ",");
@@ -198,91 +312,82 @@ static int Parse_Command(void)
     if (!tok) return 0;
     total_time = atoi(tok);
 
-    if (sampling_rate <= 0 || total_time <= 0) return 0;
+    if (sampling_rate <= 0 || sampling_rate > LOG_MAX_RATE_HZ || total_time < 0) return 0;
 
-    num_samples = sampling_rate * total_time;
-    if (num_samples > MAX_SAMPLES)
-        num_samples = MAX_SAMPLES;
+    log_sensor_mask = LOG_DEFAULT_SENSOR_MASK;
+    log_fields = LOG_FIELDS_DEFAULT;
+
+    tok = strtok(NULL, ",");
+    if (!tok) return 1;
+    unsigned long mask = strtoul(tok, &end, 0);
+    if (*end != '\0' || mask == 0 || mask >= (1UL << INA228_NUM_SENSORS)) return 0;
+    log_sensor_mask = (uint8_t)mask;
+
+    tok = strtok(NULL, ",");
+    if (!tok) return 1;
+    log_fields = 0;
+    for (; *tok; tok++) {
+        const char *f = strchr(field_names, *tok);
+        if (!f) return 0;
+        log_fields |= (uint8_t)(1U << (f - field_names));
+    }
 
     return 1;
 }
 
 /**
-  * @brief UART: Acquire data from bus sensor
+  * @brief UART: Parse and apply command "I2C,<speed_hz>"
   *
-  * To log a different sensor, change INA228_BUS + BUS_CURRENT_LSB + BUS_POWER_LSB to the desired location and LSB constants
+  * Fails if the speed is out of range for the port (400 kHz on I2C1,
+  * 1 MHz on FMPI2C1) or a sweep is on the bus right now.
+  * @retval 1 if the new speed is programmed, 0 on error
   */
-static void Acquire_Data(void)
+static int Parse_I2C_Command(void)
 {
-	SensorData_t sensor;
-	get_sensor_data(INA228_BUS, &sensor);
-
-    if (!sensor.healthy)
-    {
-        FaultType_t fault = get_current_fault();
-        const char *fault_msg = NULL;
-
-        switch (fault) {
-			case FAULT_BUS_OVERCURRENT:
-			  fault_msg = "FAULT_BUS_OVERCURRENT\n";
-			  break;
-			case FAULT_BUS_OVERVOLTAGE:
-			  fault_msg = "FAULT_BUS_OVERVOLTAGE\n";
-			  break;
-			case FAULT_BUS_UNDERVOLTAGE:
-			  fault_msg = "FAULT_BUS_UNDERVOLTAGE\n";
-			  break;
-			case FAULT_MOTOR_OVERCURRENT:
-			  fault_msg = "FAULT_MOTOR_OVERCURRENT\n";
-			  break;
-			default:
-			  fault_msg = "FAULT_UNKNOWN\n";
-			  break;
-		}
-
-        if (fault_msg)
-            HAL_UART_Transmit(&huart2, (uint8_t *)fault_msg, strlen(fault_msg), HAL_MAX_DELAY);
-
-        for (int i = 0; i < num_samples; i++)
-            voltage_buf[i] = current_buf[i] = power_buf[i] = 0.0f;
-        return;
-    }
+    int speed_hz = atoi(&rx_buf[4]);
+    if (speed_hz <= 0) return 0;
 
-    uint32_t delay_ms = (sampling_rate > 0) ? (1000 / sampling_rate) : 1;
-
-    for (int i = 0; i < num_samples; i++)
-    {
-    	precharge_fsm_tick();
-    	get_sensor_data(INA228_BUS, &sensor);
-        voltage_buf[i] = sensor.voltage;
-        current_buf[i] = sensor.current;
-        power_buf[i]   = sensor.power;
-        HAL_Delay(delay_ms);
-    }
+    return i2c_bus_set_speed((uint32_t)speed_hz) == HAL_OK;
 }
 
 /**
-  * @brief UART: Transmit logged data to PC
+  * @brief UART: Parse and apply command "ADC,<profile>[,<sensor>]"
   *
-  * Format per line: voltage,current,power\n
-  * Terminated with "DONE\n"
+  * Profile is FAST, BALANCED or LOW_NOISE; sensor is 0 (bus) to 4 (motor 4),
+  * all sensors when omitted. The FSM writes it on its next tick; the bus
+  * sensor keeps its precharge profile until precharge completes.
+  * @retval 1 if the profile is selected, 0 on error
   */
-static void Transmit_Data(void)
+static int Parse_ADC_Command(void)
 {
-    char line[64];
-
-    for (int i = 0; i < num_samples; i++)
-    {
-        int len = snprintf(line, sizeof(line),
-                           "%.4f,%.4f,%.4f\n",
-                           voltage_buf[i],
-                           current_buf[i],
-                           power_buf[i]);
-        HAL_UART_Transmit(&huart2, (uint8_t *)line, len, HAL_MAX_DELAY);
+    char *tok = strtok(&rx_buf[4], ",");
+    if (!tok) return 0;
+
+    INA228_AdcProfile_t profile = INA228_PROFILE_FAST;
+    while (profile < INA228_NUM_PROFILES && strcmp(tok, INA228_ProfileName(profile)) != 0) profile++;
+
+    uint8_t sensor_mask = (1 << INA228_NUM_SENSORS) - 1;
+    tok = strtok(NULL, ",");
+    if (tok) {
+        int sensor = atoi(tok);
+        if (sensor < 0 || sensor >= INA228_NUM_SENSORS) return 0;
+        sensor_mask = 1 << sensor;
     }
 
-    const char done[] = "DONE\n";
-    HAL_UART_Transmit(&huart2, (uint8_t *)done, sizeof(done) - 1, HAL_MAX_DELAY);
+    return precharge_set_adc_profile(sensor_mask, profile) == HAL_OK;
+}
+
+/**
+  * @brief UART: Parse and apply command "CANTX,<PERIODIC|ONCHANGE>"
+  *
+  * Every telemetry frame is sent on the next tick after the switch.
+  * @retval 1 if the mode is selected, 0 on error
+  */
+static int Parse_CANTX_Command(void)
+{
+    if (strcmp(&rx_buf[6], "PERIODIC") == 0) return telemetry_set_tx_mode(TELEMETRY_TX_PERIODIC) == HAL_OK;
+    if (strcmp(&rx_buf[6], "ONCHANGE") == 0) return telemetry_set_tx_mode(TELEMETRY_TX_ON_CHANGE) == HAL_OK;
+    return 0;
 }
 
 /* USER CODE END 4 */
@@ -4,19 +4,62 @@
  * Precharge finite state machine (FSM) and system fault management.
  * Implements three states — PRECHARGE, NORMAL_OPERATION, and FAULT — to
  * safely ramp bus voltage before closing the main contactor. Polls all five
- * INA228 sensors (1 bus + 4 motors) on a configurable interval, enforces
+ * INA228 sensors (1 bus + 4 motors) on a configurable interval through the
+ * non-blocking sensor_acq engine, enforces
  * over/undervoltage and overcurrent thresholds, and controls the contactor
  * and motor relay GPIO pins. Faults are latched until an external reset.
+ *
+ * Overcurrent and bus overvoltage are also enforced in hardware: every INA228
+ * drives its ALERT pin into an EXTI line, and the ISR opens the contactor and
+ * relays immediately. The fault cause is read back from DIAG_ALRT on the next
+ * acquisition sweep.
+ *
+ * With SENSOR_CNVR_SAMPLING the ALERT lines also report conversion ready,
+ * so instead of polling on an interval each falling edge queues a read of
+ * that sensor. The outputs then open from the I2C interrupt as soon as the
+ * DIAG_ALRT read shows a limit flag, and a slow full poll covers a sensor
+ * whose ALERT line never fires.
+ *
+ * The bus sensor switches to a fast ADC profile for the precharge ramp, so
+ * completion is seen within a couple of milliseconds of crossing the
+ * threshold, and back to its run profile afterwards. Profile changes are
+ * blocking ADC_CONFIG writes made between sweeps (sensor_acq_claim()).
  */
 
 
 #include "precharge.h"
 #include "ina228_driver.h"
+#include "sensor_acq.h"
+#include "telemetry.h"
 #include "gpio.h"
+#include "profile.h"
 
 /* Global System Status */ 
 SystemStatus_t g_system_status  = {0};
-uint32_t last_sensor_poll_time  = 0;
+
+/* Sensor table, one row per INA228_Location_t. Motor over/undervoltage is not applicable due to backfeed, so BOVL is parked at 100V */
+const SensorDesc_t g_sensor_table[INA228_NUM_SENSORS] = {
+    { INA228_ADDR1, BUS_SHUNT_RESISTOR,   BUS_CURRENT_LSB,   BUS_POWER_LSB,   BUS_OVERCURRENT_THRESHOLD,   BUS_OVERCURRENT_CODE,
+      BUS_OVERVOLTAGE_THRESHOLD, FAULT_BUS_OVERCURRENT,   ALERT_BUS_GPIO_Port, ALERT_BUS_Pin },
+    { INA228_ADDR2, MOTOR_SHUNT_RESISTOR, MOTOR_CURRENT_LSB, MOTOR_POWER_LSB, MOTOR_OVERCURRENT_THRESHOLD, MOTOR_OVERCURRENT_CODE,
+      100.0f,                    FAULT_MOTOR_OVERCURRENT, ALERT_M1_GPIO_Port,  ALERT_M1_Pin },
+    { INA228_ADDR3, MOTOR_SHUNT_RESISTOR, MOTOR_CURRENT_LSB, MOTOR_POWER_LSB, MOTOR_OVERCURRENT_THRESHOLD, MOTOR_OVERCURRENT_CODE,
+      100.0f,                    FAULT_MOTOR_OVERCURRENT, ALERT_M2_GPIO_Port,  ALERT_M2_Pin },
+    { INA228_ADDR4, MOTOR_SHUNT_RESISTOR, MOTOR_CURRENT_LSB, MOTOR_POWER_LSB, MOTOR_OVERCURRENT_THRESHOLD, MOTOR_OVERCURRENT_CODE,
+      100.0f,                    FAULT_MOTOR_OVERCURRENT, ALERT_M3_GPIO_Port,  ALERT_M3_Pin },
+    { INA228_ADDR5, MOTOR_SHUNT_RESISTOR, MOTOR_CURRENT_LSB, MOTOR_POWER_LSB, MOTOR_OVERCURRENT_THRESHOLD, MOTOR_OVERCURRENT_CODE,
+      100.0f,                    FAULT_MOTOR_OVERCURRENT, ALERT_M4_GPIO_Port,  ALERT_M4_Pin },
+};
+uint32_t last_sensor_poll_time  = 0;     // Last FSM-started sweep or received snapshot
+
+/* ALERT pin state */
+static volatile uint8_t alert_pending = 0;          // Bitmask of INA228_Location_t that tripped, cleared once classified
+static volatile uint8_t fault_sensors = 0;          // Bitmask of INA228_Location_t that tripped a limit, latched
+static volatile uint32_t alert_latency_max = 0;     // Worst case trip latency in CPU cycles
+
+/* ADC profiles, indexed by INA228_Location_t */
+static INA228_AdcProfile_t adc_active[INA228_NUM_SENSORS];     // Written to the sensor
+static INA228_AdcProfile_t adc_run[INA228_NUM_SENSORS];        // Selected for outside precharge
 
 /* Pin definitions */
 #define CONTACTOR_PORT         	GPIOA
@@ -32,83 +75,88 @@ static void FSM_Precharge(void);
 static void FSM_Normal_Operation(void);
 static void FSM_Fault(void);
 static void UpdateSensorReadings(void);
+static void ApplySample(SensorData_t* sensor, const AcqSensorRaw_t* raw, const SensorDesc_t* desc);
+static void ScaleSample(SensorData_t* sensor, const SensorDesc_t* desc);
 static uint8_t IsPrechargeComplete(void);
 static uint8_t CheckForFaults(void);
 static void SetContactor(uint8_t on);
 static void PowerMotors(uint8_t on);
+static void SetState(PrechargeState_t next);
+static void ClassifyAlert(INA228_Location_t location, uint16_t diag_alrt);
+static void CheckAlertLines(void);
+static void ApplyAdcProfiles(void);
 
 /* Initialize precharge control system */
 void precharge_control_init(void) {
     g_system_status.state = STATE_PRECHARGE;
     g_system_status.fault = FAULT_NONE;
+    fault_sensors = 0;
 
     SetContactor(0); // Contactor open at startup
 
-    HAL_StatusTypeDef status;
+    // Initialize all sensors and arm their ALERT limits
+    // Undervoltage stays a software check: the bus starts at 0V during precharge and would hold ALERT low
+    for (uint8_t i = 0; i < INA228_NUM_SENSORS; i++) {
+        const SensorDesc_t* desc = &g_sensor_table[i];
+        adc_active[i] = INA228_PROFILE_LOW_NOISE;  // What INA228_Init() programs
+        adc_run[i] = ADC_RUN_PROFILE;
 
-    // Initialize Bus sensor
-    status = INA228_Init(INA228_ADDR1, BUS_CURRENT_LSB, BUS_SHUNT_RESISTOR);
-    if (status != HAL_OK) {
-        g_system_status.bus_sensor.healthy = 0;
-    } else {
-        g_system_status.bus_sensor.healthy = 1;
-        INA228_ConfigureAlerts(INA228_ADDR1, BUS_SHUNT_RESISTOR, BUS_OVERVOLTAGE_THRESHOLD, BUS_UNDERVOLTAGE_THRESHOLD, BUS_OVERCURRENT_THRESHOLD);
+        if (INA228_Init(desc->address, desc->current_lsb, desc->shunt_resistor) != HAL_OK) {
+            g_system_status.sensor[i].healthy = 0;
+            continue;
+        }
+        g_system_status.sensor[i].healthy = 1;
+        INA228_ConfigureAlerts(desc->address, desc->shunt_resistor, desc->overvoltage_limit, 0.0f, desc->overcurrent_limit);
+        INA228_ConfigureAlertPin(desc->address, SENSOR_CNVR_SAMPLING ? (INA228_DIAG_ALATCH | INA228_DIAG_CNVR) : INA228_DIAG_ALATCH);
     }
 
-    
-    // Initialize Motor1 sensor
-	status = INA228_Init(INA228_ADDR2, MOTOR_CURRENT_LSB, MOTOR_SHUNT_RESISTOR);
-	if (status != HAL_OK) {
-		g_system_status.motor1_sensor.healthy = 0;
-	} else {
-		g_system_status.motor1_sensor.healthy = 1;
-		// Configure motor overcurrent threshold (over/under voltage not applicable due to backfeed)
-		INA228_ConfigureAlerts(INA228_ADDR2, MOTOR_SHUNT_RESISTOR, 100.0f, 0.0f, MOTOR_OVERCURRENT_THRESHOLD);
-	}
-
-	// Initialize Motor2 sensor
-	status = INA228_Init(INA228_ADDR3, MOTOR_CURRENT_LSB, MOTOR_SHUNT_RESISTOR);
-	if (status != HAL_OK) {
-		g_system_status.motor2_sensor.healthy = 0;
-	} else {
-		g_system_status.motor2_sensor.healthy = 1;
-		// Configure motor overcurrent threshold (over/under voltage not applicable due to backfeed)
-		INA228_ConfigureAlerts(INA228_ADDR3, MOTOR_SHUNT_RESISTOR, 100.0f, 0.0f, MOTOR_OVERCURRENT_THRESHOLD);
-	}
-
-	// Initialize Motor3 sensor
-	status = INA228_Init(INA228_ADDR4, MOTOR_CURRENT_LSB, MOTOR_SHUNT_RESISTOR);
-	if (status != HAL_OK) {
-		g_system_status.motor3_sensor.healthy = 0;
-	} else {
-		g_system_status.motor3_sensor.healthy = 1;
-		// Configure motor overcurrent threshold (over/under voltage not applicable due to backfeed)
-		INA228_ConfigureAlerts(INA228_ADDR4, MOTOR_SHUNT_RESISTOR, 100.0f, 0.0f, MOTOR_OVERCURRENT_THRESHOLD);
-	}
-
-	// Initialize Motor4 sensor
-	status = INA228_Init(INA228_ADDR5, MOTOR_CURRENT_LSB, MOTOR_SHUNT_RESISTOR);
-	if (status != HAL_OK) {
-		g_system_status.motor4_sensor.healthy = 0;
-	} else {
-		g_system_status.motor4_sensor.healthy = 1;
-		// Configure motor overcurrent threshold (over/under voltage not applicable due to backfeed)
-		INA228_ConfigureAlerts(INA228_ADDR5, MOTOR_SHUNT_RESISTOR, 100.0f, 0.0f, MOTOR_OVERCURRENT_THRESHOLD);
-	}
-	
-    UpdateSensorReadings(); // Take initial sensor readings
+    // Enable the DWT cycle counter used to time the ALERT trip path
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    // An ALERT already held low before the EXTI edge detector was armed would never produce an edge
+    CheckAlertLines();
+
+    // Register sensors with the acquisition engine (order matches INA228_Location_t)
+    uint8_t sensor_addrs[INA228_NUM_SENSORS];
+    for (uint8_t i = 0; i < INA228_NUM_SENSORS; i++) sensor_addrs[i] = g_sensor_table[i].address;
+    sensor_acq_init(sensor_addrs, INA228_NUM_SENSORS);
+    ApplyAdcProfiles();
+
+    // Take initial sensor readings before the FSM runs
+    sensor_acq_start_sweep(ACQ_TRIGGER_POLL);
+    sensor_acq_wait();
+    UpdateSensorReadings();
+    last_sensor_poll_time = HAL_GetTick();
 }
 
 /* Main FSM tick function */
 void precharge_fsm_tick(void) {
 
-    // Poll sensors on interval
+    // Start a background sweep on interval, the bus runs while the FSM and telemetry execute.
+    // While the sampler timer delivers sweeps at least this often, the FSM never needs to start its own.
+    // With conversion-ready sampling the ALERT lines start the reads and the interval is only a fallback.
     uint32_t now = HAL_GetTick();
-    if (now - last_sensor_poll_time >= SENSOR_POLL_INTERVAL_MS) {
-        UpdateSensorReadings();
+    uint32_t interval = SENSOR_CNVR_SAMPLING ? SENSOR_CNVR_FALLBACK_MS : SENSOR_POLL_INTERVAL_MS;
+    PrechargeState_t state_before = g_system_status.state;
+    FaultType_t fault_before = g_system_status.fault;
+    uint8_t relays_before = get_relay_status();
+    sensor_acq_poll();
+#if SENSOR_CNVR_SAMPLING
+    if (!sensor_acq_busy()) CheckAlertLines();     // A latched line whose read failed sends no further edges
+#endif
+    if (now - last_sensor_poll_time >= interval && !sensor_acq_busy()) {
+        sensor_acq_start_sweep(ACQ_TRIGGER_POLL);
         last_sensor_poll_time = now;
     }
 
+    // Pick up the latest completed sweep (no-op if nothing new)
+    UpdateSensorReadings();
+
+    // Follow state changes and runtime selections, retried next tick while a sweep holds the bus
+    ApplyAdcProfiles();
+
     // Execute state machine
     switch (g_system_status.state) {
         case STATE_PRECHARGE:
@@ -126,6 +174,11 @@ void precharge_fsm_tick(void) {
             g_system_status.fault = FAULT_NONE;
             break;
     }
+
+    // Transitions (including a fault classified from DIAG_ALRT) go out on CAN now, not on the next telemetry tick
+    if (g_system_status.state != state_before || g_system_status.fault != fault_before || get_relay_status() != relays_before) {
+        telemetry_notify_status();
+    }
 }
 
 
@@ -135,12 +188,12 @@ static void FSM_Precharge(void) {
     PowerMotors(0);  // Motor relays open
 
     if(CheckForFaults()) {
-        g_system_status.state = STATE_FAULT;
+        SetState(STATE_FAULT);
         return;
     }
 
     if(IsPrechargeComplete()) {
-        g_system_status.state = STATE_NORMAL_OPERATION;
+        SetState(STATE_NORMAL_OPERATION);
     }
 }
 
@@ -150,7 +203,7 @@ static void FSM_Normal_Operation(void) {
     PowerMotors(1); 	 // Motor relays closed
 
     if(CheckForFaults()) {
-        g_system_status.state = STATE_FAULT;
+        SetState(STATE_FAULT);
     }
 }
 
@@ -160,123 +213,85 @@ static void FSM_Fault(void) {
     SetContactor(0); // Contactor open
     PowerMotors(0);  // Motor relays open
 
-    // NOTE: Fault is latched until external reset
+    // NOTE: Fault is latched until precharge_reset_fault() (CAN FAULT_RESET command)
 }
 
-/* Update all sensor readings from INA228s */
+/* Update all sensor readings from the latest completed acquisition sweep */
 static void UpdateSensorReadings(void) {
+    AcqSnapshot_t snapshot;
+    PROFILE_BEGIN(PROF_UPDATE_SENSORS);
+
+    // Only refresh when the engine has published a new, complete sweep (only those are profiled)
+    if (!sensor_acq_get_snapshot(&snapshot)) return;
+    if (snapshot.read_mask == (1U << INA228_NUM_SENSORS) - 1) last_sensor_poll_time = HAL_GetTick();
+
+    for (uint8_t i = 0; i < INA228_NUM_SENSORS; i++) {
+        ApplySample(&g_system_status.sensor[i], &snapshot.sensor[i], &g_sensor_table[i]);
 
-    // Verify I2C communication and sensor health each cycle
-    uint8_t healthy = 0;
-    HAL_StatusTypeDef status;
-
-    // Bus
-    status = INA228_CheckHealth(INA228_ADDR1, &healthy);
-    if (status == HAL_OK && healthy){
-        g_system_status.bus_sensor.healthy = 1;
-        // Sensor readings
-        if (INA228_ReadVoltage(INA228_ADDR1, &g_system_status.bus_sensor.voltage) != HAL_OK ||
-            INA228_ReadCurrent(INA228_ADDR1, &g_system_status.bus_sensor.current, BUS_CURRENT_LSB) != HAL_OK ||
-            INA228_ReadPower(INA228_ADDR1, &g_system_status.bus_sensor.power, BUS_POWER_LSB) != HAL_OK){
-            	g_system_status.bus_sensor.healthy = 0;
+        // Resolve the cause of any ALERT trips from the latched DIAG_ALRT flags
+        if ((alert_pending & (1 << i)) && snapshot.sensor[i].healthy) {
+            ClassifyAlert((INA228_Location_t)i, snapshot.sensor[i].diag_alrt);
         }
     }
-    else {
-        g_system_status.bus_sensor.healthy = 0;
+
+    PROFILE_END(PROF_UPDATE_SENSORS);
+}
+
+/* Store one sensor's raw codes (scaled too unless SENSOR_FIXED_POINT), previous values are kept if the sensor did not respond */
+static void ApplySample(SensorData_t* sensor, const AcqSensorRaw_t* raw, const SensorDesc_t* desc) {
+    if (!raw->healthy) {
+        sensor->healthy = 0;
+        return;
     }
 
-    
-    // Motor 1
-    status = INA228_CheckHealth(INA228_ADDR2, &healthy);
-    if(status == HAL_OK && healthy){
-    	g_system_status.motor1_sensor.healthy = 1;
-		// Sensor readings
-		if (INA228_ReadVoltage(INA228_ADDR2, &g_system_status.motor1_sensor.voltage) != HAL_OK ||
-			INA228_ReadCurrent(INA228_ADDR2, &g_system_status.motor1_sensor.current, BUS_CURRENT_LSB) != HAL_OK ||
-			INA228_ReadPower(INA228_ADDR2, &g_system_status.motor1_sensor.power, BUS_POWER_LSB) != HAL_OK){
-				g_system_status.motor1_sensor.healthy = 0;
-		}
-	}
-    else {
-		g_system_status.motor1_sensor.healthy = 0;
-	}
-
-    // Motor 2
-    status = INA228_CheckHealth(INA228_ADDR3, &healthy);
-    if(status == HAL_OK && healthy){
-    	g_system_status.motor2_sensor.healthy = 1;
-		// Sensor readings
-		if (INA228_ReadVoltage(INA228_ADDR3, &g_system_status.motor2_sensor.voltage) != HAL_OK ||
-			INA228_ReadCurrent(INA228_ADDR3, &g_system_status.motor2_sensor.current, BUS_CURRENT_LSB) != HAL_OK ||
-			INA228_ReadPower(INA228_ADDR3, &g_system_status.motor2_sensor.power, BUS_POWER_LSB) != HAL_OK){
-				g_system_status.motor2_sensor.healthy = 0;
-		}
-	}
-    else {
-		g_system_status.motor2_sensor.healthy = 0;
-	}
-
-    // Motor 3
-    status = INA228_CheckHealth(INA228_ADDR4, &healthy);
-    if(status == HAL_OK && healthy){
-    	g_system_status.motor3_sensor.healthy = 1;
-		// Sensor readings
-		if (INA228_ReadVoltage(INA228_ADDR4, &g_system_status.motor3_sensor.voltage) != HAL_OK ||
-			INA228_ReadCurrent(INA228_ADDR4, &g_system_status.motor3_sensor.current, BUS_CURRENT_LSB) != HAL_OK ||
-			INA228_ReadPower(INA228_ADDR4, &g_system_status.motor3_sensor.power, BUS_POWER_LSB) != HAL_OK){
-				g_system_status.motor3_sensor.healthy = 0;
-		}
-	}
-    else {
-		g_system_status.motor3_sensor.healthy = 0;
-	}
-
-    // Motor 4
-    status = INA228_CheckHealth(INA228_ADDR5, &healthy);
-    if(status == HAL_OK && healthy){
-    	g_system_status.motor4_sensor.healthy = 1;
-		// Sensor readings
-		if (INA228_ReadVoltage(INA228_ADDR5, &g_system_status.motor4_sensor.voltage) != HAL_OK ||
-			INA228_ReadCurrent(INA228_ADDR5, &g_system_status.motor4_sensor.current, BUS_CURRENT_LSB) != HAL_OK ||
-			INA228_ReadPower(INA228_ADDR5, &g_system_status.motor4_sensor.power, BUS_POWER_LSB) != HAL_OK){
-				g_system_status.motor4_sensor.healthy = 0;
-		}
-	}
-    else {
-		g_system_status.motor4_sensor.healthy = 0;
-	}
-	
+    // V, I and P come from one measurement block read, so they belong to the same conversion
+    sensor->raw       = raw->meas;
+    sensor->diag_alrt = raw->diag_alrt;
+    sensor->healthy   = 1;
+#if SENSOR_FIXED_POINT
+    UNUSED(desc);
+#else
+    ScaleSample(sensor, desc);
+#endif
 }
 
-/* Check for fault conditions */
-static uint8_t CheckForFaults(void) {
+/* Convert the stored codes to engineering units */
+static void ScaleSample(SensorData_t* sensor, const SensorDesc_t* desc) {
+    INA228_Measurement_t meas;
+    INA228_ScaleMeasurement(&sensor->raw, desc->current_lsb, desc->power_lsb, &meas);
 
-	
-    // Motor overcurrent
-    if (g_system_status.motor1_sensor.current > MOTOR_OVERCURRENT_THRESHOLD ||
-    	g_system_status.motor2_sensor.current > MOTOR_OVERCURRENT_THRESHOLD ||
-		g_system_status.motor3_sensor.current > MOTOR_OVERCURRENT_THRESHOLD ||
-		g_system_status.motor4_sensor.current > MOTOR_OVERCURRENT_THRESHOLD) {
-        g_system_status.fault = FAULT_MOTOR_OVERCURRENT;
-        return 1;
-    }
-    
+    sensor->voltage       = meas.voltage;
+    sensor->current       = meas.current;
+    sensor->power         = meas.power;
+    sensor->shunt_voltage = meas.shunt_voltage;
+    sensor->temperature   = meas.temperature;
+}
 
-    // Bus overcurrent
-    if (g_system_status.bus_sensor.current > BUS_OVERCURRENT_THRESHOLD) {
-        g_system_status.fault = FAULT_BUS_OVERCURRENT;
-        return 1;
+/* Check for fault conditions, on raw codes against limits converted at compile time */
+static uint8_t CheckForFaults(void) {
+    const INA228_RawMeasurement_t* bus = &g_system_status.sensor[INA228_BUS].raw;
+
+    // Overcurrent, motors first so a motor fault is not reported as a bus fault
+    for (uint8_t n = 1; n <= INA228_NUM_SENSORS; n++) {
+        uint8_t i = n % INA228_NUM_SENSORS;
+        if (g_system_status.sensor[i].raw.current > g_sensor_table[i].overcurrent_code) {
+            g_system_status.fault = g_sensor_table[i].overcurrent_fault;
+            fault_sensors |= (1 << i);
+            return 1;
+        }
     }
 
     // Bus overvoltage
-    if (g_system_status.bus_sensor.voltage > BUS_OVERVOLTAGE_THRESHOLD) {
+    if (bus->vbus > BUS_OVERVOLTAGE_CODE) {
         g_system_status.fault = FAULT_BUS_OVERVOLTAGE;
+        fault_sensors |= (1 << INA228_BUS);
         return 1;
     }
 
     // Bus undervoltage (only meaningful during normal operation, bus starts low during precharge)
-    if (g_system_status.state == STATE_NORMAL_OPERATION && g_system_status.bus_sensor.voltage < BUS_UNDERVOLTAGE_THRESHOLD) {
+    if (g_system_status.state == STATE_NORMAL_OPERATION && bus->vbus < BUS_UNDERVOLTAGE_CODE) {
         g_system_status.fault = FAULT_BUS_UNDERVOLTAGE;
+        fault_sensors |= (1 << INA228_BUS);
         return 1;
     }
 
@@ -286,23 +301,32 @@ static uint8_t CheckForFaults(void) {
 /* Check if precharge is complete */
 static uint8_t IsPrechargeComplete(void) {
     // Bus voltage must reach PRECHARGE_THRESHOLD_PERCENT of nominal
-    return (g_system_status.bus_sensor.voltage >= (BATTERY_NOMINAL * ((float)PRECHARGE_THRESHOLD_PERCENT / 100.0f)));
+    return (g_system_status.sensor[INA228_BUS].raw.vbus >= PRECHARGE_COMPLETE_CODE);
 }
 
 /* Contactor control */
 static void SetContactor(uint8_t on) {
-    if(on) 	HAL_GPIO_WritePin(CONTACTOR_PORT, CONTACTOR_PIN, GPIO_PIN_SET);
+    if(on) {
+        // Check and close atomically so an ALERT trip between the two cannot be undone
+        __disable_irq();
+        if (g_system_status.state != STATE_FAULT) HAL_GPIO_WritePin(CONTACTOR_PORT, CONTACTOR_PIN, GPIO_PIN_SET);
+        __enable_irq();
+    }
     else 	HAL_GPIO_WritePin(CONTACTOR_PORT, CONTACTOR_PIN, GPIO_PIN_RESET);
 }
 
 /* Motor control */
 static void PowerMotors(uint8_t on) {
     if (on) {
-    	// Motors active LO
-        HAL_GPIO_WritePin(MOTOR_PORT, MOTOR1_PIN, GPIO_PIN_RESET);
-        HAL_GPIO_WritePin(MOTOR_PORT, MOTOR2_PIN, GPIO_PIN_RESET);
-        HAL_GPIO_WritePin(MOTOR_PORT, MOTOR3_PIN, GPIO_PIN_RESET);
-        HAL_GPIO_WritePin(MOTOR_PORT, MOTOR4_PIN, GPIO_PIN_RESET);
+    	// Motors active LO, closed atomically with the fault check (see SetContactor)
+        __disable_irq();
+        if (g_system_status.state != STATE_FAULT) {
+            HAL_GPIO_WritePin(MOTOR_PORT, MOTOR1_PIN, GPIO_PIN_RESET);
+            HAL_GPIO_WritePin(MOTOR_PORT, MOTOR2_PIN, GPIO_PIN_RESET);
+            HAL_GPIO_WritePin(MOTOR_PORT, MOTOR3_PIN, GPIO_PIN_RESET);
+            HAL_GPIO_WritePin(MOTOR_PORT, MOTOR4_PIN, GPIO_PIN_RESET);
+        }
+        __enable_irq();
     } else {
         HAL_GPIO_WritePin(MOTOR_PORT, MOTOR1_PIN, GPIO_PIN_SET);
         HAL_GPIO_WritePin(MOTOR_PORT, MOTOR2_PIN, GPIO_PIN_SET);
@@ -312,6 +336,102 @@ static void PowerMotors(uint8_t on) {
 }
 
 
+/* State transition, a latched FAULT (possibly set by the ALERT ISR) is never left here */
+static void SetState(PrechargeState_t next) {
+    __disable_irq();
+    if (g_system_status.state != STATE_FAULT) g_system_status.state = next;
+    __enable_irq();
+}
+
+/* Map the latched DIAG_ALRT limit flags of a tripped sensor to a fault code */
+static void ClassifyAlert(INA228_Location_t location, uint16_t diag_alrt) {
+    alert_pending &= ~(1 << location);
+
+    if (location != INA228_BUS || (diag_alrt & INA228_DIAG_SHNTOL)) {
+        g_system_status.fault = g_sensor_table[location].overcurrent_fault; // Only SOVL is armed on the motor sensors
+    } else if (diag_alrt & INA228_DIAG_BUSOL) {
+        g_system_status.fault = FAULT_BUS_OVERVOLTAGE;
+    }
+    // No limit flag: leave FAULT_SENSOR_ALERT so the trip is still visible
+}
+
+/* Act on any ALERT line that is already asserted (active low): trip, or read the sensor with CNVR */
+static void CheckAlertLines(void) {
+    for (uint8_t i = 0; i < INA228_NUM_SENSORS; i++) {
+        if (HAL_GPIO_ReadPin(g_sensor_table[i].alert_port, g_sensor_table[i].alert_pin) != GPIO_PIN_RESET) continue;
+#if SENSOR_CNVR_SAMPLING
+        sensor_acq_conversion_ready(i);
+#else
+        precharge_alert_trip((INA228_Location_t)i);
+#endif
+    }
+}
+
+/*
+ * ALERT fast path, runs at the highest interrupt priority.
+ * Opens the contactor and motor relays first, then latches the fault.
+ * The cause is classified in main context from the next DIAG_ALRT read.
+ */
+void precharge_alert_trip(INA228_Location_t location) {
+    uint32_t start = DWT->CYCCNT;
+
+    HAL_GPIO_WritePin(CONTACTOR_PORT, CONTACTOR_PIN, GPIO_PIN_RESET);
+    HAL_GPIO_WritePin(MOTOR_PORT, MOTOR1_PIN | MOTOR2_PIN | MOTOR3_PIN | MOTOR4_PIN, GPIO_PIN_SET); // Active LO
+
+    uint32_t elapsed = DWT->CYCCNT - start;
+    if (elapsed > alert_latency_max) alert_latency_max = elapsed;
+
+    if (g_system_status.state != STATE_FAULT) {
+        g_system_status.state = STATE_FAULT;
+        g_system_status.fault = FAULT_SENSOR_ALERT;
+    }
+    alert_pending |= (1 << location);
+    fault_sensors |= (1 << location);
+    telemetry_notify_status();
+}
+
+/* Worst case cycles from entering the trip path to outputs open (excludes exception entry and HAL EXTI dispatch) */
+uint32_t precharge_alert_latency_cycles(void) {
+    return alert_latency_max;
+}
+
+/* HAL callback: ALERT lines are active low, so every falling edge is a trip (or a new result with CNVR) */
+void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin) {
+    // Every ALERT line has its own pin number, so the pin alone identifies the sensor
+    for (uint8_t i = 0; i < INA228_NUM_SENSORS; i++) {
+        if (GPIO_Pin == g_sensor_table[i].alert_pin) {
+#if SENSOR_CNVR_SAMPLING
+            sensor_acq_conversion_ready(i);
+#else
+            precharge_alert_trip((INA228_Location_t)i);
+#endif
+            return;
+        }
+    }
+}
+
+#if SENSOR_CNVR_SAMPLING
+/* Acquisition hook: a DIAG_ALRT read found a limit flag, trip the same way the ALERT edge does without CNVR */
+void sensor_acq_limit_callback(uint8_t sensor, uint16_t diag_alrt) {
+    UNUSED(diag_alrt);
+    if (sensor < INA228_NUM_SENSORS) precharge_alert_trip((INA228_Location_t)sensor);
+}
+#endif
+
+
+/* Write ADC_CONFIG on every healthy sensor whose profile differs from the one wanted in this state */
+static void ApplyAdcProfiles(void) {
+    for (uint8_t i = 0; i < INA228_NUM_SENSORS; i++) {
+        INA228_AdcProfile_t want = adc_run[i];
+        if (i == INA228_BUS && g_system_status.state == STATE_PRECHARGE) want = ADC_PRECHARGE_PROFILE;
+
+        if (want == adc_active[i] || !g_system_status.sensor[i].healthy) continue;
+        if (sensor_acq_claim() != HAL_OK) return;
+        if (INA228_SetAdcProfile(g_sensor_table[i].address, want) == HAL_OK) adc_active[i] = want;
+        sensor_acq_release();
+    }
+}
+
 
 /* Public API functions */
 
@@ -323,26 +443,73 @@ FaultType_t get_current_fault(void) {
     return g_system_status.fault;
 }
 
-void get_sensor_data(INA228_Location_t location, SensorData_t* data) {
-    if (data == NULL) return;
-    switch (location) {
-        case INA228_BUS:
-            *data = g_system_status.bus_sensor;
-            break;
-        case INA228_MOTOR1:
-            *data = g_system_status.motor1_sensor;
-            break;
-        case INA228_MOTOR2:
-            *data = g_system_status.motor2_sensor;
-            break;
-        case INA228_MOTOR3:
-            *data = g_system_status.motor3_sensor;
-            break;
-        case INA228_MOTOR4:
-            *data = g_system_status.motor4_sensor;
-            break;
-        default:
-            break;
+uint8_t get_fault_sensors(void) {
+    return fault_sensors;
+}
+
+/* Commanded output state, read back from the output data registers */
+uint8_t get_relay_status(void) {
+    uint8_t status = (CONTACTOR_PORT->ODR & CONTACTOR_PIN) ? 1 : 0;
+    const uint16_t motor_pins[4] = { MOTOR1_PIN, MOTOR2_PIN, MOTOR3_PIN, MOTOR4_PIN };
+
+    for (uint8_t m = 0; m < 4; m++) {
+        if (!(MOTOR_PORT->ODR & motor_pins[m])) status |= (uint8_t)(1 << (m + 1));     // Active LO
     }
+    return status;
 }
 
+/*
+ * Clear a latched fault and start over from PRECHARGE, so the contactor
+ * only closes again once the bus is back up. Refused while a trip is not
+ * yet classified, while the last DIAG_ALRT read of a sensor still shows a
+ * limit flag, or, without SENSOR_CNVR_SAMPLING, while an ALERT line is
+ * still low: the latched line only releases once a sweep has read DIAG_ALRT
+ * with the condition gone, and a line that is already low would give no
+ * edge to trip again. Anything the software checks still see trips again
+ * on the next FSM tick.
+ */
+HAL_StatusTypeDef precharge_reset_fault(void) {
+    HAL_StatusTypeDef status = HAL_OK;
+
+    __disable_irq();    // The ALERT ISR may latch a new trip at any time
+    if (g_system_status.state == STATE_FAULT) {
+        if (alert_pending) status = HAL_BUSY;
+        for (uint8_t i = 0; i < INA228_NUM_SENSORS; i++) {
+            if (g_system_status.sensor[i].diag_alrt & INA228_DIAG_LIMIT_FLAGS) status = HAL_BUSY;
+#if !SENSOR_CNVR_SAMPLING
+            if (HAL_GPIO_ReadPin(g_sensor_table[i].alert_port, g_sensor_table[i].alert_pin) == GPIO_PIN_RESET) status = HAL_BUSY;
+#endif
+        }
+        if (status == HAL_OK) {
+            g_system_status.state = STATE_PRECHARGE;
+            g_system_status.fault = FAULT_NONE;
+            fault_sensors = 0;
+        }
+    }
+    __enable_irq();
+
+    if (status == HAL_OK) telemetry_notify_status();
+    return status;
+}
+
+/* Select the run profile of every sensor in sensor_mask (bit = INA228_Location_t) */
+HAL_StatusTypeDef precharge_set_adc_profile(uint8_t sensor_mask, INA228_AdcProfile_t profile) {
+    if (profile >= INA228_NUM_PROFILES || sensor_mask == 0 || (sensor_mask >> INA228_NUM_SENSORS)) return HAL_ERROR;
+
+    for (uint8_t i = 0; i < INA228_NUM_SENSORS; i++) {
+        if (sensor_mask & (1 << i)) adc_run[i] = profile;
+    }
+    return HAL_OK;
+}
+
+INA228_AdcProfile_t precharge_get_adc_profile(INA228_Location_t location) {
+    return (location < INA228_NUM_SENSORS) ? adc_active[location] : INA228_NUM_PROFILES;
+}
+
+void get_sensor_data(INA228_Location_t location, SensorData_t* data) {
+    if (data == NULL || location >= INA228_NUM_SENSORS) return;
+    *data = g_system_status.sensor[location];
+#if SENSOR_FIXED_POINT
+    ScaleSample(data, &g_sensor_table[location]);  // Readings stay raw codes until someone asks for units
+#endif
+}
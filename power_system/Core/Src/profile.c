@@ -0,0 +1,107 @@
+/*
+ * profile.c
+ *
+ * DWT cycle-count probe statistics and their UART report.
+ */
+
+#include "profile.h"
+
+#if PROFILE_ENABLE
+
+#include <stdio.h>
+#include <string.h>
+
+static const char* const probe_names[PROF_NUM_PROBES] = {
+    [PROF_UPDATE_SENSORS] = "update_sensors",
+    [PROF_TELEMETRY_TICK] = "telemetry_tick",
+    [PROF_CIRC_BUF_PUSH]  = "circ_buf_push",
+    [PROF_CAN_TX_SEND]    = "can_tx_send",
+};
+
+static ProfileStats_t stats[PROF_NUM_PROBES];
+
+/* Local Prototypes */
+static uint8_t Hist_Bin(uint32_t cycles);
+
+void profile_init(void)
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    profile_reset();
+}
+
+void profile_reset(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    memset(stats, 0, sizeof(stats));
+    for (uint8_t i = 0; i < PROF_NUM_PROBES; i++) stats[i].min_cycles = UINT32_MAX;
+    __set_PRIMASK(primask);
+}
+
+void profile_record(ProfileProbe_t probe, uint32_t cycles)
+{
+    ProfileStats_t* st = &stats[probe];
+    uint8_t bin = Hist_Bin(cycles);
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    st->count++;
+    st->total_cycles += cycles;
+    if (cycles < st->min_cycles) st->min_cycles = cycles;
+    if (cycles > st->max_cycles) st->max_cycles = cycles;
+    st->hist[bin]++;
+    __set_PRIMASK(primask);
+}
+
+void profile_get_stats(ProfileProbe_t probe, ProfileStats_t* out)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    *out = stats[probe];
+    __set_PRIMASK(primask);
+
+    if (out->count == 0) out->min_cycles = 0;
+}
+
+const char* profile_name(ProfileProbe_t probe)
+{
+    return (probe < PROF_NUM_PROBES) ? probe_names[probe] : "?";
+}
+
+/**
+  * @brief Report every probe as text lines
+  *
+  * "STATS,<probes>,<core_hz>" then per probe
+  * "<name>,<count>,<min>,<max>,<mean>,<bin0>,...,<bin15>", all in cycles.
+  */
+void profile_report(void (*send)(const char* line))
+{
+    char line[256];
+
+    snprintf(line, sizeof(line), "STATS,%u,%lu\n", PROF_NUM_PROBES, (unsigned long)SystemCoreClock);
+    send(line);
+
+    for (uint8_t i = 0; i < PROF_NUM_PROBES; i++) {
+        ProfileStats_t st;
+        profile_get_stats((ProfileProbe_t)i, &st);
+
+        int n = snprintf(line, sizeof(line), "%s,%lu,%lu,%lu,%lu", probe_names[i],
+                         (unsigned long)st.count, (unsigned long)st.min_cycles, (unsigned long)st.max_cycles,
+                         (unsigned long)(st.count ? st.total_cycles / st.count : 0));
+        for (uint8_t b = 0; b < PROFILE_HIST_BINS && n < (int)sizeof(line) - 2; b++)
+            n += snprintf(&line[n], sizeof(line) - n, ",%lu", (unsigned long)st.hist[b]);
+        snprintf(&line[n], sizeof(line) - n, "\n");
+        send(line);
+    }
+}
+
+/* log2 bin: < 32 cycles in bin 0, then one bin per doubling */
+static uint8_t Hist_Bin(uint32_t cycles)
+{
+    if (cycles < 32) return 0;
+    uint32_t bin = (31U - (uint32_t)__builtin_clz(cycles)) - 4U;
+    return (bin < PROFILE_HIST_BINS) ? (uint8_t)bin : PROFILE_HIST_BINS - 1;
+}
+
+#endif /* PROFILE_ENABLE */
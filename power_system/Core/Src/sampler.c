@@ -0,0 +1,142 @@
+/*
+ * sampler.c
+ *
+ * TIM2 microsecond timebase and compare-driven sweep trigger.
+ */
+
+#include "sampler.h"
+#include "sensor_acq.h"
+
+static volatile uint8_t running = 0;
+static uint32_t rate;
+static uint32_t period_us, period_rem, rem_acc;    // Period = period_us + period_rem / rate
+static uint32_t ticks_left;
+static uint8_t continuous;
+static volatile SamplerStats_t stats;
+
+/* Local Prototypes */
+static uint32_t Sampler_NextCompare(uint32_t prev);
+
+/* Configure TIM2 as a free-running 32-bit counter at SAMPLER_TIMER_HZ */
+void sampler_init(void)
+{
+    // APB1 timers run at 2x PCLK1 whenever the APB1 prescaler is not 1
+    uint32_t pclk1  = HAL_RCC_GetPCLK1Freq();
+    uint32_t timclk = ((RCC->CFGR & RCC_CFGR_PPRE1) == RCC_CFGR_PPRE1_DIV1) ? pclk1 : 2U * pclk1;
+
+    __HAL_RCC_TIM2_CLK_ENABLE();
+
+    TIM2->CR1  = 0;
+    TIM2->DIER = 0;
+    TIM2->PSC  = timclk / SAMPLER_TIMER_HZ - 1U;
+    TIM2->ARR  = 0xFFFFFFFFU;
+    TIM2->CCMR1 = 0;                // CH1 output compare, frozen: only the flag is used
+    TIM2->EGR  = TIM_EGR_UG;        // Load the prescaler now
+    TIM2->SR   = 0;
+    TIM2->CR1  = TIM_CR1_CEN;
+
+    // Same priority as I2C1, so a tick never preempts the sweep chain it may be starting
+    HAL_NVIC_SetPriority(TIM2_IRQn, 1, 0);
+    HAL_NVIC_EnableIRQ(TIM2_IRQn);
+}
+
+uint32_t sampler_micros(void)
+{
+    return TIM2->CNT;
+}
+
+/**
+  * @brief Start triggering sweeps at rate_hz
+  * @param count: Number of ticks before sampling stops by itself, 0 = until sampler_stop()
+  * @retval 1 if started
+  */
+uint8_t sampler_start(uint32_t rate_hz, uint32_t count)
+{
+    if (rate_hz == 0 || rate_hz > SAMPLER_MAX_RATE_HZ) return 0;
+
+    sampler_stop();
+
+    rate       = rate_hz;
+    period_us  = SAMPLER_TIMER_HZ / rate_hz;
+    period_rem = SAMPLER_TIMER_HZ % rate_hz;
+    rem_acc    = 0;
+    ticks_left = count;
+    continuous = (count == 0);
+    stats.ticks = 0;
+    stats.overruns = 0;
+    stats.max_latency_us = 0;
+
+    // First tick one period from now
+    TIM2->CCR1 = Sampler_NextCompare(TIM2->CNT);
+    TIM2->SR   = (uint32_t)~TIM_SR_CC1IF;
+    running = 1;
+    TIM2->DIER |= TIM_DIER_CC1IE;
+    return 1;
+}
+
+void sampler_stop(void)
+{
+    TIM2->DIER &= ~TIM_DIER_CC1IE;
+    running = 0;
+}
+
+uint8_t sampler_running(void)
+{
+    return running;
+}
+
+void sampler_get_stats(SamplerStats_t* out)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    out->ticks          = stats.ticks;
+    out->overruns       = stats.overruns;
+    out->max_latency_us = stats.max_latency_us;
+    __set_PRIMASK(primask);
+}
+
+void sampler_irq_handler(void)
+{
+    if (!(TIM2->SR & TIM_SR_CC1IF)) return;
+    TIM2->SR = (uint32_t)~TIM_SR_CC1IF;
+    if (!running) return;
+
+    uint32_t scheduled = TIM2->CCR1;
+    uint32_t latency   = TIM2->CNT - scheduled;
+    if (latency > stats.max_latency_us) stats.max_latency_us = latency;
+    stats.ticks++;
+
+    if (sensor_acq_start_sweep(ACQ_TRIGGER_SAMPLER) != HAL_OK)
+        stats.overruns++;
+
+    if (!continuous && --ticks_left == 0) {
+        sampler_stop();
+        return;
+    }
+
+    // Schedule the next tick from the previous scheduled time. Slots already in the past are skipped
+    // (a compare value behind the counter would only match again after the 32-bit wrap).
+    uint32_t next = Sampler_NextCompare(scheduled);
+    while ((int32_t)(next - TIM2->CNT) <= 0) {
+        stats.overruns++;
+        if (!continuous && --ticks_left == 0) {
+            sampler_stop();
+            return;
+        }
+        next = Sampler_NextCompare(next);
+    }
+    TIM2->CCR1 = next;
+}
+
+/* Scheduled time one period after prev, carrying the fractional microseconds */
+static uint32_t Sampler_NextCompare(uint32_t prev)
+{
+    uint32_t next = prev + period_us;
+
+    rem_acc += period_rem;
+    if (rem_acc >= rate) {
+        rem_acc -= rate;
+        next++;
+    }
+    return next;
+}
@@ -0,0 +1,182 @@
+/*
+ * scheduler.c
+ *
+ * Cooperative task dispatcher with event flags, deadline accounting and
+ * WFI idle.
+ */
+
+#include "scheduler.h"
+#include "sampler.h"
+#include <string.h>
+
+static const SchedTask_t* task_table;
+static uint8_t num_tasks;
+
+static volatile uint32_t pending_events;            // Set by ISRs, collected by the dispatcher
+static uint32_t task_events[SCHED_MAX_TASKS];       // Collected events not yet handled by each task
+static uint32_t next_release[SCHED_MAX_TASKS];      // HAL tick of the next periodic release
+static uint32_t period[SCHED_MAX_TASKS];            // Current period, from the table until sched_set_period()
+
+static SchedTaskStats_t task_stats[SCHED_MAX_TASKS];
+static uint64_t idle_us;
+static uint32_t last_us;                            // sampler_micros() at the last elapsed update
+static uint64_t elapsed_us;
+
+/* Local Prototypes */
+static uint8_t Sched_Due(uint8_t i, uint32_t now);
+static void Sched_RunTask(uint8_t i, uint32_t now);
+static void Sched_Elapsed(void);
+
+void sched_init(const SchedTask_t* tasks, uint8_t count)
+{
+    if (count > SCHED_MAX_TASKS) count = SCHED_MAX_TASKS;
+
+    task_table = tasks;
+    num_tasks = count;
+    memset(task_events, 0, sizeof(task_events));
+
+    // Events signalled before this call are kept. Every periodic task is released right away, then on its grid
+    uint32_t now = HAL_GetTick();
+    for (uint8_t i = 0; i < num_tasks; i++) {
+        next_release[i] = now;
+        period[i] = tasks[i].period_ms;
+    }
+
+    sched_reset_stats();
+}
+
+/* Set event flags; may run in any ISR, so the read-modify-write is masked */
+void sched_signal(uint32_t events)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    pending_events |= events;
+    __set_PRIMASK(primask);
+}
+
+void sched_run(void)
+{
+    while (1) {
+        sched_run_once();
+    }
+}
+
+void sched_run_once(void)
+{
+    // Hand the signalled events to every task waiting on them
+    __disable_irq();
+    uint32_t events = pending_events;
+    pending_events = 0;
+    __enable_irq();
+
+    for (uint8_t i = 0; i < num_tasks; i++) task_events[i] |= events & task_table[i].events;
+
+    // Highest priority ready task, one per pass so a higher one released meanwhile goes next
+    uint32_t now = HAL_GetTick();
+    for (uint8_t i = 0; i < num_tasks; i++) {
+        if (task_events[i] || Sched_Due(i, now)) {
+            Sched_RunTask(i, now);
+            return;
+        }
+    }
+
+    // Nothing ready: sleep, unless an ISR signalled since the scan. With PRIMASK set an
+    // interrupt still ends WFI, it is serviced once interrupts are enabled again.
+    __disable_irq();
+    if (pending_events == 0) {
+        uint32_t t0 = sampler_micros();
+        __WFI();
+        idle_us += sampler_micros() - t0;
+    }
+    __enable_irq();
+
+    Sched_Elapsed();
+}
+
+/*
+ * Change the period of a periodic task, e.g. the telemetry rate. The next
+ * release comes no later than one new period from now, then the task stays
+ * on the new grid. Runs in main context, between two tasks.
+ */
+HAL_StatusTypeDef sched_set_period(void (*run)(void), uint32_t period_ms)
+{
+    if (period_ms == 0) return HAL_ERROR;
+
+    for (uint8_t i = 0; i < num_tasks; i++) {
+        if (task_table[i].run != run) continue;
+        if (task_table[i].period_ms == 0) return HAL_ERROR;    // Event-driven tasks stay that way
+
+        uint32_t now = HAL_GetTick();
+        period[i] = period_ms;
+        if ((int32_t)(next_release[i] - now) > (int32_t)period_ms) next_release[i] = now + period_ms;
+        return HAL_OK;
+    }
+    return HAL_ERROR;
+}
+
+void sched_get_task_stats(uint8_t task, SchedTaskStats_t* stats)
+{
+    if (task < num_tasks) *stats = task_stats[task];
+    else memset(stats, 0, sizeof(*stats));
+}
+
+void sched_get_stats(SchedStats_t* stats)
+{
+    Sched_Elapsed();
+    stats->elapsed_us = elapsed_us;
+    stats->idle_us = idle_us;
+}
+
+void sched_reset_stats(void)
+{
+    memset(task_stats, 0, sizeof(task_stats));
+    idle_us = 0;
+    elapsed_us = 0;
+    last_us = sampler_micros();
+}
+
+static uint8_t Sched_Due(uint8_t i, uint32_t now)
+{
+    return period[i] && (int32_t)(now - next_release[i]) >= 0;
+}
+
+static void Sched_RunTask(uint8_t i, uint32_t now)
+{
+    const SchedTask_t* task = &task_table[i];
+    SchedTaskStats_t* st = &task_stats[i];
+    uint8_t periodic = Sched_Due(i, now);
+
+    task_events[i] = 0;     // Events signalled while it runs release it again
+
+    uint32_t t0 = sampler_micros();
+    task->run();
+    uint32_t us = sampler_micros() - t0;
+
+    st->runs++;
+    st->total_us += us;
+    if (us > st->max_us) st->max_us = us;
+
+    if (periodic) {
+        // Deadline is the next release: late if this job ended after it
+        uint32_t deadline = next_release[i] + period[i];
+        uint32_t end = HAL_GetTick();
+        if ((int32_t)(end - deadline) > 0) st->deadline_misses++;
+
+        // Stay on the grid; releases that are already a whole period old are skipped
+        next_release[i] = deadline;
+        while ((int32_t)(end - next_release[i]) >= (int32_t)period[i]) {
+            next_release[i] += period[i];
+            st->deadline_misses++;
+        }
+    }
+
+    Sched_Elapsed();
+}
+
+/* Accumulate wall time from the 32-bit microsecond counter before it can wrap */
+static void Sched_Elapsed(void)
+{
+    uint32_t now_us = sampler_micros();
+    elapsed_us += now_us - last_us;
+    last_us = now_us;
+}
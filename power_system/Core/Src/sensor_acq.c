@@ -0,0 +1,353 @@
+/*
+ * sensor_acq.c
+ *
+ * Non-blocking acquisition engine for the INA228 sensors on the sensor bus
+ * (i2c_bus.h, I2C1 or FMPI2C1).
+ * A sweep is a chain of interrupt-driven register reads: every completion
+ * callback stores the decoded register and launches the next transfer in
+ * the per-sensor transaction list. When the last sensor is finished the
+ * working snapshot is published and the engine goes idle until the main
+ * loop starts the next sweep. A sensor whose health check fails, or whose
+ * transfer errors out, is marked unhealthy and the sweep moves on.
+ *
+ * An accumulator sweep runs the same list with ENERGY and CHARGE appended.
+ *
+ * A conversion sweep (SENSOR_CNVR_SAMPLING) walks only the sensors whose
+ * ALERT line reported a new result, starting from a copy of the last
+ * published snapshot. Sensors that report while a sweep runs are queued and
+ * read by the next one, chained from the publish.
+ */
+
+#include "sensor_acq.h"
+#include "ina228_driver.h"
+#include "sampler.h"
+#include "scheduler.h"
+#include "i2c_bus.h"
+#include <string.h>
+
+/* Transaction list executed for every sensor, in order */
+typedef struct {
+    uint8_t reg;
+    uint8_t len;
+} AcqTransfer_t;
+
+static const AcqTransfer_t acq_xfers[] = {
+    { INA228_REG_DIAG_ALRT, 2 },    // Health check first, the remaining reads are skipped if it fails
+    { INA228_REG_VBUS,      3 },    // Measurement block, same order as INA228_ReadAll
+    { INA228_REG_CURRENT,   3 },
+    { INA228_REG_POWER,     3 },
+    { INA228_REG_VSHUNT,    3 },
+    { INA228_REG_DIETEMP,   2 },
+    { INA228_REG_ENERGY,    5 },    // Accumulator sweeps only, reading them clears ENERGYOF/CHARGEOF
+    { INA228_REG_CHARGE,    5 },
+};
+
+#define ACQ_NUM_XFERS       (sizeof(acq_xfers) / sizeof(acq_xfers[0]))
+#define ACQ_NUM_MEAS_XFERS  (ACQ_NUM_XFERS - 2)
+
+/* Sensor list */
+static uint8_t acq_addrs[ACQ_MAX_SENSORS];
+static uint8_t acq_num_sensors = 0;
+
+/* Double buffered snapshots: acq_work is filled by the ISR, acq_published is handed to the reader */
+static AcqSnapshot_t acq_snap[2];
+static uint8_t acq_work = 0;
+static volatile uint8_t acq_published = 1;
+static volatile uint8_t acq_fresh = 0;      // 1 = published snapshot not yet read
+static uint32_t acq_sequence = 0;
+
+/* Accumulator sweeps */
+static volatile uint8_t acq_accum_request = 0;
+static AcqAccum_t acq_accum;
+static volatile uint8_t acq_accum_fresh = 0;
+
+/* Sweep state */
+static volatile uint8_t acq_running = 0;
+static volatile uint8_t acq_cnvr_pending = 0;   // Sensors with a conversion ready and not read yet
+static volatile uint8_t acq_claimed = 0;    // Bus lent to blocking access between sweeps
+static uint8_t acq_sensor = 0;              // Sensor currently being read
+static uint8_t acq_xfer = 0;                // Position in acq_xfers for that sensor
+static uint8_t acq_num_xfers = ACQ_NUM_MEAS_XFERS;  // Transfers per sensor in this sweep
+static uint8_t acq_mask = 0;                // Sensors walked by this sweep
+static uint8_t acq_rx[5];                   // Receive buffer for the transfer in flight
+static uint32_t acq_start_tick = 0;
+
+/* Local Prototypes */
+static HAL_StatusTypeDef Acq_Start(AcqTrigger_t trigger, uint8_t mask);
+static void Acq_StartPending(void);
+static void Acq_LaunchNext(void);
+static void Acq_SkipSensor(void);
+static void Acq_Store(AcqSensorRaw_t* raw, uint8_t reg);
+static void Acq_Publish(void);
+
+/* Register the sensors walked by every sweep */
+void sensor_acq_init(const uint8_t* device_addrs, uint8_t num_sensors) {
+    if (num_sensors > ACQ_MAX_SENSORS) num_sensors = ACQ_MAX_SENSORS;
+
+    memset(acq_snap, 0, sizeof(acq_snap));
+    memcpy(acq_addrs, device_addrs, num_sensors);
+    acq_num_sensors = num_sensors;
+    acq_work = 0;
+    acq_published = 1;
+    acq_fresh = 0;
+    acq_accum_request = 0;
+    acq_accum_fresh = 0;
+    acq_running = 0;
+    acq_cnvr_pending = 0;
+    acq_claimed = 0;
+}
+
+/* Start a sweep over all sensors, returns HAL_BUSY if one is already running */
+HAL_StatusTypeDef sensor_acq_start_sweep(AcqTrigger_t trigger) {
+    return Acq_Start(trigger, (uint8_t)((1U << acq_num_sensors) - 1));
+}
+
+/* Queue a sensor whose ALERT line reported a new result, read now if the engine is idle */
+void sensor_acq_conversion_ready(uint8_t sensor) {
+    if (sensor >= acq_num_sensors) return;
+
+    acq_cnvr_pending |= (uint8_t)(1U << sensor);
+    Acq_StartPending();
+}
+
+uint8_t sensor_acq_busy(void) {
+    return acq_running;
+}
+
+/* Take the bus for blocking register access, no sweep starts until sensor_acq_release() */
+HAL_StatusTypeDef sensor_acq_claim(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    HAL_StatusTypeDef status = (acq_running || acq_claimed) ? HAL_BUSY : HAL_OK;
+    if (status == HAL_OK) acq_claimed = 1;
+    __set_PRIMASK(primask);
+    return status;
+}
+
+void sensor_acq_release(void) {
+    acq_claimed = 0;
+    Acq_StartPending();
+}
+
+/* Recover from a sweep that never completed (e.g. a sensor holding the bus) */
+void sensor_acq_poll(void) {
+    if (!acq_running) return;
+    if (HAL_GetTick() - acq_start_tick < ACQ_SWEEP_TIMEOUT_MS) return;
+
+    // Suspending also disables the bus interrupts, so no callback can race with the cleanup below.
+    // The claim keeps the publish from chaining a conversion sweep onto the suspended bus.
+    acq_claimed = 1;
+    i2c_bus_suspend();
+
+    if (acq_running) {
+        // Everything not read yet is reported unhealthy
+        while (acq_sensor < acq_num_sensors) {
+            if (acq_mask & (1U << acq_sensor)) Acq_SkipSensor();
+            else acq_sensor++;
+        }
+        Acq_Publish();
+    }
+
+    i2c_bus_resume();
+    sensor_acq_release();
+}
+
+/* Busy-wait for the running sweep, bounded by ACQ_SWEEP_TIMEOUT_MS */
+void sensor_acq_wait(void) {
+    while (acq_running) {
+        sensor_acq_poll();
+    }
+}
+
+/* Copy out the latest complete snapshot */
+uint8_t sensor_acq_get_snapshot(AcqSnapshot_t* snapshot) {
+    if (snapshot == NULL || !acq_fresh) return 0;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    *snapshot = acq_snap[acq_published];
+    acq_fresh = 0;
+    __set_PRIMASK(primask);
+
+    return 1;
+}
+
+/* Make the next sweep an accumulator sweep, whoever starts it */
+void sensor_acq_request_accum(void) {
+    acq_accum_request = 1;
+}
+
+/* Copy out the accumulators of the latest accumulator sweep */
+uint8_t sensor_acq_get_accum(AcqAccum_t* accum) {
+    if (accum == NULL || !acq_accum_fresh) return 0;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    *accum = acq_accum;
+    acq_accum_fresh = 0;
+    __set_PRIMASK(primask);
+
+    return 1;
+}
+
+/* Start a sweep over the sensors in mask; an accumulator request widens it to all of them */
+static HAL_StatusTypeDef Acq_Start(AcqTrigger_t trigger, uint8_t mask) {
+    if (acq_num_sensors == 0 || mask == 0) return HAL_BUSY;
+
+    // The sampler tick, the FSM poll and the ALERT lines can race for the engine
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (acq_running || acq_claimed) {
+        __set_PRIMASK(primask);
+        return HAL_BUSY;
+    }
+    acq_running = 1;
+    uint8_t accum = acq_accum_request;
+    acq_accum_request = 0;
+    if (accum) mask = (uint8_t)((1U << acq_num_sensors) - 1);
+    acq_cnvr_pending &= (uint8_t)~mask;     // This sweep reads their results
+    __set_PRIMASK(primask);
+
+    // Sensors left out keep the values they were last published with
+    AcqSnapshot_t* snap = &acq_snap[acq_work];
+    memcpy(snap->sensor, acq_snap[acq_published].sensor, sizeof(snap->sensor));
+    for (uint8_t i = 0; i < acq_num_sensors; i++) {
+        if (mask & (1U << i)) memset(&snap->sensor[i], 0, sizeof(snap->sensor[i]));
+    }
+    snap->timestamp_us = sampler_micros();
+    snap->trigger = trigger;
+    snap->accum = accum;
+    snap->read_mask = mask;
+
+    acq_num_xfers = accum ? ACQ_NUM_XFERS : ACQ_NUM_MEAS_XFERS;
+    acq_mask = mask;
+    acq_start_tick = HAL_GetTick();
+    acq_sensor = 0;
+    acq_xfer = 0;
+
+    Acq_LaunchNext();
+    return HAL_OK;
+}
+
+/* Read the queued conversion-ready sensors. While the sampler runs, its full sweeps pick up every result. */
+static void Acq_StartPending(void) {
+    if (acq_cnvr_pending && !sampler_running()) Acq_Start(ACQ_TRIGGER_CNVR, acq_cnvr_pending);
+}
+
+/* Launch reads until the HAL accepts one, or publish if every sensor is done */
+static void Acq_LaunchNext(void) {
+    while (acq_sensor < acq_num_sensors) {
+        if (!(acq_mask & (1U << acq_sensor))) {
+            acq_sensor++;
+            continue;
+        }
+        const AcqTransfer_t* xfer = &acq_xfers[acq_xfer];
+        if (INA228_ReadRegister_IT(acq_addrs[acq_sensor], xfer->reg, acq_rx, xfer->len) == HAL_OK) {
+            return; // Continues in the completion callback
+        }
+        Acq_SkipSensor();
+    }
+    Acq_Publish();
+}
+
+/* Mark the current sensor unhealthy and move on to the next one */
+static void Acq_SkipSensor(void) {
+    acq_snap[acq_work].sensor[acq_sensor].healthy = 0;
+    acq_sensor++;
+    acq_xfer = 0;
+}
+
+/* Decode the completed transfer into the working snapshot */
+static void Acq_Store(AcqSensorRaw_t* raw, uint8_t reg) {
+    if (reg == INA228_REG_DIAG_ALRT) {
+        raw->diag_alrt = INA228_Decode16bit(acq_rx);
+        raw->healthy = (raw->diag_alrt & INA228_DIAG_MEMSTAT) ? 1 : 0;
+    } else if (!INA228_DecodeAccumulator(reg, acq_rx, &raw->accum)) {
+        INA228_DecodeMeasurement(reg, acq_rx, &raw->meas);
+    }
+}
+
+/* Hand the working snapshot to the reader and swap buffers */
+static void Acq_Publish(void) {
+    const AcqSnapshot_t* snap = &acq_snap[acq_work];
+
+    if (snap->accum) {
+        acq_accum.valid_mask = 0;
+        for (uint8_t i = 0; i < acq_num_sensors; i++) {
+            acq_accum.sensor[i] = snap->sensor[i].accum;
+            acq_accum.diag_alrt[i] = snap->sensor[i].diag_alrt;
+            if (snap->sensor[i].healthy) acq_accum.valid_mask |= (uint8_t)(1U << i);
+        }
+        acq_accum.timestamp_us = snap->timestamp_us;
+        acq_accum_fresh = 1;
+    }
+
+    acq_snap[acq_work].sequence = ++acq_sequence;
+    acq_published = acq_work;
+    acq_work ^= 1;
+    acq_fresh = 1;
+    acq_running = 0;
+
+    sensor_acq_sweep_callback(&acq_snap[acq_published]);
+    sched_signal(SCHED_EV_SWEEP_DONE);  // Wake the tasks that consume snapshots
+
+    // Results that became ready during this sweep
+    Acq_StartPending();
+}
+
+/* Default publish hook, overridden by the UART logger */
+__weak void sensor_acq_sweep_callback(const AcqSnapshot_t* snapshot) {
+    UNUSED(snapshot);
+}
+
+/* Default limit hook, overridden by the precharge FSM */
+__weak void sensor_acq_limit_callback(uint8_t sensor, uint16_t diag_alrt) {
+    UNUSED(sensor);
+    UNUSED(diag_alrt);
+}
+
+/*
+ * Bus callback: called from the I2C interrupt when a register read finishes.
+ * A good read is stored and the next transfer chained. On NACK, bus error or
+ * arbitration loss the sensor is reported unhealthy and the sweep continues
+ * with the next one.
+ */
+void i2c_bus_read_callback(HAL_StatusTypeDef status) {
+    if (!acq_running) return;
+
+    if (status != HAL_OK) {
+        Acq_SkipSensor();
+        Acq_LaunchNext();
+        return;
+    }
+
+    AcqSnapshot_t* snap = &acq_snap[acq_work];
+    AcqSensorRaw_t* raw = &snap->sensor[acq_sensor];
+    uint8_t reg = acq_xfers[acq_xfer].reg;
+    Acq_Store(raw, reg);
+
+#if SENSOR_CNVR_SAMPLING
+    // ALERT also reports conversions, so a limit trip is only known once DIAG_ALRT is read
+    if (reg == INA228_REG_DIAG_ALRT && raw->healthy) {
+        if (raw->diag_alrt & INA228_DIAG_LIMIT_FLAGS) sensor_acq_limit_callback(acq_sensor, raw->diag_alrt);
+
+        // A poll or sampler sweep already read this result (accumulator sweeps read everything)
+        if (snap->trigger == ACQ_TRIGGER_CNVR && !snap->accum && !(raw->diag_alrt & INA228_DIAG_CNVRF)) {
+            raw->meas = acq_snap[acq_published].sensor[acq_sensor].meas;
+            snap->read_mask &= (uint8_t)~(1U << acq_sensor);
+            acq_sensor++;
+            acq_xfer = 0;
+            Acq_LaunchNext();
+            return;
+        }
+    }
+#endif
+
+    if (!raw->healthy) {
+        Acq_SkipSensor();
+    } else if (++acq_xfer >= acq_num_xfers) {
+        acq_sensor++;
+        acq_xfer = 0;
+    }
+    Acq_LaunchNext();
+}
@@ -2,82 +2,102 @@
  * telemetry.c
  *
  * CAN telemetry module for the exoskeleton power architecture system.
- * On each tick, reads the latest voltage and current from all enabled
- * INA228 sensors, pushes values through per-sensor circular buffers to
- * compute rolling averages, then packs the results into 7-byte CAN frames
- * (IDs 0x100–0x104) and transmits them on CAN1. 
+ * On each tick, reads the latest measurements from all enabled INA228
+ * sensors, pushes voltage, current and power through per-sensor circular
+ * buffers, then sends one status frame (0x100) and one multiplexed
+ * measurement frame (0x101) per sensor. Byte 0 of a measurement frame
+ * names the sensor and page, so all sensors share one ID and the frame
+ * decodes on its own. The diagnostic page of each sensor goes out once
+ * every TELEMETRY_DIAG_DIVIDER ticks, one sensor per tick. Frames are
+ * queued for CAN1 through can_tx, so a tick never waits for a free TX
+ * mailbox.
+ *
+ * The transmission policy decides which of these frames actually go out.
+ * Periodic mode sends them all. On-change mode remembers what each frame
+ * last carried and skips it while every value stays inside its deadband
+ * and the heartbeat is not due; the filters are still fed every tick.
+ * The status task sends the status frame as soon as precharge reports a
+ * transition, without waiting for the tick.
+ *
+ * The set of sensors sent is a runtime mask. A snapshot request sends the
+ * status frame and both pages of every enabled sensor at once, from the
+ * current filter outputs.
+ *
+ * With SENSOR_FIXED_POINT the buffers filter raw INA228 codes and the
+ * outputs are converted to frame units with precomputed Q24 multipliers,
+ * so no float math runs per sample. Values outside a frame field saturate
+ * instead of wrapping in both modes.
  */
 
 #include "telemetry.h"
-#include "can.h"
+#include "can_tx.h"
+#include "scheduler.h"
+#include "profile.h"
 #include <string.h>
 
+#define UNIT_Q              24      // Fractional bits of the code -> frame unit multipliers
+#define INT24_MAX           8388607
+#define INT24_MIN           (-8388608)
+#define STATUS_CONTENT      5       // Status frame bytes compared for a change (all but the sequence counter)
+#define DIAG_TX_FLAGS       (INA228_DIAG_LIMIT_FLAGS | INA228_DIAG_ENERGYOF | INA228_DIAG_CHARGEOF)    // CNVRF toggles every result
+
 // Circular Buffers for all 5 Sensors
 // Index corresponds to INA228_Location_t: BUS=0, MOTOR1=1 ... MOTOR4=4
 CircularBuffer_t g_voltage_buf[NUM_SENSORS];
 CircularBuffer_t g_current_buf[NUM_SENSORS];
+CircularBuffer_t g_power_buf[NUM_SENSORS];
+
+// Enabled sensors for CAN channel, bit n = sensor n
+static uint8_t sensor_mask = SENSOR_ENABLED_MASK;
+
+static uint8_t status_seq = 0;      // Status frame counter, a gap means a lost frame
+static uint8_t diag_slot = 0;       // Tick within the TELEMETRY_DIAG_DIVIDER cycle
+static uint8_t tx_mode = TELEMETRY_TX_MODE;
+
+// Frame contents as last sent, and when, for the on-change policy
+static uint8_t  status_sent[STATUS_CONTENT];
+static uint32_t status_sent_ms;
 
-// Sensor configuration table
 typedef struct {
-    INA228_Location_t location;
-    uint16_t          can_id;
-    uint8_t           enabled;
-} SensorConfig_t;
-
-static SensorConfig_t sensors[NUM_SENSORS] = {
-    { INA228_BUS,    CAN_ID_BUS,    0 },
-    { INA228_MOTOR1, CAN_ID_MOTOR1, 0 },
-    { INA228_MOTOR2, CAN_ID_MOTOR2, 0 },
-    { INA228_MOTOR3, CAN_ID_MOTOR3, 0 },
-    { INA228_MOTOR4, CAN_ID_MOTOR4, 0 },
-};
-
-// Enabled sensors for CAN channel
-static const uint8_t enabled[NUM_SENSORS] = SENSOR_ENABLED;
+	int32_t  mv, ma, dw;        // Electrical page
+	uint32_t electrical_ms;
+	int32_t  temp;              // Diagnostic page
+	uint16_t diag_flags;        // DIAG_TX_FLAGS bits of DIAG_ALRT
+	uint32_t diag_ms;
+} SentValues_t;
 
-/**
- * @brief CAN: Send one sensor frame
- *
- * Frame layout (DLC = 7):
- *   Byte 0-1 : voltage * 100  (int16, little-endian) -> divide by 100 on receiver
- *   Byte 2-3 : current * 100  (int16, little-endian) -> divide by 100 on receiver
- *   Byte 4	  : relay/contactor status (1 = closed)
- *   Byte 5   : sensor status		   (1 = healthy)
- *   Byte 6   : system fault		   (1 = fault active, bus frame only)
- *
- */
-static void CAN_Send_INA228_Frame(uint16_t can_id, float voltage, float current, uint8_t closed, uint8_t sensor_status, uint8_t fault)
-{
-	CAN_TxHeaderTypeDef TxHeader;
-	uint8_t  TxData[8] = {0};
-	uint32_t TxMailbox;
-
-    TxHeader.StdId = can_id;
-    TxHeader.IDE   = CAN_ID_STD;
-    TxHeader.RTR   = CAN_RTR_DATA;
-    TxHeader.DLC   = 7;
-
-    // Scale floats by 100 to preserve 2 decimal places as integers
-    int16_t v = (int16_t)(voltage * 100.0f);
-    int16_t c = (int16_t)(current * 100.0f);
-
-    TxData[0] = v & 0xFF;			// Voltage LSB
-    TxData[1] = (v >> 8) & 0xFF;	// Voltage MSB
-    TxData[2] = c & 0xFF;			// Current LSB
-    TxData[3] = (c >> 8) & 0xFF;	// Current MSB
-    TxData[4] = closed;				// Relay or contactor status
-    TxData[5] = sensor_status;		// Sensor status
-	TxData[6] = fault;				// System fault
-
-	// Send CAN frame if there's a free mailbox
-    if (HAL_CAN_GetTxMailboxesFreeLevel(&hcan1) > 0) {
-        HAL_StatusTypeDef ret = HAL_CAN_AddTxMessage(&hcan1, &TxHeader, TxData, &TxMailbox);
-        if (ret != HAL_OK){
-        	HAL_GPIO_TogglePin(LD2_GPIO_Port, LD2_Pin); // Blink if not sending data
-        }
+static SentValues_t sent[NUM_SENSORS];
 
-    }
-}
+#if TELEMETRY_DIAG_DIVIDER < NUM_SENSORS
+#error "TELEMETRY_DIAG_DIVIDER must leave one tick per sensor for the diagnostic page"
+#endif
+
+#if SENSOR_FIXED_POINT
+// Frame units per code in Q24: VBUS, DIETEMP and VSHUNT are fixed, CURRENT and POWER depend on each sensor's calibration
+static const int64_t vbus_milli_q   = (int64_t)(INA228_VBUS_LSB * 1000.0f * (1 << UNIT_Q) + 0.5f);
+static const int64_t temp_centi_q   = (int64_t)(INA228_DIETEMP_LSB * 100.0f * (1 << UNIT_Q) + 0.5f);
+static const int64_t vshunt_deci_q  = (int64_t)(INA228_VSHUNT_LSB * 1.0e7f * (1 << UNIT_Q) + 0.5f);
+static int64_t current_milli_q[NUM_SENSORS];
+static int64_t power_deci_q[NUM_SENSORS];
+#endif
+
+/* Local Prototypes */
+static void Filters_Init(uint8_t sensor);
+static void Electrical_Values(uint8_t sensor, int32_t* milli_volts, int32_t* milli_amps, int32_t* deci_watts);
+static void Diag_Values(uint8_t sensor, int32_t* centi_degc, int32_t* vshunt_deci_uv);
+static void Status_Update(uint8_t force);
+static void Status_Fill(uint8_t* TxData);
+static void Heartbeats_Due(void);
+static uint8_t Outside(int32_t value, int32_t last, int32_t deadband);
+static void CAN_Send_Electrical_Frame(uint8_t sensor, int32_t milli_volts, int32_t milli_amps, int32_t deci_watts);
+static void CAN_Send_Diag_Frame(uint8_t sensor, int32_t centi_degc, int32_t vshunt_deci_uv, uint16_t diag_alrt);
+#if SENSOR_FIXED_POINT
+static int32_t Code_To_Units(int32_t code, int64_t unit_q);
+#else
+static int32_t Round_To_Int(float value);
+#endif
+static int32_t Saturate(int32_t value, int32_t min, int32_t max);
+static void Put_LE(uint8_t* dst, uint32_t value, uint8_t bytes);
 
 
 // Public API Functions
@@ -88,40 +108,321 @@ static void CAN_Send_INA228_Frame(uint16_t can_id, float voltage, float current,
 void telemetry_init(void)
 {
 	for(int i = 0; i < NUM_SENSORS; i++){
-		circ_buf_init(&g_voltage_buf[i]);
-		circ_buf_init(&g_current_buf[i]);
-		sensors[i].enabled = enabled[i]; // Disabled sensors will be set to 0
+		Filters_Init(i);
+#if SENSOR_FIXED_POINT
+		current_milli_q[i] = (int64_t)(g_sensor_table[i].current_lsb * 1000.0f * (1 << UNIT_Q) + 0.5f);
+		power_deci_q[i]    = (int64_t)(g_sensor_table[i].power_lsb * 10.0f * (1 << UNIT_Q) + 0.5f);
+#endif
 	}
+	Heartbeats_Due();  // Everything goes out on the first tick
 }
 
 void telemetry_tick(void)
 {
-	uint8_t closed = (get_current_state() == STATE_NORMAL_OPERATION);  // Relay or contactor closed
-    uint8_t fault = get_current_fault(); 		  					   // System fault
+    uint8_t periodic = (tx_mode == TELEMETRY_TX_PERIODIC);
+    uint32_t now = HAL_GetTick();
+    PROFILE_BEGIN(PROF_TELEMETRY_TICK);
 
     HAL_GPIO_TogglePin(LD2_GPIO_Port, LD2_Pin); // Debugging
 
-    // Send CAN frames for all sensors
+    // Status first: lowest ID, so it also wins arbitration against the measurement frames
+    Status_Update(periodic);
+
     for (uint8_t i = 0; i < NUM_SENSORS; i++) {
 
-        if (!sensors[i].enabled) continue; // Skip disabled sensors
+        if (!(sensor_mask & (1U << i))) continue; // Skip disabled sensors
+
+        // Latest sensor reading, read in place (same context as the FSM that updates it)
+        const SensorData_t* sensor = &g_system_status.sensor[i];
+
+        // Push sensor data into rolling filters, then take the filtered values in frame units
+#if SENSOR_FIXED_POINT
+        circ_buf_push(&g_voltage_buf[i], sensor->raw.vbus);
+        circ_buf_push(&g_current_buf[i], sensor->raw.current);
+        circ_buf_push(&g_power_buf[i], (circ_sample_t)sensor->raw.power);
+#else
+        circ_buf_push(&g_voltage_buf[i], sensor->voltage);
+        circ_buf_push(&g_current_buf[i], sensor->current);
+        circ_buf_push(&g_power_buf[i], sensor->power);
+#endif
+        int32_t mv, ma, dw;
+        Electrical_Values(i, &mv, &ma, &dw);
+
+        const SentValues_t* last = &sent[i];
+        if (periodic || now - last->electrical_ms >= TELEMETRY_HEARTBEAT_MS
+                || Outside(mv, last->mv, VOLTAGE_DEADBAND_MV) || Outside(ma, last->ma, CURRENT_DEADBAND_MA)
+                || Outside(dw, last->dw, POWER_DEADBAND_DW)) {
+            CAN_Send_Electrical_Frame(i, mv, ma, dw);
+        }
+
+        // Diagnostic page, latest (unfiltered) values of one sensor per tick
+        if (i == diag_slot) {
+            int32_t temp, vshunt;
+            Diag_Values(i, &temp, &vshunt);
+            if (periodic || now - last->diag_ms >= TELEMETRY_DIAG_HEARTBEAT_MS
+                    || Outside(temp, last->temp, TEMP_DEADBAND_CENTI)
+                    || (sensor->diag_alrt & DIAG_TX_FLAGS) != last->diag_flags) {
+                CAN_Send_Diag_Frame(i, temp, vshunt, sensor->diag_alrt);
+            }
+        }
+    }
+
+    diag_slot = (diag_slot + 1) % TELEMETRY_DIAG_DIVIDER;
+
+    PROFILE_END(PROF_TELEMETRY_TICK);
+}
+
+/* Released by telemetry_notify_status(): a transition goes out without waiting for the tick */
+void telemetry_status_task(void)
+{
+    if (tx_mode == TELEMETRY_TX_ON_CHANGE) Status_Update(0);
+}
+
+void telemetry_notify_status(void)
+{
+    sched_signal(SCHED_EV_STATUS);
+}
 
-        // Obtain latest sensor reading
-        SensorData_t raw;
-        get_sensor_data(sensors[i].location, &raw);
+/*
+ * @brief Select the transmission policy
+ *
+ * Every frame is due again on the next tick, so the receiver starts from a
+ * complete picture in either mode.
+ * @retval HAL_ERROR for an unknown mode
+ */
+HAL_StatusTypeDef telemetry_set_tx_mode(uint8_t mode)
+{
+    if (mode != TELEMETRY_TX_PERIODIC && mode != TELEMETRY_TX_ON_CHANGE) return HAL_ERROR;
 
-        // Push sensor data into rolling averages
-        circ_buf_push(&g_voltage_buf[i], raw.voltage);
-        circ_buf_push(&g_current_buf[i], raw.current);
+    tx_mode = mode;
+    Heartbeats_Due();
+    return HAL_OK;
+}
 
-        // Obtain average values
-        float v_avg = circ_buf_average(&g_voltage_buf[i]);
-        float c_avg = circ_buf_average(&g_current_buf[i]);
+uint8_t telemetry_tx_mode(void)
+{
+    return tx_mode;
+}
+
+/*
+ * @brief Select the sensors sent on CAN (bit n = INA228_Location_t n)
+ *
+ * A sensor switched back on restarts its filters, so its first frames do
+ * not average in samples from before it was switched off.
+ * @retval HAL_ERROR if a bit past the last sensor is set
+ */
+HAL_StatusTypeDef telemetry_set_sensor_mask(uint8_t mask)
+{
+    if (mask >> NUM_SENSORS) return HAL_ERROR;
 
-        // Send CAN frame of 1 sensor
-        CAN_Send_INA228_Frame(sensors[i].can_id, v_avg, c_avg, closed, raw.healthy, fault);
-        HAL_Delay(1);
+    for (uint8_t i = 0; i < NUM_SENSORS; i++) {
+        if ((mask & ~sensor_mask) & (1U << i)) Filters_Init(i);
     }
+    sensor_mask = mask;
+    return HAL_OK;
+}
+
+uint8_t telemetry_sensor_mask(void)
+{
+    return sensor_mask;
 }
 
+/*
+ * @brief Send the status frame and both pages of every enabled sensor now
+ *
+ * The electrical page carries the current filter outputs; no sample is
+ * pushed, so the filters and the diagnostic slot are not disturbed.
+ */
+void telemetry_send_snapshot(void)
+{
+    Status_Update(1);
 
+    for (uint8_t i = 0; i < NUM_SENSORS; i++) {
+        if (!(sensor_mask & (1U << i))) continue;
+
+        int32_t mv, ma, dw, temp, vshunt;
+        Electrical_Values(i, &mv, &ma, &dw);
+        Diag_Values(i, &temp, &vshunt);
+        CAN_Send_Electrical_Frame(i, mv, ma, dw);
+        CAN_Send_Diag_Frame(i, temp, vshunt, g_system_status.sensor[i].diag_alrt);
+    }
+}
+
+static void Filters_Init(uint8_t sensor)
+{
+    circ_buf_init(&g_voltage_buf[sensor], VOLTAGE_FILTER_KIND, VOLTAGE_FILTER_WINDOW);
+    circ_buf_init(&g_current_buf[sensor], CURRENT_FILTER_KIND, CURRENT_FILTER_WINDOW);
+    circ_buf_init(&g_power_buf[sensor], POWER_FILTER_KIND, POWER_FILTER_WINDOW);
+}
+
+/* Filter outputs of one sensor in electrical page units */
+static void Electrical_Values(uint8_t sensor, int32_t* milli_volts, int32_t* milli_amps, int32_t* deci_watts)
+{
+#if SENSOR_FIXED_POINT
+    *milli_volts = Code_To_Units(circ_buf_average(&g_voltage_buf[sensor]), vbus_milli_q);
+    *milli_amps  = Code_To_Units(circ_buf_average(&g_current_buf[sensor]), current_milli_q[sensor]);
+    *deci_watts  = Code_To_Units(circ_buf_average(&g_power_buf[sensor]), power_deci_q[sensor]);
+#else
+    *milli_volts = Round_To_Int(circ_buf_average(&g_voltage_buf[sensor]) * 1000.0f);
+    *milli_amps  = Round_To_Int(circ_buf_average(&g_current_buf[sensor]) * 1000.0f);
+    *deci_watts  = Round_To_Int(circ_buf_average(&g_power_buf[sensor]) * 10.0f);
+#endif
+}
+
+/* Latest unfiltered reading of one sensor in diagnostic page units */
+static void Diag_Values(uint8_t sensor, int32_t* centi_degc, int32_t* vshunt_deci_uv)
+{
+    const SensorData_t* data = &g_system_status.sensor[sensor];
+#if SENSOR_FIXED_POINT
+    *centi_degc     = Code_To_Units(data->raw.dietemp, temp_centi_q);
+    *vshunt_deci_uv = Code_To_Units(data->raw.vshunt, vshunt_deci_q);
+#else
+    *centi_degc     = Round_To_Int(data->temperature * 100.0f);
+    *vshunt_deci_uv = Round_To_Int(data->shunt_voltage * 1.0e7f);
+#endif
+}
+
+/* Send the status frame if forced, if its content changed or if its heartbeat is due */
+static void Status_Update(uint8_t force)
+{
+    uint8_t TxData[6];
+    uint32_t now = HAL_GetTick();
+
+    Status_Fill(TxData);
+    if (!force && memcmp(TxData, status_sent, STATUS_CONTENT) == 0 && now - status_sent_ms < TELEMETRY_HEARTBEAT_MS) return;
+
+    memcpy(status_sent, TxData, STATUS_CONTENT);
+    status_sent_ms = now;
+    TxData[5] = status_seq++;
+    can_tx_send(CAN_ID_STATUS, TxData, 6);
+}
+
+/* Backdate every last-sent time by its heartbeat, so each frame goes out at its next chance */
+static void Heartbeats_Due(void)
+{
+    uint32_t now = HAL_GetTick();
+
+    status_sent_ms = now - TELEMETRY_HEARTBEAT_MS;
+    for (uint8_t i = 0; i < NUM_SENSORS; i++) {
+        sent[i].electrical_ms = now - TELEMETRY_HEARTBEAT_MS;
+        sent[i].diag_ms = now - TELEMETRY_DIAG_HEARTBEAT_MS;
+    }
+}
+
+/* 1 if value moved more than deadband away from the value last sent */
+static uint8_t Outside(int32_t value, int32_t last, int32_t deadband)
+{
+    return (value - last > deadband) || (last - value > deadband);
+}
+
+/**
+ * @brief CAN: Fill the status frame
+ *
+ * Frame layout (DLC = 6):
+ *   Byte 0 : FSM state (PrechargeState_t)
+ *   Byte 1 : fault code (FaultType_t, 0 = none)
+ *   Byte 2 : fault sensors, bit n = sensor n tripped a limit (latched with the fault)
+ *   Byte 3 : sensor health, bit n = sensor n healthy
+ *   Byte 4 : relays, bit 0 = contactor closed, bit n = motor n relay closed
+ *   Byte 5 : sequence counter (set by Status_Update, counts frames actually sent)
+ */
+static void Status_Fill(uint8_t* TxData)
+{
+	uint8_t health = 0;
+
+	for (uint8_t i = 0; i < NUM_SENSORS; i++) {
+		if ((sensor_mask & (1U << i)) && g_system_status.sensor[i].healthy) health |= (uint8_t)(1 << i);
+	}
+
+	TxData[0] = (uint8_t)get_current_state();
+	TxData[1] = (uint8_t)get_current_fault();
+	TxData[2] = get_fault_sensors();
+	TxData[3] = health;
+	TxData[4] = get_relay_status();
+}
+
+/**
+ * @brief CAN: Send the electrical page of one sensor
+ *
+ * Frame layout (DLC = 8, little-endian, filtered, saturated):
+ *   Byte 0   : MEAS_MUX(MEAS_PAGE_ELECTRICAL, sensor)
+ *   Byte 1-2 : voltage in mV (uint16, 0..65.535 V)
+ *   Byte 3-5 : current in mA (int24, ±8388 A)
+ *   Byte 6-7 : power in 0.1 W (uint16, 0..6553.5 W)
+ */
+static void CAN_Send_Electrical_Frame(uint8_t sensor, int32_t milli_volts, int32_t milli_amps, int32_t deci_watts)
+{
+	uint8_t TxData[8];
+
+	TxData[0] = MEAS_MUX(MEAS_PAGE_ELECTRICAL, sensor);
+	Put_LE(&TxData[1], (uint32_t)Saturate(milli_volts, 0, UINT16_MAX), 2);
+	Put_LE(&TxData[3], (uint32_t)Saturate(milli_amps, INT24_MIN, INT24_MAX), 3);
+	Put_LE(&TxData[6], (uint32_t)Saturate(deci_watts, 0, UINT16_MAX), 2);
+
+	// Queued in CAN ID order, same-ID frames keep their order; the TX mailbox interrupts put them on the bus
+	can_tx_send(CAN_ID_MEAS, TxData, 8);
+
+	// The on-change policy compares the next values with these
+	sent[sensor].mv = milli_volts;
+	sent[sensor].ma = milli_amps;
+	sent[sensor].dw = deci_watts;
+	sent[sensor].electrical_ms = HAL_GetTick();
+}
+
+/**
+ * @brief CAN: Send the diagnostic page of one sensor
+ *
+ * Frame layout (DLC = 8, little-endian, saturated):
+ *   Byte 0   : MEAS_MUX(MEAS_PAGE_DIAG, sensor)
+ *   Byte 1-2 : die temperature in 0.01 °C (int16)
+ *   Byte 3-5 : shunt voltage in 0.1 uV (int24, covers the full ±163.84 mV range)
+ *   Byte 6-7 : DIAG_ALRT register of the last good sweep (uint16)
+ */
+static void CAN_Send_Diag_Frame(uint8_t sensor, int32_t centi_degc, int32_t vshunt_deci_uv, uint16_t diag_alrt)
+{
+	uint8_t TxData[8];
+
+	TxData[0] = MEAS_MUX(MEAS_PAGE_DIAG, sensor);
+	Put_LE(&TxData[1], (uint32_t)Saturate(centi_degc, INT16_MIN, INT16_MAX), 2);
+	Put_LE(&TxData[3], (uint32_t)Saturate(vshunt_deci_uv, INT24_MIN, INT24_MAX), 3);
+	Put_LE(&TxData[6], diag_alrt, 2);
+
+	can_tx_send(CAN_ID_MEAS, TxData, 8);
+
+	sent[sensor].temp = centi_degc;
+	sent[sensor].diag_flags = diag_alrt & DIAG_TX_FLAGS;
+	sent[sensor].diag_ms = HAL_GetTick();
+}
+
+#if SENSOR_FIXED_POINT
+/* code x (frame units per code), rounded to nearest */
+static int32_t Code_To_Units(int32_t code, int64_t unit_q)
+{
+	int64_t scaled = (int64_t)code * unit_q;
+	return (int32_t)((scaled + ((int64_t)1 << (UNIT_Q - 1))) >> UNIT_Q);
+}
+#else
+/* Round to nearest, clamped first so an out-of-range float cannot overflow the conversion */
+static int32_t Round_To_Int(float value)
+{
+	if (value > 2.0e9f) return 2000000000;
+	if (value < -2.0e9f) return -2000000000;
+	return (int32_t)(value >= 0.0f ? value + 0.5f : value - 0.5f);
+}
+#endif
+
+/* Clamp to a frame field's range, so e.g. an overrange current reads full scale instead of wrapping */
+static int32_t Saturate(int32_t value, int32_t min, int32_t max)
+{
+	if (value > max) return max;
+	if (value < min) return min;
+	return value;
+}
+
+/* Little-endian, lowest `bytes` bytes of value (two's complement for negative fields) */
+static void Put_LE(uint8_t* dst, uint32_t value, uint8_t bytes)
+{
+	for (uint8_t b = 0; b < bytes; b++) {
+		dst[b] = (value >> (8 * b)) & 0xFF;
+	}
+}
@@ -0,0 +1,362 @@
+/*
+ * uart_logger.c
+ *
+ * Streaming UART data logger.
+ *
+ * The sampler timer starts a sweep on every tick. Sweeps it triggered are
+ * packed into one record each (timestamp, valid bits, then the selected
+ * fields of every selected sensor in ID order) straight into log_queue from
+ * the publish hook, which runs in the I2C ISR; sweeps never overlap, so the
+ * hook is the only producer and the main loop the only consumer. Records
+ * have a fixed size for the whole capture, set by the sensor mask and
+ * fields, and the queue holds as many of them as fit, so a narrow capture
+ * rides out longer UART stalls. The main loop moves queued records into the
+ * batch and frames it into the "fill" buffer. Whenever the DMA channel is
+ * idle the fill buffer is handed to HAL_UART_Transmit_DMA and the other
+ * buffer becomes the new fill buffer, so encoding and transmission overlap.
+ *
+ * A bus-only V/I/P sample costs 13 bytes (timestamp, valid bits, raw codes)
+ * inside a 16-record frame (~13.7 bytes on the wire) instead of a ~25 byte
+ * CSV row, and no float formatting is done on the MCU. Every further sensor
+ * in the same capture adds only its 8 bytes of codes. If the queue or the UART cannot keep
+ * up, samples are dropped instead of stalling the loop; the host sees the gap
+ * in the frame sequence and the END frame carries the dropped and overrun
+ * counts.
+ */
+
+#include "uart_logger.h"
+#include "usart.h"
+#include "precharge.h"
+#include "sensor_acq.h"
+#include "log_frame.h"
+#include <string.h>
+
+#define LOG_SAMPLES_HEADER_SIZE 4   // type, seq, count ahead of the records
+
+// Double-buffered TX pipeline
+static char tx_buf[2][LOG_TX_BUF_SIZE];
+static uint16_t tx_len[2];
+static uint8_t fill_idx;                // Buffer currently being written by the main loop
+static volatile uint8_t tx_busy;        // Set while DMA owns the other buffer
+
+// Capture state
+static volatile uint8_t active;
+static uint8_t info_pending;            // INFO frame goes out on the first tick, after the OK reply
+static uint32_t rate;
+static uint8_t sensor_mask;             // Sensors captured, bit per INA228_Location_t
+static uint8_t fields;                  // LOG_FIELD_* bits
+static uint8_t sample_size;             // Bytes per packed sample
+static uint8_t record_size;             // Bytes per sweep record
+static uint8_t batch_max;               // Records per SAMPLES frame
+static uint32_t dropped;                // Samples lost because a frame did not fit in the TX buffer
+static uint16_t frame_seq;
+static uint8_t end_frame[LOG_FRAME_MAX_ENCODED];
+static uint16_t end_len;                // Nonzero while the END frame waits for room in the fill buffer
+
+// ISR -> main loop sweep queue, q_depth records of record_size bytes
+static uint8_t log_queue[LOG_QUEUE_DEPTH * LOG_RECORD_MAX_SIZE];
+static uint8_t q_depth;
+static volatile uint8_t q_head, q_tail;
+static volatile uint32_t q_dropped;     // Sweeps lost because the queue was full
+
+// Payload of the next LOG_FRAME_SAMPLES frame, records from LOG_SAMPLES_HEADER_SIZE on
+static uint8_t batch[LOG_FRAME_MAX_PAYLOAD];
+static uint8_t batch_count;
+static uint32_t batch_start_ms;
+
+/* Local Prototypes */
+static uint8_t Logger_Write(const void* data, uint16_t len);
+static void Logger_Flush(void);
+static uint8_t Logger_SendFrame(const uint8_t* payload, uint16_t len);
+static void Logger_SendInfo(void);
+static void Logger_AddRecord(const uint8_t* record);
+static void Logger_SendBatch(void);
+static void Logger_Finish(void);
+static uint16_t Put16(uint8_t* p, uint16_t v);
+static uint16_t Put32(uint8_t* p, uint32_t v);
+static const char* Fault_Message(FaultType_t fault);
+
+void uart_logger_init(void)
+{
+    tx_len[0] = tx_len[1] = 0;
+    fill_idx = 0;
+    tx_busy = 0;
+    active = 0;
+    end_len = 0;
+}
+
+/**
+  * @brief Start streaming samples and reply to the host
+  *
+  * Replies OK on success. Refuses to start (and reports the latched fault to the host instead)
+  * if the bus sensor is unhealthy, or replies ERR if the rate/duration is out of range or
+  * no sensor or field is selected.
+  * @param mask: Sensors captured, bit per INA228_Location_t
+  * @param field_bits: Raw codes captured per sensor, LOG_FIELD_* bits
+  * @retval 1 if the capture started
+  */
+uint8_t uart_logger_start(uint32_t rate_hz, uint32_t duration_s, uint8_t mask, uint8_t field_bits)
+{
+    if (rate_hz == 0 || rate_hz > LOG_MAX_RATE_HZ || duration_s > UINT32_MAX / rate_hz
+        || mask == 0 || (mask >> INA228_NUM_SENSORS) || field_bits == 0 || (field_bits & ~LOG_FIELDS_ALL)) {
+        uart_logger_send("ERR\n");
+        return 0;
+    }
+
+    SensorData_t sensor;
+    get_sensor_data(INA228_BUS, &sensor);
+    if (!sensor.healthy) {
+        uart_logger_send(Fault_Message(get_current_fault()));
+        return 0;
+    }
+
+    // Size the records, the queue and the batches for this selection
+    uint8_t sensors = 0;
+    for (uint8_t s = 0; s < INA228_NUM_SENSORS; s++)
+        if (mask & (1U << s)) sensors++;
+
+    rate        = rate_hz;
+    sensor_mask = mask;
+    fields      = field_bits;
+    sample_size = log_sample_size(fields);
+    record_size = (uint8_t)(LOG_RECORD_HEADER_SIZE + sensors * sample_size);
+    batch_max   = (uint8_t)((LOG_FRAME_MAX_PAYLOAD - LOG_SAMPLES_HEADER_SIZE) / record_size);
+    if (batch_max > LOG_BATCH_SAMPLES) batch_max = LOG_BATCH_SAMPLES;
+    q_depth     = (sizeof(log_queue) / record_size > UINT8_MAX) ? UINT8_MAX : (uint8_t)(sizeof(log_queue) / record_size);
+
+    dropped   = 0;
+    frame_seq = 0;
+    q_head = q_tail = 0;
+    q_dropped = 0;
+    batch_count = 0;
+    info_pending = 1;
+
+    uart_logger_send("OK\n");   // Response for Python script to check
+
+    active = 1;
+    sampler_start(rate_hz, rate_hz * duration_s);
+    return 1;
+}
+
+void uart_logger_stop(void)
+{
+    if (active) sampler_stop();     // uart_logger_tick() finishes once the last sweep is drained
+}
+
+uint8_t uart_logger_active(void)
+{
+    return active || end_len;
+}
+
+void uart_logger_send(const char* msg)
+{
+    Logger_Write(msg, (uint16_t)strlen(msg));
+    Logger_Flush();
+}
+
+void uart_logger_tick(void)
+{
+    if (active) {
+        if (info_pending) {
+            Logger_SendInfo();
+            info_pending = 0;
+        }
+
+        // Drain sweeps handed over by the I2C ISR
+        while (q_tail != q_head) {
+            Logger_AddRecord(&log_queue[q_tail * record_size]);
+            q_tail = (uint8_t)((q_tail + 1) % q_depth);
+        }
+
+        // Keep low sample rates from sitting in a batch for seconds
+        if (batch_count && HAL_GetTick() - batch_start_ms >= LOG_BATCH_MAX_AGE_MS)
+            Logger_SendBatch();
+
+        // Capture over once the timer has stopped and its last sweep has been drained
+        if (!sampler_running() && !sensor_acq_busy() && q_tail == q_head)
+            Logger_Finish();
+    }
+
+    // The END frame must reach the host: retry until DMA has freed a buffer
+    if (end_len && Logger_Write(end_frame, end_len))
+        end_len = 0;
+
+    Logger_Flush();
+}
+
+/*
+ * sensor_acq publish hook (I2C ISR): queue sweeps started by the sampler.
+ * Sweeps started by the precharge FSM poll are off-schedule and are not logged.
+ */
+void sensor_acq_sweep_callback(const AcqSnapshot_t* snapshot)
+{
+    if (!active || snapshot->trigger != ACQ_TRIGGER_SAMPLER) return;
+
+    uint8_t next = (uint8_t)((q_head + 1) % q_depth);
+    if (next == q_tail) {
+        q_dropped++;
+        return;
+    }
+
+    // Column-packed: one timestamp, then the selected sensors at a fixed stride
+    uint8_t* record = &log_queue[q_head * record_size];
+    uint16_t n = Put32(record, snapshot->timestamp_us);
+    uint8_t* valid = &record[n++];
+    uint8_t k = 0;
+
+    *valid = 0;
+    for (uint8_t s = 0; s < ACQ_MAX_SENSORS; s++) {
+        if (!(sensor_mask & (1U << s))) continue;
+        if (snapshot->sensor[s].healthy) {
+            log_pack_sample(&snapshot->sensor[s].meas, fields, &record[n]);
+            *valid |= (uint8_t)(1U << k);
+        } else {
+            memset(&record[n], 0, sample_size);
+        }
+        n += sample_size;
+        k++;
+    }
+    q_head = next;
+}
+
+/* Append to the fill buffer, returns 0 (and writes nothing) if it does not fit */
+static uint8_t Logger_Write(const void* data, uint16_t len)
+{
+    if (len > LOG_TX_BUF_SIZE - tx_len[fill_idx]) return 0;
+
+    memcpy(&tx_buf[fill_idx][tx_len[fill_idx]], data, len);
+    tx_len[fill_idx] += len;
+    return 1;
+}
+
+/* Hand the fill buffer to DMA if the channel is free and swap halves */
+static void Logger_Flush(void)
+{
+    if (tx_busy || tx_len[fill_idx] == 0) return;
+
+    tx_busy = 1;
+    if (HAL_UART_Transmit_DMA(&huart2, (uint8_t*)tx_buf[fill_idx], tx_len[fill_idx]) != HAL_OK) {
+        tx_busy = 0;
+        return;
+    }
+
+    fill_idx ^= 1;
+    tx_len[fill_idx] = 0;
+}
+
+/* Frame a payload into the fill buffer. The sequence number is consumed even if the frame does not fit. */
+static uint8_t Logger_SendFrame(const uint8_t* payload, uint16_t len)
+{
+    uint8_t encoded[LOG_FRAME_MAX_ENCODED];
+
+    frame_seq++;
+    return Logger_Write(encoded, log_frame_encode(payload, len, encoded));
+}
+
+static void Logger_SendInfo(void)
+{
+    uint8_t payload[LOG_FRAME_MAX_PAYLOAD];
+    uint16_t n = 0;
+    uint16_t count_pos;
+
+    payload[n++] = LOG_FRAME_INFO;
+    n += Put16(&payload[n], frame_seq);
+    n += Put32(&payload[n], rate);
+    payload[n++] = fields;
+    count_pos = n++;
+    payload[count_pos] = 0;
+
+    for (uint8_t s = 0; s < ACQ_MAX_SENSORS; s++) {
+        if (!(sensor_mask & (1U << s))) continue;
+        payload[n++] = s;
+        memcpy(&payload[n], &g_sensor_table[s].current_lsb, 4); n += 4;
+        memcpy(&payload[n], &g_sensor_table[s].power_lsb, 4);   n += 4;
+        payload[count_pos]++;
+    }
+
+    Logger_SendFrame(payload, n);
+}
+
+static void Logger_AddRecord(const uint8_t* record)
+{
+    if (batch_count == 0) batch_start_ms = HAL_GetTick();
+    memcpy(&batch[LOG_SAMPLES_HEADER_SIZE + batch_count * record_size], record, record_size);
+
+    if (++batch_count == batch_max) Logger_SendBatch();
+}
+
+/* Frame the batch in place: the header goes in front of the records */
+static void Logger_SendBatch(void)
+{
+    if (batch_count == 0) return;
+
+    batch[0] = LOG_FRAME_SAMPLES;
+    Put16(&batch[1], frame_seq);
+    batch[3] = batch_count;
+
+    if (!Logger_SendFrame(batch, (uint16_t)(LOG_SAMPLES_HEADER_SIZE + batch_count * record_size)))
+        dropped += batch_count;
+    batch_count = 0;
+}
+
+static void Logger_Finish(void)
+{
+    SamplerStats_t stats;
+    uint8_t payload[16];
+    uint16_t n = 0;
+
+    Logger_SendBatch();
+    active = 0;
+
+    sampler_get_stats(&stats);
+    payload[n++] = LOG_FRAME_END;
+    n += Put16(&payload[n], frame_seq);
+    n += Put32(&payload[n], dropped + q_dropped);
+    n += Put32(&payload[n], stats.overruns);
+    n += Put32(&payload[n], stats.max_latency_us);
+
+    // Queued for uart_logger_tick() rather than spinning on tx_busy here
+    end_len = log_frame_encode(payload, n, end_frame);
+    frame_seq++;
+}
+
+static uint16_t Put16(uint8_t* p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    return 2;
+}
+
+static uint16_t Put32(uint8_t* p, uint32_t v)
+{
+    for (uint8_t i = 0; i < 4; i++)
+        p[i] = (uint8_t)(v >> (8 * i));
+    return 4;
+}
+
+static const char* Fault_Message(FaultType_t fault)
+{
+    switch (fault) {
+        case FAULT_BUS_OVERCURRENT:   return "FAULT_BUS_OVERCURRENT\n";
+        case FAULT_BUS_OVERVOLTAGE:   return "FAULT_BUS_OVERVOLTAGE\n";
+        case FAULT_BUS_UNDERVOLTAGE:  return "FAULT_BUS_UNDERVOLTAGE\n";
+        case FAULT_MOTOR_OVERCURRENT: return "FAULT_MOTOR_OVERCURRENT\n";
+        case FAULT_SENSOR_ALERT:      return "FAULT_SENSOR_ALERT\n";
+        default:                      return "FAULT_UNKNOWN\n";
+    }
+}
+
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+    if (huart->Instance == USART2) {
+        tx_busy = 0;
+    }
+}
+
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+{
+    // A TX DMA error aborts the transfer and returns gState to READY; release the channel so the next flush can retry
+    if (huart->Instance == USART2 && huart->gState == HAL_UART_STATE_READY) {
+        tx_busy = 0;
+    }
+}
@@ -3,10 +3,18 @@ can_rx.py
  
 CAN bus receiver for exoskeleton telemetry data.
 Listens on the 'can0' SocketCAN interface for frames sent by the STM32
-from five INA228 power sensors (1 bus + 4 motors, CAN IDs 0x100–0x104).
-Each 7-byte frame carries scaled voltage, current, relay/contactor status,
-sensor health, and fault flags. Decoded values are printed to stdout in
-real time.
+from five INA228 power sensors (1 bus + 4 motors). The board sends a status
+frame (CAN ID 0x100: FSM state, fault code, fault/health/relay bitmaps) and
+one measurement frame per sensor (CAN ID 0x101), every 100 ms or, in
+on-change mode, when a value changes and at least once a second. Byte 0
+of a measurement frame selects the sensor and page: page 0 carries voltage,
+current and power, page 1 (once a second per sensor) die temperature, shunt
+voltage and DIAG_ALRT. Once a second each sensor also sends an 8-byte
+energy frame (CAN IDs 0x110–0x114) with its Wh/Ah totals. Commands sent to
+the board on CAN ID 0x080 are answered on 0x081; those acknowledgements are
+printed too. Once a second a CAN health frame (CAN ID 0x0F0) reports the
+board's CAN error counters, bus-off count, TX results and bus load.
+Decoded values are printed to stdout in real time.
 """
 
 import can
@@ -15,48 +23,105 @@ import struct
 # https://python-can.readthedocs.io/en/stable/bus.html#
 # https://docs.python.org/3/library/struct.html
 
+CAN_ID_CMD_ACK    = 0x081
+CAN_ID_CAN_HEALTH = 0x0F0
+CAN_ID_STATUS     = 0x100
+CAN_ID_MEAS       = 0x101
+
+PAGE_ELECTRICAL = 0
+PAGE_DIAG       = 1
+
 # Initialize bus
 bus = can.interface.Bus(channel="can0", interface="socketcan")
 print("Exoskeleton Telemetry Started...")
 
-# Sensor data payload structure
-telemetry = {
-    "voltage": 0.0,
-    "current": 0.0,
-    "closed": False,
-    "sensor_healthy": False,
-    "fault": False
-}
+# INA228 sensor locations, bit n of the status bitmaps / low nibble of the measurement mux
+sensor = ["BUS", " M1", " M2", " M3", " M4"]
+
+# FSM states and fault codes (PrechargeState_t / FaultType_t in precharge.h)
+states = ["PRECHARGE", "NORMAL", "FAULT"]
+faults = ["NONE", "BUS_OVERCURRENT", "BUS_OVERVOLTAGE", "BUS_UNDERVOLTAGE", "MOTOR_OVERCURRENT", "SENSOR_ALERT"]
+
+# Command opcodes and acknowledgement results (can_cmd.h)
+commands = ["?0", "FAULT_RESET", "TELEMETRY_RATE", "SENSOR_MASK", "ADC_PROFILE", "SNAPSHOT"]
+results = ["OK", "UNKNOWN", "BAD_ARG", "BUSY"]
+
+# CAN error states and last bus error codes (can_health.h)
+can_states = ["ACTIVE", "WARNING", "PASSIVE", "BUS_OFF"]
+can_errors = ["NONE", "STUFF", "FORM", "ACK", "BIT_RECESSIVE", "BIT_DOMINANT", "CRC"]
 
-# INA228 sensor locations
-sensor = {
-    0x100: "BUS", 
-    0x101: " M1", 
-    0x102: " M2", 
-    0x103: " M3", 
-    0x104: " M4"
+# Energy frames, same sensor order
+energy = {
+    0x110: "BUS",
+    0x111: " M1",
+    0x112: " M2",
+    0x113: " M3",
+    0x114: " M4"
 }
 
+last_seq = None
+
+
+def lookup(names, index):
+    return names[index] if index < len(names) else f"?{index}"
+
+
+def bits(mask):
+    # One character per sensor, BUS first
+    return "".join("1" if mask & (1 << n) else "0" for n in range(len(sensor)))
+
+
+def int24(data):
+    return int.from_bytes(data[0:3], "little", signed=True)
+
+
 for msg in bus:
-    if msg.arbitration_id in sensor:
-        # Unpack 7 bytes: 2 int16s + 2 bools + 1 uint8
-        # '<hh???' = little-endian, 2x signed short, 2x bool, 1x unsigned short integer
-        try:
-            
-            v_raw, c_raw, closed, healthy, fault = struct.unpack('<hh??B', msg.data[0:7])
-
-            # Divide by 100 because we multiplied by 100 in main.c
-            telemetry["voltage"]        = v_raw / 100.0 
-            telemetry["current"]        = c_raw / 100.0
-            telemetry["closed"]         = closed
-            telemetry["sensor_healthy"] = healthy
-            telemetry["fault"]          = fault
-
-        except Exception as e:
-            print(f"Error in retrieving data: {e}")
-    
-    # Map map CAN ID to sensor (default is ??? if not found)
-    label = sensor.get(msg.arbitration_id, "???") 
-    
-    print(f"[{label}] V: {telemetry['voltage']:4.2f}V | I: {telemetry['current']:.5f}A | "
-          f"Closed: {int(telemetry['closed'])} | Healthy: {int(telemetry['sensor_healthy'])} | Fault: {int(telemetry['fault'])}")
+    try:
+        if msg.arbitration_id == CAN_ID_STATUS:
+            # '<6B' = state, fault code, fault sensors, healthy sensors, relays, sequence
+            state, fault, fault_mask, health, relays, seq = struct.unpack('<6B', msg.data[0:6])
+
+            # The sequence counter steps by one per frame, so a jump means frames were lost
+            lost = "" if last_seq is None or seq == (last_seq + 1) & 0xFF else f" | LOST {(seq - last_seq - 1) & 0xFF}"
+            last_seq = seq
+
+            print(f"[STATUS] {lookup(states, state)} | Fault: {lookup(faults, fault)} (sensors {bits(fault_mask)}) | "
+                  f"Healthy: {bits(health)} | Contactor: {relays & 1} | Motors: {bits(relays >> 1)[:4]}{lost}")
+
+        elif msg.arbitration_id == CAN_ID_MEAS:
+            page = msg.data[0] >> 4
+            label = lookup(sensor, msg.data[0] & 0x0F)
+
+            if page == PAGE_ELECTRICAL:
+                # uint16 mV, int24 mA, uint16 0.1 W
+                (mv,) = struct.unpack('<H', msg.data[1:3])
+                ma = int24(msg.data[3:6])
+                (dw,) = struct.unpack('<H', msg.data[6:8])
+                print(f"[{label}] V: {mv / 1000.0:6.3f}V | I: {ma / 1000.0:8.3f}A | P: {dw / 10.0:7.1f}W")
+
+            elif page == PAGE_DIAG:
+                # int16 0.01 °C, int24 0.1 uV, uint16 DIAG_ALRT
+                (temp,) = struct.unpack('<h', msg.data[1:3])
+                vshunt = int24(msg.data[3:6])
+                (diag,) = struct.unpack('<H', msg.data[6:8])
+                print(f"[{label}] T: {temp / 100.0:6.2f}C | Vshunt: {vshunt / 10.0:10.1f}uV | DIAG_ALRT: 0x{diag:04X}")
+
+        elif msg.arbitration_id == CAN_ID_CMD_ACK:
+            # '<3B' = opcode, tag, result
+            opcode, tag, result = struct.unpack('<3B', msg.data[0:3])
+            print(f"[ACK] {lookup(commands, opcode)} (tag {tag}): {lookup(results, result)}")
+
+        elif msg.arbitration_id == CAN_ID_CAN_HEALTH:
+            # '<4BH2B' = TEC, REC, state | last error << 4, bus-offs, frames sent, frames lost, load in 0.5 %
+            tec, rec, flags, bus_offs, sent, lost, load = struct.unpack('<4BH2B', msg.data[0:8])
+            print(f"[CAN] {lookup(can_states, flags & 0x03)} | TEC: {tec} | REC: {rec} | Bus-off: {bus_offs} | "
+                  f"Last error: {lookup(can_errors, (flags >> 4) & 0x07)} | Sent: {sent} | Lost: {lost} | "
+                  f"Load: {load * 0.5:.1f}%")
+
+        elif msg.arbitration_id in energy:
+            # '<Ii' = little-endian, unsigned mWh, signed mAh
+            mwh, mah = struct.unpack('<Ii', msg.data[0:8])
+            print(f"[{energy[msg.arbitration_id]}] E: {mwh / 1000.0:.3f}Wh | Q: {mah / 1000.0:.3f}Ah")
+
+    except Exception as e:
+        print(f"Error in retrieving data: {e}")
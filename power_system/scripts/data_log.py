@@ -3,11 +3,21 @@ data_log.py
  
 UART data logger for STM32 bus sensor measurements.
 Sends a START command to the MCU over a serial connection, receives
-timestamped voltage, current, and power samples, and plots the results using matplotlib. 
-Sampling rate and duration are inputted by the user at runtime.
+binary sample frames (raw INA228 codes, see power_system/Core/Inc/log_frame.h),
+and plots the captured fields vs. time using matplotlib.
+Sampling rate, duration, sensors and fields are inputted by the user at
+runtime. Any subset of the five sensors can be captured together with any
+of V (bus voltage), I (current), P (power), T (die temperature) and
+S (shunt voltage); every sweep carries one timestamp for all of them.
+A duration of 0 streams until Ctrl+C, which sends STOP to the MCU.
+
+Frames are COBS-encoded with a CRC-16/CCITT-FALSE and delimited by 0x00.
+Frames failing the CRC are discarded, and gaps in the frame sequence
+number are reported as lost frames.
 """
 
 import serial
+import struct
 import time
 import numpy as np
 import matplotlib.pyplot as plt
@@ -28,9 +38,11 @@ time.sleep(2)  # allow Nucleo reset
 ############################################
 
 sampling_rate = int(input("Enter sampling rate (Hz): "))
-total_time    = int(input("Enter total time (seconds): "))
+total_time    = int(input("Enter total time (seconds, 0 = until Ctrl+C): "))
+sensor_mask   = input("Enter sensor mask (bit 0 = BUS, bits 1-4 = M1-M4, Enter = 0x01): ").strip() or "0x01"
+fields        = input("Enter fields (any of V I P T S, Enter = VIP): ").strip().upper() or "VIP"
 
-command = f"START,{sampling_rate},{total_time}\n"
+command = f"START,{sampling_rate},{total_time},{sensor_mask},{fields}\n"
 print("Sending:", command.strip())
 
 ser.write(command.encode("ascii"))
@@ -39,71 +51,207 @@ ser.write(command.encode("ascii"))
 # 3. Wait for MCU Acknowledgment
 ############################################
 
-response = ser.readline().decode("ascii", errors="ignore").strip()
-print("MCU response:", response)
-
-if response != "OK":
-    print("MCU did not acknowledge command.")
-    ser.close()
-    exit(1)
-
-############################################
-# 4. Receive Samples
-############################################
-
 FAULT_MESSAGES = {
     "FAULT_BUS_OVERCURRENT",
     "FAULT_BUS_OVERVOLTAGE",
     "FAULT_BUS_UNDERVOLTAGE",
     "FAULT_SENSOR_COMM",
     "FAULT_MOTOR_OVERCURRENT",
+    "FAULT_SENSOR_ALERT",
     "FAULT_UNKNOWN",
 }
 
 def is_fault(line):
     return line in FAULT_MESSAGES
 
-voltages = []
-currents = []
-powers   = []
+response = ser.readline().decode("ascii", errors="ignore").strip()
+print("MCU response:", response)
 
-print("Receiving samples...")
+# Check for fault message from MCU
+if is_fault(response):
+    print(f"\n  MCU reported fault: {response}")
+    print("Aborting data collection.")
+    ser.close()
+    exit(1)
 
-# Print header for console output
-print("\n" + "="*60)
-print(f" {'Voltage (V)':<15} {'Current (A)':<15} {'Power (W)':<15}")
-print("="*60)
+if response != "OK":
+    print("MCU did not acknowledge command.")
+    ser.close()
+    exit(1)
 
-while True:
-    line_test = ser.readline()
-    line = line_test.decode("ascii", errors="ignore").strip()
+############################################
+# 4. Receive Samples
+############################################
 
-    if not line:
-        continue
-    
-     # Check for fault message from MCU
-    if is_fault(line):
-        print(f"\n  MCU reported fault: {line}")
-        print("Aborting data collection.")
-        ser.close()
-        exit(1)
-
-    if line == "DONE":
-        print("Sampling complete.")
-        break
+FRAME_SAMPLES = 0x01
+FRAME_INFO    = 0x02
+FRAME_END     = 0x03
+
+VBUS_LSB    = 195.3125e-6   # V per LSB (datasheet Table 8-1)
+VSHUNT_LSB  = 312.5e-9      # V per LSB, ADCRANGE = 0
+DIETEMP_LSB = 7.8125e-3     # degC per LSB
+
+# Fields in packing order: key, bit in the INFO fields byte, code width, signed, label
+FIELDS = [
+    ("v", 0x01, 20, True,  "Voltage (V)"),
+    ("i", 0x02, 20, True,  "Current (A)"),
+    ("p", 0x04, 24, False, "Power (W)"),
+    ("t", 0x08, 16, True,  "Temperature (C)"),
+    ("s", 0x10, 20, True,  "Shunt (mV)"),
+]
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data):
+            raise ValueError("bad COBS block")
+        out += data[i + 1:i + code]
+        i += code
+        if code < 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+def crc16(data):
+    crc = 0xFFFF
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+def sign_extend(value, bits):
+    return value - (1 << bits) if value & (1 << (bits - 1)) else value
+
+def sample_size(field_bits):
+    return (sum(w for _, bit, w, _, _ in FIELDS if field_bits & bit) + 7) // 8
+
+def unpack_sample(raw, field_bits):
+    """Raw codes of the selected fields, keyed by FIELDS key."""
+    word = int.from_bytes(raw, "little")
+    codes = {}
+    for key, bit, width, signed, _ in FIELDS:
+        if field_bits & bit:
+            code = word & ((1 << width) - 1)
+            codes[key] = sign_extend(code, width) if signed else code
+            word >>= width
+    return codes
+
+SENSOR_NAMES = ["BUS", "M1", "M2", "M3", "M4"]
+
+lsbs       = {}     # sensor_id -> (current_lsb, power_lsb)
+sensor_ids = []     # Captured sensors, in record order
+field_bits = 0
+frame_rate = sampling_rate
+expected_seq = None
+lost_frames  = 0
+bad_frames   = 0
+dropped      = 0
+overruns     = 0
+max_latency_us = 0
+
+# Per-sensor sample lists; one timestamp per sweep, unwrapped from the 32-bit microsecond counter
+samples = {}        # sensor_id -> {"t": [], and a list per captured field}
+last_t_us = None    # (last raw timestamp, wrap offset)
+invalid = 0         # Sensor samples a sweep could not read
+
+print("Receiving samples...")
+
+def handle_frame(frame):
+    """Decode one frame, returns True once the END frame arrives."""
+    global expected_seq, lost_frames, bad_frames, dropped, overruns, max_latency_us, frame_rate
+    global field_bits, last_t_us, invalid
 
     try:
-        v, i, p = map(float, line.split(","))
-        voltages.append(v)
-        currents.append(i)
-        powers.append(p)
-        
-        # Print values to console
-        print(f"{v:<15.6f} {i:<15.6f} {p:<15.6f}")
-        
+        payload = cobs_decode(frame)
     except ValueError:
-        # ignore malformed lines
-        continue
+        bad_frames += 1
+        return False
+    if len(payload) < 5 or crc16(payload[:-2]) != struct.unpack_from("<H", payload, len(payload) - 2)[0]:
+        bad_frames += 1
+        return False
+    payload = payload[:-2]
+
+    ftype, seq = struct.unpack_from("<BH", payload, 0)
+    if expected_seq is not None and seq != expected_seq:
+        lost_frames += (seq - expected_seq) & 0xFFFF
+    expected_seq = (seq + 1) & 0xFFFF
+
+    if ftype == FRAME_INFO:
+        frame_rate, field_bits, n = struct.unpack_from("<IBB", payload, 3)
+        sensor_ids.clear()
+        for k in range(n):
+            sid, i_lsb, p_lsb = struct.unpack_from("<Bff", payload, 9 + 9 * k)
+            lsbs[sid] = (i_lsb, p_lsb)
+            sensor_ids.append(sid)
+
+        # Print header for console output
+        labels = [label for _, bit, _, _, label in FIELDS if field_bits & bit]
+        print("\n" + "=" * (9 + 16 * len(labels)))
+        print(f" {'Sensor':<8}" + "".join(f" {label:<15}" for label in labels))
+        print("=" * (9 + 16 * len(labels)))
+
+    elif ftype == FRAME_SAMPLES:
+        count = payload[3]
+        size = sample_size(field_bits)
+        record = 5 + size * len(sensor_ids)
+
+        for k in range(count):
+            rec = 4 + record * k
+            t_us, valid = struct.unpack_from("<IB", payload, rec)
+            prev, offset = last_t_us or (t_us, 0)
+            if t_us < prev:
+                offset += 1 << 32
+            last_t_us = (t_us, offset)
+
+            for slot, sid in enumerate(sensor_ids):
+                if not valid & (1 << slot):
+                    invalid += 1
+                    continue
+                i_lsb, p_lsb = lsbs[sid]
+                codes = unpack_sample(payload[rec + 5 + size * slot:rec + 5 + size * (slot + 1)], field_bits)
+                scale = {"v": VBUS_LSB, "i": i_lsb, "p": p_lsb, "t": DIETEMP_LSB, "s": VSHUNT_LSB * 1e3}
+                values = {key: code * scale[key] for key, code in codes.items()}
+
+                data = samples.setdefault(sid, {"t": [], **{key: [] for key in values}})
+                data["t"].append((t_us + offset) * 1e-6)
+                for key, value in values.items():
+                    data[key].append(value)
+
+                # Print values to console
+                print(f" {SENSOR_NAMES[sid]:<8}" + "".join(f" {value:<15.6f}" for value in values.values()))
+
+    elif ftype == FRAME_END:
+        dropped, overruns, max_latency_us = struct.unpack_from("<III", payload, 3)
+        print("Sampling complete.")
+        return True
+
+    return False
+
+def read_frame():
+    """Read up to the next 0x00 delimiter, returns None if the MCU went quiet."""
+    global pending
+    pending += ser.read_until(b"\x00")
+    if not pending.endswith(b"\x00"):
+        return None
+    frame, pending = pending[:-1], b""
+    return frame
+
+pending = b""
+try:
+    while True:
+        frame = read_frame()
+        if frame and handle_frame(frame):
+            break
+except KeyboardInterrupt:
+    # Stop the stream and drain the frames still in flight up to END
+    ser.write(b"STOP\n")
+    while True:
+        frame = read_frame()
+        if frame is None or (frame and handle_frame(frame)):
+            break
 
 ser.close()
 
@@ -111,17 +259,18 @@ ser.close()
 # 5. Convert to NumPy
 ############################################
 
-voltages = np.array(voltages)
-currents = np.array(currents)
-powers   = np.array(powers)
-
-num_samples = len(voltages)
+num_samples = sum(len(d["t"]) for d in samples.values())
 
 if num_samples == 0:
     print("No data received.")
     exit(1)
 
-time_vector = np.arange(num_samples) / sampling_rate
+sensor_ids = sorted(samples)
+t_start = min(samples[sid]["t"][0] for sid in sensor_ids)
+for sid in sensor_ids:
+    for key in samples[sid]:
+        samples[sid][key] = np.array(samples[sid][key])
+    samples[sid]["t"] -= t_start
 
 ############################################
 # 6. Plot Results
@@ -129,15 +278,19 @@ time_vector = np.arange(num_samples) / sampling_rate
 
 plt.style.use("seaborn-v0_8")
 
-plt.figure(figsize=(10, 5))
-plt.plot(time_vector, voltages, label="Voltage (V)")
-plt.plot(time_vector, currents, label="Current (A)")
-plt.plot(time_vector, powers,   label="Power (W)")
-plt.xlabel("Time (s)")
-plt.ylabel("Value")
-plt.title("Voltage, Current, and Power vs Time")
-plt.grid(True)
-plt.legend()
+fig, axes = plt.subplots(len(sensor_ids), 1, figsize=(10, 4 * len(sensor_ids)), sharex=True, squeeze=False)
+for ax, sid in zip(axes[:, 0], sensor_ids):
+    d = samples[sid]
+    labels = []
+    for key, _, _, _, label in FIELDS:
+        if key in d:
+            ax.plot(d["t"], d[key], label=label)
+            labels.append(label.split(" (")[0])
+    ax.set_ylabel("Value")
+    ax.set_title(f"{SENSOR_NAMES[sid]}: {', '.join(labels)} vs Time")
+    ax.grid(True)
+    ax.legend()
+axes[-1, 0].set_xlabel("Time (s)")
 plt.tight_layout()
 plt.show()
 
@@ -146,4 +299,23 @@ plt.show()
 ############################################
 
 print(f"\nReceived {num_samples} samples.")
+if invalid:
+    print(f"{invalid} sensor samples were not read (sensor unhealthy during the sweep).")
+
+# Rate accuracy and jitter from the MCU timestamps (intervals spanning a gap are excluded from jitter)
+period = 1.0 / frame_rate
+for sid in sensor_ids:
+    t = samples[sid]["t"]
+    if len(t) < 2:
+        continue
+    dt = np.diff(t)
+    steady = dt[dt < 1.5 * period]
+    achieved = (len(t) - 1) / (t[-1] - t[0]) if t[-1] > t[0] else 0.0
+    jitter_us = np.std(steady) * 1e6 if len(steady) else 0.0
+    print(f"{SENSOR_NAMES[sid]}: {achieved:.3f} Hz achieved (requested {frame_rate} Hz), "
+          f"interval jitter {jitter_us:.1f} us RMS")
+
+print(f"Sampler overruns: {overruns}, worst ISR latency: {max_latency_us} us")
+if dropped or lost_frames or bad_frames:
+    print(f"MCU dropped {dropped} samples, {lost_frames} frames lost in transit, {bad_frames} frames failed CRC.")
 print("Plotting complete.")
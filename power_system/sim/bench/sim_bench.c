@@ -0,0 +1,1410 @@
+/*
+ * sim_bench.c
+ *
+ * Benchmark harness for the host simulator.
+ *
+ * Boots the firmware the way main() does (same MX_*_Init order, same
+ * module init calls, same scheduler task table) and then runs dispatcher
+ * passes, charging LOOP_COST_NS of CPU time per pass on top of what the HAL
+ * calls cost. The dispatcher's WFI jumps the clock to the next interrupt. Every scenario starts from a fresh boot with the same waveforms, so
+ * results are reproducible run to run and comparable across commits.
+ *
+ * The firmware modules keep their state in statics that only a reset
+ * clears, so every boot happens in a child forked from a process that has
+ * never booted; the child reports its result and check failures back.
+ *
+ * Scenarios (all run when none are named on the command line):
+ *   throughput  CPU idle, task stats and profiling probes, I2C and CAN load, telemetry frame rates, status frame and
+ *               decoded measurement pages against the model, INA228 results read once, more than once or never
+ *   latency     bus/motor limit step -> contactor/relays open, ALERT and software paths
+ *   logger      UART logger capture at several rates and sensor/field selections, frames and values decoded and checked
+ *   i2c         NACKing and stuck sensors, health flags and sweep recovery
+ *   i2cspeed    sweep time and sweep rate limit on I2C1 and FMPI2C1 at 100 kHz to 1 MHz
+ *   can         TX queue under lost arbitration: frames requeued, none dropped
+ *   cantx       periodic vs on-change telemetry: steady-state frames and bus load, a current step, status after a trip
+ *   cancmd      CAN commands injected on the bus: acknowledgements, telemetry rate and sensor mask, ADC profile,
+ *               snapshot, fault reset refused while the overcurrent persists and accepted after it cleared
+ *   canhealth   TX frames failing on the bus: bus-off, restarts with growing backoff, recovery, health frame and load
+ *   energy      Wh/Ah frames against the model's power, across an ENERGY/CHARGE wrap, after a reset
+ *   adc         fast bus profile during precharge, run profile after it, runtime profile change on a motor
+ *
+ * The exit code is the number of failed sanity checks.
+ */
+
+#include "sim.h"
+#include "main.h"
+#include "gpio.h"
+#include "dma.h"
+#include "usart.h"
+#include "i2c.h"
+#include "i2c_bus.h"
+#include "can.h"
+#include "precharge.h"
+#include "telemetry.h"
+#include "energy.h"
+#include "can_tx.h"
+#include "can_cmd.h"
+#include "can_health.h"
+#include "sampler.h"
+#include "sensor_acq.h"
+#include "uart_logger.h"
+#include "log_frame.h"
+#include "scheduler.h"
+#include "profile.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define LOOP_COST_NS            1000    // Dispatcher CPU time not spent inside HAL calls
+#define CAN_TX_INTERVAL_MS      100     // Mirrors main.c
+#define FSM_INTERVAL_MS         10
+#define LOGGER_INTERVAL_MS      1
+#define ENERGY_WINDOW_S         5       // Energy frames compared this far apart
+#define BOOT_TIMEOUT_S          2.0     // Precharge must finish within this
+#define NUM_PHASES              8       // Fault step offsets tried per latency case
+#define PHASE_STEP_NS           411000  // Not a multiple of any conversion period
+
+#define PRECHARGE_TAU_S         0.05    // Bus RC charge through the precharge resistor
+#define CANTX_WINDOW_S          5       // Steady-state window of the cantx scenario
+#define CANTX_STEP_CURRENT      4.0     // Motor1 current after the cantx step
+#define CANCMD_RATE_MS          50      // Telemetry tick set by the cancmd scenario
+#define CANCMD_MASK             0x05    // Sensors left on by the cancmd scenario (bus, motor2)
+#define CANHEALTH_WINDOW_S      3       // Healthy-bus window of the canhealth scenario
+#define CANHEALTH_RESTARTS      5       // Bus-off restarts timed while the canhealth fault lasts
+#define CAN_LEC_BIT_DOMINANT    5       // ESR.LEC code injected by the canhealth scenario
+
+#define BUS_VOLTAGE             40.0
+#define BUS_CURRENT             8.0
+#define MOTOR_CURRENT           2.0
+
+typedef struct {
+    const char* name;
+    void (*run)(void* result);
+} Scenario_t;
+
+typedef struct {
+    const char* label;
+    INA228_Location_t sensor;
+    uint8_t step_voltage;           // 1 = step the bus voltage, 0 = step the current
+    double target;                  // V or A after the step
+    uint8_t alert_connected;        // 0 = only the software threshold check can trip
+    GPIO_TypeDef* port;             // Output whose change ends the measurement
+    uint16_t pin;
+    FaultType_t expect;
+} LatencyCase_t;
+
+typedef struct {
+    int ok;
+    double ms;
+} LatencyResult_t;
+
+typedef struct {
+    uint32_t rate_hz;
+    uint32_t duration_s;
+    uint8_t sensor_mask;            // Bit per INA228_Location_t
+    uint8_t fields;                 // LOG_FIELD_* bits
+} LoggerCase_t;
+
+typedef struct {
+    const char* label;
+    uint8_t port;                   // I2C_BUS_I2C1 or I2C_BUS_FMPI2C1
+    uint32_t boot_hz;               // Speed the firmware boots with
+    uint32_t run_hz;                // Speed set at runtime before measuring, as the I2C command does
+} BusSpeedCase_t;
+
+typedef struct {
+    int ok;
+    double sweep_us;
+} BusSpeedResult_t;
+
+typedef struct {
+    int ok;
+    double frames_s;                // All telemetry frames, steady state
+    double status_s;                // Status frames, steady state
+    double electrical_s;            // Electrical pages per sensor, steady state
+    double load_pct;                // CAN bus load, steady state (including energy frames)
+    double step_ms;                 // Current step -> first electrical frame showing it
+    double status_ms;               // Relays open -> status frame reporting FAULT
+    uint32_t seq_gaps;
+} TxPolicyResult_t;
+
+/* Scheduler tasks, mirrors main.c without the UART command task */
+static const SchedTask_t tasks[] = {
+    { "fsm",       precharge_fsm_tick,    FSM_INTERVAL_MS,    SCHED_EV_SWEEP_DONE },
+    { "logger",    uart_logger_tick,      LOGGER_INTERVAL_MS, SCHED_EV_SWEEP_DONE },
+    { "status",    telemetry_status_task, 0,                  SCHED_EV_STATUS },
+    { "cancmd",    can_cmd_task,          0,                  SCHED_EV_CAN_CMD },
+    { "telemetry", telemetry_tick,        CAN_TX_INTERVAL_MS, 0 },
+    { "energy",    energy_tick,           ENERGY_INTERVAL_MS, 0 },
+    { "canhealth", can_health_task,       CAN_HEALTH_INTERVAL_MS, 0 },
+};
+#define NUM_TASKS       (sizeof(tasks) / sizeof(tasks[0]))
+
+/* CAN frames seen on the bus: status frames, measurement frames per page and sensor */
+static uint32_t status_frames;
+static uint32_t status_seq_gaps;
+static SimCanFrame_t status_last;
+static uint32_t meas_frames[2][NUM_SENSORS];
+static SimCanFrame_t meas_last[2][NUM_SENSORS];
+static uint32_t can_order_errors;   // Frame of a tick on the bus after a higher ID of the same tick
+static uint64_t status_fault_ns;    // First status frame reporting STATE_FAULT, 0 = none yet
+static uint32_t energy_frames[NUM_SENSORS];
+static SimCanFrame_t energy_last[NUM_SENSORS];
+static uint32_t ack_frames;
+static SimCanFrame_t ack_last;
+static uint8_t cmd_tag;             // Tag of the last command sent by Command()
+static uint32_t health_frames;
+static uint32_t health_lost;        // Sum of the lost-frame counts of the health frames
+static SimCanFrame_t health_last;
+static uint32_t restarts_seen;      // Restart count Restarted() waits to see exceeded
+
+static int failures;
+
+/* Case a forked child runs */
+static const LatencyCase_t* latency_case;
+static int latency_phase;
+static const LoggerCase_t* logger_case;
+static const BusSpeedCase_t* bus_case;      // NULL = main.h I2C_BUS_PORT / I2C_BUS_SPEED_HZ
+static uint8_t tx_policy;                   // TELEMETRY_TX_* mode of a cantx run
+
+/* Local Prototypes */
+static void Boot(void);
+static void Loop_Once(void);
+static uint64_t Run_For(uint64_t ns);
+static int Run_Until(int (*done)(void), double timeout_s);
+static int Is_Normal(void);
+static int Contactor_Open(void);
+static int Relays_Open(void);
+static int Logger_Idle(void);
+static int Acq_Idle(void);
+static int Energy_Frame(void);
+static int Step_Sent(void);
+static int Fault_Status_Sent(void);
+static int Ack_Received(void);
+static int Bus_Off(void);
+static int Bus_On(void);
+static int Restarted(void);
+static int Status_Sent(void);
+static int Command(uint8_t opcode, const uint8_t* args, uint8_t n_args, double* ack_ms);
+static void Can_Hook(const SimCanFrame_t* frame);
+static void Check(int ok, const char* what);
+static double Host_Seconds(void);
+static double Ms(uint64_t ns);
+static SensorData_t Sensor(INA228_Location_t location);
+static void Can_Reset_Counts(void);
+static int32_t Frame_Field(const SimCanFrame_t* frame, uint8_t offset, uint8_t bytes, int is_signed);
+static int Log_Values_Ok(uint8_t sensor, uint8_t fields, const uint8_t* sample);
+static uint32_t Frame_Milli_Wh(const SimCanFrame_t* frame);
+static int32_t Frame_Milli_Ah(const SimCanFrame_t* frame);
+static void Isolated(void (*body)(void* result), void* result, size_t size);
+static void Scenario_Throughput(void* result);
+static void Scenario_Latency(void* result);
+static void Scenario_Logger(void* result);
+static void Scenario_I2c(void* result);
+static void Scenario_I2cSpeed(void* result);
+static void Scenario_Can(void* result);
+static void Scenario_Energy(void* result);
+static void Scenario_Adc(void* result);
+static void Scenario_CanTx(void* result);
+static void Scenario_CanCmd(void* result);
+static void Scenario_CanHealth(void* result);
+static void Latency_Phase(void* result);
+static void Logger_Capture(void* result);
+static void Bus_Speed_Sweep(void* result);
+static void Tx_Policy_Run(void* result);
+
+static const Scenario_t scenarios[] = {
+    { "throughput", Scenario_Throughput },
+    { "latency",    Scenario_Latency },
+    { "logger",     Scenario_Logger },
+    { "i2c",        Scenario_I2c },
+    { "i2cspeed",   Scenario_I2cSpeed },
+    { "can",        Scenario_Can },
+    { "cantx",      Scenario_CanTx },
+    { "cancmd",     Scenario_CanCmd },
+    { "canhealth",  Scenario_CanHealth },
+    { "energy",     Scenario_Energy },
+    { "adc",        Scenario_Adc },
+};
+#define NUM_SCENARIOS   (sizeof(scenarios) / sizeof(scenarios[0]))
+
+static const LatencyCase_t latency_cases[] = {
+    { "bus overcurrent, ALERT pin",    INA228_BUS,    0, 60.0, 1, CONTACTOR_GPIO_Port, CONTACTOR_Pin, FAULT_BUS_OVERCURRENT },
+    { "bus overvoltage, ALERT pin",    INA228_BUS,    1, 50.0, 1, CONTACTOR_GPIO_Port, CONTACTOR_Pin, FAULT_BUS_OVERVOLTAGE },
+    { "bus overvoltage, software",     INA228_BUS,    1, 50.0, 0, CONTACTOR_GPIO_Port, CONTACTOR_Pin, FAULT_BUS_OVERVOLTAGE },
+    { "motor2 overcurrent, ALERT pin", INA228_MOTOR2, 0, 30.0, 1, MOTOR2_GPIO_Port,    MOTOR2_Pin,    FAULT_MOTOR_OVERCURRENT },
+};
+
+static const LoggerCase_t logger_cases[] = {
+    { 100,             2, 1U << INA228_BUS, LOG_FIELDS_DEFAULT },
+    { 1000,            2, 1U << INA228_BUS, LOG_FIELDS_DEFAULT },
+    { LOG_MAX_RATE_HZ, 1, 1U << INA228_BUS, LOG_FIELDS_DEFAULT },
+    { 100,             2, 0x1F,             LOG_FIELDS_ALL },
+    { 200,             2, 0x1E,             LOG_FIELD_CURRENT | LOG_FIELD_DIETEMP },
+};
+
+static const BusSpeedCase_t bus_cases[] = {
+    { "I2C1 100 kHz",             I2C_BUS_I2C1,    100000U,  100000U },
+    { "I2C1 400 kHz",             I2C_BUS_I2C1,    400000U,  400000U },
+    { "FMPI2C1 400 kHz",          I2C_BUS_FMPI2C1, 400000U,  400000U },
+    { "FMPI2C1 400 kHz -> 1 MHz", I2C_BUS_FMPI2C1, 400000U,  1000000U },
+    { "FMPI2C1 1 MHz",            I2C_BUS_FMPI2C1, 1000000U, 1000000U },
+};
+
+int main(int argc, char** argv)
+{
+    for (size_t i = 0; i < NUM_SCENARIOS; i++) {
+        int selected = (argc < 2);
+        for (int a = 1; a < argc; a++) {
+            if (strcmp(argv[a], scenarios[i].name) == 0) selected = 1;
+        }
+        if (!selected) continue;
+
+        printf("== %s ==\n", scenarios[i].name);
+        Isolated(scenarios[i].run, NULL, 0);
+        printf("\n");
+    }
+
+    printf("%d check(s) failed\n", failures);
+    return failures;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Scenarios                                                                 */
+/* ------------------------------------------------------------------------- */
+
+static void Scenario_Throughput(void* result)
+{
+    const double window_s = 2.0;
+    SimI2cStats_t i2c0, i2c1;
+    SimCanStats_t can0, can1;
+    SimIna228Reads_t reads0[NUM_SENSORS], reads1[NUM_SENSORS];
+    CanTxStats_t tx;
+    SchedStats_t sched;
+
+    Boot();
+    Check(Run_Until(Is_Normal, BOOT_TIMEOUT_S), "precharge completes");
+    printf("precharge complete at %.1f ms\n", sim_now_s() * 1e3);
+    telemetry_set_tx_mode(TELEMETRY_TX_PERIODIC);     // Frame rates checked below; cantx covers on-change
+
+    sim_i2c_stats(&i2c0);
+    sim_can_stats(&can0);
+    for (uint8_t s = 0; s < NUM_SENSORS; s++) sim_ina228_read_stats(s, &reads0[s]);
+    Can_Reset_Counts();
+    sched_reset_stats();
+#if PROFILE_ENABLE
+    profile_reset();
+#endif
+
+    double host_start = Host_Seconds();
+    uint64_t loops = Run_For((uint64_t)(window_s * 1e9));
+    double host_s = Host_Seconds() - host_start;
+
+    sim_i2c_stats(&i2c1);
+    sim_can_stats(&can1);
+    for (uint8_t s = 0; s < NUM_SENSORS; s++) sim_ina228_read_stats(s, &reads1[s]);
+
+    sched_get_stats(&sched);
+    printf("scheduler:     %.0f passes/s, CPU %.1f%% idle\n", loops / window_s,
+           100.0 * (double)sched.idle_us / (double)sched.elapsed_us);
+    for (uint8_t t = 0; t < NUM_TASKS; t++) {
+        SchedTaskStats_t st;
+        sched_get_task_stats(t, &st);
+        printf("  %-11s  %6.1f runs/s, mean %.1f us, max %lu us, %lu deadline misses\n", tasks[t].name,
+               st.runs / window_s, st.runs ? (double)st.total_us / st.runs : 0.0,
+               (unsigned long)st.max_us, (unsigned long)st.deadline_misses);
+        Check(st.deadline_misses == 0, "no deadline misses");
+        if (tasks[t].run == telemetry_tick) Check(st.max_us < 100, "telemetry_tick does not wait for the bus");
+    }
+    Check(sched.idle_us > 0, "core sleeps between events");
+#if PROFILE_ENABLE
+    // Only cycles charged by the HAL model show up here, code between HAL calls is free
+    for (uint8_t p = 0; p < PROF_NUM_PROBES; p++) {
+        ProfileStats_t ps;
+        profile_get_stats((ProfileProbe_t)p, &ps);
+        printf("  %-15s%7lu calls, cycles min %lu max %lu mean %.0f\n", profile_name((ProfileProbe_t)p),
+               (unsigned long)ps.count, (unsigned long)ps.min_cycles, (unsigned long)ps.max_cycles,
+               ps.count ? (double)ps.total_cycles / ps.count : 0.0);
+        Check(ps.count > 0, "profiling probe hit");
+    }
+#endif
+    printf("host:          %.1f ns/pass, %.1fx real time\n", host_s * 1e9 / loops, window_s / host_s);
+    printf("I2C:           %s at %lu Hz, %.0f transfers/s, %.1f%% bus busy, %u errors\n",
+           i2c_bus_port() == I2C_BUS_FMPI2C1 ? "FMPI2C1" : "I2C1", (unsigned long)i2c_bus_speed(),
+           (i2c1.transfers - i2c0.transfers) / window_s,
+           100.0 * (double)(i2c1.busy_ns - i2c0.busy_ns) / (window_s * 1e9),
+           i2c1.errors - i2c0.errors);
+    printf("clocks:        SYSCLK %lu MHz, PCLK1 %lu MHz, TIM2 PSC %lu\n", (unsigned long)(SystemCoreClock / 1000000U),
+           (unsigned long)(HAL_RCC_GetPCLK1Freq() / 1000000U), (unsigned long)TIM2->PSC);
+    Check(sim_can_bitrate() == 1000000U, "CAN bit rate from the clock tree");
+    printf("CAN:           %.0f frames/s at %lu bit/s, %.2f%% bus load\n",
+           (can1.tx_frames - can0.tx_frames) / window_s, (unsigned long)sim_can_bitrate(),
+           100.0 * (double)(can1.busy_ns - can0.busy_ns) / (window_s * 1e9));
+    printf("  0x%03X        %.1f frames/s  CAN health\n", CAN_ID_CAN_HEALTH, health_frames / window_s);
+    Check(fabs(health_frames / window_s - 1000.0 / CAN_HEALTH_FRAME_MS) < 0.6, "CAN health frame rate");
+    printf("  0x%03X        %.1f frames/s  status\n", CAN_ID_STATUS, status_frames / window_s);
+    Check(fabs(status_frames / window_s - 1000.0 / CAN_TX_INTERVAL_MS) < 1.0, "status frame rate");
+    for (uint8_t s = 0; s < NUM_SENSORS; s++) {
+        printf("  0x%03X/%u      %.1f frames/s  electrical, %.1f frames/s  diagnostic\n", CAN_ID_MEAS, s,
+               meas_frames[MEAS_PAGE_ELECTRICAL][s] / window_s, meas_frames[MEAS_PAGE_DIAG][s] / window_s);
+        Check(fabs(meas_frames[MEAS_PAGE_ELECTRICAL][s] / window_s - 1000.0 / CAN_TX_INTERVAL_MS) < 1.0,
+              "electrical page rate");
+        Check(fabs(meas_frames[MEAS_PAGE_DIAG][s] / window_s - 1000.0 / (CAN_TX_INTERVAL_MS * TELEMETRY_DIAG_DIVIDER)) < 0.6,
+              "diagnostic page rate");
+    }
+    printf("status:        state %ld, fault %ld, fault sensors 0x%02lX, healthy 0x%02lX, relays 0x%02lX, %lu seq gaps\n",
+           (long)Frame_Field(&status_last, 0, 1, 0), (long)Frame_Field(&status_last, 1, 1, 0),
+           (long)Frame_Field(&status_last, 2, 1, 0), (long)Frame_Field(&status_last, 3, 1, 0),
+           (long)Frame_Field(&status_last, 4, 1, 0), (unsigned long)status_seq_gaps);
+    Check(status_last.dlc == 6 && Frame_Field(&status_last, 0, 1, 0) == STATE_NORMAL_OPERATION
+          && Frame_Field(&status_last, 1, 1, 0) == FAULT_NONE && Frame_Field(&status_last, 2, 1, 0) == 0,
+          "status frame state and fault");
+    Check(Frame_Field(&status_last, 3, 1, 0) == (1 << NUM_SENSORS) - 1, "status frame health bits");
+    Check(Frame_Field(&status_last, 4, 1, 0) == 0x1F, "status frame contactor and relays closed");
+    Check(status_seq_gaps == 0, "status sequence without gaps");
+    can_tx_get_stats(&tx);
+    printf("CAN TX queue:  max depth %u, %lu dropped\n", tx.max_depth, (unsigned long)tx.dropped);
+    Check(tx.dropped == 0, "no CAN frames dropped");
+
+    // Firmware readings and filtered CAN values against the model's inputs
+    printf("readings:      sensor   V (set/read/CAN)           I (set/read/CAN)       P (set/CAN)      T (CAN)\n");
+    for (uint8_t s = 0; s < NUM_SENSORS; s++) {
+        SensorData_t d = Sensor((INA228_Location_t)s);
+        double amps = (s == INA228_BUS) ? BUS_CURRENT : MOTOR_CURRENT;
+        const SimCanFrame_t* el = &meas_last[MEAS_PAGE_ELECTRICAL][s];
+        const SimCanFrame_t* dg = &meas_last[MEAS_PAGE_DIAG][s];
+        double can_v = Frame_Field(el, 1, 2, 0) / 1000.0;
+        double can_i = Frame_Field(el, 3, 3, 1) / 1000.0;
+        double can_p = Frame_Field(el, 6, 2, 0) / 10.0;
+        double can_t = Frame_Field(dg, 1, 2, 1) / 100.0;
+        printf("               %u        %5.2f / %6.3f / %6.3f    %5.2f / %6.3f / %6.3f   %6.1f / %6.1f   %5.2f%s\n", s,
+               BUS_VOLTAGE, d.voltage, can_v, amps, d.current, can_i, BUS_VOLTAGE * amps, can_p, can_t,
+               d.healthy ? "" : "  (unhealthy)");
+        Check(d.healthy, "sensor healthy");
+        Check(fabs(d.voltage - BUS_VOLTAGE) < 0.05, "voltage reading");
+        Check(fabs(d.current - amps) < 0.01, "current reading");
+        Check(el->dlc == 8 && fabs(can_v - BUS_VOLTAGE) < 0.002 && fabs(can_i - amps) < 0.002, "CAN values");
+        Check(fabs(can_p - BUS_VOLTAGE * amps) < 0.2, "CAN power");
+        Check(dg->dlc == 8 && fabs(can_t - 25.0) < 0.02, "CAN die temperature");
+        Check(fabs(Frame_Field(dg, 3, 3, 1) / 1.0e7 - d.shunt_voltage) < 1.0e-6, "CAN shunt voltage");
+    }
+
+    // Polling reads results whenever the interval comes round; conversion-ready sampling reads each one once
+    printf("results:       sensor   new/s   read/s  stale/s  missed/s  (%s)\n",
+           SENSOR_CNVR_SAMPLING ? "conversion ready" : "polled");
+    for (uint8_t s = 0; s < NUM_SENSORS; s++) {
+        uint32_t results = reads1[s].results - reads0[s].results;
+        uint32_t n_reads = reads1[s].reads - reads0[s].reads;
+        uint32_t fresh = reads1[s].fresh_reads - reads0[s].fresh_reads;
+        printf("               %u       %6.1f   %6.1f   %6.1f    %6.1f\n", s, results / window_s, n_reads / window_s,
+               (n_reads - fresh) / window_s, (results - fresh) / window_s);
+#if SENSOR_CNVR_SAMPLING
+        // Full sweeps (energy, fallback poll) may read a result before its ALERT edge is served
+        Check(results - fresh <= 1, "every result read");
+        Check(n_reads - fresh <= 2 * window_s * (1000.0 / ENERGY_INTERVAL_MS + 1000.0 / SENSOR_CNVR_FALLBACK_MS),
+              "stale reads only from full sweeps");
+#endif
+    }
+}
+
+/* Step the current at a different point of the conversion cycle in each phase */
+static void Scenario_Latency(void* result)
+{
+    for (size_t c = 0; c < sizeof(latency_cases) / sizeof(latency_cases[0]); c++) {
+        double min_ms = 1e9, max_ms = 0.0, sum_ms = 0.0;
+        int ok = 1;
+
+        latency_case = &latency_cases[c];
+        for (latency_phase = 0; latency_phase < NUM_PHASES && ok; latency_phase++) {
+            LatencyResult_t r = { 0, 0.0 };
+            Isolated(Latency_Phase, &r, sizeof(r));
+            ok = r.ok;
+            if (r.ms < min_ms) min_ms = r.ms;
+            if (r.ms > max_ms) max_ms = r.ms;
+            sum_ms += r.ms;
+        }
+
+        Check(ok, latency_case->label);
+        if (!ok) continue;
+        printf("%-30s min %7.3f  avg %7.3f  max %7.3f ms\n", latency_case->label, min_ms, sum_ms / NUM_PHASES, max_ms);
+        if (latency_case->alert_connected) Check(max_ms < 5.0, "ALERT trip within one conversion cycle");
+    }
+}
+
+static void Scenario_Logger(void* result)
+{
+    for (size_t c = 0; c < sizeof(logger_cases) / sizeof(logger_cases[0]); c++) {
+        logger_case = &logger_cases[c];
+        Isolated(Logger_Capture, NULL, 0);
+    }
+}
+
+static void Scenario_I2c(void* result)
+{
+    SimI2cStats_t st;
+
+    Boot();
+    Check(Run_Until(Is_Normal, BOOT_TIMEOUT_S), "precharge completes");
+
+    // Motor3 stops answering, motor2 wedges the bus on its next transfer
+    sim_ina228_fault(INA228_MOTOR3)->nack = 1;
+    sim_ina228_fault(INA228_MOTOR2)->stuck = 1;
+    sim_ina228_set_voltage(INA228_BUS, sim_wave_step(BUS_VOLTAGE, BUS_VOLTAGE - 2.0, sim_now_s()));
+    Run_For(1000000000ULL);
+
+    sim_i2c_stats(&st);
+    printf("faulted:       motor2 %s, motor3 %s, bus %.2f V (%s)\n",
+           Sensor(INA228_MOTOR2).healthy ? "healthy" : "unhealthy",
+           Sensor(INA228_MOTOR3).healthy ? "healthy" : "unhealthy",
+           Sensor(INA228_BUS).voltage, Sensor(INA228_BUS).healthy ? "healthy" : "unhealthy");
+    printf("I2C:           %u transfers, %u NACKs, %u aborted\n", st.transfers, st.errors, st.aborts);
+    Check(!Sensor(INA228_MOTOR2).healthy, "stuck sensor flagged");
+    Check(!Sensor(INA228_MOTOR3).healthy, "NACKing sensor flagged");
+    Check(Sensor(INA228_BUS).healthy && fabs(Sensor(INA228_BUS).voltage - (BUS_VOLTAGE - 2.0)) < 0.05,
+          "other sensors keep updating");
+    Check(st.aborts > 0, "stalled sweep aborted");
+
+    // Faults clear: the next sweeps must bring both sensors back
+    sim_ina228_fault(INA228_MOTOR3)->nack = 0;
+    sim_ina228_fault(INA228_MOTOR2)->stuck = 0;
+    Run_For(500000000ULL);
+
+    printf("recovered:     motor2 %s, motor3 %s\n",
+           Sensor(INA228_MOTOR2).healthy ? "healthy" : "unhealthy",
+           Sensor(INA228_MOTOR3).healthy ? "healthy" : "unhealthy");
+    Check(Sensor(INA228_MOTOR2).healthy && Sensor(INA228_MOTOR3).healthy, "sensors recover");
+    Check(get_current_state() == STATE_NORMAL_OPERATION, "no fault from a sensor dropout");
+}
+
+/* One full sweep of all sensors on each port and speed */
+static void Scenario_I2cSpeed(void* result)
+{
+    double base_us = 0.0, fast_us = 0.0;
+    int ok = 1;
+
+    for (size_t c = 0; c < sizeof(bus_cases) / sizeof(bus_cases[0]); c++) {
+        BusSpeedResult_t r = { 0, 0.0 };
+
+        bus_case = &bus_cases[c];
+        Isolated(Bus_Speed_Sweep, &r, sizeof(r));
+        bus_case = NULL;
+        Check(r.ok, bus_cases[c].label);
+        if (!r.ok) {
+            ok = 0;
+            continue;
+        }
+
+        printf("%-26s sweep %7.1f us, at most %6.0f sweeps/s\n", bus_cases[c].label, r.sweep_us, 1e6 / r.sweep_us);
+        if (bus_cases[c].port == I2C_BUS_I2C1 && bus_cases[c].run_hz == 400000U) base_us = r.sweep_us;
+        if (bus_cases[c].port == I2C_BUS_FMPI2C1 && bus_cases[c].run_hz == 1000000U) fast_us = r.sweep_us;
+    }
+    if (ok) Check(fast_us * 2.0 < base_us, "1 MHz FMPI2C1 sweep over twice as fast as 400 kHz I2C1");
+}
+
+/* Frames that lose arbitration come back through the queue, still in ID order */
+static void Scenario_Can(void* result)
+{
+    const uint32_t lost = 4;
+    CanTxStats_t tx;
+    SimCanStats_t can;
+
+    Boot();
+    Check(Run_Until(Is_Normal, BOOT_TIMEOUT_S), "precharge completes");
+    telemetry_set_tx_mode(TELEMETRY_TX_PERIODIC);     // Every frame of every tick is counted
+
+    Can_Reset_Counts();
+    can_order_errors = 0;
+    sim_can_lose_arbitration(lost);
+    Run_For(1000000000ULL);
+
+    can_tx_get_stats(&tx);
+    sim_can_stats(&can);
+    printf("arbitration:   %lu lost on the bus, %lu requeued, %lu sent, %lu dropped, max depth %u\n",
+           (unsigned long)can.arb_lost, (unsigned long)tx.arb_lost, (unsigned long)tx.sent,
+           (unsigned long)tx.dropped, tx.max_depth);
+    printf("  0x%03X        %lu frames  status\n", CAN_ID_STATUS, (unsigned long)status_frames);
+    Check(status_frames == 1000 / CAN_TX_INTERVAL_MS, "every status frame delivered");
+    for (uint8_t s = 0; s < NUM_SENSORS; s++) {
+        printf("  0x%03X/%u      %lu frames  electrical\n", CAN_ID_MEAS, s,
+               (unsigned long)meas_frames[MEAS_PAGE_ELECTRICAL][s]);
+        Check(meas_frames[MEAS_PAGE_ELECTRICAL][s] == 1000 / CAN_TX_INTERVAL_MS, "every telemetry frame delivered");
+    }
+    Check(can.arb_lost == lost && tx.arb_lost == lost, "lost arbitrations counted");
+    Check(tx.dropped == 0, "no CAN frames dropped");
+    Check(can_order_errors == 0, "frames of a tick go out in ID order");
+}
+
+/* The same boot, waveforms and events under both transmission policies */
+static void Scenario_CanTx(void* result)
+{
+    TxPolicyResult_t r[2];
+    static const char* const names[2] = { "periodic", "on-change" };
+
+    for (uint8_t m = 0; m < 2; m++) {
+        memset(&r[m], 0, sizeof(r[m]));
+        tx_policy = (m == 0) ? TELEMETRY_TX_PERIODIC : TELEMETRY_TX_ON_CHANGE;
+        Isolated(Tx_Policy_Run, &r[m], sizeof(r[m]));
+        Check(r[m].ok, names[m]);
+        printf("%-10s     %5.1f frames/s, %.2f%% bus load (status %.1f/s, electrical %.1f/s per sensor), "
+               "step %.1f ms, fault status %.3f ms\n", names[m], r[m].frames_s, r[m].load_pct, r[m].status_s,
+               r[m].electrical_s, r[m].step_ms, r[m].status_ms);
+        Check(r[m].seq_gaps == 0, "status sequence without gaps");
+    }
+
+    Check(fabs(r[1].status_s - 1000.0 / TELEMETRY_HEARTBEAT_MS) < 0.3
+          && fabs(r[1].electrical_s - 1000.0 / TELEMETRY_HEARTBEAT_MS) < 0.3, "heartbeat while nothing changes");
+    Check(r[1].frames_s < r[0].frames_s / 4.0, "steady-state telemetry drops to the heartbeats");
+    Check(r[1].step_ms <= r[0].step_ms + 1.0, "deadband does not delay a real change");
+    Check(r[1].status_ms < 1.0, "fault status sent without waiting for the tick");
+}
+
+/*
+ * Commands injected on the bus as the dashboard would send them, each run
+ * until its acknowledgement is on the bus. Telemetry is periodic so the
+ * frame counts follow the tick directly.
+ */
+static void Scenario_CanCmd(void* result)
+{
+    const uint8_t rate[2] = { CANCMD_RATE_MS & 0xFF, CANCMD_RATE_MS >> 8 };
+    const uint8_t too_fast[2] = { TELEMETRY_RATE_MIN_MS - 1, 0 };
+    const uint8_t slow[2] = { TELEMETRY_RATE_MAX_MS & 0xFF, TELEMETRY_RATE_MAX_MS >> 8 };
+    const uint8_t mask = CANCMD_MASK, bad_mask = 1 << NUM_SENSORS, all = (1 << NUM_SENSORS) - 1;
+    const uint8_t profile[2] = { INA228_PROFILE_BALANCED, 1 << INA228_MOTOR3 };
+    const uint8_t bad_profile[2] = { INA228_NUM_PROFILES, 0 };
+    const uint8_t other[2] = { 0, 0 };
+    double ack_ms, ack_max_ms = 0.0;
+    int commands = 0;
+    SimCanStats_t can0, can1;
+    CanCmdStats_t st;
+
+    Boot();
+    Check(Run_Until(Is_Normal, BOOT_TIMEOUT_S), "precharge completes");
+    telemetry_set_tx_mode(TELEMETRY_TX_PERIODIC);
+    ack_frames = 0;
+
+    // Frames on other IDs never reach the FIFO
+    sim_can_stats(&can0);
+    sim_can_inject(CAN_ID_STATUS, other, 2);
+    Run_For(10000000ULL);
+    sim_can_stats(&can1);
+    Check(can1.rx_dropped - can0.rx_dropped == 1 && ack_frames == 0, "other IDs filtered out");
+
+    // Telemetry rate
+    Check(Command(CAN_CMD_TELEMETRY_RATE, rate, 2, &ack_ms) == CAN_CMD_OK, "TELEMETRY_RATE accepted");
+    if (ack_ms > ack_max_ms) ack_max_ms = ack_ms;
+    Check(Command(CAN_CMD_TELEMETRY_RATE, too_fast, 2, NULL) == CAN_CMD_ERR_ARG, "rate out of range rejected");
+    Check(Command(CAN_CMD_TELEMETRY_RATE, NULL, 0, NULL) == CAN_CMD_ERR_ARG, "rate without argument rejected");
+    commands += 3;
+    Can_Reset_Counts();
+    Run_For(1000000000ULL);
+    printf("rate:          %u ms tick, %lu status frames/s, %lu electrical pages/s per sensor\n", CANCMD_RATE_MS,
+           (unsigned long)status_frames, (unsigned long)meas_frames[MEAS_PAGE_ELECTRICAL][INA228_BUS]);
+    Check(abs((int)status_frames - 1000 / CANCMD_RATE_MS) <= 1, "status frames at the new rate");
+    Check(abs((int)meas_frames[MEAS_PAGE_ELECTRICAL][INA228_BUS] - 1000 / CANCMD_RATE_MS) <= 1,
+          "measurement frames at the new rate");
+
+    // Sensor mask
+    Check(Command(CAN_CMD_SENSOR_MASK, &mask, 1, &ack_ms) == CAN_CMD_OK, "SENSOR_MASK accepted");
+    if (ack_ms > ack_max_ms) ack_max_ms = ack_ms;
+    Check(Command(CAN_CMD_SENSOR_MASK, &bad_mask, 1, NULL) == CAN_CMD_ERR_ARG, "mask past the last sensor rejected");
+    commands += 2;
+    Can_Reset_Counts();
+    Run_For(1000000000ULL);
+    printf("mask:          0x%02X, electrical pages/s", mask);
+    for (uint8_t s = 0; s < NUM_SENSORS; s++) {
+        uint32_t n = meas_frames[MEAS_PAGE_ELECTRICAL][s] + meas_frames[MEAS_PAGE_DIAG][s];
+        printf(" %lu", (unsigned long)meas_frames[MEAS_PAGE_ELECTRICAL][s]);
+        Check(((mask >> s) & 1U) ? n > 0 : n == 0, "measurement frames follow the mask");
+    }
+    printf(", health bits 0x%02lX\n", (unsigned long)Frame_Field(&status_last, 3, 1, 0));
+    Check(Frame_Field(&status_last, 3, 1, 0) == mask, "health bits follow the mask");
+    Check(Command(CAN_CMD_SENSOR_MASK, &all, 1, NULL) == CAN_CMD_OK, "every sensor back on");
+    commands++;
+
+    // ADC profile, written by the FSM on its next tick
+    Check(Command(CAN_CMD_ADC_PROFILE, profile, 2, NULL) == CAN_CMD_OK, "ADC_PROFILE accepted");
+    Check(Command(CAN_CMD_ADC_PROFILE, bad_profile, 2, NULL) == CAN_CMD_ERR_ARG, "bad profile rejected");
+    commands += 2;
+    Run_For(2ULL * FSM_INTERVAL_MS * 1000000ULL);
+    printf("adc:           motor3 %s, motor2 %s\n", INA228_ProfileName(precharge_get_adc_profile(INA228_MOTOR3)),
+           INA228_ProfileName(precharge_get_adc_profile(INA228_MOTOR2)));
+    Check(precharge_get_adc_profile(INA228_MOTOR3) == INA228_PROFILE_BALANCED &&
+          sim_ina228_reg(INA228_MOTOR3, INA228_REG_ADC_CONFIG) == INA228_ProfileAdcConfig(INA228_PROFILE_BALANCED),
+          "profile written to the selected sensor");
+    Check(precharge_get_adc_profile(INA228_MOTOR2) == ADC_RUN_PROFILE, "other sensors keep their profile");
+
+    // Snapshot, with the tick slowed down so only the snapshot's frames are counted
+    Check(Command(CAN_CMD_TELEMETRY_RATE, slow, 2, NULL) == CAN_CMD_OK, "slowest rate accepted");
+    commands++;
+    Run_For(2ULL * CANCMD_RATE_MS * 1000000ULL);    // Release already due on the old grid
+    Can_Reset_Counts();
+    Check(Command(CAN_CMD_SNAPSHOT, NULL, 0, &ack_ms) == CAN_CMD_OK, "SNAPSHOT accepted");
+    if (ack_ms > ack_max_ms) ack_max_ms = ack_ms;
+    commands++;
+    Run_For(5000000ULL);
+    uint32_t electrical = 0, diag = 0;
+    for (uint8_t s = 0; s < NUM_SENSORS; s++) {
+        electrical += meas_frames[MEAS_PAGE_ELECTRICAL][s];
+        diag += meas_frames[MEAS_PAGE_DIAG][s];
+    }
+    printf("snapshot:      %lu status, %lu electrical, %lu diagnostic frames, acknowledged in %.3f ms\n",
+           (unsigned long)status_frames, (unsigned long)electrical, (unsigned long)diag, ack_ms);
+    Check(status_frames == 1 && electrical == NUM_SENSORS && diag == NUM_SENSORS, "snapshot sends every frame once");
+    Check(fabs(Frame_Field(&meas_last[MEAS_PAGE_ELECTRICAL][INA228_BUS], 1, 2, 0) / 1000.0 - BUS_VOLTAGE) < 0.002,
+          "snapshot values");
+
+    Check(Command(0x7F, NULL, 0, NULL) == CAN_CMD_ERR_UNKNOWN, "unknown opcode rejected");
+    commands++;
+
+    // Fault reset: refused while motor1 is still over its limit, accepted once it is back
+    sim_ina228_set_current(INA228_MOTOR1, sim_wave_step(MOTOR_CURRENT, 30.0, sim_now_s()));
+    Check(Run_Until(Relays_Open, 1.0), "motor1 overcurrent trips");
+    Run_For(500000000ULL);
+    int refused = Command(CAN_CMD_FAULT_RESET, NULL, 0, NULL);
+    Check(refused == CAN_CMD_ERR_BUSY && get_current_state() == STATE_FAULT, "reset refused while the overcurrent persists");
+    sim_ina228_set_current(INA228_MOTOR1, sim_wave_step(30.0, MOTOR_CURRENT, sim_now_s()));
+    Run_For(500000000ULL);
+    Check(Command(CAN_CMD_FAULT_RESET, NULL, 0, NULL) == CAN_CMD_OK, "FAULT_RESET accepted");
+    commands += 2;
+    uint64_t t_reset = sim_now_ns();
+    Check(Run_Until(Is_Normal, BOOT_TIMEOUT_S), "back to normal operation");
+    printf("fault reset:   %s while the overcurrent persists, NORMAL %.1f ms after the reset\n",
+           refused == CAN_CMD_ERR_BUSY ? "refused" : "not refused", Ms(sim_now_ns() - t_reset));
+    Run_For(2ULL * FSM_INTERVAL_MS * 1000000ULL);
+    Check(get_current_fault() == FAULT_NONE && get_fault_sensors() == 0 && !Relays_Open(), "fault cleared, relays closed");
+
+    can_cmd_get_stats(&st);
+    printf("commands:      %lu received, %lu acknowledged, %lu dropped, slowest acknowledgement %.3f ms\n",
+           (unsigned long)st.received, (unsigned long)ack_frames, (unsigned long)st.dropped, ack_max_ms);
+    Check(st.received == (uint32_t)commands && ack_frames == (uint32_t)commands && st.dropped == 0,
+          "every command acknowledged");
+}
+
+/*
+ * A bus fault that makes every TX frame fail with a bit error, as a shorted
+ * or badly terminated bus would: bus-off after 32 errors, restarts whose
+ * backoff doubles while the fault lasts, recovery once it is gone, and the
+ * health frame before and after. Telemetry is periodic so the load is
+ * steady.
+ */
+static void Scenario_CanHealth(void* result)
+{
+    CanHealth_t h;
+    SimCanStats_t can0, can1;
+    double gap_ms[CANHEALTH_RESTARTS];
+    int timed = 0;
+
+    Boot();
+    Check(Run_Until(Is_Normal, BOOT_TIMEOUT_S), "precharge completes");
+    telemetry_set_tx_mode(TELEMETRY_TX_PERIODIC);
+    Run_For(1000000000ULL);
+
+    // Healthy bus: the firmware's load estimate against the bus model
+    Can_Reset_Counts();
+    sim_can_stats(&can0);
+    Run_For((uint64_t)CANHEALTH_WINDOW_S * 1000000000ULL);
+    sim_can_stats(&can1);
+    can_health_get(&h);
+    double load_pct = 100.0 * (double)(can1.busy_ns - can0.busy_ns) / (CANHEALTH_WINDOW_S * 1e9);
+    double frames_s = (can1.tx_frames - can0.tx_frames) / (double)CANHEALTH_WINDOW_S;
+    printf("healthy:       state %u, TEC %u, load %.2f%% (bus %.2f%%, frame %.1f%%), %ld frames sent per health frame\n",
+           h.state, h.tec, h.load_centi_pct / 100.0, load_pct, health_last.data[7] * 0.5,
+           (long)Frame_Field(&health_last, 4, 2, 0));
+    Check(health_frames == CANHEALTH_WINDOW_S * 1000 / CAN_HEALTH_FRAME_MS, "health frame once a second");
+    Check(h.state == CAN_ERROR_ACTIVE && h.tec == 0 && h.bus_offs == 0 && health_last.data[2] == 0, "error active");
+    Check(fabs(h.load_centi_pct / 100.0 - load_pct) < 0.02, "bus load estimate");
+    Check(fabs(health_last.data[7] * 0.5 - load_pct) <= 0.25, "bus load in the health frame");
+    Check(fabs(Frame_Field(&health_last, 4, 2, 0) - frames_s * CAN_HEALTH_FRAME_MS / 1000.0) <= 1.0,
+          "frames sent in the health frame");
+
+    // Every frame fails: error warning, error passive, then bus-off at the 32nd error
+    health_lost = 0;
+    uint64_t t_fault = sim_now_ns();
+    sim_can_tx_errors(UINT32_MAX, CAN_LEC_BIT_DOMINANT);
+    Check(Run_Until(Bus_Off, 2.0), "bus-off");
+    double off_ms = Ms(sim_now_ns() - t_fault);
+    Run_For(100000ULL);     // Error interrupt
+    can_health_get(&h);
+    printf("bus-off:       %.1f ms after the fault, %lu bus errors, last error %u\n", off_ms,
+           (unsigned long)h.bus_errors, h.last_error);
+    Check(h.bus_offs == 1 && h.bus_errors == 32 && h.last_error == CAN_LEC_BIT_DOMINANT, "bus-off reported by the error interrupt");
+
+    // While the fault lasts every restart ends in another bus-off, each one waited out twice as long
+    uint32_t backoff_ms = CAN_BUSOFF_BACKOFF_MIN_MS;
+    for (; timed < CANHEALTH_RESTARTS; timed++) {
+        uint64_t t_off = sim_now_ns();
+        can_health_get(&h);
+        restarts_seen = h.restarts;
+        if (!Run_Until(Restarted, 10.0)) break;
+        gap_ms[timed] = Ms(sim_now_ns() - t_off);
+        Check(gap_ms[timed] > backoff_ms - 1.0 && gap_ms[timed] <= backoff_ms + CAN_HEALTH_INTERVAL_MS + 1.0,
+              "restart after the backoff");   // Tick resolution: the bus-off is stamped to the millisecond
+        backoff_ms = (backoff_ms * 2 > CAN_BUSOFF_BACKOFF_MAX_MS) ? CAN_BUSOFF_BACKOFF_MAX_MS : backoff_ms * 2;
+        if (!Run_Until(Bus_On, 0.1) || !Run_Until(Bus_Off, 2.0)) break;
+    }
+    Check(timed == CANHEALTH_RESTARTS, "bus-off again after every restart");
+    printf("restarts:      after");
+    for (int k = 0; k < timed; k++) printf(" %.0f", gap_ms[k]);
+    printf(" ms\n");
+
+    // Fault gone: back on the bus at the next restart
+    sim_can_tx_errors(0, 0);
+    Can_Reset_Counts();
+    uint64_t t_clear = sim_now_ns();
+    Check(Run_Until(Status_Sent, (backoff_ms + 2 * CAN_HEALTH_INTERVAL_MS) / 1000.0), "telemetry back on the bus");
+    double back_ms = Ms(sim_now_ns() - t_clear);
+    Can_Reset_Counts();
+    Run_For(2000000000ULL);
+    can_health_get(&h);
+    sim_can_stats(&can1);
+    printf("recovered:     telemetry %.0f ms after the fault cleared, state %u, TEC %u, %lu bus-offs, "
+           "%lu frames lost, %lu bus errors\n", back_ms, h.state, h.tec, (unsigned long)h.bus_offs,
+           (unsigned long)health_lost, (unsigned long)h.bus_errors);
+    Check(h.state == CAN_ERROR_ACTIVE && h.tec == 0, "error active after recovery");
+    Check(h.bus_offs == can1.bus_offs && health_last.data[3] == can1.bus_offs, "bus-offs counted");
+    Check(health_lost > 0 && (health_last.data[2] >> 4) == CAN_LEC_BIT_DOMINANT, "health frame reports the losses");
+    Check(abs((int)status_frames - (int)(2000 / CAN_TX_INTERVAL_MS)) <= 1, "telemetry at its rate again");
+
+    // A bus that stays up restarts the backoff
+    Run_For((uint64_t)CAN_BUSOFF_STABLE_MS * 1000000ULL);
+    can_health_get(&h);
+    Check(h.backoff_ms == CAN_BUSOFF_BACKOFF_MIN_MS, "backoff back to the minimum");
+}
+
+/*
+ * Energy and charge totals over ENERGY_WINDOW_S against the model's power and
+ * current. The bus sensor starts just below the ENERGY and CHARGE wrap
+ * points, so its totals have to carry across both overflows.
+ */
+static void Scenario_Energy(void* result)
+{
+    const double step_s = 3 * 1052e-6 * 64;     // The sensors add to ENERGY/CHARGE once per averaged result
+    SimCanFrame_t first[NUM_SENSORS];
+
+    Boot();
+    // 3 s below the wrap at the bus load (register LSBs: 16 x POWER LSB per ENERGY code, CURRENT LSB per CHARGE code)
+    double energy_per_s = BUS_VOLTAGE * BUS_CURRENT / (INA228_ENERGY_LSB_FACTOR * BUS_POWER_LSB);
+    double charge_per_s = BUS_CURRENT / BUS_CURRENT_LSB;
+    sim_ina228_set_accumulators(INA228_BUS, 1099511627776.0 - 3.0 * energy_per_s, 549755813888.0 - 3.0 * charge_per_s);
+
+    Check(Run_Until(Is_Normal, BOOT_TIMEOUT_S), "precharge completes");
+    memset(energy_frames, 0, sizeof(energy_frames));
+    Check(Run_Until(Energy_Frame, 1.5), "energy frames sent");
+    memcpy(first, energy_last, sizeof(first));
+    memset(energy_frames, 0, sizeof(energy_frames));
+
+    Run_For(ENERGY_WINDOW_S * 1000000000ULL + 1000000ULL);
+
+    for (uint8_t s = 0; s < NUM_SENSORS; s++) {
+        double amps = (s == INA228_BUS) ? BUS_CURRENT : MOTOR_CURRENT;
+        double dt_s = (energy_last[s].t_ns - first[s].t_ns) / 1e9;
+        double dt_h = dt_s / 3600.0;
+        double mwh = (double)Frame_Milli_Wh(&energy_last[s]) - Frame_Milli_Wh(&first[s]);
+        double mah = (double)Frame_Milli_Ah(&energy_last[s]) - Frame_Milli_Ah(&first[s]);
+        double set_mwh = BUS_VOLTAGE * amps * dt_h * 1e3;
+        double set_mah = amps * dt_h * 1e3;
+
+        printf("  0x%03X        %lu frames, %.0f mWh (set %.1f), %.0f mAh (set %.2f)%s\n",
+               CAN_ID_ENERGY_BUS + s, (unsigned long)energy_frames[s], mwh, set_mwh, mah, set_mah,
+               (s == INA228_BUS) ? "  across wrap" : "");
+        Check(energy_frames[s] == ENERGY_WINDOW_S * 1000 / ENERGY_INTERVAL_MS, "energy frame rate");
+        Check(fabs(mwh - set_mwh) <= 1.0 + set_mwh * step_s / dt_s, "energy total");
+        Check(fabs(mah - set_mah) <= 1.0 + set_mah * step_s / dt_s, "charge total");
+    }
+
+    // Totals restart from zero, the sensors keep integrating
+    energy_reset();
+    memset(energy_frames, 0, sizeof(energy_frames));
+    Run_Until(Energy_Frame, 1.5);
+    printf("after reset:   bus %lu mWh, %ld mAh\n", (unsigned long)Frame_Milli_Wh(&energy_last[INA228_BUS]),
+           (long)Frame_Milli_Ah(&energy_last[INA228_BUS]));
+    Check(Frame_Milli_Wh(&energy_last[INA228_BUS]) <= BUS_VOLTAGE * BUS_CURRENT * (1.0 + step_s) / 3.6 + 1.0, "energy reset");
+}
+
+/*
+ * ADC_CONFIG as written to the model: the bus sensor runs the fast profile
+ * while precharging, so the first sweep after the threshold crossing sees
+ * it, then every sensor runs its run profile. A run profile
+ * selected at runtime reaches the sensor on the next FSM tick.
+ */
+static void Scenario_Adc(void* result)
+{
+    const INA228_AdcProfile_t selected = INA228_PROFILE_BALANCED;
+    double t_cross_s = -PRECHARGE_TAU_S * log(1.0 - PRECHARGE_THRESHOLD_PERCENT / 100.0);
+
+    Boot();
+    Check(sim_ina228_reg(INA228_BUS, INA228_REG_ADC_CONFIG) == INA228_ProfileAdcConfig(ADC_PRECHARGE_PROFILE),
+          "bus sensor on the precharge profile");
+    Check(sim_ina228_reg(INA228_MOTOR1, INA228_REG_ADC_CONFIG) == INA228_ProfileAdcConfig(ADC_RUN_PROFILE),
+          "motor sensors on the run profile");
+
+    Check(Run_Until(Is_Normal, BOOT_TIMEOUT_S), "precharge completes");
+    double lag_ms = (sim_now_s() - t_cross_s) * 1e3;
+    printf("precharge:     %s, complete %.1f ms after the threshold crossing\n",
+           INA228_ProfileName(ADC_PRECHARGE_PROFILE), lag_ms);
+    // Without the logger, sweeps start every SENSOR_POLL_INTERVAL_MS on the next FSM tick
+    Check(lag_ms < 3.0 * INA228_ProfileResultUs(ADC_PRECHARGE_PROFILE) / 1e3 + SENSOR_POLL_INTERVAL_MS + FSM_INTERVAL_MS,
+          "completion seen on the next sweep");
+
+    Run_For(2ULL * FSM_INTERVAL_MS * 1000000ULL);
+    Check(precharge_get_adc_profile(INA228_BUS) == ADC_RUN_PROFILE &&
+          sim_ina228_reg(INA228_BUS, INA228_REG_ADC_CONFIG) == INA228_ProfileAdcConfig(ADC_RUN_PROFILE),
+          "bus sensor back on the run profile");
+
+    // Runtime selection on one motor sensor, conversions counted over a second
+    Check(precharge_set_adc_profile(1 << INA228_MOTOR1, selected) == HAL_OK, "profile selected");
+    Check(precharge_set_adc_profile(1 << INA228_MOTOR1, INA228_NUM_PROFILES) != HAL_OK, "bad profile rejected");
+    Run_For(2ULL * FSM_INTERVAL_MS * 1000000ULL);
+    Check(precharge_get_adc_profile(INA228_MOTOR1) == selected &&
+          sim_ina228_reg(INA228_MOTOR1, INA228_REG_ADC_CONFIG) == INA228_ProfileAdcConfig(selected),
+          "selected profile written");
+
+    uint32_t conv0 = sim_ina228_conversions(INA228_MOTOR1);
+    uint32_t other0 = sim_ina228_conversions(INA228_MOTOR2);
+    Run_For(1000000000ULL);
+    uint32_t results = (sim_ina228_conversions(INA228_MOTOR1) - conv0) / 16;
+    uint32_t other = (sim_ina228_conversions(INA228_MOTOR2) - other0) / 64;
+    printf("motor1:        %s, %lu results/s (motor2 %s, %lu results/s)\n", INA228_ProfileName(selected),
+           (unsigned long)results, INA228_ProfileName(ADC_RUN_PROFILE), (unsigned long)other);
+    Check(abs((int)results - (int)(1000000U / INA228_ProfileResultUs(selected))) <= 1, "result rate of the selected profile");
+    Check(Sensor(INA228_MOTOR1).healthy && fabs(Sensor(INA228_MOTOR1).current - MOTOR_CURRENT) < 0.01,
+          "readings keep flowing");
+    Check(Is_Normal(), "no fault from a profile change");
+}
+
+/* ------------------------------------------------------------------------- */
+/* Scenario cases                                                            */
+/* ------------------------------------------------------------------------- */
+
+static void Latency_Phase(void* result)
+{
+    const LatencyCase_t* lc = latency_case;
+    LatencyResult_t* r = result;
+    int (*tripped)(void) = (lc->sensor == INA228_BUS) ? Contactor_Open : Relays_Open;
+
+    Boot();
+    sim_ina228_fault(lc->sensor)->alert_disconnected = !lc->alert_connected;
+    if (!Run_Until(Is_Normal, BOOT_TIMEOUT_S)) return;
+
+    Run_For(500000000ULL + (uint64_t)latency_phase * PHASE_STEP_NS);
+    uint64_t t_step = sim_now_ns();
+    if (lc->step_voltage) {
+        sim_ina228_set_voltage(lc->sensor, sim_wave_step(BUS_VOLTAGE, lc->target, sim_now_s()));
+    } else {
+        double base = (lc->sensor == INA228_BUS) ? BUS_CURRENT : MOTOR_CURRENT;
+        sim_ina228_set_current(lc->sensor, sim_wave_step(base, lc->target, sim_now_s()));
+    }
+
+    if (!Run_Until(tripped, 2.0)) return;
+    r->ms = Ms(sim_gpio_changed_ns(lc->port, lc->pin) - t_step);
+
+    // The cause is resolved from DIAG_ALRT on a later sweep
+    Run_For(500000000ULL);
+    r->ok = (get_current_fault() == lc->expect);
+}
+
+static void Bus_Speed_Sweep(void* result)
+{
+    BusSpeedResult_t* r = result;
+
+    Boot();
+    if (!Run_Until(Is_Normal, BOOT_TIMEOUT_S)) return;
+    if (bus_case->run_hz != bus_case->boot_hz) {
+        Check(Run_Until(Acq_Idle, 0.1), "bus idle for the speed change");
+        Check(i2c_bus_set_speed(bus_case->run_hz) == HAL_OK, "runtime speed change");
+    }
+    Check(i2c_bus_port() == bus_case->port && i2c_bus_speed() == bus_case->run_hz, "bus port and speed");
+
+    // Time a sweep started on an idle bus, with no conversion-ready read chained behind it
+    for (uint8_t s = 0; s < NUM_SENSORS; s++) sim_ina228_fault(s)->alert_disconnected = 1;
+    if (!Run_Until(Acq_Idle, 0.1) || sensor_acq_start_sweep(ACQ_TRIGGER_POLL) != HAL_OK) return;
+    uint64_t t0 = sim_now_ns();
+    if (!Run_Until(Acq_Idle, 0.1)) return;
+    r->sweep_us = (sim_now_ns() - t0) / 1e3;
+    for (uint8_t s = 0; s < NUM_SENSORS; s++) sim_ina228_fault(s)->alert_disconnected = 0;
+
+    // Readings keep flowing at the new speed
+    Run_For(500000000ULL);
+    r->ok = Is_Normal() && Sensor(INA228_BUS).healthy && fabs(Sensor(INA228_BUS).voltage - BUS_VOLTAGE) < 0.5;
+}
+
+static void Logger_Capture(void* result)
+{
+    uint32_t rate_hz = logger_case->rate_hz;
+    uint32_t duration_s = logger_case->duration_s;
+    size_t len;
+    uint32_t samples = 0, frames = 0, bad = 0, gaps = 0, invalid = 0, wrong = 0, unordered = 0;
+    uint32_t end_dropped = 0, end_overruns = 0, end_latency = 0;
+    int have_info = 0, have_end = 0, have_seq = 0, have_t = 0;
+    uint16_t last_seq = 0;
+    uint32_t last_t = 0;
+    uint8_t sensors[INA228_NUM_SENSORS], n_sensors = 0, fields = 0;
+
+    Boot();
+    Check(Run_Until(Is_Normal, BOOT_TIMEOUT_S), "precharge completes");
+    Run_For((uint64_t)(10 * PRECHARGE_TAU_S * 1e9));    // Bus settled, so every sample can be checked against BUS_VOLTAGE
+    sim_uart_clear_output();
+
+    uint64_t t_start = sim_now_ns();
+    Check(uart_logger_start(rate_hz, duration_s, logger_case->sensor_mask, logger_case->fields), "capture starts");
+    Check(Run_Until(Logger_Idle, duration_s + 2.0), "capture ends");
+    Run_For(50000000ULL);   // Let the last DMA transfer drain
+    double elapsed_s = (sim_now_ns() - t_start) / 1e9;
+
+    const uint8_t* out = sim_uart_output(&len);
+    size_t pos = 0;
+    if (len >= 3 && memcmp(out, "OK\n", 3) == 0) pos = 3;
+    else Check(0, "OK reply");
+
+    // Split on the 0x00 delimiters, undo COBS and verify the CRC of every frame
+    while (pos < len) {
+        uint8_t frame[LOG_FRAME_MAX_ENCODED];
+        size_t n = 0, end = pos;
+        while (end < len && out[end] != 0) end++;
+        if (end == len) break;
+
+        size_t i = pos;
+        int valid = 1;
+        while (i < end && valid) {
+            uint8_t code = out[i++];
+            if (code == 0 || i + code - 1 > end || n + code > sizeof(frame)) { valid = 0; break; }
+            for (uint8_t k = 1; k < code; k++) frame[n++] = out[i++];
+            if (code != 0xFF && i < end) frame[n++] = 0;
+        }
+        pos = end + 1;
+
+        if (!valid || n < 5 || log_crc16(frame, (uint16_t)(n - 2)) != (frame[n - 2] | (frame[n - 1] << 8))) {
+            bad++;
+            continue;
+        }
+        frames++;
+
+        uint16_t seq = (uint16_t)(frame[1] | (frame[2] << 8));
+        if (have_seq && seq != (uint16_t)(last_seq + 1)) gaps++;
+        last_seq = seq;
+        have_seq = 1;
+
+        switch (frame[0]) {
+            case LOG_FRAME_INFO:
+                have_info = 1;
+                fields = frame[7];
+                n_sensors = frame[8];
+                for (uint8_t k = 0; k < n_sensors && k < INA228_NUM_SENSORS; k++) sensors[k] = frame[9 + 9 * k];
+                break;
+            case LOG_FRAME_SAMPLES: {
+                // One record per sweep: timestamp, valid bits, the listed sensors' samples in order
+                uint8_t sample_size = log_sample_size(fields);
+                size_t record_size = LOG_RECORD_HEADER_SIZE + n_sensors * sample_size;
+                if (!have_info || 4 + frame[3] * record_size != n - 2) { bad++; break; }
+                for (uint8_t r = 0; r < frame[3]; r++) {
+                    const uint8_t* rec = &frame[4 + r * record_size];
+                    uint32_t t = (uint32_t)(rec[0] | (rec[1] << 8) | (rec[2] << 16) | ((uint32_t)rec[3] << 24));
+                    if (have_t && (int32_t)(t - last_t) <= 0) unordered++;
+                    last_t = t;
+                    have_t = 1;
+                    if (rec[4] != (1U << n_sensors) - 1) invalid++;
+                    for (uint8_t k = 0; k < n_sensors; k++)
+                        if (!Log_Values_Ok(sensors[k], fields, &rec[LOG_RECORD_HEADER_SIZE + k * sample_size])) wrong++;
+                }
+                samples += frame[3];
+                break;
+            }
+            case LOG_FRAME_END:
+                have_end = 1;
+                memcpy(&end_dropped, &frame[3], 4);
+                memcpy(&end_overruns, &frame[7], 4);
+                memcpy(&end_latency, &frame[11], 4);
+                break;
+            default: bad++; break;
+        }
+    }
+
+    char field_names[6];
+    uint8_t nf = 0;
+    for (uint8_t f = 0; f < 5; f++)
+        if (logger_case->fields & (1U << f)) field_names[nf++] = "VIPTS"[f];
+    field_names[nf] = '\0';
+
+    uint32_t scheduled = rate_hz * duration_s;
+    printf("%5lu Hz x %lus, sensors 0x%02X %-5s: %lu/%lu sweeps, %lu overruns, %lu dropped, max latency %lu us\n",
+           (unsigned long)rate_hz, (unsigned long)duration_s, logger_case->sensor_mask, field_names,
+           (unsigned long)samples, (unsigned long)scheduled,
+           (unsigned long)end_overruns, (unsigned long)end_dropped, (unsigned long)end_latency);
+    printf("               %lu frames (%lu bad, %lu seq gaps), %.0f B/s, %.2f B/sweep\n",
+           (unsigned long)frames, (unsigned long)bad, (unsigned long)gaps, len / elapsed_s,
+           samples ? (double)len / samples : 0.0);
+
+    Check(have_info && have_end, "INFO and END frames present");
+    Check(n_sensors == __builtin_popcount(logger_case->sensor_mask) && fields == logger_case->fields, "INFO lists the selection");
+    Check(bad == 0 && gaps == 0, "frames intact and in sequence");
+    Check(unordered == 0, "one timestamp per sweep, in order");
+    Check(invalid == 0 && wrong == 0, "every selected sensor valid and its fields decode to the model");
+    Check(abs((int)(samples + end_overruns + end_dropped) - (int)scheduled) <= 2, "every tick accounted for");
+}
+
+/* ------------------------------------------------------------------------- */
+/* Firmware boot and main loop                                               */
+/* ------------------------------------------------------------------------- */
+
+static void Boot(void)
+{
+    sim_init();
+
+    // Bus clocks of SystemClock_Config() for the built profile
+#if CLOCK_PROFILE == CLOCK_PROFILE_FULL
+    sim_set_clocks(180000000U, 4, 2);
+#elif CLOCK_PROFILE == CLOCK_PROFILE_BALANCED
+    sim_set_clocks(84000000U, 2, 1);
+#else
+    sim_set_clocks(CLOCK_USE_HSE ? HSE_VALUE : HSI_VALUE, 1, 1);
+#endif
+    sim_can_set_tx_hook(Can_Hook);
+    Can_Reset_Counts();
+    memset(energy_frames, 0, sizeof(energy_frames));
+
+    // Bus charges through the precharge resistor, motor rails follow it
+    sim_ina228_set_voltage(INA228_BUS, sim_wave_rc(0.0, BUS_VOLTAGE, 0.0, PRECHARGE_TAU_S));
+    sim_ina228_set_current(INA228_BUS, sim_wave_const(BUS_CURRENT));
+    for (uint8_t s = INA228_MOTOR1; s <= INA228_MOTOR4; s++) {
+        sim_ina228_set_voltage(s, sim_wave_const(BUS_VOLTAGE));
+        sim_ina228_set_current(s, sim_wave_const(MOTOR_CURRENT));
+    }
+
+    // Same order as main()
+    MX_GPIO_Init();
+    MX_DMA_Init();
+    MX_USART2_UART_Init();
+    MX_I2C1_Init();
+    MX_CAN1_Init();
+    if (bus_case) Check(i2c_bus_init(bus_case->port, bus_case->boot_hz) == HAL_OK, "sensor bus init");
+    else Check(i2c_bus_init(I2C_BUS_PORT, I2C_BUS_SPEED_HZ) == HAL_OK, "sensor bus init");
+    sampler_init();
+#if PROFILE_ENABLE
+    profile_init();
+#endif
+    precharge_control_init();
+    HAL_CAN_Start(&hcan1);
+    can_tx_init();
+    can_health_init();
+    Check(can_cmd_init() == HAL_OK, "CAN command filter");
+    telemetry_init();
+    energy_init();
+    uart_logger_init();
+
+    sched_init(tasks, NUM_TASKS);
+}
+
+/* One dispatcher pass of main()'s sched_run(): one task, or WFI */
+static void Loop_Once(void)
+{
+    sched_run_once();
+    sim_cpu_ns(LOOP_COST_NS);
+}
+
+static uint64_t Run_For(uint64_t ns)
+{
+    uint64_t end = sim_now_ns() + ns;
+    uint64_t loops = 0;
+
+    sim_wake_at(end);   // Stop exactly at end, not at the next SysTick
+    while (sim_now_ns() < end) {
+        Loop_Once();
+        loops++;
+    }
+    sim_wake_at(0);
+    return loops;
+}
+
+static int Run_Until(int (*done)(void), double timeout_s)
+{
+    uint64_t end = sim_now_ns() + (uint64_t)(timeout_s * 1e9);
+
+    while (!done()) {
+        if (sim_now_ns() >= end) return 0;
+        Loop_Once();
+    }
+    return 1;
+}
+
+static int Is_Normal(void)
+{
+    return get_current_state() == STATE_NORMAL_OPERATION;
+}
+
+static int Contactor_Open(void)
+{
+    return !sim_gpio_output(CONTACTOR_GPIO_Port, CONTACTOR_Pin);
+}
+
+static int Relays_Open(void)
+{
+    return sim_gpio_output(MOTOR1_GPIO_Port, MOTOR1_Pin | MOTOR2_Pin | MOTOR3_Pin | MOTOR4_Pin);  // Active low
+}
+
+static int Logger_Idle(void)
+{
+    return !uart_logger_active();
+}
+
+static int Acq_Idle(void)
+{
+    return !sensor_acq_busy();
+}
+
+/* Every sensor's energy frame seen since energy_frames was cleared */
+static int Energy_Frame(void)
+{
+    for (uint8_t s = 0; s < NUM_SENSORS; s++) {
+        if (energy_frames[s] == 0) return 0;
+    }
+    return 1;
+}
+
+/* Motor1's electrical page shows the cantx step (halfway is enough, the filter is still catching up) */
+static int Step_Sent(void)
+{
+    double amps = Frame_Field(&meas_last[MEAS_PAGE_ELECTRICAL][INA228_MOTOR1], 3, 3, 1) / 1000.0;
+    return amps > MOTOR_CURRENT + 0.1;
+}
+
+static int Fault_Status_Sent(void)
+{
+    return status_fault_ns != 0;
+}
+
+/* Acknowledgement of the last command sent by Command() */
+static int Ack_Received(void)
+{
+    return ack_last.dlc == 3 && ack_last.data[1] == cmd_tag;
+}
+
+static int Bus_Off(void)
+{
+    return (hcan1.Instance->ESR & CAN_ESR_BOFF) != 0;
+}
+
+static int Bus_On(void)
+{
+    return !Bus_Off();
+}
+
+/* can_health restarted the controller since restarts_seen was taken */
+static int Restarted(void)
+{
+    CanHealth_t h;
+    can_health_get(&h);
+    return h.restarts > restarts_seen;
+}
+
+static int Status_Sent(void)
+{
+    return status_frames > 0;
+}
+
+static void Can_Hook(const SimCanFrame_t* frame)
+{
+    static SimCanFrame_t prev;
+
+    // Frames of one tick follow each other within a millisecond; the health frame comes from its own task
+    if (frame->id != CAN_ID_CAN_HEALTH) {
+        if (frame->t_ns - prev.t_ns < 1000000ULL && frame->id < prev.id) can_order_errors++;
+        prev = *frame;
+    }
+
+    if (frame->id == CAN_ID_STATUS) {
+        if (status_frames > 0 && frame->data[5] != (uint8_t)(status_last.data[5] + 1)) status_seq_gaps++;
+        if (frame->data[0] == STATE_FAULT && status_fault_ns == 0) status_fault_ns = frame->t_ns;
+        status_frames++;
+        status_last = *frame;
+    } else if (frame->id == CAN_ID_MEAS) {
+        uint8_t page = frame->data[0] >> 4;
+        uint8_t sensor = frame->data[0] & 0x0F;
+        if (page <= MEAS_PAGE_DIAG && sensor < NUM_SENSORS) {
+            meas_frames[page][sensor]++;
+            meas_last[page][sensor] = *frame;
+        }
+    } else if (frame->id == CAN_ID_CAN_HEALTH) {
+        health_frames++;
+        health_lost += frame->data[6];
+        health_last = *frame;
+    } else if (frame->id == CAN_ID_CMD_ACK) {
+        ack_frames++;
+        ack_last = *frame;
+    } else if (frame->id >= CAN_ID_ENERGY_BUS && frame->id < CAN_ID_ENERGY_BUS + NUM_SENSORS) {
+        energy_frames[frame->id - CAN_ID_ENERGY_BUS]++;
+        energy_last[frame->id - CAN_ID_ENERGY_BUS] = *frame;
+    }
+}
+
+/* Steady state, a motor1 current step, then a motor2 ALERT trip, under tx_policy */
+static void Tx_Policy_Run(void* result)
+{
+    TxPolicyResult_t* r = result;
+    SimCanStats_t can0, can1;
+
+    Boot();
+    if (!Run_Until(Is_Normal, BOOT_TIMEOUT_S)) return;
+    telemetry_set_tx_mode(tx_policy);
+    Run_For(1500000000ULL);     // Filters settled, the full resend after the mode change is over
+
+    Can_Reset_Counts();
+    sim_can_stats(&can0);
+    Run_For((uint64_t)CANTX_WINDOW_S * 1000000000ULL);
+    sim_can_stats(&can1);
+
+    r->frames_s = (can1.tx_frames - can0.tx_frames) / (double)CANTX_WINDOW_S;
+    r->load_pct = 100.0 * (double)(can1.busy_ns - can0.busy_ns) / (CANTX_WINDOW_S * 1e9);
+    r->status_s = status_frames / (double)CANTX_WINDOW_S;
+    for (uint8_t s = 0; s < NUM_SENSORS; s++) r->electrical_s += meas_frames[MEAS_PAGE_ELECTRICAL][s];
+    r->electrical_s /= (double)CANTX_WINDOW_S * NUM_SENSORS;
+
+    uint64_t t_step = sim_now_ns();
+    sim_ina228_set_current(INA228_MOTOR1, sim_wave_step(MOTOR_CURRENT, CANTX_STEP_CURRENT, sim_now_s()));
+    if (!Run_Until(Step_Sent, 2.0)) return;
+    r->step_ms = Ms(meas_last[MEAS_PAGE_ELECTRICAL][INA228_MOTOR1].t_ns - t_step);
+
+    status_fault_ns = 0;
+    sim_ina228_set_current(INA228_MOTOR2, sim_wave_step(MOTOR_CURRENT, 30.0, sim_now_s()));
+    if (!Run_Until(Relays_Open, 1.0) || !Run_Until(Fault_Status_Sent, 1.0)) return;
+    r->status_ms = Ms(status_fault_ns - sim_gpio_changed_ns(MOTOR2_GPIO_Port, MOTOR2_Pin));
+    r->seq_gaps = status_seq_gaps;
+    r->ok = 1;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Helpers                                                                   */
+/* ------------------------------------------------------------------------- */
+
+/* Run body in a fresh copy of this (never booted) process, collecting its result and failed checks */
+static void Isolated(void (*body)(void* result), void* result, size_t size)
+{
+    int fds[2];
+    int status;
+
+    fflush(stdout);
+    if (pipe(fds) != 0) { perror("pipe"); exit(255); }
+
+    pid_t pid = fork();
+    if (pid < 0) { perror("fork"); exit(255); }
+    if (pid == 0) {
+        close(fds[0]);
+        failures = 0;
+        body(result);
+        if (size && write(fds[1], result, size) != (ssize_t)size) failures++;
+        fflush(stdout);
+        _exit(failures > 254 ? 254 : failures);
+    }
+
+    close(fds[1]);
+    if (size && read(fds[0], result, size) != (ssize_t)size) memset(result, 0, size);
+    close(fds[0]);
+
+    if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status)) {
+        printf("  FAIL: simulation crashed\n");
+        failures++;
+        return;
+    }
+    failures += WEXITSTATUS(status);
+}
+
+static void Check(int ok, const char* what)
+{
+    if (ok) return;
+    printf("  FAIL: %s (t = %.3f s)\n", what, sim_now_s());
+    failures++;
+}
+
+static double Host_Seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double Ms(uint64_t ns)
+{
+    return ns / 1e6;
+}
+
+static SensorData_t Sensor(INA228_Location_t location)
+{
+    SensorData_t data;
+    get_sensor_data(location, &data);
+    return data;
+}
+
+/* Clear the telemetry frame counters */
+static void Can_Reset_Counts(void)
+{
+    status_frames = 0;
+    status_seq_gaps = 0;
+    memset(meas_frames, 0, sizeof(meas_frames));
+    health_frames = 0;
+}
+
+/* Little-endian field of a telemetry frame, sign extended when is_signed */
+static int32_t Frame_Field(const SimCanFrame_t* frame, uint8_t offset, uint8_t bytes, int is_signed)
+{
+    uint32_t v = 0;
+    for (uint8_t b = 0; b < bytes; b++) v |= (uint32_t)frame->data[offset + b] << (8 * b);
+    if (is_signed && bytes < 4 && (v >> (8 * bytes - 1)) & 1U) v |= ~0U << (8 * bytes);
+    return (int32_t)v;
+}
+
+/* Unpack a logged sample (log_frame.h bit string) and compare every field with the model's steady state */
+static int Log_Values_Ok(uint8_t sensor, uint8_t fields, const uint8_t* sample)
+{
+    static const uint8_t bits[] = { 20, 20, 24, 16, 20 };
+    const SensorDesc_t* desc = &g_sensor_table[sensor];
+    double amps = (sensor == INA228_BUS) ? BUS_CURRENT : MOTOR_CURRENT;
+    unsigned pos = 0;
+    int ok = 1;
+
+    for (uint8_t f = 0; f < sizeof(bits); f++) {
+        if (!(fields & (1U << f))) continue;
+        uint32_t v = 0;
+        for (uint8_t b = 0; b < bits[f]; b++, pos++) v |= (uint32_t)((sample[pos / 8] >> (pos % 8)) & 1U) << b;
+        int32_t code = (f == 2 || !(v >> (bits[f] - 1))) ? (int32_t)v : (int32_t)(v | (~0U << bits[f]));
+
+        switch (f) {
+            case 0: ok &= fabs(code * INA228_VBUS_LSB - BUS_VOLTAGE) < 0.05; break;
+            case 1: ok &= fabs(code * desc->current_lsb - amps) < 0.01; break;
+            case 2: ok &= fabs(code * desc->power_lsb - BUS_VOLTAGE * amps) < 0.2; break;
+            case 3: ok &= fabs(code * INA228_DIETEMP_LSB - 25.0) < 0.1; break;
+            case 4: ok &= fabs(code * INA228_VSHUNT_LSB - amps * desc->shunt_resistor) < 1e-4; break;
+        }
+    }
+    return ok;
+}
+
+/*
+ * Put a command frame on the bus with a new tag and run until its
+ * acknowledgement; returns the result, -1 if none came. ack_ms (optional)
+ * is the time from handing the frame to the bus to the end of the
+ * acknowledgement.
+ */
+static int Command(uint8_t opcode, const uint8_t* args, uint8_t n_args, double* ack_ms)
+{
+    uint8_t data[8] = { opcode, ++cmd_tag };
+
+    if (n_args) memcpy(&data[2], args, n_args);
+    sim_can_inject(CAN_ID_CMD, data, (uint8_t)(2 + n_args));
+    uint64_t t0 = sim_now_ns();
+    if (!Run_Until(Ack_Received, 0.1)) return -1;
+    if (ack_ms) *ack_ms = Ms(ack_last.t_ns - t0);
+    return ack_last.data[2];
+}
+
+static uint32_t Frame_Milli_Wh(const SimCanFrame_t* frame)
+{
+    return (uint32_t)frame->data[0] | ((uint32_t)frame->data[1] << 8) | ((uint32_t)frame->data[2] << 16) | ((uint32_t)frame->data[3] << 24);
+}
+
+static int32_t Frame_Milli_Ah(const SimCanFrame_t* frame)
+{
+    return (int32_t)((uint32_t)frame->data[4] | ((uint32_t)frame->data[5] << 8) | ((uint32_t)frame->data[6] << 16) | ((uint32_t)frame->data[7] << 24));
+}
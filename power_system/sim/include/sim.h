@@ -0,0 +1,130 @@
+/*
+ * sim.h
+ *
+ * Control interface of the host simulator. The firmware only ever sees the
+ * stub HAL in stm32f4xx_hal.h; this header is for the benchmark harness,
+ * which drives the virtual clock, sets up the INA228 waveforms, injects
+ * faults and inspects what the firmware put on CAN, UART and GPIO.
+ *
+ * Time is virtual and counted in nanoseconds from sim_init(). It only moves
+ * when the firmware or the harness spends it (see SimConfig_t), so a run is
+ * fully deterministic and independent of the host's speed.
+ */
+
+#ifndef SIM_H_
+#define SIM_H_
+
+#include "stm32f4xx_hal.h"
+#include <stdint.h>
+#include <stddef.h>
+
+#define SIM_NUM_INA228      5       // Indexed like INA228_Location_t, I2C address 0x40 + index
+
+/* CPU time charged to the firmware, all in virtual nanoseconds */
+typedef struct {
+    uint32_t gettick_ns;            // Per HAL_GetTick() call; busy-wait loops advance time through it
+    uint32_t isr_entry_ns;          // Per interrupt dispatch (exception entry + HAL dispatch)
+    uint32_t i2c_overhead_ns;       // Per I2C transfer on top of the bit time (driver and ISR work)
+} SimConfig_t;
+
+/* Virtual clock */
+void sim_init(void);                // Reset every model; call before the MX_*_Init functions
+SimConfig_t* sim_config(void);
+uint64_t sim_now_ns(void);
+double sim_now_s(void);
+void sim_run_ns(uint64_t ns);       // Let time pass in the calling context, delivering interrupts
+void sim_cpu_ns(uint32_t ns);       // Same, for CPU work the harness wants to account for
+void sim_set_clocks(uint32_t sysclk_hz, uint8_t apb1_div, uint8_t apb2_div);  // What SystemClock_Config() would set up; call after sim_init()
+void sim_wake_at(uint64_t t_ns);    // __WFI() sleeps no later than this (0 = no limit), to stop at an exact time
+
+/* Analog waveforms fed to the INA228 models (units: V or A, seconds) */
+typedef enum {
+    SIM_WAVE_CONST,                 // a
+    SIM_WAVE_STEP,                  // a before t0, b from t0 on
+    SIM_WAVE_RC,                    // a before t0, then a + (b - a)(1 - e^(-(t - t0)/tau))
+    SIM_WAVE_SINE                   // a + b sin(2 pi freq t)
+} SimWaveKind_t;
+
+typedef struct {
+    SimWaveKind_t kind;
+    double a, b;
+    double t0, tau, freq;
+    double noise;                   // Gaussian noise RMS added to every conversion
+} SimWaveform_t;
+
+/* Per-sensor fault injection, changes take effect on the next transfer / conversion */
+typedef struct {
+    uint8_t nack;                   // Device does not acknowledge its address
+    uint8_t stuck;                  // Device holds SDA low: interrupt transfers never complete
+    uint8_t memstat_fail;           // DIAG_ALRT reports a trim memory checksum error
+    uint8_t alert_disconnected;     // ALERT line never leaves its pulled-up level
+    uint32_t extra_latency_us;      // Clock stretching added to every transfer
+} SimIna228Fault_t;
+
+/* Averaged results against VBUS reads: a read is fresh if a result arrived since the previous one */
+typedef struct {
+    uint32_t results;
+    uint32_t reads;
+    uint32_t fresh_reads;
+} SimIna228Reads_t;
+
+void sim_ina228_set_voltage(uint8_t idx, SimWaveform_t wave);
+void sim_ina228_set_current(uint8_t idx, SimWaveform_t wave);
+void sim_ina228_set_shunt(uint8_t idx, double ohms);
+void sim_ina228_set_temperature(uint8_t idx, double celsius);
+void sim_ina228_set_accumulators(uint8_t idx, double energy, double charge);  // ENERGY / CHARGE in register LSBs
+SimIna228Fault_t* sim_ina228_fault(uint8_t idx);
+uint32_t sim_ina228_reg(uint8_t idx, uint8_t reg);      // Register peek, no side effects
+uint32_t sim_ina228_conversions(uint8_t idx);           // Individual ADC conversions so far
+void sim_ina228_read_stats(uint8_t idx, SimIna228Reads_t* stats);
+
+SimWaveform_t sim_wave_const(double value);
+SimWaveform_t sim_wave_step(double before, double after, double t0);
+SimWaveform_t sim_wave_rc(double from, double to, double t0, double tau);
+SimWaveform_t sim_wave_sine(double offset, double amplitude, double freq);
+
+/* I2C bus */
+typedef struct {
+    uint32_t transfers;
+    uint32_t errors;                // NACKed transfers
+    uint32_t timeouts;              // Blocking transfers that hit their timeout
+    uint32_t aborts;                // Transfers cut short by HAL_I2C_DeInit
+    uint64_t busy_ns;               // Time SCL was running
+} SimI2cStats_t;
+void sim_i2c_stats(SimI2cStats_t* stats);
+
+/* GPIO */
+uint8_t sim_gpio_output(GPIO_TypeDef* port, uint16_t pin);
+uint64_t sim_gpio_changed_ns(GPIO_TypeDef* port, uint16_t pin);    // Last level change of an output, 0 = never
+
+/* CAN bus, every frame that wins arbitration is reported to the hook */
+typedef struct {
+    uint32_t id;
+    uint8_t dlc;
+    uint8_t data[8];
+    uint64_t t_ns;                  // End of frame
+} SimCanFrame_t;
+
+typedef struct {
+    uint32_t tx_frames;
+    uint32_t rx_frames;
+    uint32_t rx_dropped;            // No filter matched, or FIFO full
+    uint32_t arb_lost;              // TX frames that lost arbitration (sim_can_lose_arbitration)
+    uint32_t tx_errors;             // TX frames that failed with an error (sim_can_tx_errors)
+    uint32_t bus_offs;              // Entries into bus-off
+    uint64_t busy_ns;
+} SimCanStats_t;
+
+void sim_can_set_tx_hook(void (*hook)(const SimCanFrame_t* frame));
+void sim_can_inject(uint32_t std_id, const uint8_t* data, uint8_t dlc);
+void sim_can_lose_arbitration(uint32_t frames);     // The next TX frames lose arbitration to another node
+void sim_can_tx_errors(uint32_t frames, uint8_t lec); // The next TX frames fail with ESR.LEC error lec, 0 = stop failing
+void sim_can_stats(SimCanStats_t* stats);
+uint32_t sim_can_bitrate(void);
+
+/* UART (USART2 / ST-LINK VCP) */
+void sim_uart_inject(const char* text);                 // Host -> MCU, paced at the configured baud rate
+const uint8_t* sim_uart_output(size_t* len);            // MCU -> host, everything sent since the last clear
+void sim_uart_clear_output(void);
+
+#endif /* SIM_H_ */
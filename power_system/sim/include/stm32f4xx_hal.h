@@ -0,0 +1,601 @@
+/*
+ * stm32f4xx_hal.h (host simulator stub)
+ *
+ * Stands in for the STM32F4 HAL and CMSIS headers when the firmware modules
+ * are compiled for Linux. Only the types, registers and functions the
+ * firmware actually uses are provided. Peripheral behaviour (I2C bus with
+ * INA228 models, CAN, UART, TIM2, GPIO, DWT) is implemented in sim/src and
+ * driven by the virtual clock in sim.h.
+ *
+ * Interrupts are delivered when virtual time advances: in HAL_GetTick(),
+ * HAL_Delay(), blocking transfers, __WFI() and the harness's per-iteration
+ * loop cost. Handlers never nest and are held off while PRIMASK is set.
+ */
+
+#ifndef SIM_STM32F4XX_HAL_H_
+#define SIM_STM32F4XX_HAL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ------------------------------------------------------------------------- */
+/* Common                                                                    */
+/* ------------------------------------------------------------------------- */
+
+typedef enum {
+    HAL_OK      = 0x00U,
+    HAL_ERROR   = 0x01U,
+    HAL_BUSY    = 0x02U,
+    HAL_TIMEOUT = 0x03U
+} HAL_StatusTypeDef;
+
+typedef enum { RESET = 0U, SET = !RESET } FlagStatus, ITStatus;
+typedef enum { DISABLE = 0U, ENABLE = !DISABLE } FunctionalState;
+
+#define HAL_MAX_DELAY   0xFFFFFFFFU
+#define UNUSED(X)       (void)(X)
+#define __weak          __attribute__((weak))
+#define __IO            volatile
+
+extern uint32_t SystemCoreClock;
+
+#define HSE_VALUE       8000000U
+#define HSI_VALUE       16000000U
+
+uint32_t HAL_GetTick(void);
+void HAL_Delay(uint32_t Delay);
+void HAL_IncTick(void);
+HAL_StatusTypeDef HAL_Init(void);
+
+/* ------------------------------------------------------------------------- */
+/* Cortex-M core                                                             */
+/* ------------------------------------------------------------------------- */
+
+typedef enum {
+    NonMaskableInt_IRQn = -14,
+    SysTick_IRQn        = -1,
+    EXTI0_IRQn          = 6,
+    EXTI1_IRQn          = 7,
+    EXTI2_IRQn          = 8,
+    EXTI3_IRQn          = 9,
+    EXTI4_IRQn          = 10,
+    DMA1_Stream6_IRQn   = 17,
+    CAN1_TX_IRQn        = 19,
+    CAN1_RX0_IRQn       = 20,
+    CAN1_RX1_IRQn       = 21,
+    CAN1_SCE_IRQn       = 22,
+    EXTI9_5_IRQn        = 23,
+    TIM2_IRQn           = 28,
+    I2C1_EV_IRQn        = 31,
+    I2C1_ER_IRQn        = 32,
+    USART2_IRQn         = 38,
+    EXTI15_10_IRQn      = 40,
+    FMPI2C1_EV_IRQn     = 95,
+    FMPI2C1_ER_IRQn     = 96
+} IRQn_Type;
+
+void __disable_irq(void);
+void __enable_irq(void);
+uint32_t __get_PRIMASK(void);
+void __set_PRIMASK(uint32_t priMask);
+void __WFI(void);
+void __NOP(void);
+
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority);
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn);
+void HAL_NVIC_DisableIRQ(IRQn_Type IRQn);
+
+typedef struct {
+    __IO uint32_t CTRL;
+    __IO uint32_t CYCCNT;
+} DWT_Type;
+
+typedef struct {
+    __IO uint32_t DEMCR;
+} CoreDebug_Type;
+
+extern DWT_Type sim_dwt;
+extern CoreDebug_Type sim_coredebug;
+#define DWT         (&sim_dwt)
+#define CoreDebug   (&sim_coredebug)
+
+#define DWT_CTRL_CYCCNTENA_Msk          (1UL << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk      (1UL << 24)
+
+/* ------------------------------------------------------------------------- */
+/* RCC                                                                       */
+/* ------------------------------------------------------------------------- */
+
+typedef struct {
+    __IO uint32_t CFGR;
+    __IO uint32_t APB1ENR;
+    __IO uint32_t APB2ENR;
+} RCC_TypeDef;
+
+extern RCC_TypeDef sim_rcc;
+#define RCC     (&sim_rcc)
+
+#define RCC_CFGR_PPRE1          (0x7UL << 10)
+#define RCC_CFGR_PPRE1_DIV1     (0x0UL << 10)
+#define RCC_CFGR_PPRE1_DIV2     (0x4UL << 10)
+#define RCC_CFGR_PPRE1_DIV4     (0x5UL << 10)
+
+#define __HAL_RCC_TIM2_CLK_ENABLE()     do { RCC->APB1ENR |= (1UL << 0); } while (0)
+#define __HAL_RCC_I2C1_CLK_ENABLE()     do { RCC->APB1ENR |= (1UL << 21); } while (0)
+#define __HAL_RCC_I2C1_CLK_DISABLE()    do { RCC->APB1ENR &= ~(1UL << 21); } while (0)
+#define __HAL_RCC_CAN1_CLK_ENABLE()     do { RCC->APB1ENR |= (1UL << 25); } while (0)
+#define __HAL_RCC_CAN1_CLK_DISABLE()    do { RCC->APB1ENR &= ~(1UL << 25); } while (0)
+#define __HAL_RCC_USART2_CLK_ENABLE()   do { RCC->APB1ENR |= (1UL << 17); } while (0)
+#define __HAL_RCC_USART2_CLK_DISABLE()  do { RCC->APB1ENR &= ~(1UL << 17); } while (0)
+#define __HAL_RCC_DMA1_CLK_ENABLE()     do { } while (0)
+#define __HAL_RCC_GPIOA_CLK_ENABLE()    do { } while (0)
+#define __HAL_RCC_GPIOB_CLK_ENABLE()    do { } while (0)
+#define __HAL_RCC_GPIOC_CLK_ENABLE()    do { } while (0)
+#define __HAL_RCC_GPIOD_CLK_ENABLE()    do { } while (0)
+#define __HAL_RCC_GPIOH_CLK_ENABLE()    do { } while (0)
+
+uint32_t HAL_RCC_GetSysClockFreq(void);
+uint32_t HAL_RCC_GetHCLKFreq(void);
+uint32_t HAL_RCC_GetPCLK1Freq(void);
+uint32_t HAL_RCC_GetPCLK2Freq(void);
+
+/* ------------------------------------------------------------------------- */
+/* GPIO                                                                      */
+/* ------------------------------------------------------------------------- */
+
+typedef enum {
+    GPIO_PIN_RESET = 0,
+    GPIO_PIN_SET
+} GPIO_PinState;
+
+typedef struct {
+    __IO uint32_t IDR;
+    __IO uint32_t ODR;
+} GPIO_TypeDef;
+
+typedef struct {
+    uint32_t Pin;
+    uint32_t Mode;
+    uint32_t Pull;
+    uint32_t Speed;
+    uint32_t Alternate;
+} GPIO_InitTypeDef;
+
+extern GPIO_TypeDef sim_gpio[4];
+#define GPIOA   (&sim_gpio[0])
+#define GPIOB   (&sim_gpio[1])
+#define GPIOC   (&sim_gpio[2])
+#define GPIOD   (&sim_gpio[3])
+
+#define GPIO_PIN_0      ((uint16_t)0x0001)
+#define GPIO_PIN_1      ((uint16_t)0x0002)
+#define GPIO_PIN_2      ((uint16_t)0x0004)
+#define GPIO_PIN_3      ((uint16_t)0x0008)
+#define GPIO_PIN_4      ((uint16_t)0x0010)
+#define GPIO_PIN_5      ((uint16_t)0x0020)
+#define GPIO_PIN_6      ((uint16_t)0x0040)
+#define GPIO_PIN_7      ((uint16_t)0x0080)
+#define GPIO_PIN_8      ((uint16_t)0x0100)
+#define GPIO_PIN_9      ((uint16_t)0x0200)
+#define GPIO_PIN_10     ((uint16_t)0x0400)
+#define GPIO_PIN_11     ((uint16_t)0x0800)
+#define GPIO_PIN_12     ((uint16_t)0x1000)
+#define GPIO_PIN_13     ((uint16_t)0x2000)
+#define GPIO_PIN_14     ((uint16_t)0x4000)
+#define GPIO_PIN_15     ((uint16_t)0x8000)
+
+#define GPIO_MODE_INPUT         0x00000000U
+#define GPIO_MODE_OUTPUT_PP     0x00000001U
+#define GPIO_MODE_OUTPUT_OD     0x00000011U
+#define GPIO_MODE_AF_PP         0x00000002U
+#define GPIO_MODE_AF_OD         0x00000012U
+#define GPIO_MODE_ANALOG        0x00000003U
+#define GPIO_MODE_IT_RISING     0x10110000U
+#define GPIO_MODE_IT_FALLING    0x10210000U
+#define GPIO_MODE_IT_RISING_FALLING 0x10310000U
+#define GPIO_NOPULL             0x00000000U
+#define GPIO_PULLUP             0x00000001U
+#define GPIO_PULLDOWN           0x00000002U
+#define GPIO_SPEED_FREQ_LOW     0x00000000U
+#define GPIO_SPEED_FREQ_MEDIUM  0x00000001U
+#define GPIO_SPEED_FREQ_HIGH    0x00000002U
+#define GPIO_SPEED_FREQ_VERY_HIGH 0x00000003U
+#define GPIO_AF4_I2C1           0x04U
+#define GPIO_AF7_USART2         0x07U
+#define GPIO_AF9_CAN1           0x09U
+
+void HAL_GPIO_Init(GPIO_TypeDef* GPIOx, GPIO_InitTypeDef* GPIO_Init);
+void HAL_GPIO_DeInit(GPIO_TypeDef* GPIOx, uint32_t GPIO_Pin);
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin);
+void HAL_GPIO_WritePin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState);
+void HAL_GPIO_TogglePin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin);
+void HAL_GPIO_EXTI_IRQHandler(uint16_t GPIO_Pin);
+void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin);
+
+/* ------------------------------------------------------------------------- */
+/* TIM (register level only, TIM2)                                           */
+/* ------------------------------------------------------------------------- */
+
+typedef struct {
+    __IO uint32_t CR1;
+    __IO uint32_t CR2;
+    __IO uint32_t SMCR;
+    __IO uint32_t DIER;
+    __IO uint32_t SR;
+    __IO uint32_t EGR;
+    __IO uint32_t CCMR1;
+    __IO uint32_t CCMR2;
+    __IO uint32_t CCER;
+    __IO uint32_t CNT;
+    __IO uint32_t PSC;
+    __IO uint32_t ARR;
+    __IO uint32_t RCR;
+    __IO uint32_t CCR1;
+    __IO uint32_t CCR2;
+    __IO uint32_t CCR3;
+    __IO uint32_t CCR4;
+} TIM_TypeDef;
+
+extern TIM_TypeDef sim_tim2;
+#define TIM2    (&sim_tim2)
+
+#define TIM_CR1_CEN         (1UL << 0)
+#define TIM_DIER_CC1IE      (1UL << 1)
+#define TIM_SR_CC1IF        (1UL << 1)
+#define TIM_EGR_UG          (1UL << 0)
+
+/* ------------------------------------------------------------------------- */
+/* DMA                                                                       */
+/* ------------------------------------------------------------------------- */
+
+typedef struct { uint32_t id; } DMA_Stream_TypeDef;
+extern DMA_Stream_TypeDef sim_dma1_stream6_instance;
+#define DMA1_Stream6    (&sim_dma1_stream6_instance)
+
+typedef struct {
+    uint32_t Channel;
+    uint32_t Direction;
+    uint32_t PeriphInc;
+    uint32_t MemInc;
+    uint32_t PeriphDataAlignment;
+    uint32_t MemDataAlignment;
+    uint32_t Mode;
+    uint32_t Priority;
+    uint32_t FIFOMode;
+    uint32_t FIFOThreshold;
+    uint32_t MemBurst;
+    uint32_t PeriphBurst;
+} DMA_InitTypeDef;
+
+typedef struct {
+    DMA_Stream_TypeDef* Instance;
+    DMA_InitTypeDef Init;
+    void* Parent;
+} DMA_HandleTypeDef;
+
+#define DMA_CHANNEL_4           0x08000000U
+#define DMA_MEMORY_TO_PERIPH    0x00000040U
+#define DMA_PINC_DISABLE        0x00000000U
+#define DMA_MINC_ENABLE         0x00000400U
+#define DMA_PDATAALIGN_BYTE     0x00000000U
+#define DMA_MDATAALIGN_BYTE     0x00000000U
+#define DMA_NORMAL              0x00000000U
+#define DMA_CIRCULAR            0x00000100U
+#define DMA_PRIORITY_LOW        0x00000000U
+#define DMA_FIFOMODE_DISABLE    0x00000000U
+
+#define __HAL_LINKDMA(__HANDLE__, __PPP_DMA_FIELD__, __DMA_HANDLE__) \
+    do { (__HANDLE__)->__PPP_DMA_FIELD__ = &(__DMA_HANDLE__); (__DMA_HANDLE__).Parent = (__HANDLE__); } while (0)
+
+HAL_StatusTypeDef HAL_DMA_Init(DMA_HandleTypeDef* hdma);
+HAL_StatusTypeDef HAL_DMA_DeInit(DMA_HandleTypeDef* hdma);
+void HAL_DMA_IRQHandler(DMA_HandleTypeDef* hdma);
+
+/* ------------------------------------------------------------------------- */
+/* I2C                                                                       */
+/* ------------------------------------------------------------------------- */
+
+typedef struct { uint32_t id; } I2C_TypeDef;
+extern I2C_TypeDef sim_i2c1_instance;
+#define I2C1    (&sim_i2c1_instance)
+
+typedef struct {
+    uint32_t ClockSpeed;
+    uint32_t DutyCycle;
+    uint32_t OwnAddress1;
+    uint32_t AddressingMode;
+    uint32_t DualAddressMode;
+    uint32_t OwnAddress2;
+    uint32_t GeneralCallMode;
+    uint32_t NoStretchMode;
+} I2C_InitTypeDef;
+
+typedef enum {
+    HAL_I2C_STATE_RESET   = 0x00U,
+    HAL_I2C_STATE_READY   = 0x20U,
+    HAL_I2C_STATE_BUSY    = 0x24U,
+    HAL_I2C_STATE_BUSY_TX = 0x21U,
+    HAL_I2C_STATE_BUSY_RX = 0x22U
+} HAL_I2C_StateTypeDef;
+
+typedef struct {
+    I2C_TypeDef* Instance;
+    I2C_InitTypeDef Init;
+    __IO HAL_I2C_StateTypeDef State;
+    __IO uint32_t ErrorCode;
+} I2C_HandleTypeDef;
+
+#define I2C_DUTYCYCLE_2             0x00000000U
+#define I2C_ADDRESSINGMODE_7BIT     0x00004000U
+#define I2C_DUALADDRESS_DISABLE     0x00000000U
+#define I2C_GENERALCALL_DISABLE     0x00000000U
+#define I2C_NOSTRETCH_DISABLE       0x00000000U
+#define I2C_MEMADD_SIZE_8BIT        0x00000001U
+#define HAL_I2C_ERROR_AF        0x00000004U
+
+HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef* hi2c);
+HAL_StatusTypeDef HAL_I2C_DeInit(I2C_HandleTypeDef* hi2c);
+HAL_StatusTypeDef HAL_I2C_Master_Transmit(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint8_t* pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_I2C_Mem_Write(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t* pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_I2C_Mem_Read(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t* pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_I2C_Mem_Read_IT(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t* pData, uint16_t Size);
+HAL_I2C_StateTypeDef HAL_I2C_GetState(I2C_HandleTypeDef* hi2c);
+void HAL_I2C_EV_IRQHandler(I2C_HandleTypeDef* hi2c);
+void HAL_I2C_ER_IRQHandler(I2C_HandleTypeDef* hi2c);
+void HAL_I2C_MspInit(I2C_HandleTypeDef* hi2c);
+void HAL_I2C_MspDeInit(I2C_HandleTypeDef* hi2c);
+void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef* hi2c);
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef* hi2c);
+
+/* ------------------------------------------------------------------------- */
+/* CAN                                                                       */
+/* ------------------------------------------------------------------------- */
+
+typedef struct {
+    __IO uint32_t MSR;
+    __IO uint32_t ESR;
+    __IO uint32_t BTR;
+} CAN_TypeDef;
+extern CAN_TypeDef sim_can1_instance;
+#define CAN1    (&sim_can1_instance)
+
+typedef struct {
+    uint32_t Prescaler;
+    uint32_t Mode;
+    uint32_t SyncJumpWidth;
+    uint32_t TimeSeg1;
+    uint32_t TimeSeg2;
+    FunctionalState TimeTriggeredMode;
+    FunctionalState AutoBusOff;
+    FunctionalState AutoWakeUp;
+    FunctionalState AutoRetransmission;
+    FunctionalState ReceiveFifoLocked;
+    FunctionalState TransmitFifoPriority;
+} CAN_InitTypeDef;
+
+typedef enum {
+    HAL_CAN_STATE_RESET     = 0x00U,
+    HAL_CAN_STATE_READY     = 0x01U,
+    HAL_CAN_STATE_LISTENING = 0x02U,
+    HAL_CAN_STATE_ERROR     = 0x05U
+} HAL_CAN_StateTypeDef;
+
+typedef struct {
+    CAN_TypeDef* Instance;
+    CAN_InitTypeDef Init;
+    __IO HAL_CAN_StateTypeDef State;
+    __IO uint32_t ErrorCode;
+} CAN_HandleTypeDef;
+
+typedef struct {
+    uint32_t StdId;
+    uint32_t ExtId;
+    uint32_t IDE;
+    uint32_t RTR;
+    uint32_t DLC;
+    FunctionalState TransmitGlobalTime;
+} CAN_TxHeaderTypeDef;
+
+typedef struct {
+    uint32_t StdId;
+    uint32_t ExtId;
+    uint32_t IDE;
+    uint32_t RTR;
+    uint32_t DLC;
+    uint32_t Timestamp;
+    uint32_t FilterMatchIndex;
+} CAN_RxHeaderTypeDef;
+
+typedef struct {
+    uint32_t FilterIdHigh;
+    uint32_t FilterIdLow;
+    uint32_t FilterMaskIdHigh;
+    uint32_t FilterMaskIdLow;
+    uint32_t FilterFIFOAssignment;
+    uint32_t FilterBank;
+    uint32_t FilterMode;
+    uint32_t FilterScale;
+    uint32_t FilterActivation;
+    uint32_t SlaveStartFilterBank;
+} CAN_FilterTypeDef;
+
+#define CAN_MODE_NORMAL             0x00000000U
+#define CAN_MODE_LOOPBACK           0x40000000U
+#define CAN_SJW_1TQ                 0x00000000U
+#define CAN_SJW_2TQ                 0x01000000U
+#define CAN_BS1_1TQ                 0x00000000U
+#define CAN_BS1_16TQ                0x000F0000U
+#define CAN_BS2_1TQ                 0x00000000U
+#define CAN_BS2_8TQ                 0x00700000U
+/* TimeSegN = (TQ - 1) << shift, like the HAL encodings */
+#define CAN_BS1_TQ(n)               ((uint32_t)((n) - 1U) << 16)
+#define CAN_BS2_TQ(n)               ((uint32_t)((n) - 1U) << 20)
+#define CAN_BTR_TS1_Pos             16U
+#define CAN_BTR_TS2_Pos             20U
+#define CAN_BS1_2TQ   CAN_BS1_TQ(2)
+#define CAN_BS1_3TQ   CAN_BS1_TQ(3)
+#define CAN_BS1_4TQ   CAN_BS1_TQ(4)
+#define CAN_BS1_5TQ   CAN_BS1_TQ(5)
+#define CAN_BS1_6TQ   CAN_BS1_TQ(6)
+#define CAN_BS1_7TQ   CAN_BS1_TQ(7)
+#define CAN_BS1_8TQ   CAN_BS1_TQ(8)
+#define CAN_BS1_9TQ   CAN_BS1_TQ(9)
+#define CAN_BS1_10TQ  CAN_BS1_TQ(10)
+#define CAN_BS1_11TQ  CAN_BS1_TQ(11)
+#define CAN_BS1_12TQ  CAN_BS1_TQ(12)
+#define CAN_BS1_13TQ  CAN_BS1_TQ(13)
+#define CAN_BS1_14TQ  CAN_BS1_TQ(14)
+#define CAN_BS1_15TQ  CAN_BS1_TQ(15)
+#define CAN_BS2_2TQ   CAN_BS2_TQ(2)
+#define CAN_BS2_3TQ   CAN_BS2_TQ(3)
+#define CAN_BS2_4TQ   CAN_BS2_TQ(4)
+#define CAN_BS2_5TQ   CAN_BS2_TQ(5)
+#define CAN_BS2_6TQ   CAN_BS2_TQ(6)
+#define CAN_BS2_7TQ   CAN_BS2_TQ(7)
+
+#define CAN_ID_STD                  0x00000000U
+#define CAN_ID_EXT                  0x00000004U
+#define CAN_RTR_DATA                0x00000000U
+#define CAN_RTR_REMOTE              0x00000002U
+#define CAN_RX_FIFO0                0x00000000U
+#define CAN_RX_FIFO1                0x00000001U
+#define CAN_FILTER_FIFO0            0x00000000U
+#define CAN_FILTER_FIFO1            0x00000001U
+#define CAN_FILTERMODE_IDMASK       0x00000000U
+#define CAN_FILTERMODE_IDLIST       0x00000001U
+#define CAN_FILTERSCALE_16BIT       0x00000000U
+#define CAN_FILTERSCALE_32BIT       0x00000001U
+#define CAN_FILTER_DISABLE          0x00000000U
+#define CAN_FILTER_ENABLE           0x00000001U
+#define CAN_TX_MAILBOX0             0x00000001U
+#define CAN_TX_MAILBOX1             0x00000002U
+#define CAN_TX_MAILBOX2             0x00000004U
+
+#define HAL_CAN_ERROR_NONE          0x00000000U
+#define HAL_CAN_ERROR_EWG           0x00000001U
+#define HAL_CAN_ERROR_EPV           0x00000002U
+#define HAL_CAN_ERROR_BOF           0x00000004U
+#define HAL_CAN_ERROR_STF           0x00000008U
+#define HAL_CAN_ERROR_FOR           0x00000010U
+#define HAL_CAN_ERROR_ACK           0x00000020U
+#define HAL_CAN_ERROR_BR            0x00000040U
+#define HAL_CAN_ERROR_BD            0x00000080U
+#define HAL_CAN_ERROR_CRC           0x00000100U
+#define HAL_CAN_ERROR_TX_ALST0      0x00000800U
+#define HAL_CAN_ERROR_TX_TERR0      0x00001000U
+#define HAL_CAN_ERROR_TX_ALST1      0x00002000U
+#define HAL_CAN_ERROR_TX_TERR1      0x00004000U
+#define HAL_CAN_ERROR_TX_ALST2      0x00008000U
+#define HAL_CAN_ERROR_TX_TERR2      0x00010000U
+
+#define CAN_IT_TX_MAILBOX_EMPTY     0x00000001U
+#define CAN_IT_RX_FIFO0_MSG_PENDING 0x00000002U
+#define CAN_IT_RX_FIFO0_FULL        0x00000004U
+#define CAN_IT_RX_FIFO0_OVERRUN     0x00000008U
+#define CAN_IT_RX_FIFO1_MSG_PENDING 0x00000010U
+#define CAN_IT_RX_FIFO1_FULL        0x00000020U
+#define CAN_IT_RX_FIFO1_OVERRUN     0x00000040U
+#define CAN_IT_ERROR_WARNING        0x00000100U
+#define CAN_IT_ERROR_PASSIVE        0x00000200U
+#define CAN_IT_BUSOFF               0x00000400U
+#define CAN_IT_LAST_ERROR_CODE      0x00000800U
+#define CAN_IT_ERROR                0x00008000U
+
+#define CAN_ESR_EWGF                (1UL << 0)
+#define CAN_ESR_EPVF                (1UL << 1)
+#define CAN_ESR_BOFF                (1UL << 2)
+#define CAN_ESR_LEC_Pos             4U
+#define CAN_ESR_LEC                 (0x7UL << 4)
+#define CAN_ESR_TEC_Pos             16U
+#define CAN_ESR_TEC                 (0xFFUL << 16)
+#define CAN_ESR_REC_Pos             24U
+#define CAN_ESR_REC                 (0xFFUL << 24)
+
+HAL_StatusTypeDef HAL_CAN_Init(CAN_HandleTypeDef* hcan);
+void HAL_CAN_IRQHandler(CAN_HandleTypeDef* hcan);
+void HAL_CAN_MspInit(CAN_HandleTypeDef* hcan);
+void HAL_CAN_MspDeInit(CAN_HandleTypeDef* hcan);
+HAL_StatusTypeDef HAL_CAN_Start(CAN_HandleTypeDef* hcan);
+HAL_StatusTypeDef HAL_CAN_Stop(CAN_HandleTypeDef* hcan);
+HAL_StatusTypeDef HAL_CAN_ConfigFilter(CAN_HandleTypeDef* hcan, CAN_FilterTypeDef* sFilterConfig);
+HAL_StatusTypeDef HAL_CAN_AddTxMessage(CAN_HandleTypeDef* hcan, CAN_TxHeaderTypeDef* pHeader, uint8_t aData[], uint32_t* pTxMailbox);
+HAL_StatusTypeDef HAL_CAN_AbortTxRequest(CAN_HandleTypeDef* hcan, uint32_t TxMailboxes);
+uint32_t HAL_CAN_GetTxMailboxesFreeLevel(CAN_HandleTypeDef* hcan);
+uint32_t HAL_CAN_IsTxMessagePending(CAN_HandleTypeDef* hcan, uint32_t TxMailboxes);
+HAL_StatusTypeDef HAL_CAN_GetRxMessage(CAN_HandleTypeDef* hcan, uint32_t RxFifo, CAN_RxHeaderTypeDef* pHeader, uint8_t aData[]);
+uint32_t HAL_CAN_GetRxFifoFillLevel(CAN_HandleTypeDef* hcan, uint32_t RxFifo);
+HAL_StatusTypeDef HAL_CAN_ActivateNotification(CAN_HandleTypeDef* hcan, uint32_t ActiveITs);
+HAL_StatusTypeDef HAL_CAN_DeactivateNotification(CAN_HandleTypeDef* hcan, uint32_t InactiveITs);
+HAL_CAN_StateTypeDef HAL_CAN_GetState(CAN_HandleTypeDef* hcan);
+uint32_t HAL_CAN_GetError(CAN_HandleTypeDef* hcan);
+HAL_StatusTypeDef HAL_CAN_ResetError(CAN_HandleTypeDef* hcan);
+void HAL_CAN_TxMailbox0CompleteCallback(CAN_HandleTypeDef* hcan);
+void HAL_CAN_TxMailbox1CompleteCallback(CAN_HandleTypeDef* hcan);
+void HAL_CAN_TxMailbox2CompleteCallback(CAN_HandleTypeDef* hcan);
+void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef* hcan);
+void HAL_CAN_RxFifo1MsgPendingCallback(CAN_HandleTypeDef* hcan);
+void HAL_CAN_ErrorCallback(CAN_HandleTypeDef* hcan);
+
+/* ------------------------------------------------------------------------- */
+/* UART                                                                      */
+/* ------------------------------------------------------------------------- */
+
+typedef struct { uint32_t id; } USART_TypeDef;
+extern USART_TypeDef sim_usart2_instance;
+#define USART2  (&sim_usart2_instance)
+
+typedef struct {
+    uint32_t BaudRate;
+    uint32_t WordLength;
+    uint32_t StopBits;
+    uint32_t Parity;
+    uint32_t Mode;
+    uint32_t HwFlowCtl;
+    uint32_t OverSampling;
+} UART_InitTypeDef;
+
+typedef enum {
+    HAL_UART_STATE_RESET   = 0x00U,
+    HAL_UART_STATE_READY   = 0x20U,
+    HAL_UART_STATE_BUSY    = 0x24U,
+    HAL_UART_STATE_BUSY_TX = 0x21U,
+    HAL_UART_STATE_BUSY_RX = 0x22U
+} HAL_UART_StateTypeDef;
+
+typedef struct {
+    USART_TypeDef* Instance;
+    UART_InitTypeDef Init;
+    DMA_HandleTypeDef* hdmatx;
+    DMA_HandleTypeDef* hdmarx;
+    __IO HAL_UART_StateTypeDef gState;
+    __IO HAL_UART_StateTypeDef RxState;
+    __IO uint32_t ErrorCode;
+} UART_HandleTypeDef;
+
+#define UART_WORDLENGTH_8B      0x00000000U
+#define UART_STOPBITS_1         0x00000000U
+#define UART_PARITY_NONE        0x00000000U
+#define UART_MODE_TX_RX         0x0000000CU
+#define UART_HWCONTROL_NONE     0x00000000U
+#define UART_OVERSAMPLING_16    0x00000000U
+
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef* huart);
+void HAL_UART_IRQHandler(UART_HandleTypeDef* huart);
+void HAL_UART_MspInit(UART_HandleTypeDef* huart);
+void HAL_UART_MspDeInit(UART_HandleTypeDef* huart);
+HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef* huart, const uint8_t* pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef* huart, const uint8_t* pData, uint16_t Size);
+HAL_StatusTypeDef HAL_UART_Receive_IT(UART_HandleTypeDef* huart, uint8_t* pData, uint16_t Size);
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef* huart);
+void HAL_UART_RxCpltCallback(UART_HandleTypeDef* huart);
+void HAL_UART_ErrorCallback(UART_HandleTypeDef* huart);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIM_STM32F4XX_HAL_H_ */
@@ -0,0 +1,609 @@
+/*
+ * sim_can.c
+ *
+ * bxCAN model for CAN1: three TX mailboxes, two 3-deep RX FIFOs and the 28
+ * acceptance filter banks. The bit rate comes from hcan1.Init and PCLK1,
+ * like the silicon. Pending mailboxes go out one at a time, lowest ID first
+ * (or in request order with TransmitFifoPriority), each taking the
+ * unstuffed frame length on the wire. Every frame that finishes is passed
+ * to the harness hook. Frames injected by the harness are run through the
+ * filters and land in the FIFO of the matching filter. The harness can make
+ * TX frames lose arbitration: the other node's frame occupies the bus for
+ * the same time and the mailbox completes with ALST set, which the HAL
+ * reports through HAL_CAN_ErrorCallback.
+ *
+ * The harness can also make TX frames fail with a bus error. The transmit
+ * error counter follows the CAN rules (+8 per error, -1 per frame sent, no
+ * increment for an ACK error while error passive), and the ESR flags and
+ * LEC follow it and raise the status change/error interrupt. Past 255 the
+ * controller is bus-off: nothing is sent or received until it has seen
+ * 128 x 11 recessive bits, counted automatically with AutoBusOff and
+ * otherwise from when software leaves initialization mode (HAL_CAN_Start).
+ *
+ * Simplifications: no bit stuffing, a failed frame takes a whole frame
+ * time and no error frame follows it, REC stays 0 (injected frames are
+ * always received correctly), no hardware retransmission, and injected
+ * frames do not compete with TX frames for the bus.
+ */
+
+#include "sim_internal.h"
+#include <string.h>
+
+#define CAN_NUM_MAILBOXES   3
+#define CAN_FIFO_DEPTH      3
+#define CAN_NUM_BANKS       28
+#define CAN_RX_QUEUE        64
+
+typedef struct {
+    uint8_t pending;
+    uint32_t order;                 // Request order, for TransmitFifoPriority
+    SimCanFrame_t frame;
+} Mailbox_t;
+
+typedef struct {
+    CAN_RxHeaderTypeDef header;
+    uint8_t data[8];
+} RxEntry_t;
+
+static CAN_HandleTypeDef* can;      // Handle passed to HAL_CAN_Init
+static uint32_t notifications;
+static Mailbox_t mailbox[CAN_NUM_MAILBOXES];
+static uint32_t tx_order;
+static int tx_current;              // Mailbox on the wire, -1 = bus idle
+static uint64_t tx_end_ns;
+static uint32_t tx_done_mask;       // Completed mailboxes waiting for the TX interrupt
+static uint32_t tx_alst_mask;       // Of those, the ones that lost arbitration
+static uint32_t tx_terr_mask;       // Of those, the ones that failed with a bus error
+static uint32_t lose_arbitration;   // TX frames still to lose arbitration
+static uint32_t fail_frames;        // TX frames still to fail with fail_lec
+static uint8_t fail_lec;
+
+static uint16_t tec;                // Transmit error counter, over 255 = bus-off
+static uint8_t lec;                 // ESR.LEC
+static uint8_t bus_off;
+static uint64_t recover_ns;         // End of the bus-off recovery sequence, SIM_NEVER = not counting
+static uint8_t err_pending;         // MSR.ERRI
+
+static RxEntry_t fifo[2][CAN_FIFO_DEPTH];
+static uint8_t fifo_fill[2];
+static CAN_FilterTypeDef filter[CAN_NUM_BANKS];
+
+static struct {
+    SimCanFrame_t frame;
+} rx_queue[CAN_RX_QUEUE];
+static uint8_t rx_head, rx_count;
+
+static SimCanStats_t stats;
+static void (*tx_hook)(const SimCanFrame_t* frame);
+
+/* Local Prototypes */
+static uint64_t Frame_Ns(uint8_t dlc);
+static void Start_Next(uint64_t t_ns);
+static void Deliver(const SimCanFrame_t* frame);
+static int Match_Filter(uint32_t std_id, uint32_t* fifo_out, uint32_t* index_out);
+static void Bus_Error(uint8_t code, uint64_t t_ns);
+static void Update_Esr(void);
+static void Raise_Error(uint32_t esr_before);
+static uint64_t Recovery_Ns(void);
+
+void sim_can_reset(void)
+{
+    can = NULL;
+    notifications = 0;
+    memset(mailbox, 0, sizeof(mailbox));
+    tx_order = 0;
+    tx_current = -1;
+    tx_end_ns = 0;
+    tx_done_mask = 0;
+    tx_alst_mask = 0;
+    tx_terr_mask = 0;
+    lose_arbitration = 0;
+    fail_frames = 0;
+    fail_lec = 0;
+    tec = 0;
+    lec = 0;
+    bus_off = 0;
+    recover_ns = SIM_NEVER;
+    err_pending = 0;
+    memset(fifo, 0, sizeof(fifo));
+    memset(fifo_fill, 0, sizeof(fifo_fill));
+    memset(filter, 0, sizeof(filter));
+    rx_head = rx_count = 0;
+    memset(&stats, 0, sizeof(stats));
+    tx_hook = NULL;
+}
+
+uint64_t sim_can_next(void)
+{
+    uint64_t t = (tx_current >= 0) ? tx_end_ns : SIM_NEVER;
+    if (rx_count && rx_queue[rx_head].frame.t_ns < t) t = rx_queue[rx_head].frame.t_ns;
+    if (recover_ns < t) t = recover_ns;
+    return t;
+}
+
+void sim_can_fire(uint64_t t_ns)
+{
+    if (recover_ns == t_ns) {
+        // Recovery sequence complete: error active with the counters cleared
+        recover_ns = SIM_NEVER;
+        bus_off = 0;
+        tec = 0;
+        Update_Esr();
+        if (tx_current < 0) Start_Next(t_ns);
+        return;
+    }
+
+    if (rx_count && rx_queue[rx_head].frame.t_ns == t_ns) {
+        Deliver(&rx_queue[rx_head].frame);
+        rx_head = (uint8_t)((rx_head + 1) % CAN_RX_QUEUE);
+        rx_count--;
+        return;
+    }
+
+    // TX frame finished, or the bus was taken by the frame that won arbitration
+    Mailbox_t* mb = &mailbox[tx_current];
+    mb->pending = 0;
+    mb->frame.t_ns = t_ns;
+    tx_alst_mask &= ~(1U << tx_current);
+    tx_terr_mask &= ~(1U << tx_current);
+    if (lose_arbitration) {
+        lose_arbitration--;
+        stats.arb_lost++;
+        tx_alst_mask |= 1U << tx_current;
+    } else if (fail_frames) {
+        fail_frames--;
+        stats.tx_errors++;
+        tx_terr_mask |= 1U << tx_current;
+        Bus_Error(fail_lec, t_ns);
+    } else {
+        stats.tx_frames++;
+        if (tec) tec--;
+        lec = 0;            // Cleared by a frame sent without error
+        Update_Esr();
+        if (tx_hook) tx_hook(&mb->frame);
+    }
+
+    if (notifications & CAN_IT_TX_MAILBOX_EMPTY) {
+        tx_done_mask |= 1U << tx_current;
+        sim_irq_pend(CAN1_TX_IRQn);
+    }
+    tx_current = -1;
+    Start_Next(t_ns);
+}
+
+void sim_can_set_tx_hook(void (*hook)(const SimCanFrame_t* frame))
+{
+    tx_hook = hook;
+}
+
+void sim_can_inject(uint32_t std_id, const uint8_t* data, uint8_t dlc)
+{
+    if (rx_count >= CAN_RX_QUEUE) return;
+    if (dlc > 8) dlc = 8;
+
+    // Queued behind any frame already injected, one frame time each
+    uint64_t start = sim_now_ns();
+    if (rx_count) {
+        uint64_t last = rx_queue[(rx_head + rx_count - 1) % CAN_RX_QUEUE].frame.t_ns;
+        if (last > start) start = last;
+    }
+
+    SimCanFrame_t* f = &rx_queue[(rx_head + rx_count) % CAN_RX_QUEUE].frame;
+    memset(f, 0, sizeof(*f));
+    f->id = std_id & 0x7FF;
+    f->dlc = dlc;
+    memcpy(f->data, data, dlc);
+    f->t_ns = start + Frame_Ns(dlc);
+    rx_count++;
+}
+
+void sim_can_lose_arbitration(uint32_t frames)
+{
+    lose_arbitration = frames;
+}
+
+void sim_can_tx_errors(uint32_t frames, uint8_t code)
+{
+    fail_frames = code ? frames : 0;
+    fail_lec = code & 0x7;
+}
+
+void sim_can_stats(SimCanStats_t* out)
+{
+    *out = stats;
+}
+
+uint32_t sim_can_bitrate(void)
+{
+    if (can == NULL || can->Init.Prescaler == 0) return 0;
+
+    uint32_t bs1 = ((can->Init.TimeSeg1 >> 16) & 0xFU) + 1U;
+    uint32_t bs2 = ((can->Init.TimeSeg2 >> 20) & 0x7U) + 1U;
+    return HAL_RCC_GetPCLK1Freq() / (can->Init.Prescaler * (1U + bs1 + bs2));
+}
+
+/* ------------------------------------------------------------------------- */
+/* HAL                                                                       */
+/* ------------------------------------------------------------------------- */
+
+HAL_StatusTypeDef HAL_CAN_Init(CAN_HandleTypeDef* hcan)
+{
+    if (hcan->State == HAL_CAN_STATE_RESET) HAL_CAN_MspInit(hcan);
+    can = hcan;
+    hcan->State = HAL_CAN_STATE_READY;
+    hcan->ErrorCode = 0;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_CAN_Start(CAN_HandleTypeDef* hcan)
+{
+    if (hcan->State != HAL_CAN_STATE_READY) return HAL_ERROR;
+    hcan->State = HAL_CAN_STATE_LISTENING;
+
+    // Leaving initialization mode starts the bus-off recovery sequence
+    if (bus_off && recover_ns == SIM_NEVER) recover_ns = sim_now_ns() + Recovery_Ns();
+    else if (!bus_off && tx_current < 0) Start_Next(sim_now_ns());
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_CAN_Stop(CAN_HandleTypeDef* hcan)
+{
+    if (hcan->State != HAL_CAN_STATE_LISTENING) return HAL_ERROR;
+    hcan->State = HAL_CAN_STATE_READY;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_CAN_ConfigFilter(CAN_HandleTypeDef* hcan, CAN_FilterTypeDef* sFilterConfig)
+{
+    (void)hcan;
+    if (sFilterConfig->FilterBank >= CAN_NUM_BANKS) return HAL_ERROR;
+    filter[sFilterConfig->FilterBank] = *sFilterConfig;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_CAN_AddTxMessage(CAN_HandleTypeDef* hcan, CAN_TxHeaderTypeDef* pHeader, uint8_t aData[], uint32_t* pTxMailbox)
+{
+    if (hcan->State != HAL_CAN_STATE_LISTENING) return HAL_ERROR;
+
+    for (int i = 0; i < CAN_NUM_MAILBOXES; i++) {
+        if (mailbox[i].pending) continue;
+
+        Mailbox_t* mb = &mailbox[i];
+        mb->pending = 1;
+        mb->order = tx_order++;
+        mb->frame.id = (pHeader->IDE == CAN_ID_EXT) ? pHeader->ExtId : pHeader->StdId;
+        mb->frame.dlc = (uint8_t)(pHeader->DLC > 8 ? 8 : pHeader->DLC);
+        memset(mb->frame.data, 0, sizeof(mb->frame.data));
+        memcpy(mb->frame.data, aData, mb->frame.dlc);
+        *pTxMailbox = 1U << i;
+
+        // Setting TXRQ clears RQCP, ALST and TERR: an unserviced completion of this mailbox is lost
+        tx_done_mask &= ~(1U << i);
+        tx_alst_mask &= ~(1U << i);
+        tx_terr_mask &= ~(1U << i);
+
+        if (tx_current < 0) Start_Next(sim_now_ns());
+        return HAL_OK;
+    }
+    return HAL_ERROR;   // No free mailbox
+}
+
+HAL_StatusTypeDef HAL_CAN_AbortTxRequest(CAN_HandleTypeDef* hcan, uint32_t TxMailboxes)
+{
+    (void)hcan;
+    for (int i = 0; i < CAN_NUM_MAILBOXES; i++) {
+        // A frame already on the wire cannot be recalled
+        if ((TxMailboxes & (1U << i)) && i != tx_current) mailbox[i].pending = 0;
+    }
+    return HAL_OK;
+}
+
+uint32_t HAL_CAN_GetTxMailboxesFreeLevel(CAN_HandleTypeDef* hcan)
+{
+    uint32_t free = 0;
+    (void)hcan;
+    for (int i = 0; i < CAN_NUM_MAILBOXES; i++) {
+        if (!mailbox[i].pending) free++;
+    }
+    return free;
+}
+
+uint32_t HAL_CAN_IsTxMessagePending(CAN_HandleTypeDef* hcan, uint32_t TxMailboxes)
+{
+    (void)hcan;
+    for (int i = 0; i < CAN_NUM_MAILBOXES; i++) {
+        if ((TxMailboxes & (1U << i)) && mailbox[i].pending) return 1;
+    }
+    return 0;
+}
+
+HAL_StatusTypeDef HAL_CAN_GetRxMessage(CAN_HandleTypeDef* hcan, uint32_t RxFifo, CAN_RxHeaderTypeDef* pHeader, uint8_t aData[])
+{
+    (void)hcan;
+    if (RxFifo > CAN_RX_FIFO1 || fifo_fill[RxFifo] == 0) return HAL_ERROR;
+
+    *pHeader = fifo[RxFifo][0].header;
+    memcpy(aData, fifo[RxFifo][0].data, 8);
+    memmove(&fifo[RxFifo][0], &fifo[RxFifo][1], sizeof(RxEntry_t) * (CAN_FIFO_DEPTH - 1));
+    fifo_fill[RxFifo]--;
+    return HAL_OK;
+}
+
+uint32_t HAL_CAN_GetRxFifoFillLevel(CAN_HandleTypeDef* hcan, uint32_t RxFifo)
+{
+    (void)hcan;
+    return (RxFifo <= CAN_RX_FIFO1) ? fifo_fill[RxFifo] : 0;
+}
+
+HAL_StatusTypeDef HAL_CAN_ActivateNotification(CAN_HandleTypeDef* hcan, uint32_t ActiveITs)
+{
+    (void)hcan;
+    notifications |= ActiveITs;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_CAN_DeactivateNotification(CAN_HandleTypeDef* hcan, uint32_t InactiveITs)
+{
+    (void)hcan;
+    notifications &= ~InactiveITs;
+    return HAL_OK;
+}
+
+HAL_CAN_StateTypeDef HAL_CAN_GetState(CAN_HandleTypeDef* hcan)
+{
+    return hcan->State;
+}
+
+uint32_t HAL_CAN_GetError(CAN_HandleTypeDef* hcan)
+{
+    return hcan->ErrorCode;
+}
+
+HAL_StatusTypeDef HAL_CAN_ResetError(CAN_HandleTypeDef* hcan)
+{
+    hcan->ErrorCode = 0;
+    return HAL_OK;
+}
+
+/* Shared by the TX, RX0 and RX1 vectors, like the HAL */
+void HAL_CAN_IRQHandler(CAN_HandleTypeDef* hcan)
+{
+    static const uint32_t lec_error[8] = {
+        HAL_CAN_ERROR_NONE, HAL_CAN_ERROR_STF, HAL_CAN_ERROR_FOR, HAL_CAN_ERROR_ACK,
+        HAL_CAN_ERROR_BR, HAL_CAN_ERROR_BD, HAL_CAN_ERROR_CRC, HAL_CAN_ERROR_NONE
+    };
+    uint32_t done = tx_done_mask, alst = tx_alst_mask & tx_done_mask, terr = tx_terr_mask & tx_done_mask;
+    uint32_t errorcode = HAL_CAN_ERROR_NONE;
+    tx_done_mask = 0;
+    tx_alst_mask &= ~done;
+    tx_terr_mask &= ~done;
+
+    // A mailbox that lost arbitration or failed is only reported through ErrorCode
+    if (alst & CAN_TX_MAILBOX0) errorcode |= HAL_CAN_ERROR_TX_ALST0;
+    else if (terr & CAN_TX_MAILBOX0) errorcode |= HAL_CAN_ERROR_TX_TERR0;
+    else if (done & CAN_TX_MAILBOX0) HAL_CAN_TxMailbox0CompleteCallback(hcan);
+    if (alst & CAN_TX_MAILBOX1) errorcode |= HAL_CAN_ERROR_TX_ALST1;
+    else if (terr & CAN_TX_MAILBOX1) errorcode |= HAL_CAN_ERROR_TX_TERR1;
+    else if (done & CAN_TX_MAILBOX1) HAL_CAN_TxMailbox1CompleteCallback(hcan);
+    if (alst & CAN_TX_MAILBOX2) errorcode |= HAL_CAN_ERROR_TX_ALST2;
+    else if (terr & CAN_TX_MAILBOX2) errorcode |= HAL_CAN_ERROR_TX_TERR2;
+    else if (done & CAN_TX_MAILBOX2) HAL_CAN_TxMailbox2CompleteCallback(hcan);
+
+    if ((notifications & CAN_IT_RX_FIFO0_MSG_PENDING) && fifo_fill[0]) {
+        HAL_CAN_RxFifo0MsgPendingCallback(hcan);
+        if (fifo_fill[0]) sim_irq_pend(CAN1_RX0_IRQn);     // Level triggered while the FIFO is not empty
+    }
+    if ((notifications & CAN_IT_RX_FIFO1_MSG_PENDING) && fifo_fill[1]) {
+        HAL_CAN_RxFifo1MsgPendingCallback(hcan);
+        if (fifo_fill[1]) sim_irq_pend(CAN1_RX1_IRQn);
+    }
+
+    // Status change/error: every enabled flag still set is reported, LEC is cleared once read
+    if ((notifications & CAN_IT_ERROR) && err_pending) {
+        uint32_t esr = CAN1->ESR;
+        if ((notifications & CAN_IT_ERROR_WARNING) && (esr & CAN_ESR_EWGF)) errorcode |= HAL_CAN_ERROR_EWG;
+        if ((notifications & CAN_IT_ERROR_PASSIVE) && (esr & CAN_ESR_EPVF)) errorcode |= HAL_CAN_ERROR_EPV;
+        if ((notifications & CAN_IT_BUSOFF) && (esr & CAN_ESR_BOFF)) errorcode |= HAL_CAN_ERROR_BOF;
+        if ((notifications & CAN_IT_LAST_ERROR_CODE) && lec) {
+            errorcode |= lec_error[lec];
+            lec = 0;
+            Update_Esr();
+        }
+        err_pending = 0;
+    }
+
+    if (errorcode != HAL_CAN_ERROR_NONE) {
+        hcan->ErrorCode |= errorcode;
+        HAL_CAN_ErrorCallback(hcan);
+    }
+}
+
+__weak void HAL_CAN_MspInit(CAN_HandleTypeDef* hcan)                    { UNUSED(hcan); }
+__weak void HAL_CAN_MspDeInit(CAN_HandleTypeDef* hcan)                  { UNUSED(hcan); }
+__weak void HAL_CAN_TxMailbox0CompleteCallback(CAN_HandleTypeDef* hcan) { UNUSED(hcan); }
+__weak void HAL_CAN_TxMailbox1CompleteCallback(CAN_HandleTypeDef* hcan) { UNUSED(hcan); }
+__weak void HAL_CAN_TxMailbox2CompleteCallback(CAN_HandleTypeDef* hcan) { UNUSED(hcan); }
+__weak void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef* hcan)  { UNUSED(hcan); }
+__weak void HAL_CAN_RxFifo1MsgPendingCallback(CAN_HandleTypeDef* hcan)  { UNUSED(hcan); }
+__weak void HAL_CAN_ErrorCallback(CAN_HandleTypeDef* hcan)              { UNUSED(hcan); }
+
+/* ------------------------------------------------------------------------- */
+/* Bus                                                                       */
+/* ------------------------------------------------------------------------- */
+
+/* Standard data frame without stuffing: 44 + 8 x DLC bits, plus 3 bits interframe space */
+static uint64_t Frame_Ns(uint8_t dlc)
+{
+    uint32_t bitrate = sim_can_bitrate();
+    if (bitrate == 0) bitrate = 1000000U;
+    return (uint64_t)(47U + 8U * dlc) * SIM_NS_PER_S / bitrate;
+}
+
+/* Put the winning pending mailbox on the wire */
+static void Start_Next(uint64_t t_ns)
+{
+    int best = -1;
+    uint8_t fifo_prio = (can && can->Init.TransmitFifoPriority == ENABLE);
+
+    for (int i = 0; i < CAN_NUM_MAILBOXES; i++) {
+        if (!mailbox[i].pending) continue;
+        if (best < 0 ||
+            ( fifo_prio && mailbox[i].order < mailbox[best].order) ||
+            (!fifo_prio && mailbox[i].frame.id < mailbox[best].frame.id))
+            best = i;
+    }
+    if (best < 0) return;
+
+    if (bus_off || can->State != HAL_CAN_STATE_LISTENING) return;
+
+    uint64_t ns = Frame_Ns(mailbox[best].frame.dlc);
+    tx_current = best;
+    tx_end_ns = t_ns + ns;
+    stats.busy_ns += ns;
+}
+
+static void Deliver(const SimCanFrame_t* frame)
+{
+    uint32_t f, index;
+
+    stats.busy_ns += Frame_Ns(frame->dlc);
+    if (bus_off || !Match_Filter(frame->id, &f, &index)) {
+        stats.rx_dropped++;
+        return;
+    }
+
+    // FIFO not locked: a full FIFO overwrites its newest message
+    uint8_t slot = fifo_fill[f];
+    if (slot >= CAN_FIFO_DEPTH) {
+        slot = CAN_FIFO_DEPTH - 1;
+        stats.rx_dropped++;
+    } else {
+        fifo_fill[f]++;
+    }
+
+    RxEntry_t* e = &fifo[f][slot];
+    memset(e, 0, sizeof(*e));
+    e->header.StdId = frame->id;
+    e->header.IDE = CAN_ID_STD;
+    e->header.RTR = CAN_RTR_DATA;
+    e->header.DLC = frame->dlc;
+    e->header.Timestamp = (uint32_t)(frame->t_ns / 1000U);
+    e->header.FilterMatchIndex = index;
+    memcpy(e->data, frame->data, frame->dlc);
+    stats.rx_frames++;
+
+    uint32_t it = (f == 0) ? CAN_IT_RX_FIFO0_MSG_PENDING : CAN_IT_RX_FIFO1_MSG_PENDING;
+    if (notifications & it) sim_irq_pend((f == 0) ? CAN1_RX0_IRQn : CAN1_RX1_IRQn);
+}
+
+/*
+ * Acceptance filtering for a standard data frame. The winner follows the
+ * bxCAN rules: 32-bit banks before 16-bit, list mode before mask mode, then
+ * the lowest bank. The match index counts filter entries of the same FIFO
+ * in bank order.
+ */
+static int Match_Filter(uint32_t std_id, uint32_t* fifo_out, uint32_t* index_out)
+{
+    uint32_t id32 = std_id << 21;               // STID[10:0] | EXID | IDE=0 | RTR=0 | 0
+    uint32_t id16 = std_id << 5;                // STID[10:0] | RTR=0 | IDE=0 | EXID[17:15]
+    int best = -1, best_rank = 0;
+    uint32_t best_index = 0;
+    uint32_t next_index[2] = { 0, 0 };
+
+    for (int b = 0; b < CAN_NUM_BANKS; b++) {
+        const CAN_FilterTypeDef* fb = &filter[b];
+        if (fb->FilterActivation != CAN_FILTER_ENABLE) continue;
+
+        uint32_t fr1, fr2, f = fb->FilterFIFOAssignment & 1U;
+        uint8_t scale32 = (fb->FilterScale == CAN_FILTERSCALE_32BIT);
+        uint8_t list = (fb->FilterMode == CAN_FILTERMODE_IDLIST);
+        int hit = -1;   // Entry within the bank
+
+        if (scale32) {
+            fr1 = (fb->FilterIdHigh << 16) | (fb->FilterIdLow & 0xFFFFU);
+            fr2 = (fb->FilterMaskIdHigh << 16) | (fb->FilterMaskIdLow & 0xFFFFU);
+            if (list) {
+                if (id32 == fr1) hit = 0;
+                else if (id32 == fr2) hit = 1;
+            } else if ((id32 & fr2) == (fr1 & fr2)) {
+                hit = 0;
+            }
+        } else {
+            fr1 = ((fb->FilterMaskIdLow & 0xFFFFU) << 16) | (fb->FilterIdLow & 0xFFFFU);
+            fr2 = ((fb->FilterMaskIdHigh & 0xFFFFU) << 16) | (fb->FilterIdHigh & 0xFFFFU);
+            if (list) {
+                uint16_t e[4] = { (uint16_t)fr1, (uint16_t)(fr1 >> 16), (uint16_t)fr2, (uint16_t)(fr2 >> 16) };
+                for (int k = 0; k < 4 && hit < 0; k++) if (id16 == e[k]) hit = k;
+            } else {
+                if ((id16 & (fr1 >> 16)) == (fr1 & (fr1 >> 16) & 0xFFFFU)) hit = 0;
+                else if ((id16 & (fr2 >> 16)) == (fr2 & (fr2 >> 16) & 0xFFFFU)) hit = 1;
+            }
+        }
+
+        int rank = (scale32 ? 2 : 0) + (list ? 1 : 0) + 1;
+        if (hit >= 0 && rank > best_rank) {
+            best = b;
+            best_rank = rank;
+            best_index = next_index[f] + (uint32_t)hit;
+            *fifo_out = f;
+        }
+        next_index[f] += (uint32_t)((scale32 ? 1 : 2) * (list ? 2 : 1));
+    }
+
+    *index_out = best_index;
+    return best >= 0;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Error confinement                                                         */
+/* ------------------------------------------------------------------------- */
+
+/* A TX frame failed with LEC code */
+static void Bus_Error(uint8_t code, uint64_t t_ns)
+{
+    uint32_t before = CAN1->ESR;
+
+    // An error-passive transmitter does not count ACK errors, so a lone node never goes bus-off
+    if (!(code == 3 && tec >= 128)) tec += 8;
+    lec = code;
+    if (tec > 255 && !bus_off) {
+        bus_off = 1;
+        stats.bus_offs++;
+        if (can && can->Init.AutoBusOff == ENABLE) recover_ns = t_ns + Recovery_Ns();
+    }
+    Update_Esr();
+    Raise_Error(before);
+}
+
+static void Update_Esr(void)
+{
+    uint32_t esr = ((uint32_t)(tec > 255 ? 255 : tec) << CAN_ESR_TEC_Pos) | ((uint32_t)lec << CAN_ESR_LEC_Pos);
+
+    if (tec >= 96) esr |= CAN_ESR_EWGF;
+    if (tec >= 128) esr |= CAN_ESR_EPVF;
+    if (bus_off) esr |= CAN_ESR_BOFF;
+    CAN1->ESR = esr;
+}
+
+/* ERRI: an enabled ESR flag was just set, or an error code written with its interrupt enabled */
+static void Raise_Error(uint32_t esr_before)
+{
+    uint32_t esr = CAN1->ESR, rising = esr & ~esr_before;
+
+    if (!(notifications & CAN_IT_ERROR)) return;
+    if (((rising & CAN_ESR_EWGF) && (notifications & CAN_IT_ERROR_WARNING)) ||
+        ((rising & CAN_ESR_EPVF) && (notifications & CAN_IT_ERROR_PASSIVE)) ||
+        ((rising & CAN_ESR_BOFF) && (notifications & CAN_IT_BUSOFF)) ||
+        ((esr & CAN_ESR_LEC) && (notifications & CAN_IT_LAST_ERROR_CODE))) {
+        err_pending = 1;
+        sim_irq_pend(CAN1_SCE_IRQn);
+    }
+}
+
+/* Bus-off recovery: 128 occurrences of 11 recessive bits */
+static uint64_t Recovery_Ns(void)
+{
+    uint32_t bitrate = sim_can_bitrate();
+    if (bitrate == 0) bitrate = 1000000U;
+    return 128ULL * 11U * SIM_NS_PER_S / bitrate;
+}
@@ -0,0 +1,410 @@
+/*
+ * sim_core.c
+ *
+ * Virtual clock, interrupt controller and core peripherals (RCC, DWT,
+ * TIM2) of the host simulator.
+ *
+ * sim_run_ns() is the only place time moves. It repeatedly fires the
+ * earliest peripheral event that falls inside the requested window and
+ * dispatches whatever interrupts that pended, highest NVIC priority first,
+ * to the handlers in stm32f4xx_it.c. Handlers run to completion: time they
+ * spend (HAL_GetTick calls, blocking transfers) is added to the clock but
+ * peripheral events falling inside it are only fired once the handler has
+ * returned, with their original timestamps. There is no preemption between
+ * interrupt priorities.
+ */
+
+#include "sim_internal.h"
+#include "main.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Peripheral register blocks referenced through the stub HAL macros */
+GPIO_TypeDef sim_gpio[4];
+TIM_TypeDef sim_tim2;
+RCC_TypeDef sim_rcc;
+DWT_Type sim_dwt;
+CoreDebug_Type sim_coredebug;
+I2C_TypeDef sim_i2c1_instance = { 1 };
+CAN_TypeDef sim_can1_instance;
+USART_TypeDef sim_usart2_instance = { 2 };
+DMA_Stream_TypeDef sim_dma1_stream6_instance = { 6 };
+
+uint32_t SystemCoreClock = 84000000U;   // Set by sim_set_clocks() to the firmware's clock profile
+static uint8_t apb1_div = 2;
+static uint8_t apb2_div = 1;
+
+/* Vectors the firmware may define in stm32f4xx_it.c; missing ones are simply never called */
+extern void EXTI0_IRQHandler(void) __attribute__((weak));
+extern void EXTI1_IRQHandler(void) __attribute__((weak));
+extern void EXTI2_IRQHandler(void) __attribute__((weak));
+extern void EXTI3_IRQHandler(void) __attribute__((weak));
+extern void EXTI4_IRQHandler(void) __attribute__((weak));
+extern void EXTI9_5_IRQHandler(void) __attribute__((weak));
+extern void EXTI15_10_IRQHandler(void) __attribute__((weak));
+extern void DMA1_Stream6_IRQHandler(void) __attribute__((weak));
+extern void CAN1_TX_IRQHandler(void) __attribute__((weak));
+extern void CAN1_RX0_IRQHandler(void) __attribute__((weak));
+extern void CAN1_RX1_IRQHandler(void) __attribute__((weak));
+extern void CAN1_SCE_IRQHandler(void) __attribute__((weak));
+extern void TIM2_IRQHandler(void) __attribute__((weak));
+extern void I2C1_EV_IRQHandler(void) __attribute__((weak));
+extern void I2C1_ER_IRQHandler(void) __attribute__((weak));
+extern void USART2_IRQHandler(void) __attribute__((weak));
+extern void FMPI2C1_EV_IRQHandler(void) __attribute__((weak));
+extern void FMPI2C1_ER_IRQHandler(void) __attribute__((weak));
+
+#define SIM_NUM_IRQ     97
+
+static uint64_t now_ns;
+static uint32_t primask;
+static uint8_t in_isr;
+static uint32_t irq_taken;              // Handlers run so far, lets WFI see a wake-up
+static uint64_t wake_at;                // Harness limit on WFI sleeps, 0 = none
+static SimConfig_t config;
+
+static uint8_t irq_enabled[SIM_NUM_IRQ];
+static uint8_t irq_pending[SIM_NUM_IRQ];
+static uint8_t irq_priority[SIM_NUM_IRQ];
+
+/* Local Prototypes */
+static void Set_Time(uint64_t t_ns);
+static void Dispatch_Irqs(void);
+static int Irq_Waiting(void);
+static void (*Vector(int irqn))(void);
+static uint64_t Tim2_TickNs(void);
+static uint64_t Tim2_Next(void);
+static void Tim2_Fire(uint64_t t_ns);
+
+void sim_init(void)
+{
+    now_ns = 0;
+    primask = 0;
+    in_isr = 0;
+    wake_at = 0;
+    memset(irq_enabled, 0, sizeof(irq_enabled));
+    memset(irq_pending, 0, sizeof(irq_pending));
+    memset(irq_priority, 0, sizeof(irq_priority));
+
+    config.gettick_ns = 250;
+    config.isr_entry_ns = 300;
+    config.i2c_overhead_ns = 0;
+
+    memset(&sim_tim2, 0, sizeof(sim_tim2));
+    memset(&sim_dwt, 0, sizeof(sim_dwt));
+    memset(&sim_coredebug, 0, sizeof(sim_coredebug));
+    memset(&sim_can1_instance, 0, sizeof(sim_can1_instance));
+    sim_set_clocks(84000000U, 2, 1);
+    sim_rcc.APB1ENR = 0;
+    sim_rcc.APB2ENR = 0;
+
+    sim_gpio_reset();
+    sim_ina228_reset();
+    sim_i2c_reset();
+    sim_can_reset();
+    sim_uart_reset();
+}
+
+SimConfig_t* sim_config(void)
+{
+    return &config;
+}
+
+uint64_t sim_now_ns(void)
+{
+    return now_ns;
+}
+
+double sim_now_s(void)
+{
+    return (double)now_ns / (double)SIM_NS_PER_S;
+}
+
+void sim_run_ns(uint64_t ns)
+{
+    uint64_t target = now_ns + ns;
+
+    // Handlers run to completion, peripherals catch up once they return. A TIM2
+    // match is relative to the counter, so one passed inside a handler is latched now.
+    if (in_isr) {
+        if (Tim2_Next() <= target) Tim2_Fire(target);
+        Set_Time(target);
+        return;
+    }
+
+    for (;;) {
+        Dispatch_Irqs();
+
+        // Earliest event across all models
+        uint64_t t = Tim2_Next();
+        int src = 0;
+        uint64_t n;
+        if ((n = sim_ina228_next()) < t) { t = n; src = 1; }
+        if ((n = sim_i2c_next())    < t) { t = n; src = 2; }
+        if ((n = sim_can_next())    < t) { t = n; src = 3; }
+        if ((n = sim_uart_next())   < t) { t = n; src = 4; }
+        if (t == SIM_NEVER || t > target) break;
+
+        if (t > now_ns) Set_Time(t);
+        switch (src) {
+            case 0: Tim2_Fire(t);       break;
+            case 1: sim_ina228_fire(t); break;
+            case 2: sim_i2c_fire(t);    break;
+            case 3: sim_can_fire(t);    break;
+            default: sim_uart_fire(t);  break;
+        }
+    }
+
+    if (target > now_ns) Set_Time(target);
+}
+
+void sim_cpu_ns(uint32_t ns)
+{
+    sim_run_ns(ns);
+}
+
+void sim_set_clocks(uint32_t sysclk_hz, uint8_t apb1, uint8_t apb2)
+{
+    SystemCoreClock = sysclk_hz;
+    apb1_div = apb1 ? apb1 : 1;
+    apb2_div = apb2 ? apb2 : 1;
+    sim_rcc.CFGR = (apb1_div == 1) ? RCC_CFGR_PPRE1_DIV1 : (apb1_div == 2) ? RCC_CFGR_PPRE1_DIV2 : RCC_CFGR_PPRE1_DIV4;
+}
+
+void sim_wake_at(uint64_t t_ns)
+{
+    wake_at = t_ns;
+}
+
+void sim_irq_pend(IRQn_Type irqn)
+{
+    if (irqn >= 0 && irqn < SIM_NUM_IRQ) irq_pending[irqn] = 1;
+}
+
+/* TIM2 runs from APB1 x2 whenever the APB1 prescaler is not 1 */
+uint32_t sim_timer_clock_hz(void)
+{
+    uint32_t pclk1 = HAL_RCC_GetPCLK1Freq();
+    return ((RCC->CFGR & RCC_CFGR_PPRE1) == RCC_CFGR_PPRE1_DIV1) ? pclk1 : 2U * pclk1;
+}
+
+/* Move the clock and the free-running counters the firmware reads directly */
+static void Set_Time(uint64_t t_ns)
+{
+    now_ns = t_ns;
+    sim_dwt.CYCCNT = (uint32_t)((now_ns * (SystemCoreClock / 1000000U)) / 1000U);
+    if (sim_tim2.CR1 & TIM_CR1_CEN)
+        sim_tim2.CNT = (uint32_t)(now_ns / Tim2_TickNs());
+}
+
+/* Run pending handlers, highest priority (lowest value) first, then lowest IRQ number */
+static void Dispatch_Irqs(void)
+{
+    while (!primask && !in_isr) {
+        int best = -1;
+        for (int i = 0; i < SIM_NUM_IRQ; i++) {
+            if (irq_pending[i] && irq_enabled[i] && (best < 0 || irq_priority[i] < irq_priority[best]))
+                best = i;
+        }
+        if (best < 0) return;
+
+        irq_pending[best] = 0;
+        void (*handler)(void) = Vector(best);
+        if (handler == NULL) continue;
+
+        in_isr = 1;
+        irq_taken++;
+        sim_run_ns(config.isr_entry_ns);
+        handler();
+        in_isr = 0;
+    }
+}
+
+/* An enabled interrupt is pending (held off by PRIMASK): it ends WFI */
+static int Irq_Waiting(void)
+{
+    for (int i = 0; i < SIM_NUM_IRQ; i++) {
+        if (irq_pending[i] && irq_enabled[i]) return 1;
+    }
+    return 0;
+}
+
+static void (*Vector(int irqn))(void)
+{
+    switch (irqn) {
+        case EXTI0_IRQn:        return EXTI0_IRQHandler;
+        case EXTI1_IRQn:        return EXTI1_IRQHandler;
+        case EXTI2_IRQn:        return EXTI2_IRQHandler;
+        case EXTI3_IRQn:        return EXTI3_IRQHandler;
+        case EXTI4_IRQn:        return EXTI4_IRQHandler;
+        case EXTI9_5_IRQn:      return EXTI9_5_IRQHandler;
+        case EXTI15_10_IRQn:    return EXTI15_10_IRQHandler;
+        case DMA1_Stream6_IRQn: return DMA1_Stream6_IRQHandler;
+        case CAN1_TX_IRQn:      return CAN1_TX_IRQHandler;
+        case CAN1_RX0_IRQn:     return CAN1_RX0_IRQHandler;
+        case CAN1_RX1_IRQn:     return CAN1_RX1_IRQHandler;
+        case CAN1_SCE_IRQn:     return CAN1_SCE_IRQHandler;
+        case TIM2_IRQn:         return TIM2_IRQHandler;
+        case I2C1_EV_IRQn:      return I2C1_EV_IRQHandler;
+        case I2C1_ER_IRQn:      return I2C1_ER_IRQHandler;
+        case USART2_IRQn:       return USART2_IRQHandler;
+        case FMPI2C1_EV_IRQn:   return FMPI2C1_EV_IRQHandler;
+        case FMPI2C1_ER_IRQn:   return FMPI2C1_ER_IRQHandler;
+        default:                return NULL;
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/* TIM2: counter derived from the clock, CC1 compare interrupt only           */
+/* ------------------------------------------------------------------------- */
+
+static uint64_t Tim2_TickNs(void)
+{
+    uint64_t tick = ((uint64_t)sim_tim2.PSC + 1U) * SIM_NS_PER_S / sim_timer_clock_hz();
+    return tick ? tick : 1U;
+}
+
+static uint64_t Tim2_Next(void)
+{
+    if (!(sim_tim2.CR1 & TIM_CR1_CEN) || !(sim_tim2.DIER & TIM_DIER_CC1IE)) return SIM_NEVER;
+
+    uint64_t tick = Tim2_TickNs();
+    uint64_t cnt = now_ns / tick;
+    uint32_t delta = sim_tim2.CCR1 - (uint32_t)cnt;
+    uint64_t wait = delta ? delta : (1ULL << 32);   // Equal now means the match already happened
+    return (cnt + wait) * tick;
+}
+
+static void Tim2_Fire(uint64_t t_ns)
+{
+    (void)t_ns;
+    sim_tim2.SR |= TIM_SR_CC1IF;
+    sim_irq_pend(TIM2_IRQn);
+}
+
+/* ------------------------------------------------------------------------- */
+/* HAL: core, cortex, RCC                                                    */
+/* ------------------------------------------------------------------------- */
+
+HAL_StatusTypeDef HAL_Init(void)
+{
+    return HAL_OK;
+}
+
+uint32_t HAL_GetTick(void)
+{
+    sim_run_ns(config.gettick_ns);
+    return (uint32_t)(now_ns / 1000000U);
+}
+
+/* Same semantics as the HAL: waits at least Delay + 1 tick boundaries */
+void HAL_Delay(uint32_t Delay)
+{
+    uint64_t start_ms = HAL_GetTick();
+    uint64_t wait = (Delay < HAL_MAX_DELAY) ? (uint64_t)Delay + 1U : Delay;
+    uint64_t end_ns = (start_ms + wait) * 1000000U;
+    if (end_ns > now_ns) sim_run_ns(end_ns - now_ns);
+}
+
+void HAL_IncTick(void)
+{
+}
+
+void __disable_irq(void)
+{
+    primask = 1;
+}
+
+void __enable_irq(void)
+{
+    primask = 0;
+    Dispatch_Irqs();
+}
+
+uint32_t __get_PRIMASK(void)
+{
+    return primask;
+}
+
+void __set_PRIMASK(uint32_t priMask)
+{
+    primask = priMask & 1U;
+    Dispatch_Irqs();
+}
+
+/*
+ * Sleep until an interrupt: jump the clock from event to event until one
+ * pends an enabled interrupt (or runs its handler when PRIMASK is clear),
+ * or SysTick wakes the core at the next millisecond (or the harness at
+ * sim_wake_at()).
+ */
+void __WFI(void)
+{
+    if (in_isr) return;
+
+    // SysTick wakes the core every millisecond
+    uint64_t systick = (now_ns / 1000000U + 1U) * 1000000U;
+    if (wake_at > now_ns && wake_at < systick) systick = wake_at;
+    uint32_t taken = irq_taken;
+
+    while (!Irq_Waiting() && irq_taken == taken && now_ns < systick) {
+        uint64_t t = Tim2_Next();
+        uint64_t n;
+        if ((n = sim_ina228_next()) < t) t = n;
+        if ((n = sim_i2c_next())    < t) t = n;
+        if ((n = sim_can_next())    < t) t = n;
+        if ((n = sim_uart_next())   < t) t = n;
+        if (systick < t) t = systick;
+
+        sim_run_ns(t > now_ns ? t - now_ns : 0);
+    }
+}
+
+void __NOP(void)
+{
+    sim_run_ns(1000000000U / SystemCoreClock);
+}
+
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority)
+{
+    (void)SubPriority;
+    if (IRQn >= 0 && IRQn < SIM_NUM_IRQ) irq_priority[IRQn] = (uint8_t)PreemptPriority;
+}
+
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn)
+{
+    if (IRQn >= 0 && IRQn < SIM_NUM_IRQ) irq_enabled[IRQn] = 1;
+}
+
+void HAL_NVIC_DisableIRQ(IRQn_Type IRQn)
+{
+    if (IRQn >= 0 && IRQn < SIM_NUM_IRQ) irq_enabled[IRQn] = 0;
+}
+
+uint32_t HAL_RCC_GetSysClockFreq(void)
+{
+    return SystemCoreClock;
+}
+
+uint32_t HAL_RCC_GetHCLKFreq(void)
+{
+    return SystemCoreClock;
+}
+
+uint32_t HAL_RCC_GetPCLK1Freq(void)
+{
+    return SystemCoreClock / apb1_div;
+}
+
+uint32_t HAL_RCC_GetPCLK2Freq(void)
+{
+    return SystemCoreClock / apb2_div;
+}
+
+/* main.c is not part of the simulator build */
+void Error_Handler(void)
+{
+    fprintf(stderr, "sim: Error_Handler() called at t=%.6f s\n", sim_now_s());
+    exit(2);
+}
@@ -0,0 +1,180 @@
+/*
+ * sim_gpio.c
+ *
+ * GPIO ports A-D and the EXTI edge detectors. Outputs written by the
+ * firmware are timestamped so the harness can measure reaction times.
+ * Inputs are driven by the models (the INA228 ALERT lines); an edge that
+ * matches the mode HAL_GPIO_Init() configured on the pin sets the EXTI
+ * pending bit and pends the line's NVIC vector, exactly as gpio.c wires it.
+ */
+
+#include "sim_internal.h"
+#include <string.h>
+
+#define GPIO_MODE_EXTI_FLAG     0x10000000U
+#define GPIO_MODE_EXTI_RISING   0x00100000U
+#define GPIO_MODE_EXTI_FALLING  0x00200000U
+
+static uint32_t pin_mode[4][16];
+static uint64_t changed_ns[4][16];
+static int8_t exti_port[16];            // Port selected for each EXTI line (SYSCFG_EXTICR), -1 = none
+static uint16_t exti_rising_mask, exti_falling_mask;
+static uint16_t exti_pr;                // Pending register
+
+/* Local Prototypes */
+static int Port_Index(GPIO_TypeDef* port);
+static int Pin_Index(uint16_t pin);
+static IRQn_Type Exti_Irq(int line);
+
+void sim_gpio_reset(void)
+{
+    memset(sim_gpio, 0, sizeof(GPIO_TypeDef) * 4);
+    memset(pin_mode, 0, sizeof(pin_mode));
+    memset(changed_ns, 0, sizeof(changed_ns));
+    memset(exti_port, -1, sizeof(exti_port));
+    exti_rising_mask = exti_falling_mask = 0;
+    exti_pr = 0;
+}
+
+uint8_t sim_gpio_output(GPIO_TypeDef* port, uint16_t pin)
+{
+    return (port->ODR & pin) ? 1 : 0;
+}
+
+uint64_t sim_gpio_changed_ns(GPIO_TypeDef* port, uint16_t pin)
+{
+    int p = Port_Index(port), n = Pin_Index(pin);
+    return (p < 0 || n < 0) ? 0 : changed_ns[p][n];
+}
+
+/* A model drives an input line, edges are fed to EXTI */
+void sim_gpio_drive_input(GPIO_TypeDef* port, uint16_t pin, uint8_t level)
+{
+    int p = Port_Index(port), n = Pin_Index(pin);
+    if (p < 0 || n < 0) return;
+
+    uint8_t old = (port->IDR & pin) ? 1 : 0;
+    if (level) port->IDR |= pin;
+    else       port->IDR &= ~(uint32_t)pin;
+    if (old == level || exti_port[n] != p) return;
+
+    if ((level && (exti_rising_mask & pin)) || (!level && (exti_falling_mask & pin))) {
+        exti_pr |= pin;
+        sim_irq_pend(Exti_Irq(n));
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/* HAL                                                                       */
+/* ------------------------------------------------------------------------- */
+
+void HAL_GPIO_Init(GPIO_TypeDef* GPIOx, GPIO_InitTypeDef* GPIO_Init)
+{
+    int p = Port_Index(GPIOx);
+    if (p < 0) return;
+
+    for (int n = 0; n < 16; n++) {
+        uint16_t pin = (uint16_t)(1U << n);
+        if (!(GPIO_Init->Pin & pin)) continue;
+
+        pin_mode[p][n] = GPIO_Init->Mode;
+
+        // Idle level of a pulled-up input until a model drives it
+        if (GPIO_Init->Pull == GPIO_PULLUP && (GPIO_Init->Mode & 0x3U) == GPIO_MODE_INPUT)
+            GPIOx->IDR |= pin;
+
+        if (GPIO_Init->Mode & GPIO_MODE_EXTI_FLAG) {
+            exti_port[n] = (int8_t)p;
+            if (GPIO_Init->Mode & GPIO_MODE_EXTI_RISING)  exti_rising_mask  |= pin;
+            else                                          exti_rising_mask  &= (uint16_t)~pin;
+            if (GPIO_Init->Mode & GPIO_MODE_EXTI_FALLING) exti_falling_mask |= pin;
+            else                                          exti_falling_mask &= (uint16_t)~pin;
+        }
+    }
+}
+
+void HAL_GPIO_DeInit(GPIO_TypeDef* GPIOx, uint32_t GPIO_Pin)
+{
+    int p = Port_Index(GPIOx);
+    if (p < 0) return;
+
+    for (int n = 0; n < 16; n++) {
+        if (!(GPIO_Pin & (1U << n))) continue;
+        pin_mode[p][n] = GPIO_MODE_INPUT;
+        if (exti_port[n] == p) {
+            exti_port[n] = -1;
+            exti_rising_mask  &= (uint16_t)~(1U << n);
+            exti_falling_mask &= (uint16_t)~(1U << n);
+        }
+    }
+}
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin)
+{
+    return (GPIOx->IDR & GPIO_Pin) ? GPIO_PIN_SET : GPIO_PIN_RESET;
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState)
+{
+    int p = Port_Index(GPIOx);
+    uint32_t old = GPIOx->ODR;
+
+    if (PinState == GPIO_PIN_SET) GPIOx->ODR |= GPIO_Pin;
+    else                          GPIOx->ODR &= ~(uint32_t)GPIO_Pin;
+
+    // Output pins read back their driven level
+    GPIOx->IDR = (GPIOx->IDR & ~(uint32_t)GPIO_Pin) | (GPIOx->ODR & GPIO_Pin);
+
+    uint32_t changed = old ^ GPIOx->ODR;
+    for (int n = 0; p >= 0 && n < 16; n++) {
+        if (changed & (1U << n)) changed_ns[p][n] = sim_now_ns();
+    }
+}
+
+void HAL_GPIO_TogglePin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin)
+{
+    uint32_t odr = GPIOx->ODR;
+    HAL_GPIO_WritePin(GPIOx, GPIO_Pin & (uint16_t)odr, GPIO_PIN_RESET);
+    HAL_GPIO_WritePin(GPIOx, GPIO_Pin & (uint16_t)~odr, GPIO_PIN_SET);
+}
+
+void HAL_GPIO_EXTI_IRQHandler(uint16_t GPIO_Pin)
+{
+    if (exti_pr & GPIO_Pin) {
+        exti_pr &= (uint16_t)~GPIO_Pin;
+        HAL_GPIO_EXTI_Callback(GPIO_Pin);
+    }
+}
+
+__weak void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
+{
+    UNUSED(GPIO_Pin);
+}
+
+static int Port_Index(GPIO_TypeDef* port)
+{
+    for (int i = 0; i < 4; i++) {
+        if (port == &sim_gpio[i]) return i;
+    }
+    return -1;
+}
+
+static int Pin_Index(uint16_t pin)
+{
+    for (int n = 0; n < 16; n++) {
+        if (pin == (1U << n)) return n;
+    }
+    return -1;
+}
+
+static IRQn_Type Exti_Irq(int line)
+{
+    switch (line) {
+        case 0:  return EXTI0_IRQn;
+        case 1:  return EXTI1_IRQn;
+        case 2:  return EXTI2_IRQn;
+        case 3:  return EXTI3_IRQn;
+        case 4:  return EXTI4_IRQn;
+        default: return (line < 10) ? EXTI9_5_IRQn : EXTI15_10_IRQn;
+    }
+}
@@ -0,0 +1,365 @@
+/*
+ * sim_i2c.c
+ *
+ * I2C1 and FMPI2C1 masters sharing one bus with the INA228 models as its
+ * targets. Transfer time is the number of bits on the wire at the port's
+ * speed (hi2c1.Init.ClockSpeed, or the speed given to fmpi2c_init()), plus
+ * any clock stretching injected on the target and the configured
+ * per-transfer overhead. Blocking calls consume that time in the caller
+ * (interrupts still run); interrupt-mode reads complete as an event that
+ * pends the port's EV interrupt, or its ER interrupt when the target does
+ * not acknowledge. A stuck target never completes until HAL_I2C_DeInit() or
+ * fmpi2c_deinit() aborts the transfer.
+ *
+ * FMPI2C1 is modelled at the fmpi2c.h API (fmpi2c.c programs registers the
+ * stub HAL does not have) and runs at exactly the requested speed; the
+ * TIMINGR rounding in fmpi2c.c is not modelled.
+ */
+
+#include "sim_internal.h"
+#include "fmpi2c.h"
+#include <string.h>
+
+#define I2C_ADDR_BITS       10U     // START + address + ACK
+#define I2C_BYTE_BITS       9U      // 8 data + ACK
+#define I2C_STOP_BITS       1U
+
+#define FMP_MAX_SPEED_HZ    1000000U
+
+static struct {
+    uint8_t active;
+    uint8_t fmp;                    // 1 = FMPI2C1, 0 = I2C1
+    uint8_t nack;
+    uint8_t addr7;
+    uint8_t reg;
+    uint8_t* buf;
+    uint16_t len;
+    uint64_t done_ns;
+} xfer;
+
+static uint8_t ev_pending, er_pending;     // Completion waiting for its ISR
+static SimI2cStats_t stats;
+
+static uint32_t fmp_speed;
+static uint8_t fmp_busy;
+
+/* Local Prototypes */
+static uint64_t Xfer_Ns(uint32_t speed, uint8_t addr7, uint32_t bits);
+static HAL_StatusTypeDef Blocking_Xfer(uint32_t speed, uint8_t addr7, uint32_t bits, uint32_t Timeout);
+static void It_Begin(uint8_t fmp, uint32_t speed, uint8_t addr7, uint8_t reg, uint8_t* buf, uint16_t len);
+
+void sim_i2c_reset(void)
+{
+    memset(&xfer, 0, sizeof(xfer));
+    ev_pending = er_pending = 0;
+    memset(&stats, 0, sizeof(stats));
+    fmp_speed = 0;
+    fmp_busy = 0;
+}
+
+uint64_t sim_i2c_next(void)
+{
+    return xfer.active ? xfer.done_ns : SIM_NEVER;
+}
+
+void sim_i2c_fire(uint64_t t_ns)
+{
+    (void)t_ns;
+    xfer.active = 0;
+
+    if (xfer.nack) {
+        er_pending = 1;
+        sim_irq_pend(xfer.fmp ? FMPI2C1_ER_IRQn : I2C1_ER_IRQn);
+    } else {
+        sim_ina228_read(xfer.addr7, xfer.reg, xfer.buf, xfer.len);
+        ev_pending = 1;
+        sim_irq_pend(xfer.fmp ? FMPI2C1_EV_IRQn : I2C1_EV_IRQn);
+    }
+}
+
+void sim_i2c_stats(SimI2cStats_t* out)
+{
+    *out = stats;
+}
+
+/* ------------------------------------------------------------------------- */
+/* HAL                                                                       */
+/* ------------------------------------------------------------------------- */
+
+HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef* hi2c)
+{
+    if (hi2c->State == HAL_I2C_STATE_RESET) HAL_I2C_MspInit(hi2c);
+    hi2c->State = HAL_I2C_STATE_READY;
+    hi2c->ErrorCode = 0;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_DeInit(I2C_HandleTypeDef* hi2c)
+{
+    if (xfer.active && !xfer.fmp) {
+        stats.aborts++;
+        xfer.active = 0;
+    }
+    if (!xfer.fmp) ev_pending = er_pending = 0;
+
+    HAL_I2C_MspDeInit(hi2c);
+    hi2c->State = HAL_I2C_STATE_RESET;
+    hi2c->ErrorCode = 0;
+    return HAL_OK;
+}
+
+HAL_I2C_StateTypeDef HAL_I2C_GetState(I2C_HandleTypeDef* hi2c)
+{
+    return hi2c->State;
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Transmit(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint8_t* pData, uint16_t Size, uint32_t Timeout)
+{
+    uint8_t addr7 = (uint8_t)(DevAddress >> 1);
+
+    if (hi2c->State != HAL_I2C_STATE_READY) return HAL_BUSY;
+    hi2c->State = HAL_I2C_STATE_BUSY;
+
+    HAL_StatusTypeDef status = Blocking_Xfer(hi2c->Init.ClockSpeed, addr7, I2C_ADDR_BITS + I2C_BYTE_BITS * Size + I2C_STOP_BITS, Timeout);
+    if (status == HAL_OK) sim_ina228_write(addr7, pData, Size);
+
+    hi2c->ErrorCode = (status == HAL_ERROR) ? HAL_I2C_ERROR_AF : 0;
+    hi2c->State = HAL_I2C_STATE_READY;
+    return status;
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Write(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t* pData, uint16_t Size, uint32_t Timeout)
+{
+    uint8_t frame[1 + 16];
+    (void)MemAddSize;
+
+    if (Size > 16) return HAL_ERROR;
+    frame[0] = (uint8_t)MemAddress;
+    memcpy(&frame[1], pData, Size);
+    return HAL_I2C_Master_Transmit(hi2c, DevAddress, frame, (uint16_t)(Size + 1), Timeout);
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Read(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t* pData, uint16_t Size, uint32_t Timeout)
+{
+    uint8_t addr7 = (uint8_t)(DevAddress >> 1);
+    uint32_t bits = 2U * I2C_ADDR_BITS + I2C_BYTE_BITS * (1U + Size) + I2C_STOP_BITS;   // Write pointer, repeated START, read
+    (void)MemAddSize;
+
+    if (hi2c->State != HAL_I2C_STATE_READY) return HAL_BUSY;
+    hi2c->State = HAL_I2C_STATE_BUSY;
+
+    HAL_StatusTypeDef status = Blocking_Xfer(hi2c->Init.ClockSpeed, addr7, bits, Timeout);
+    if (status == HAL_OK) sim_ina228_read(addr7, (uint8_t)MemAddress, pData, Size);
+
+    hi2c->ErrorCode = (status == HAL_ERROR) ? HAL_I2C_ERROR_AF : 0;
+    hi2c->State = HAL_I2C_STATE_READY;
+    return status;
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Read_IT(I2C_HandleTypeDef* hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t* pData, uint16_t Size)
+{
+    (void)MemAddSize;
+
+    if (hi2c->State != HAL_I2C_STATE_READY) return HAL_BUSY;
+    hi2c->State = HAL_I2C_STATE_BUSY_RX;
+    hi2c->ErrorCode = 0;
+
+    It_Begin(0, hi2c->Init.ClockSpeed, (uint8_t)(DevAddress >> 1), (uint8_t)MemAddress, pData, Size);
+    return HAL_OK;
+}
+
+void HAL_I2C_EV_IRQHandler(I2C_HandleTypeDef* hi2c)
+{
+    if (!ev_pending || xfer.fmp) return;
+    ev_pending = 0;
+    hi2c->State = HAL_I2C_STATE_READY;
+    HAL_I2C_MemRxCpltCallback(hi2c);
+}
+
+void HAL_I2C_ER_IRQHandler(I2C_HandleTypeDef* hi2c)
+{
+    if (!er_pending || xfer.fmp) return;
+    er_pending = 0;
+    hi2c->State = HAL_I2C_STATE_READY;
+    hi2c->ErrorCode = HAL_I2C_ERROR_AF;
+    HAL_I2C_ErrorCallback(hi2c);
+}
+
+__weak void HAL_I2C_MspInit(I2C_HandleTypeDef* hi2c)
+{
+    UNUSED(hi2c);
+}
+
+__weak void HAL_I2C_MspDeInit(I2C_HandleTypeDef* hi2c)
+{
+    UNUSED(hi2c);
+}
+
+__weak void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef* hi2c)
+{
+    UNUSED(hi2c);
+}
+
+__weak void HAL_I2C_ErrorCallback(I2C_HandleTypeDef* hi2c)
+{
+    UNUSED(hi2c);
+}
+
+/* ------------------------------------------------------------------------- */
+/* FMPI2C1 (fmpi2c.h)                                                        */
+/* ------------------------------------------------------------------------- */
+
+HAL_StatusTypeDef fmpi2c_init(uint32_t speed_hz)
+{
+    if (speed_hz == 0 || speed_hz > FMP_MAX_SPEED_HZ) return HAL_ERROR;
+    fmp_speed = speed_hz;
+    fmp_busy = 0;
+
+    HAL_NVIC_SetPriority(FMPI2C1_EV_IRQn, 1, 0);
+    HAL_NVIC_EnableIRQ(FMPI2C1_EV_IRQn);
+    HAL_NVIC_SetPriority(FMPI2C1_ER_IRQn, 1, 0);
+    HAL_NVIC_EnableIRQ(FMPI2C1_ER_IRQn);
+    return HAL_OK;
+}
+
+void fmpi2c_deinit(void)
+{
+    HAL_NVIC_DisableIRQ(FMPI2C1_EV_IRQn);
+    HAL_NVIC_DisableIRQ(FMPI2C1_ER_IRQn);
+
+    if (xfer.active && xfer.fmp) {
+        stats.aborts++;
+        xfer.active = 0;
+    }
+    if (xfer.fmp) ev_pending = er_pending = 0;
+    fmp_busy = 0;
+}
+
+uint32_t fmpi2c_speed(void)
+{
+    return fmp_speed;
+}
+
+uint8_t fmpi2c_busy(void)
+{
+    return fmp_busy;
+}
+
+HAL_StatusTypeDef fmpi2c_transmit(uint8_t dev_addr, const uint8_t* data, uint16_t len, uint32_t timeout_ms)
+{
+    uint8_t addr7 = (uint8_t)(dev_addr >> 1);
+
+    if (fmp_busy) return HAL_BUSY;
+    fmp_busy = 1;
+
+    HAL_StatusTypeDef status = Blocking_Xfer(fmp_speed, addr7, I2C_ADDR_BITS + I2C_BYTE_BITS * len + I2C_STOP_BITS, timeout_ms);
+    if (status == HAL_OK) sim_ina228_write(addr7, data, len);
+
+    fmp_busy = 0;
+    return status;
+}
+
+HAL_StatusTypeDef fmpi2c_mem_read(uint8_t dev_addr, uint8_t reg, uint8_t* data, uint16_t len, uint32_t timeout_ms)
+{
+    uint8_t addr7 = (uint8_t)(dev_addr >> 1);
+
+    if (fmp_busy) return HAL_BUSY;
+    fmp_busy = 1;
+
+    HAL_StatusTypeDef status = Blocking_Xfer(fmp_speed, addr7, 2U * I2C_ADDR_BITS + I2C_BYTE_BITS * (1U + len) + I2C_STOP_BITS, timeout_ms);
+    if (status == HAL_OK) sim_ina228_read(addr7, reg, data, len);
+
+    fmp_busy = 0;
+    return status;
+}
+
+HAL_StatusTypeDef fmpi2c_mem_read_it(uint8_t dev_addr, uint8_t reg, uint8_t* data, uint16_t len)
+{
+    if (fmp_busy) return HAL_BUSY;
+    fmp_busy = 1;
+
+    It_Begin(1, fmp_speed, (uint8_t)(dev_addr >> 1), reg, data, len);
+    return HAL_OK;
+}
+
+void fmpi2c_ev_irq_handler(void)
+{
+    if (!ev_pending || !xfer.fmp) return;
+    ev_pending = 0;
+    fmp_busy = 0;
+    fmpi2c_mem_read_cplt_callback();
+}
+
+void fmpi2c_er_irq_handler(void)
+{
+    if (!er_pending || !xfer.fmp) return;
+    er_pending = 0;
+    fmp_busy = 0;
+    fmpi2c_error_callback();
+}
+
+__weak void fmpi2c_mem_read_cplt_callback(void)
+{
+}
+
+__weak void fmpi2c_error_callback(void)
+{
+}
+
+/* Wire time of a transfer, including injected clock stretching */
+static uint64_t Xfer_Ns(uint32_t speed, uint8_t addr7, uint32_t bits)
+{
+    const SimIna228Fault_t* fault = sim_ina228_fault_at(addr7);
+    uint64_t ns = (uint64_t)bits * SIM_NS_PER_S / (speed ? speed : 100000U);
+
+    stats.busy_ns += ns;
+    if (fault) ns += (uint64_t)fault->extra_latency_us * 1000U;
+    return ns + sim_config()->i2c_overhead_ns;
+}
+
+/* Run a blocking transfer up to the point where its data moves; HAL_ERROR = NACK */
+static HAL_StatusTypeDef Blocking_Xfer(uint32_t speed, uint8_t addr7, uint32_t bits, uint32_t Timeout)
+{
+    const SimIna228Fault_t* fault = sim_ina228_fault_at(addr7);
+
+    stats.transfers++;
+
+    if (fault == NULL || fault->nack) {
+        stats.errors++;
+        sim_run_ns(Xfer_Ns(speed, addr7, I2C_ADDR_BITS));
+        return HAL_ERROR;
+    }
+    if (fault->stuck) {
+        stats.timeouts++;
+        sim_run_ns((uint64_t)Timeout * 1000000U);
+        return HAL_TIMEOUT;
+    }
+
+    sim_run_ns(Xfer_Ns(speed, addr7, bits));
+    return HAL_OK;
+}
+
+/* Schedule the completion of an interrupt-mode register read */
+static void It_Begin(uint8_t fmp, uint32_t speed, uint8_t addr7, uint8_t reg, uint8_t* buf, uint16_t len)
+{
+    const SimIna228Fault_t* fault = sim_ina228_fault_at(addr7);
+
+    stats.transfers++;
+
+    xfer.active = 1;
+    xfer.fmp = fmp;
+    xfer.addr7 = addr7;
+    xfer.reg = reg;
+    xfer.buf = buf;
+    xfer.len = len;
+    xfer.nack = (fault == NULL || fault->nack);
+
+    if (xfer.nack) {
+        stats.errors++;
+        xfer.done_ns = sim_now_ns() + Xfer_Ns(speed, addr7, I2C_ADDR_BITS);
+    } else if (fault->stuck) {
+        xfer.done_ns = SIM_NEVER;
+    } else {
+        xfer.done_ns = sim_now_ns() + Xfer_Ns(speed, addr7, 2U * I2C_ADDR_BITS + I2C_BYTE_BITS * (1U + len) + I2C_STOP_BITS);
+    }
+}
@@ -0,0 +1,508 @@
+/*
+ * sim_ina228.c
+ *
+ * Register-level INA228 model, one per sensor address (0x40 + index).
+ *
+ * The ADC runs on the configured schedule: every conversion cycle takes the
+ * sum of the enabled channels' conversion times (ADC_CONFIG VBUSCT/VSHCT/
+ * VTCT plus CONFIG CONVDLY) and samples the analog waveforms at its end.
+ * Results registers update once per AVG cycles with the averaged codes.
+ * Limits are compared on every cycle, or on the averaged result with
+ * SLOWALERT, and drive DIAG_ALRT and the ALERT pin (latched with ALATCH,
+ * active low unless APOL, optionally on conversion ready with CNVR).
+ * Reading DIAG_ALRT clears the latched flags and CNVRF. CURRENT and POWER
+ * are derived from SHUNT_CAL the same way the silicon does, and ENERGY /
+ * CHARGE accumulate every averaged result.
+ */
+
+#include "sim_internal.h"
+#include "main.h"
+#include "ina228_driver.h"
+#include <math.h>
+#include <string.h>
+
+#define INA228_BASE_ADDR        0x40
+#define INA228_MANUFACTURER     0x5449
+#define INA228_DEVICE           0x2281
+#define INA228_ADCRANGE_BIT     (1U << 4)
+#define INA228_DIAG_WRITABLE    0xF000U
+
+typedef struct {
+    // Analog side
+    double rshunt;
+    double temp_c;
+    SimWaveform_t vbus, current;
+    SimIna228Fault_t fault;
+    uint32_t noise_state;
+
+    // Registers
+    uint16_t config, adc_config, shunt_cal, shunt_tempco;
+    uint16_t diag_ctrl;             // DIAG_ALRT[15:12]
+    uint16_t diag_flags;            // DIAG_ALRT[11:1]
+    uint16_t sovl, suvl, bovl, buvl, temp_limit, pwr_limit;
+    int32_t vshunt, current_code, dietemp;
+    uint32_t vbus_code, power;
+    double energy, charge;          // In ENERGY / CHARGE register LSBs
+
+    // Conversion schedule
+    uint64_t next_ns;               // End of the next conversion cycle, SIM_NEVER when idle
+    uint32_t triggered_left;        // Cycles left in a triggered (single shot) conversion
+    uint32_t avg_n;
+    double acc_vshunt, acc_vbus, acc_temp;
+    uint32_t conversions;
+    SimIna228Reads_t reads;
+    uint8_t result_unread;
+    uint8_t alert_level;
+} Ina228Model_t;
+
+static Ina228Model_t dev[SIM_NUM_INA228];
+
+/* ALERT line of each sensor, indexed like INA228_Location_t */
+static GPIO_TypeDef* const alert_port[SIM_NUM_INA228] = {
+    ALERT_BUS_GPIO_Port, ALERT_M1_GPIO_Port, ALERT_M2_GPIO_Port, ALERT_M3_GPIO_Port, ALERT_M4_GPIO_Port
+};
+static const uint16_t alert_pin[SIM_NUM_INA228] = {
+    ALERT_BUS_Pin, ALERT_M1_Pin, ALERT_M2_Pin, ALERT_M3_Pin, ALERT_M4_Pin
+};
+
+static const uint32_t conv_time_us[8] = { 50, 84, 150, 280, 540, 1052, 2074, 4120 };
+static const uint32_t avg_count[8]    = { 1, 4, 16, 64, 128, 256, 512, 1024 };
+
+/* Local Prototypes */
+static void Model_Reset(Ina228Model_t* d);
+static void Model_Schedule(Ina228Model_t* d, uint64_t from_ns);
+static uint64_t Model_CycleNs(const Ina228Model_t* d);
+static void Model_Convert(Ina228Model_t* d, uint64_t t_ns);
+static uint16_t Model_Compare(const Ina228Model_t* d, int32_t vshunt, uint32_t vbus, int32_t temp, uint32_t power);
+static void Model_UpdateAlert(uint8_t idx);
+static uint32_t Model_ReadReg(Ina228Model_t* d, uint8_t reg, uint8_t* width);
+static int32_t Model_CurrentCode(const Ina228Model_t* d, int32_t vshunt);
+static uint32_t Model_PowerCode(int32_t current, uint32_t vbus);
+static double Wave_Value(const SimWaveform_t* w, double t, uint32_t* noise_state);
+static int Index_Of(uint8_t addr7);
+static int32_t Clamp(int64_t v, int64_t lo, int64_t hi);
+
+void sim_ina228_reset(void)
+{
+    for (uint8_t i = 0; i < SIM_NUM_INA228; i++) {
+        Ina228Model_t* d = &dev[i];
+        memset(d, 0, sizeof(*d));
+        d->rshunt = (i == 0) ? 0.003 : 0.006;
+        d->temp_c = 25.0;
+        d->vbus = sim_wave_const(0.0);
+        d->current = sim_wave_const(0.0);
+        d->noise_state = 0x12345u + i;
+        Model_Reset(d);
+        Model_Schedule(d, 0);
+        d->alert_level = 1;
+        sim_gpio_drive_input(alert_port[i], alert_pin[i], 1);
+    }
+}
+
+uint64_t sim_ina228_next(void)
+{
+    uint64_t t = SIM_NEVER;
+    for (uint8_t i = 0; i < SIM_NUM_INA228; i++) {
+        if (dev[i].next_ns < t) t = dev[i].next_ns;
+    }
+    return t;
+}
+
+void sim_ina228_fire(uint64_t t_ns)
+{
+    for (uint8_t i = 0; i < SIM_NUM_INA228; i++) {
+        if (dev[i].next_ns != t_ns) continue;
+        Model_Convert(&dev[i], t_ns);
+        Model_UpdateAlert(i);
+        return;
+    }
+}
+
+uint8_t sim_ina228_present(uint8_t addr7)
+{
+    return Index_Of(addr7) >= 0;
+}
+
+const SimIna228Fault_t* sim_ina228_fault_at(uint8_t addr7)
+{
+    int i = Index_Of(addr7);
+    return (i < 0) ? NULL : &dev[i].fault;
+}
+
+/* Register read over I2C: big-endian, as many bytes as the master clocks out */
+void sim_ina228_read(uint8_t addr7, uint8_t reg, uint8_t* data, uint16_t len)
+{
+    int i = Index_Of(addr7);
+    if (i < 0) return;
+
+    Ina228Model_t* d = &dev[i];
+    uint8_t width;
+    uint64_t value = Model_ReadReg(d, reg, &width);
+    if (reg == INA228_REG_ENERGY || reg == INA228_REG_CHARGE) {
+        value = (reg == INA228_REG_ENERGY) ? (uint64_t)d->energy : (uint64_t)(int64_t)d->charge;
+        value &= 0xFFFFFFFFFFULL;
+        width = 5;
+    }
+
+    for (uint16_t b = 0; b < len; b++) {
+        data[b] = (b < width) ? (uint8_t)(value >> (8 * (width - 1 - b))) : 0xFF;
+    }
+
+    if (reg == INA228_REG_VBUS) {
+        d->reads.reads++;
+        if (d->result_unread) d->reads.fresh_reads++;
+        d->result_unread = 0;
+    }
+
+    // Reading an accumulator clears its overflow flag
+    if (reg == INA228_REG_ENERGY) d->diag_flags &= (uint16_t)~INA228_DIAG_ENERGYOF;
+    if (reg == INA228_REG_CHARGE) d->diag_flags &= (uint16_t)~INA228_DIAG_CHARGEOF;
+
+    // Reading DIAG_ALRT clears CNVRF and the latched flags
+    if (reg == INA228_REG_DIAG_ALRT) {
+        d->diag_flags &= (uint16_t)~INA228_DIAG_CNVRF;
+        if (d->diag_ctrl & INA228_DIAG_ALATCH) d->diag_flags &= (uint16_t)~INA228_DIAG_LIMIT_FLAGS;
+        Model_UpdateAlert((uint8_t)i);
+    }
+}
+
+/* Register write over I2C: pointer byte followed by a 16-bit value */
+void sim_ina228_write(uint8_t addr7, const uint8_t* data, uint16_t len)
+{
+    int i = Index_Of(addr7);
+    if (i < 0 || len < 3) return;
+
+    Ina228Model_t* d = &dev[i];
+    uint16_t v = (uint16_t)((data[1] << 8) | data[2]);
+
+    switch (data[0]) {
+        case INA228_REG_CONFIG:
+            if (v & INA228_CONFIG_RST) {
+                Model_Reset(d);
+            } else {
+                if (v & INA228_CONFIG_RSTACC) d->energy = d->charge = 0.0;
+                d->config = v & (uint16_t)~(INA228_CONFIG_RST | INA228_CONFIG_RSTACC);
+            }
+            Model_Schedule(d, sim_now_ns());
+            break;
+        case INA228_REG_ADC_CONFIG:
+            d->adc_config = v;
+            Model_Schedule(d, sim_now_ns());
+            break;
+        case INA228_REG_SHUNT_CAL:    d->shunt_cal = v & 0x7FFF;                 break;
+        case INA228_REG_SHUNT_TEMPCO: d->shunt_tempco = v & 0x3FFF;              break;
+        case INA228_REG_DIAG_ALRT:    d->diag_ctrl = v & INA228_DIAG_WRITABLE;   break;
+        case INA228_REG_SOVL:         d->sovl = v;                               break;
+        case INA228_REG_SUVL:         d->suvl = v;                               break;
+        case INA228_REG_BOVL:         d->bovl = v & 0x7FFF;                      break;
+        case INA228_REG_BUVL:         d->buvl = v & 0x7FFF;                      break;
+        case INA228_REG_TEMP_LIMIT:   d->temp_limit = v;                         break;
+        case INA228_REG_PWR_LIMIT:    d->pwr_limit = v;                          break;
+        default: break;
+    }
+    Model_UpdateAlert((uint8_t)i);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Harness API                                                               */
+/* ------------------------------------------------------------------------- */
+
+void sim_ina228_set_voltage(uint8_t idx, SimWaveform_t wave)
+{
+    if (idx < SIM_NUM_INA228) dev[idx].vbus = wave;
+}
+
+void sim_ina228_set_current(uint8_t idx, SimWaveform_t wave)
+{
+    if (idx < SIM_NUM_INA228) dev[idx].current = wave;
+}
+
+void sim_ina228_set_shunt(uint8_t idx, double ohms)
+{
+    if (idx < SIM_NUM_INA228) dev[idx].rshunt = ohms;
+}
+
+void sim_ina228_set_temperature(uint8_t idx, double celsius)
+{
+    if (idx < SIM_NUM_INA228) dev[idx].temp_c = celsius;
+}
+
+/* Preload ENERGY / CHARGE (register LSBs), e.g. just below the wrap point */
+void sim_ina228_set_accumulators(uint8_t idx, double energy, double charge)
+{
+    if (idx < SIM_NUM_INA228) {
+        dev[idx].energy = energy;
+        dev[idx].charge = charge;
+    }
+}
+
+SimIna228Fault_t* sim_ina228_fault(uint8_t idx)
+{
+    return (idx < SIM_NUM_INA228) ? &dev[idx].fault : NULL;
+}
+
+uint32_t sim_ina228_reg(uint8_t idx, uint8_t reg)
+{
+    uint8_t width;
+    return (idx < SIM_NUM_INA228) ? Model_ReadReg(&dev[idx], reg, &width) : 0;
+}
+
+uint32_t sim_ina228_conversions(uint8_t idx)
+{
+    return (idx < SIM_NUM_INA228) ? dev[idx].conversions : 0;
+}
+
+void sim_ina228_read_stats(uint8_t idx, SimIna228Reads_t* stats)
+{
+    if (idx < SIM_NUM_INA228) *stats = dev[idx].reads;
+}
+
+SimWaveform_t sim_wave_const(double value)
+{
+    SimWaveform_t w = { SIM_WAVE_CONST, value, 0.0, 0.0, 0.0, 0.0, 0.0 };
+    return w;
+}
+
+SimWaveform_t sim_wave_step(double before, double after, double t0)
+{
+    SimWaveform_t w = { SIM_WAVE_STEP, before, after, t0, 0.0, 0.0, 0.0 };
+    return w;
+}
+
+SimWaveform_t sim_wave_rc(double from, double to, double t0, double tau)
+{
+    SimWaveform_t w = { SIM_WAVE_RC, from, to, t0, tau, 0.0, 0.0 };
+    return w;
+}
+
+SimWaveform_t sim_wave_sine(double offset, double amplitude, double freq)
+{
+    SimWaveform_t w = { SIM_WAVE_SINE, offset, amplitude, 0.0, 0.0, freq, 0.0 };
+    return w;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Model                                                                     */
+/* ------------------------------------------------------------------------- */
+
+/* Power-on / RST register values (datasheet Table 7-3) */
+static void Model_Reset(Ina228Model_t* d)
+{
+    d->config = 0x0000;
+    d->adc_config = 0xFB68;         // Continuous all, 1052us, AVG 1
+    d->shunt_cal = 0x1000;
+    d->shunt_tempco = 0;
+    d->diag_ctrl = 0;
+    d->diag_flags = 0;
+    d->sovl = 0x7FFF;
+    d->suvl = 0x8000;
+    d->bovl = 0x7FFF;
+    d->buvl = 0;
+    d->temp_limit = 0x7FFF;
+    d->pwr_limit = 0xFFFF;
+    d->vshunt = d->current_code = d->dietemp = 0;
+    d->vbus_code = d->power = 0;
+    d->energy = d->charge = 0.0;
+    d->avg_n = 0;
+    d->acc_vshunt = d->acc_vbus = d->acc_temp = 0.0;
+}
+
+/* Restart the conversion schedule after a CONFIG / ADC_CONFIG write */
+static void Model_Schedule(Ina228Model_t* d, uint64_t from_ns)
+{
+    uint8_t mode = (uint8_t)(d->adc_config >> 12);
+
+    d->avg_n = 0;
+    d->acc_vshunt = d->acc_vbus = d->acc_temp = 0.0;
+
+    if ((mode & 0x7) == 0) {
+        d->next_ns = SIM_NEVER;     // Shutdown
+        return;
+    }
+    d->triggered_left = (mode & 0x8) ? 0 : avg_count[d->adc_config & 0x7];
+    d->next_ns = from_ns + Model_CycleNs(d);
+}
+
+static uint64_t Model_CycleNs(const Ina228Model_t* d)
+{
+    uint8_t mode = (uint8_t)(d->adc_config >> 12);
+    uint64_t us = 0;
+
+    if (mode & 0x1) us += conv_time_us[(d->adc_config >> 9) & 0x7];
+    if (mode & 0x2) us += conv_time_us[(d->adc_config >> 6) & 0x7];
+    if (mode & 0x4) us += conv_time_us[(d->adc_config >> 3) & 0x7];
+    us += 2000U * ((d->config >> 6) & 0xFF);    // CONVDLY, 2ms steps
+    return us * 1000U;
+}
+
+/* One conversion cycle completes at t_ns */
+static void Model_Convert(Ina228Model_t* d, uint64_t t_ns)
+{
+    double t = (double)t_ns / (double)SIM_NS_PER_S;
+    double vsh_lsb = (d->config & INA228_ADCRANGE_BIT) ? 78.125e-9 : 312.5e-9;
+    double amps = Wave_Value(&d->current, t, &d->noise_state);
+    double volts = Wave_Value(&d->vbus, t, &d->noise_state);
+
+    int32_t vshunt = Clamp(llround(amps * d->rshunt / vsh_lsb), -524288, 524287);
+    uint32_t vbus = (uint32_t)Clamp(llround(volts / INA228_VBUS_LSB), 0, 1048575);
+    int32_t temp = Clamp(llround(d->temp_c / INA228_DIETEMP_LSB), -32768, 32767);
+
+    d->conversions++;
+    d->acc_vshunt += vshunt;
+    d->acc_vbus += vbus;
+    d->acc_temp += temp;
+
+    uint16_t slow = d->diag_ctrl & INA228_DIAG_SLOWALERT;
+    uint16_t hit = 0;
+    if (!slow) hit = Model_Compare(d, vshunt, vbus, temp, Model_PowerCode(Model_CurrentCode(d, vshunt), vbus));
+
+    if (++d->avg_n >= avg_count[d->adc_config & 0x7]) {
+        double n = (double)d->avg_n;
+        d->vshunt = (int32_t)lround(d->acc_vshunt / n);
+        d->vbus_code = (uint32_t)lround(d->acc_vbus / n);
+        d->dietemp = (int32_t)lround(d->acc_temp / n);
+        d->current_code = Model_CurrentCode(d, d->vshunt);
+        d->power = Model_PowerCode(d->current_code, d->vbus_code);
+        d->avg_n = 0;
+        d->acc_vshunt = d->acc_vbus = d->acc_temp = 0.0;
+
+        // Accumulate over the averaging window: ENERGY LSB = 16 x POWER LSB, CHARGE LSB = CURRENT LSB
+        double window_s = (double)Model_CycleNs(d) * avg_count[d->adc_config & 0x7] / (double)SIM_NS_PER_S;
+        d->energy += (double)d->power * window_s / 16.0;
+        d->charge += (double)d->current_code * window_s;
+        if (d->energy >= 1099511627776.0) {
+            d->energy -= 1099511627776.0;
+            d->diag_flags |= INA228_DIAG_ENERGYOF;
+        }
+        if (d->charge >= 549755813888.0 || d->charge < -549755813888.0) {
+            d->charge += (d->charge > 0.0) ? -1099511627776.0 : 1099511627776.0;   // Two's complement wrap
+            d->diag_flags |= INA228_DIAG_CHARGEOF;
+        }
+
+        if (slow) hit = Model_Compare(d, d->vshunt, d->vbus_code, d->dietemp, d->power);
+        d->diag_flags |= INA228_DIAG_CNVRF;
+        d->reads.results++;
+        d->result_unread = 1;
+    }
+
+    if (d->diag_ctrl & INA228_DIAG_ALATCH) d->diag_flags |= hit;
+    else if (!slow || d->avg_n == 0)        d->diag_flags = (uint16_t)((d->diag_flags & ~INA228_DIAG_LIMIT_FLAGS) | hit);
+
+    // Continuous modes run forever, triggered modes stop after one averaged result
+    if (d->triggered_left && --d->triggered_left == 0) d->next_ns = SIM_NEVER;
+    else d->next_ns = t_ns + Model_CycleNs(d);
+}
+
+/* Limit checks, each limit register is 16x coarser than the 20-bit result it guards */
+static uint16_t Model_Compare(const Ina228Model_t* d, int32_t vshunt, uint32_t vbus, int32_t temp, uint32_t power)
+{
+    uint16_t hit = 0;
+
+    if (vshunt / 16 > (int16_t)d->sovl)          hit |= INA228_DIAG_SHNTOL;
+    if (vshunt / 16 < (int16_t)d->suvl)          hit |= INA228_DIAG_SHNTUL;
+    if (vbus / 16 > d->bovl)                     hit |= INA228_DIAG_BUSOL;
+    if (vbus / 16 < d->buvl)                     hit |= INA228_DIAG_BUSUL;
+    if (temp > (int16_t)d->temp_limit)           hit |= INA228_DIAG_TMPOL;
+    if (power / 256 > d->pwr_limit)              hit |= INA228_DIAG_POL;
+    return hit;
+}
+
+/* ALERT is open drain: asserted by any limit flag, or by CNVRF when CNVR is set */
+static void Model_UpdateAlert(uint8_t idx)
+{
+    Ina228Model_t* d = &dev[idx];
+    uint8_t asserted = (d->diag_flags & INA228_DIAG_LIMIT_FLAGS) ||
+                       ((d->diag_ctrl & INA228_DIAG_CNVR) && (d->diag_flags & INA228_DIAG_CNVRF));
+    uint8_t level = (d->diag_ctrl & INA228_DIAG_APOL) ? asserted : !asserted;
+
+    if (d->fault.alert_disconnected) level = 1;
+    if (level == d->alert_level) return;
+
+    d->alert_level = level;
+    sim_gpio_drive_input(alert_port[idx], alert_pin[idx], level);
+}
+
+static uint32_t Model_ReadReg(Ina228Model_t* d, uint8_t reg, uint8_t* width)
+{
+    *width = 2;
+    switch (reg) {
+        case INA228_REG_CONFIG:          return d->config;
+        case INA228_REG_ADC_CONFIG:      return d->adc_config;
+        case INA228_REG_SHUNT_CAL:       return d->shunt_cal;
+        case INA228_REG_SHUNT_TEMPCO:    return d->shunt_tempco;
+        case INA228_REG_VSHUNT:          *width = 3; return ((uint32_t)d->vshunt & 0xFFFFF) << 4;
+        case INA228_REG_VBUS:            *width = 3; return (d->vbus_code & 0xFFFFF) << 4;
+        case INA228_REG_DIETEMP:         return (uint16_t)d->dietemp;
+        case INA228_REG_CURRENT:         *width = 3; return ((uint32_t)d->current_code & 0xFFFFF) << 4;
+        case INA228_REG_POWER:           *width = 3; return d->power & 0xFFFFFF;
+        case INA228_REG_ENERGY:          *width = 5; return (uint32_t)d->energy;
+        case INA228_REG_CHARGE:          *width = 5; return (uint32_t)(int32_t)d->charge;
+        case INA228_REG_DIAG_ALRT:
+            return d->diag_ctrl | d->diag_flags | (d->fault.memstat_fail ? 0 : INA228_DIAG_MEMSTAT);
+        case INA228_REG_SOVL:            return d->sovl;
+        case INA228_REG_SUVL:            return d->suvl;
+        case INA228_REG_BOVL:            return d->bovl;
+        case INA228_REG_BUVL:            return d->buvl;
+        case INA228_REG_TEMP_LIMIT:      return d->temp_limit;
+        case INA228_REG_PWR_LIMIT:       return d->pwr_limit;
+        case INA228_REG_MANUFACTURER_ID: return INA228_MANUFACTURER;
+        case INA228_REG_DEVICE_ID:       return INA228_DEVICE;
+        default:                         return 0;
+    }
+}
+
+/* CURRENT = VSHUNT x 4096 / SHUNT_CAL: the datasheet's SHUNT_CAL equation rearranged, valid for both ADC ranges */
+static int32_t Model_CurrentCode(const Ina228Model_t* d, int32_t vshunt)
+{
+    if (d->shunt_cal == 0) return 0;
+    return Clamp(((int64_t)vshunt * 4096) / d->shunt_cal, -524288, 524287);
+}
+
+/* POWER = |CURRENT| x VBUS, scaled so that POWER LSB = 3.2 x CURRENT LSB */
+static uint32_t Model_PowerCode(int32_t current, uint32_t vbus)
+{
+    int64_t mag = (current < 0) ? -(int64_t)current : current;
+    int64_t p = (mag * vbus) / 16384;
+    return (uint32_t)Clamp(p, 0, 0xFFFFFF);
+}
+
+static double Wave_Value(const SimWaveform_t* w, double t, uint32_t* noise_state)
+{
+    double v;
+
+    switch (w->kind) {
+        case SIM_WAVE_STEP:
+            v = (t < w->t0) ? w->a : w->b;
+            break;
+        case SIM_WAVE_RC:
+            v = (t < w->t0) ? w->a : w->a + (w->b - w->a) * (1.0 - exp(-(t - w->t0) / w->tau));
+            break;
+        case SIM_WAVE_SINE:
+            v = w->a + w->b * sin(2.0 * M_PI * w->freq * t);
+            break;
+        default:
+            v = w->a;
+            break;
+    }
+
+    if (w->noise > 0.0) {
+        // Deterministic Box-Muller on a 32-bit LCG, so runs are repeatable
+        *noise_state = *noise_state * 1664525u + 1013904223u;
+        double u1 = ((*noise_state >> 8) + 1.0) / 16777217.0;
+        *noise_state = *noise_state * 1664525u + 1013904223u;
+        double u2 = (*noise_state >> 8) / 16777216.0;
+        v += w->noise * sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+    }
+    return v;
+}
+
+static int Index_Of(uint8_t addr7)
+{
+    int i = (int)addr7 - INA228_BASE_ADDR;
+    return (i >= 0 && i < SIM_NUM_INA228) ? i : -1;
+}
+
+static int32_t Clamp(int64_t v, int64_t lo, int64_t hi)
+{
+    return (int32_t)(v < lo ? lo : (v > hi ? hi : v));
+}
@@ -0,0 +1,51 @@
+/*
+ * sim_internal.h
+ *
+ * Glue shared between the simulator's peripheral models. Every model that
+ * produces timed events exposes a next/fire pair: sim_core asks for the
+ * earliest pending event, advances the clock to it and fires it. Firing
+ * usually pends an interrupt, which sim_core dispatches to the firmware's
+ * vector (stm32f4xx_it.c) once PRIMASK allows it.
+ */
+
+#ifndef SIM_INTERNAL_H_
+#define SIM_INTERNAL_H_
+
+#include "sim.h"
+
+#define SIM_NEVER       UINT64_MAX
+#define SIM_NS_PER_S    1000000000ULL
+
+/* sim_core.c */
+void sim_irq_pend(IRQn_Type irqn);
+uint32_t sim_timer_clock_hz(void);
+
+/* sim_gpio.c */
+void sim_gpio_reset(void);
+void sim_gpio_drive_input(GPIO_TypeDef* port, uint16_t pin, uint8_t level);
+
+/* sim_ina228.c */
+void sim_ina228_reset(void);
+uint64_t sim_ina228_next(void);
+void sim_ina228_fire(uint64_t t_ns);
+uint8_t sim_ina228_present(uint8_t addr7);
+const SimIna228Fault_t* sim_ina228_fault_at(uint8_t addr7);
+void sim_ina228_read(uint8_t addr7, uint8_t reg, uint8_t* data, uint16_t len);
+void sim_ina228_write(uint8_t addr7, const uint8_t* data, uint16_t len);
+
+/* sim_i2c.c */
+void sim_i2c_reset(void);
+uint64_t sim_i2c_next(void);
+void sim_i2c_fire(uint64_t t_ns);
+
+/* sim_can.c */
+void sim_can_reset(void);
+uint64_t sim_can_next(void);
+void sim_can_fire(uint64_t t_ns);
+
+/* sim_uart.c */
+void sim_uart_reset(void);
+uint64_t sim_uart_next(void);
+void sim_uart_fire(uint64_t t_ns);
+
+#endif /* SIM_INTERNAL_H_ */
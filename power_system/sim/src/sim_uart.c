@@ -0,0 +1,222 @@
+/*
+ * sim_uart.c
+ *
+ * USART2 with its DMA1 Stream6 TX channel, as seen by the ST-LINK virtual
+ * COM port. Bytes take 10 bit times at huart2.Init.BaudRate (8N1). A DMA
+ * transfer copies the buffer when it completes, so firmware that touches a
+ * buffer while DMA still owns it shows up as corrupted output. Received
+ * bytes are delivered one at a time through HAL_UART_Receive_IT; a byte
+ * arriving while reception is not armed is lost, like an overrun.
+ */
+
+#include "sim_internal.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define UART_RX_QUEUE   256
+
+static UART_HandleTypeDef* uart;    // Handle passed to HAL_UART_Init
+
+static struct {
+    uint8_t active;
+    const uint8_t* data;
+    uint16_t len;
+    uint64_t end_ns;
+} dma_tx;
+static uint8_t dma_done;            // Transfer complete waiting for the DMA interrupt
+
+static struct {
+    uint8_t byte;
+    uint64_t t_ns;
+} rx_queue[UART_RX_QUEUE];
+static uint16_t rx_head, rx_count;
+static uint8_t* rx_buf;
+static uint16_t rx_size, rx_got;
+static uint8_t rx_done;
+static uint32_t rx_overruns;
+
+static uint8_t* out;
+static size_t out_len, out_cap;
+
+/* Local Prototypes */
+static uint64_t Byte_Ns(void);
+static void Output_Append(const uint8_t* data, size_t len);
+
+void sim_uart_reset(void)
+{
+    uart = NULL;
+    memset(&dma_tx, 0, sizeof(dma_tx));
+    dma_done = 0;
+    rx_head = rx_count = 0;
+    rx_buf = NULL;
+    rx_size = rx_got = 0;
+    rx_done = 0;
+    rx_overruns = 0;
+    out_len = 0;
+}
+
+uint64_t sim_uart_next(void)
+{
+    uint64_t t = dma_tx.active ? dma_tx.end_ns : SIM_NEVER;
+    if (rx_count && rx_queue[rx_head].t_ns < t) t = rx_queue[rx_head].t_ns;
+    return t;
+}
+
+void sim_uart_fire(uint64_t t_ns)
+{
+    if (dma_tx.active && dma_tx.end_ns == t_ns) {
+        Output_Append(dma_tx.data, dma_tx.len);
+        dma_tx.active = 0;
+        dma_done = 1;
+        sim_irq_pend(DMA1_Stream6_IRQn);
+        return;
+    }
+
+    uint8_t byte = rx_queue[rx_head].byte;
+    rx_head = (uint16_t)((rx_head + 1) % UART_RX_QUEUE);
+    rx_count--;
+
+    if (uart == NULL || uart->RxState != HAL_UART_STATE_BUSY_RX || rx_got >= rx_size) {
+        rx_overruns++;
+        return;
+    }
+    rx_buf[rx_got++] = byte;
+    if (rx_got == rx_size) {
+        rx_done = 1;
+        sim_irq_pend(USART2_IRQn);
+    }
+}
+
+void sim_uart_inject(const char* text)
+{
+    uint64_t t = sim_now_ns();
+    if (rx_count) {
+        uint64_t last = rx_queue[(rx_head + rx_count - 1) % UART_RX_QUEUE].t_ns;
+        if (last > t) t = last;
+    }
+
+    for (; *text && rx_count < UART_RX_QUEUE; text++) {
+        t += Byte_Ns();
+        uint16_t slot = (uint16_t)((rx_head + rx_count) % UART_RX_QUEUE);
+        rx_queue[slot].byte = (uint8_t)*text;
+        rx_queue[slot].t_ns = t;
+        rx_count++;
+    }
+}
+
+const uint8_t* sim_uart_output(size_t* len)
+{
+    *len = out_len;
+    return out;
+}
+
+void sim_uart_clear_output(void)
+{
+    out_len = 0;
+}
+
+/* ------------------------------------------------------------------------- */
+/* HAL                                                                       */
+/* ------------------------------------------------------------------------- */
+
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef* huart)
+{
+    if (huart->gState == HAL_UART_STATE_RESET) HAL_UART_MspInit(huart);
+    uart = huart;
+    huart->gState = HAL_UART_STATE_READY;
+    huart->RxState = HAL_UART_STATE_READY;
+    huart->ErrorCode = 0;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef* huart, const uint8_t* pData, uint16_t Size, uint32_t Timeout)
+{
+    (void)Timeout;
+    if (huart->gState != HAL_UART_STATE_READY) return HAL_BUSY;
+
+    huart->gState = HAL_UART_STATE_BUSY_TX;
+    sim_run_ns(Byte_Ns() * Size);
+    Output_Append(pData, Size);
+    huart->gState = HAL_UART_STATE_READY;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef* huart, const uint8_t* pData, uint16_t Size)
+{
+    if (huart->gState != HAL_UART_STATE_READY) return HAL_BUSY;
+    if (pData == NULL || Size == 0) return HAL_ERROR;
+
+    huart->gState = HAL_UART_STATE_BUSY_TX;
+    dma_tx.active = 1;
+    dma_tx.data = pData;
+    dma_tx.len = Size;
+    dma_tx.end_ns = sim_now_ns() + Byte_Ns() * Size;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Receive_IT(UART_HandleTypeDef* huart, uint8_t* pData, uint16_t Size)
+{
+    if (huart->RxState != HAL_UART_STATE_READY) return HAL_BUSY;
+    if (pData == NULL || Size == 0) return HAL_ERROR;
+
+    huart->RxState = HAL_UART_STATE_BUSY_RX;
+    rx_buf = pData;
+    rx_size = Size;
+    rx_got = 0;
+    return HAL_OK;
+}
+
+void HAL_UART_IRQHandler(UART_HandleTypeDef* huart)
+{
+    if (!rx_done) return;
+    rx_done = 0;
+    huart->RxState = HAL_UART_STATE_READY;
+    HAL_UART_RxCpltCallback(huart);
+}
+
+HAL_StatusTypeDef HAL_DMA_Init(DMA_HandleTypeDef* hdma)
+{
+    (void)hdma;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_DMA_DeInit(DMA_HandleTypeDef* hdma)
+{
+    (void)hdma;
+    return HAL_OK;
+}
+
+/* Transfer complete: the HAL's UART DMA callback chain ends in HAL_UART_TxCpltCallback */
+void HAL_DMA_IRQHandler(DMA_HandleTypeDef* hdma)
+{
+    UART_HandleTypeDef* huart = (UART_HandleTypeDef*)hdma->Parent;
+
+    if (!dma_done || huart == NULL) return;
+    dma_done = 0;
+    huart->gState = HAL_UART_STATE_READY;
+    HAL_UART_TxCpltCallback(huart);
+}
+
+__weak void HAL_UART_MspInit(UART_HandleTypeDef* huart)         { UNUSED(huart); }
+__weak void HAL_UART_MspDeInit(UART_HandleTypeDef* huart)       { UNUSED(huart); }
+__weak void HAL_UART_TxCpltCallback(UART_HandleTypeDef* huart)  { UNUSED(huart); }
+__weak void HAL_UART_RxCpltCallback(UART_HandleTypeDef* huart)  { UNUSED(huart); }
+__weak void HAL_UART_ErrorCallback(UART_HandleTypeDef* huart)   { UNUSED(huart); }
+
+/* 8N1: start + 8 data + stop */
+static uint64_t Byte_Ns(void)
+{
+    uint32_t baud = (uart && uart->Init.BaudRate) ? uart->Init.BaudRate : 115200U;
+    return 10ULL * SIM_NS_PER_S / baud;
+}
+
+static void Output_Append(const uint8_t* data, size_t len)
+{
+    if (out_len + len > out_cap) {
+        out_cap = (out_len + len) * 2;
+        out = realloc(out, out_cap);
+        if (out == NULL) abort();
+    }
+    memcpy(out + out_len, data, len);
+    out_len += len;
+}